@@ -0,0 +1,266 @@
+﻿/***********************************************************************
+* COPYRIGHT (C) 2018 PEPSTACK, PEPSTACK.COM
+*
+* THIS SOFTWARE IS PROVIDED 'AS-IS', WITHOUT ANY EXPRESS OR IMPLIED
+* WARRANTY. IN NO EVENT WILL THE AUTHORS BE HELD LIABLE FOR ANY DAMAGES
+* ARISING FROM THE USE OF THIS SOFTWARE.
+*
+* PERMISSION IS GRANTED TO ANYONE TO USE THIS SOFTWARE FOR ANY PURPOSE,
+* INCLUDING COMMERCIAL APPLICATIONS, AND TO ALTER IT AND REDISTRIBUTE IT
+* FREELY, SUBJECT TO THE FOLLOWING RESTRICTIONS:
+*
+*  THE ORIGIN OF THIS SOFTWARE MUST NOT BE MISREPRESENTED; YOU MUST NOT
+*  CLAIM THAT YOU WROTE THE ORIGINAL SOFTWARE. IF YOU USE THIS SOFTWARE
+*  IN A PRODUCT, AN ACKNOWLEDGMENT IN THE PRODUCT DOCUMENTATION WOULD
+*  BE APPRECIATED BUT IS NOT REQUIRED.
+*
+*  ALTERED SOURCE VERSIONS MUST BE PLAINLY MARKED AS SUCH, AND MUST NOT
+*  BE MISREPRESENTED AS BEING THE ORIGINAL SOFTWARE.
+*
+*  THIS NOTICE MAY NOT BE REMOVED OR ALTERED FROM ANY SOURCE DISTRIBUTION.
+***********************************************************************/
+
+/**
+ * @file: cstrsimd.h
+ *
+ *   substring search on x86 by SIMD (SSE2, AVX2) with runtime cpu
+ *   dispatch and scalar fallback on other platforms.
+ *
+ *   candidates are positions where both the first and the last byte of
+ *   substring are found (16 or 32 positions per compare), then only
+ *   candidates are checked by memcmp.
+ *
+ *   define CSTR_SIMD_DISABLED to build scalar only.
+ *
+ * @author: master@pepstack.com
+ *
+ * @create: 2019-10-17
+ *
+ * @update:
+ */
+#ifndef CSTRSIMD_H_INCLUDED
+#define CSTRSIMD_H_INCLUDED
+
+#if defined(__cplusplus)
+extern "C"
+{
+#endif
+
+#include "cstrut.h"
+
+#if !defined(CSTR_SIMD_DISABLED)
+# if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#   define CSTR_SIMD_X86   1
+#   define CSTR_SIMD_TARGET(isa)  __attribute__((target(isa)))
+#   include <immintrin.h>
+# elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#   define CSTR_SIMD_X86   1
+#   define CSTR_SIMD_TARGET(isa)
+#   include <intrin.h>
+#   include <immintrin.h>
+# endif
+#endif
+
+
+/* scalar: first byte by memchr, then memcmp */
+static const char * cstr_memmem_scalar (const char *str, int count, const char *sub, int sublen)
+{
+    const char *p = str;
+    const char *end = str + count - sublen;
+
+    while (p <= end) {
+        p = (const char *) memchr(p, sub[0], (size_t) (end - p + 1));
+        if (! p) {
+            break;
+        }
+
+        if (! memcmp(p + 1, sub + 1, (size_t) (sublen - 1))) {
+            return p;
+        }
+        p++;
+    }
+
+    return NULL;
+}
+
+
+#if defined(CSTR_SIMD_X86)
+
+# define CSTR_SIMD_NONE   0
+# define CSTR_SIMD_SSE2   1
+# define CSTR_SIMD_AVX2   2
+
+static int cstr_simd_ctz (unsigned int mask)
+{
+# if defined(_MSC_VER)
+    unsigned long bit;
+    _BitScanForward(&bit, mask);
+    return (int) bit;
+# else
+    return __builtin_ctz(mask);
+# endif
+}
+
+
+/* best instruction set of current cpu, detected once */
+static int cstr_simd_level (void)
+{
+    static int level = -1;
+
+    if (level == -1) {
+        int detected = CSTR_SIMD_SSE2;
+
+# if defined(_MSC_VER)
+        int info[4];
+
+        __cpuidex(info, 0, 0);
+        if (info[0] >= 7) {
+            __cpuid(info, 1);
+
+            // OSXSAVE and AVX, then YMM state enabled by os
+            if ((info[2] & (1 << 27)) && (info[2] & (1 << 28)) && (_xgetbv(0) & 6) == 6) {
+                __cpuidex(info, 7, 0);
+                if (info[1] & (1 << 5)) {
+                    detected = CSTR_SIMD_AVX2;
+                }
+            }
+        }
+# else
+        __builtin_cpu_init();
+
+        if (__builtin_cpu_supports("avx2")) {
+            detected = CSTR_SIMD_AVX2;
+        } else if (! __builtin_cpu_supports("sse2")) {
+            detected = CSTR_SIMD_NONE;
+        }
+# endif
+
+        level = detected;
+    }
+
+    return level;
+}
+
+
+CSTR_SIMD_TARGET("sse2")
+static const char * cstr_memmem_sse2 (const char *str, int count, const char *sub, int sublen)
+{
+    int i = 0;
+
+    const __m128i first = _mm_set1_epi8(sub[0]);
+    const __m128i last = _mm_set1_epi8(sub[sublen - 1]);
+
+    for (; i + sublen - 1 + 16 <= count; i += 16) {
+        const __m128i blkfirst = _mm_loadu_si128((const __m128i *) (str + i));
+        const __m128i blklast = _mm_loadu_si128((const __m128i *) (str + i + sublen - 1));
+
+        unsigned int mask = (unsigned int) _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(first, blkfirst), _mm_cmpeq_epi8(last, blklast)));
+
+        while (mask) {
+            int bit = cstr_simd_ctz(mask);
+
+            if (! memcmp(str + i + bit + 1, sub + 1, (size_t) (sublen - 2))) {
+                return str + i + bit;
+            }
+
+            mask &= mask - 1;
+        }
+    }
+
+    if (i + sublen <= count) {
+        // tail less than one block
+        return cstr_memmem_scalar(str + i, count - i, sub, sublen);
+    }
+
+    return NULL;
+}
+
+
+CSTR_SIMD_TARGET("avx2")
+static const char * cstr_memmem_avx2 (const char *str, int count, const char *sub, int sublen)
+{
+    int i = 0;
+
+    const __m256i first = _mm256_set1_epi8(sub[0]);
+    const __m256i last = _mm256_set1_epi8(sub[sublen - 1]);
+
+    for (; i + sublen - 1 + 32 <= count; i += 32) {
+        const __m256i blkfirst = _mm256_loadu_si256((const __m256i *) (str + i));
+        const __m256i blklast = _mm256_loadu_si256((const __m256i *) (str + i + sublen - 1));
+
+        unsigned int mask = (unsigned int) _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(first, blkfirst), _mm256_cmpeq_epi8(last, blklast)));
+
+        while (mask) {
+            int bit = cstr_simd_ctz(mask);
+
+            if (! memcmp(str + i + bit + 1, sub + 1, (size_t) (sublen - 2))) {
+                return str + i + bit;
+            }
+
+            mask &= mask - 1;
+        }
+    }
+
+    if (i + sublen <= count) {
+        // tail less than one block
+        return cstr_memmem_scalar(str + i, count - i, sub, sublen);
+    }
+
+    return NULL;
+}
+
+#endif /* CSTR_SIMD_X86 */
+
+
+/**
+ * cstr_memmem
+ *   find sub[0..sublen) in str[0..count), not relying on '\0'.
+ *   returns NULL if not found.
+ */
+static const char * cstr_memmem (const char *str, int count, const char *sub, int sublen)
+{
+    if (sublen <= 0) {
+        return str;
+    }
+
+    if (sublen > count) {
+        return NULL;
+    }
+
+    if (sublen == 1) {
+        return (const char *) memchr(str, sub[0], (size_t) count);
+    }
+
+#if defined(CSTR_SIMD_X86)
+    switch (cstr_simd_level()) {
+    case CSTR_SIMD_AVX2:
+        return cstr_memmem_avx2(str, count, sub, sublen);
+
+    case CSTR_SIMD_SSE2:
+        return cstr_memmem_sse2(str, count, sub, sublen);
+    }
+#endif
+
+    return cstr_memmem_scalar(str, count, sub, sublen);
+}
+
+
+/* same as cstr_containwith but by cstr_memmem */
+static int cstr_containwith_simd (const char *str, int count, const char *sub, int sublen)
+{
+    if (str == sub) {
+        return cstr_bool_true;
+    }
+
+    if (str && sub && sublen <= count) {
+        return cstr_memmem(str, count, sub, sublen)? cstr_bool_true : cstr_bool_false;
+    }
+
+    return cstr_bool_false;
+}
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /* CSTRSIMD_H_INCLUDED */
@@ -545,6 +545,31 @@ static int cstr_replace_new (const char *original, const char *pattern, const ch
 }
     
 
+#define CSTR_NUMBER_MAXLEN  63
+
+/**
+ * cstr_number_str
+ *   str[0..slen) terminated by '\0' for strto*(): str may be a slice not
+ *   terminated by '\0'. number longer than CSTR_NUMBER_MAXLEN is truncated.
+ *   returns str itself if slen < 0.
+ */
+static const char * cstr_number_str (const char *str, int slen, char numbuf[CSTR_NUMBER_MAXLEN + 1])
+{
+    if (slen < 0) {
+        return str;
+    }
+
+    if (slen > CSTR_NUMBER_MAXLEN) {
+        slen = CSTR_NUMBER_MAXLEN;
+    }
+
+    memcpy(numbuf, str, slen);
+    numbuf[slen] = '\0';
+
+    return numbuf;
+}
+
+
 static int cstr_to_dbl (const char *str, int slen, double *outval)
 {
     if (slen == 0) {
@@ -554,10 +579,13 @@ static int cstr_to_dbl (const char *str, int slen, double *outval)
         double val;
         char *endptr;
 
+        char numbuf[CSTR_NUMBER_MAXLEN + 1];
+        const char *numstr = cstr_number_str(str, slen, numbuf);
+
         /* To distinguish success/failure after call */
         errno = 0;
 
-        val = strtod(str, &endptr);
+        val = strtod(numstr, &endptr);
 
         /* Check for various possible errors */
         if ((errno == ERANGE) || (errno != 0 && val == 0)) {
@@ -565,7 +593,7 @@ static int cstr_to_dbl (const char *str, int slen, double *outval)
             return (-1);
         }
 
-        if (endptr == str) {
+        if (endptr == numstr) {
             // No digits were found
             return 0;
         }
@@ -687,10 +715,13 @@ static int cstr_to_sb8 (int base, const char *str, int slen, sb8 *outval)
         sb8 val;
         char *endptr;
 
+        char numbuf[CSTR_NUMBER_MAXLEN + 1];
+        const char *numstr = cstr_number_str(str, slen, numbuf);
+
         /* To distinguish success/failure after call */
         errno = 0;
 
-        val = strtoll(str, &endptr, base);
+        val = strtoll(numstr, &endptr, base);
 
         /* Check for various possible errors */
         if ((errno == ERANGE && (val == LLONG_MAX || val == LLONG_MIN)) || (errno != 0 && val == 0)) {
@@ -698,7 +729,7 @@ static int cstr_to_sb8 (int base, const char *str, int slen, sb8 *outval)
             return (-1);
         }
 
-        if (endptr == str) {
+        if (endptr == numstr) {
             // No digits were found
             return (0);
         }
@@ -719,10 +750,13 @@ static int cstr_to_ub8 (int base, const char *str, int slen, ub8 *outval)
         ub8 val;
         char *endptr;
 
+        char numbuf[CSTR_NUMBER_MAXLEN + 1];
+        const char *numstr = cstr_number_str(str, slen, numbuf);
+
         /* To distinguish success/failure after call */
         errno = 0;
 
-        val = strtoull(str, &endptr, base);
+        val = strtoull(numstr, &endptr, base);
 
         /* Check for various possible errors */
         if ((errno == ERANGE && (val == ULLONG_MAX || val == 0)) || (errno != 0 && val == 0)) {
@@ -730,7 +764,7 @@ static int cstr_to_ub8 (int base, const char *str, int slen, ub8 *outval)
             return (-1);
         }
 
-        if (endptr == str) {
+        if (endptr == numstr) {
             // No digits were found
             return (0);
         }
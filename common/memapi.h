@@ -176,6 +176,125 @@ static __INLINE__ void mem_free_s (void **pptr)
     }
 }
 
+
+/**
+ * mem_arena_t is a region of memory carved by mem_arena_alloc() and
+ *  freed in one shot by mem_arena_free(). it is NOT thread-safe: use an
+ *  arena per thread and mem_arena_merge() them into the owner.
+ */
+#define MEM_ARENA_ALIGN(sz)  (((sz) + 15) & ~((size_t)15))
+
+typedef struct _mem_arena_chunk_t
+{
+    struct _mem_arena_chunk_t *next;
+    size_t size;
+    size_t used;
+} mem_arena_chunk_t;
+
+
+typedef struct _mem_arena_t
+{
+    /* head chunk is the current one to carve from */
+    mem_arena_chunk_t *chunks;
+
+    /* default bytes of a chunk */
+    size_t chunksize;
+} mem_arena_t;
+
+
+static __INLINE__ void mem_arena_init (mem_arena_t *arena, size_t chunksize)
+{
+    arena->chunks = 0;
+    arena->chunksize = MEM_ARENA_ALIGN(chunksize);
+}
+
+
+/**
+ * mem_arena_alloc() returns size bytes aligned to 16 from arena.
+ * THE MEMORY IS SET TO ZERO.
+ */
+static __INLINE__ void * mem_arena_alloc (mem_arena_t *arena, size_t size)
+{
+    char *ptr;
+    mem_arena_chunk_t *chunk = arena->chunks;
+
+    size_t hdrsize = MEM_ARENA_ALIGN(sizeof(mem_arena_chunk_t));
+
+    size = MEM_ARENA_ALIGN(size);
+
+    if (! chunk || chunk->used + size > chunk->size) {
+        if (size > arena->chunksize / 4) {
+            /* big block has its own chunk behind the current one */
+            chunk = (mem_arena_chunk_t *) mem_alloc_zero(1, hdrsize + size);
+
+            chunk->size = size;
+            chunk->used = size;
+
+            if (arena->chunks) {
+                chunk->next = arena->chunks->next;
+                arena->chunks->next = chunk;
+            } else {
+                arena->chunks = chunk;
+            }
+
+            return (char *) chunk + hdrsize;
+        }
+
+        chunk = (mem_arena_chunk_t *) mem_alloc_zero(1, hdrsize + arena->chunksize);
+
+        chunk->size = arena->chunksize;
+        chunk->next = arena->chunks;
+        arena->chunks = chunk;
+    }
+
+    ptr = (char *) chunk + hdrsize + chunk->used;
+    chunk->used += size;
+
+    return ptr;
+}
+
+
+/**
+ * mem_arena_merge() moves all chunks of src into dst. src is empty after.
+ */
+static __INLINE__ void mem_arena_merge (mem_arena_t *dst, mem_arena_t *src)
+{
+    mem_arena_chunk_t *tail = src->chunks;
+
+    if (tail) {
+        while (tail->next) {
+            tail = tail->next;
+        }
+
+        if (dst->chunks) {
+            /* keep head of dst as the current chunk */
+            tail->next = dst->chunks->next;
+            dst->chunks->next = src->chunks;
+        } else {
+            dst->chunks = src->chunks;
+        }
+
+        src->chunks = 0;
+    }
+}
+
+
+/**
+ * mem_arena_free() frees all memory of arena. arena could be used again.
+ */
+static __INLINE__ void mem_arena_free (mem_arena_t *arena)
+{
+    mem_arena_chunk_t *chunk = arena->chunks;
+
+    arena->chunks = 0;
+
+    while (chunk) {
+        mem_arena_chunk_t *next = chunk->next;
+        mem_free(chunk);
+        chunk = next;
+    }
+}
+
 #if defined (_MSC_VER)
 # pragma warning(pop)
 #endif
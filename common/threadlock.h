@@ -130,6 +130,12 @@ extern "C"
     #define __interlock_get(addr)           InterlockedCompareExchange64(addr, 0, 0)
     #define __interlock_set(addr, newval)   InterlockedExchange64(addr, newval)
 
+    /* full memory barrier */
+    #define __interlock_barrier()           MemoryBarrier()
+
+    /* returns nonzero if *addr was oldval and has been set to newval */
+    #define __interlock_cas(addr, oldval, newval)  (InterlockedCompareExchange64(addr, newval, oldval) == (oldval))
+
     /* get current thread id */
     #define gettid()  GetCurrentThreadId(void)
 
@@ -168,6 +174,12 @@ extern "C"
     #define __interlock_get(addr)           __sync_fetch_and_add(addr, 0)
     #define __interlock_set(addr, newval)   __sync_lock_test_and_set(addr, newval)
 
+    /* full memory barrier */
+    #define __interlock_barrier()           __sync_synchronize()
+
+    /* returns nonzero if *addr was oldval and has been set to newval */
+    #define __interlock_cas(addr, oldval, newval)  __sync_bool_compare_and_swap(addr, oldval, newval)
+
 
     /* get current thread id */
     #define gettid()    syscall(__NR_gettid)
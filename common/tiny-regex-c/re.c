@@ -33,6 +33,7 @@
 
 #include "re.h"
 #include <stdio.h>
+#include <string.h>
 
 /* Definitions: */
 
@@ -58,10 +59,11 @@ typedef struct regex_t
 
 
 /* Private function declarations: */
-static int matchpattern(regex_t* pattern, const char* text);
+static re_t re_compile_buf(const char* pattern, regex_t* re_compiled, unsigned char* ccl_buf);
+static int matchpattern(regex_t* pattern, const char* text, const char* end);
 static int matchcharclass(char c, const char* str);
-static int matchstar(regex_t p, regex_t* pattern, const char* text);
-static int matchplus(regex_t p, regex_t* pattern, const char* text);
+static int matchstar(regex_t p, regex_t* pattern, const char* text, const char* end);
+static int matchplus(regex_t p, regex_t* pattern, const char* text, const char* end);
 static int matchone(regex_t p, char c);
 static int matchdigit(char c);
 static int matchalpha(char c);
@@ -80,11 +82,18 @@ int re_match(const char* pattern, const char* text)
 
 int re_matchp(re_t pattern, const char* text)
 {
+  return re_matchp_n(pattern, text, (int) strlen(text));
+}
+
+int re_matchp_n(re_t pattern, const char* text, int textlen)
+{
+  const char* end = text + textlen;
+
   if (pattern != 0)
   {
     if (pattern[0].type == BEGIN)
     {
-      return ((matchpattern(&pattern[1], text)) ? 0 : -1);
+      return ((matchpattern(&pattern[1], text, end)) ? 0 : -1);
     }
     else
     {
@@ -94,15 +103,15 @@ int re_matchp(re_t pattern, const char* text)
       {
         idx += 1;
         
-        if (matchpattern(pattern, text))
+        if (matchpattern(pattern, text, end))
         {
-          if (text[0] == '\0')
+          if (text == end)
             return -1;
         
           return idx;
         }
       }
-      while (*text++ != '\0');
+      while (text++ != end);
     }
   }
   return -1;
@@ -115,6 +124,24 @@ re_t re_compile(const char* pattern)
      MAX_CHAR_CLASS_LEN determines the size of buffer for chars in all char-classes in the expression. */
   static regex_t re_compiled[MAX_REGEXP_OBJECTS];
   static unsigned char ccl_buf[MAX_CHAR_CLASS_LEN];
+
+  return re_compile_buf(pattern, re_compiled, ccl_buf);
+}
+
+int re_compiled_size(void)
+{
+  return (int) (sizeof(regex_t) * MAX_REGEXP_OBJECTS + MAX_CHAR_CLASS_LEN);
+}
+
+re_t re_compile_r(const char* pattern, void* buf)
+{
+  regex_t* re_compiled = (regex_t*) buf;
+
+  return re_compile_buf(pattern, re_compiled, (unsigned char*) &re_compiled[MAX_REGEXP_OBJECTS]);
+}
+
+static re_t re_compile_buf(const char* pattern, regex_t* re_compiled, unsigned char* ccl_buf)
+{
   int ccl_bufidx = 1;
 
   char c;     /* current char in pattern   */
@@ -372,36 +399,36 @@ static int matchone(regex_t p, char c)
   }
 }
 
-static int matchstar(regex_t p, regex_t* pattern, const char* text)
+static int matchstar(regex_t p, regex_t* pattern, const char* text, const char* end)
 {
   do
   {
-    if (matchpattern(pattern, text))
+    if (matchpattern(pattern, text, end))
       return 1;
   }
-  while ((text[0] != '\0') && matchone(p, *text++));
+  while ((text != end) && matchone(p, *text++));
 
   return 0;
 }
 
-static int matchplus(regex_t p, regex_t* pattern, const char* text)
+static int matchplus(regex_t p, regex_t* pattern, const char* text, const char* end)
 {
-  while ((text[0] != '\0') && matchone(p, *text++))
+  while ((text != end) && matchone(p, *text++))
   {
-    if (matchpattern(pattern, text))
+    if (matchpattern(pattern, text, end))
       return 1;
   }
   return 0;
 }
 
-static int matchquestion(regex_t p, regex_t* pattern, const char* text)
+static int matchquestion(regex_t p, regex_t* pattern, const char* text, const char* end)
 {
   if (p.type == UNUSED)
     return 1;
-  if (matchpattern(pattern, text))
+  if (matchpattern(pattern, text, end))
       return 1;
-  if (*text && matchone(p, *text++))
-    return matchpattern(pattern, text);
+  if ((text != end) && matchone(p, *text++))
+    return matchpattern(pattern, text, end);
   return 0;
 }
 
@@ -409,27 +436,27 @@ static int matchquestion(regex_t p, regex_t* pattern, const char* text)
 #if 0
 
 /* Recursive matching */
-static int matchpattern(regex_t* pattern, const char* text)
+static int matchpattern(regex_t* pattern, const char* text, const char* end)
 {
   if ((pattern[0].type == UNUSED) || (pattern[1].type == QUESTIONMARK))
   {
-    return matchquestion(pattern[1], &pattern[2], text);
+    return matchquestion(pattern[1], &pattern[2], text, end);
   }
   else if (pattern[1].type == STAR)
   {
-    return matchstar(pattern[0], &pattern[2], text);
+    return matchstar(pattern[0], &pattern[2], text, end);
   }
   else if (pattern[1].type == PLUS)
   {
-    return matchplus(pattern[0], &pattern[2], text);
+    return matchplus(pattern[0], &pattern[2], text, end);
   }
   else if ((pattern[0].type == END) && pattern[1].type == UNUSED)
   {
-    return text[0] == '\0';
+    return text == end;
   }
-  else if ((text[0] != '\0') && matchone(pattern[0], text[0]))
+  else if ((text != end) && matchone(pattern[0], text[0]))
   {
-    return matchpattern(&pattern[1], text+1);
+    return matchpattern(&pattern[1], text+1, end);
   }
   else
   {
@@ -440,36 +467,170 @@ static int matchpattern(regex_t* pattern, const char* text)
 #else
 
 /* Iterative matching */
-static int matchpattern(regex_t* pattern, const char* text)
+static int matchpattern(regex_t* pattern, const char* text, const char* end)
 {
   do
   {
     if ((pattern[0].type == UNUSED) || (pattern[1].type == QUESTIONMARK))
     {
-      return matchquestion(pattern[0], &pattern[2], text);
+      return matchquestion(pattern[0], &pattern[2], text, end);
     }
     else if (pattern[1].type == STAR)
     {
-      return matchstar(pattern[0], &pattern[2], text);
+      return matchstar(pattern[0], &pattern[2], text, end);
     }
     else if (pattern[1].type == PLUS)
     {
-      return matchplus(pattern[0], &pattern[2], text);
+      return matchplus(pattern[0], &pattern[2], text, end);
     }
     else if ((pattern[0].type == END) && pattern[1].type == UNUSED)
     {
-      return (text[0] == '\0');
+      return (text == end);
     }
 /*  Branching is not working properly
     else if (pattern[1].type == BRANCH)
     {
-      return (matchpattern(pattern, text) || matchpattern(&pattern[2], text));
+      return (matchpattern(pattern, text, end) || matchpattern(&pattern[2], text, end));
     }
 */
   }
-  while ((text[0] != '\0') && matchone(*pattern++, *text++));
+  while ((text != end) && matchone(*pattern++, *text++));
 
   return 0;
 }
 
 #endif
+
+
+/* Automaton matching:
+   pattern is split into elements (atom with optional quantifier), 'x+' is
+   taken as 'x' followed by 'x*'. state i means element i is expected next,
+   state n means pattern matched. all states reachable are kept in a bitset
+   and moved together by each char of text. */
+
+#define NFA_ONE   0
+#define NFA_OPT   1
+#define NFA_STAR  2
+
+typedef struct
+{
+  regex_t atom;
+  unsigned char quant;
+} nfaelem_t;
+
+static unsigned long long nfaclosure(const nfaelem_t* elems, int n, unsigned long long states)
+{
+  int i;
+
+  for (i = 0; i < n; i++)
+  {
+    if ((states & (1ULL << i)) && elems[i].quant != NFA_ONE)
+    {
+      states |= (1ULL << (i + 1));
+    }
+  }
+  return states;
+}
+
+int re_matchp_nfa(re_t pattern, const char* text)
+{
+  return re_matchp_nfa_n(pattern, text, (int) strlen(text));
+}
+
+int re_matchp_nfa_n(re_t pattern, const char* text, int textlen)
+{
+  const char* end = text + textlen;
+
+  nfaelem_t elems[MAX_REGEXP_OBJECTS * 2];
+  int n = 0;
+  int anchored = 0;
+  int endanchor = 0;
+
+  unsigned long long states = 0;
+  unsigned long long accept;
+
+  if (pattern == 0)
+  {
+    return 0;
+  }
+
+  if (pattern[0].type == BEGIN)
+  {
+    anchored = 1;
+    pattern++;
+  }
+
+  while (pattern[0].type != UNUSED)
+  {
+    if (pattern[1].type == QUESTIONMARK || pattern[1].type == STAR)
+    {
+      elems[n].atom = pattern[0];
+      elems[n++].quant = (pattern[1].type == STAR ? NFA_STAR : NFA_OPT);
+      pattern += 2;
+    }
+    else if (pattern[1].type == PLUS)
+    {
+      elems[n].atom = pattern[0];
+      elems[n++].quant = NFA_ONE;
+      elems[n].atom = pattern[0];
+      elems[n++].quant = NFA_STAR;
+      pattern += 2;
+    }
+    else if (pattern[0].type == END && pattern[1].type == UNUSED)
+    {
+      endanchor = 1;
+      pattern += 1;
+    }
+    else
+    {
+      elems[n].atom = pattern[0];
+      elems[n++].quant = NFA_ONE;
+      pattern += 1;
+    }
+  }
+
+  accept = (1ULL << n);
+
+  if (anchored)
+  {
+    states = nfaclosure(elems, n, 1ULL);
+  }
+
+  for (;;)
+  {
+    int i;
+    unsigned long long next = 0;
+
+    if (!anchored && text != end)
+    {
+      /* a match may start at any char but not at end of text */
+      states |= nfaclosure(elems, n, 1ULL);
+    }
+
+    if ((states & accept) && (!endanchor || text == end))
+    {
+      return 1;
+    }
+
+    if (text == end || !states)
+    {
+      return 0;
+    }
+
+    for (i = 0; i < n; i++)
+    {
+      if ((states & (1ULL << i)) && matchone(elems[i].atom, text[0]))
+      {
+        next |= (1ULL << (i + 1));
+
+        if (elems[i].quant == NFA_STAR)
+        {
+          next |= (1ULL << i);
+        }
+      }
+    }
+
+    states = nfaclosure(elems, n, next);
+    text++;
+  }
+}
@@ -57,6 +57,21 @@ int  re_matchp(re_t pattern, const char* text);
 /* Find matches of the txt pattern inside text (will compile automatically first). */
 int  re_match(const char* pattern, const char* text);
 
+/* Size in bytes of buffer for re_compile_r. */
+int  re_compiled_size(void);
+
+/* Compile regex string pattern into buf of re_compiled_size() bytes (reentrant). */
+re_t re_compile_r(const char* pattern, void* buf);
+
+/* 1 if compiled pattern matches text as re_matchp does, else 0. runs pattern as
+   an automaton on sets of positions: linear in text, no backtracking. */
+int  re_matchp_nfa(re_t pattern, const char* text);
+
+/* Same as re_matchp and re_matchp_nfa on text[0..textlen) not terminated by '\0'. */
+int  re_matchp_n(re_t pattern, const char* text, int textlen);
+
+int  re_matchp_nfa_n(re_t pattern, const char* text, int textlen);
+
 #ifdef __cplusplus
 }
 #endif
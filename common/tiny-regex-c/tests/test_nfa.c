@@ -0,0 +1,170 @@
+/*
+ * Testing re_compile_r and the automaton matcher against the backtracking matcher
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "re.h"
+
+
+#define OK    ((char*) 1)
+#define NOK   ((char*) 0)
+
+
+char* test_vector[][3] =
+{
+  { OK,  "^abc",                      "abcdef"           },
+  { NOK, "^abc",                      "xabc"             },
+  { OK,  "def$",                      "abcdef"           },
+  { NOK, "def$",                      "abcdefx"          },
+  { OK,  "^abc$",                     "abc"              },
+  { NOK, "^abc$",                     "abcc"             },
+  { OK,  "^$",                        ""                 },
+  { NOK, "^$",                        "a"                },
+  { OK,  "[abc]",                     "1c2"              },
+  { NOK, "[abc]",                     "1C2"              },
+  { OK,  "[^abc]",                    "abcd"             },
+  { NOK, "[^abc]",                    "cab"              },
+  { OK,  "[a-f0-9]+$",                "xyz09af"          },
+  { OK,  "\\d\\d:\\d\\d",             "at 12:30"         },
+  { NOK, "\\d\\d:\\d\\d",             "at 1:30"          },
+  { OK,  "\\w+\\s\\w+",               "hello world"      },
+  { NOK, "\\W",                       "hello_world"      },
+  { OK,  "a*b",                       "b"                },
+  { OK,  "a*b",                       "aaab"             },
+  { OK,  "^a+b",                      "aaab"             },
+  { NOK, "^a+b",                      "b"                },
+  { OK,  "^colou?r$",                 "color"            },
+  { OK,  "^colou?r$",                 "colour"           },
+  { NOK, "^colou?r$",                 "colouur"          },
+  { OK,  "^.*c$",                     "abcabc"           },
+  { OK,  "^a.+c$",                    "abcabc"           },
+  { NOK, "^a.+c$",                    "ac"               },
+  { OK,  "^[\\+-]*[\\d]+$",           "+27"              },
+  { NOK, "^[\\+-]*[\\d]+$",           "+2x7"             },
+  { OK,  "^\\d*a*\\d+$",              "123"              },
+  { OK,  "x*y*z",                     "xxz"              },
+  { NOK, "^x*y*z$",                   "xxzy"             },
+};
+
+
+/* text[0..textlen) must match as the whole text of textlen bytes would */
+char* bounded_vector[][4] =
+{
+  { OK,  "^ab$",                      "abc",             (char*) 2 },
+  { NOK, "c",                         "abc",             (char*) 2 },
+  { OK,  "\\d+$",                     "12ab",            (char*) 2 },
+  { NOK, "^\\d+$",                    "12ab",            (char*) 3 },
+  { OK,  "^a*$",                      "aaab",            (char*) 3 },
+  { NOK, "b",                         "aaab",            (char*) 3 },
+  { OK,  "^$",                        "xyz",             (char*) 0 },
+  { NOK, ".",                         "xyz",             (char*) 0 },
+  { OK,  "^[^z]+$",                   "xyz",             (char*) 2 },
+};
+
+
+/* patterns cross-checked on random texts */
+const char* rand_patterns[] =
+{
+  "a+b*", "^a*b", "b$", "^[ab]+$", "a.b", "^.*1$", "\\d+\\s?a", "[^a]+1",
+  "^a?b?1", "ab*a", "\\w\\W", "^\\s*\\d", "[a-b1]*-$", "a*a*b",
+};
+
+
+static int nfa_matches(const char* pattern, const char* text, int textlen, char* buf)
+{
+  re_t re = re_compile_r(pattern, buf);
+
+  return (textlen < 0 ? re_matchp_nfa(re, text) : re_matchp_nfa_n(re, text, textlen));
+}
+
+
+static int bt_matches(const char* pattern, const char* text, int textlen, char* buf)
+{
+  re_t re = re_compile_r(pattern, buf);
+
+  return (textlen < 0 ? re_matchp(re, text) : re_matchp_n(re, text, textlen)) != (-1);
+}
+
+
+int main()
+{
+  const char* alphabet = "ab1 -";
+
+  char* buf = (char*) malloc(re_compiled_size());
+  char text[16];
+  char prefix[16];
+  size_t ntests = 0;
+  size_t nfailed = 0;
+  size_t i, j;
+
+  for (i = 0; i < sizeof(test_vector) / sizeof(*test_vector); ++i)
+  {
+    const char* pattern = test_vector[i][1];
+    const char* txt = test_vector[i][2];
+    int expect = (test_vector[i][0] == OK);
+
+    ntests++;
+
+    if (bt_matches(pattern, txt, -1, buf) != expect || nfa_matches(pattern, txt, -1, buf) != expect)
+    {
+      fprintf(stderr, "pattern '%s' on '%s': expected %s\n", pattern, txt, expect ? "match" : "no match");
+      nfailed++;
+    }
+  }
+
+  for (i = 0; i < sizeof(bounded_vector) / sizeof(*bounded_vector); ++i)
+  {
+    const char* pattern = bounded_vector[i][1];
+    const char* txt = bounded_vector[i][2];
+    int textlen = (int) (size_t) bounded_vector[i][3];
+    int expect = (bounded_vector[i][0] == OK);
+
+    ntests++;
+
+    if (bt_matches(pattern, txt, textlen, buf) != expect || nfa_matches(pattern, txt, textlen, buf) != expect)
+    {
+      fprintf(stderr, "pattern '%s' on '%.*s' (%d of '%s'): expected %s\n", pattern, textlen, txt, textlen, txt, expect ? "match" : "no match");
+      nfailed++;
+    }
+  }
+
+  srand(1);
+
+  for (i = 0; i < sizeof(rand_patterns) / sizeof(*rand_patterns); ++i)
+  {
+    for (j = 0; j < 1000; ++j)
+    {
+      int k, len = rand() % (int) (sizeof(text) - 1);
+      int cut = (len ? rand() % len : 0);
+
+      for (k = 0; k < len; ++k)
+      {
+        text[k] = alphabet[rand() % 5];
+      }
+      text[len] = '\0';
+
+      memcpy(prefix, text, cut);
+      prefix[cut] = '\0';
+
+      ntests++;
+
+      /* automaton agrees with backtracking on whole text, and bounded prefix
+         matches as the same prefix terminated by '\0' */
+      if (nfa_matches(rand_patterns[i], text, -1, buf) != bt_matches(rand_patterns[i], text, -1, buf) ||
+          nfa_matches(rand_patterns[i], text, cut, buf) != bt_matches(rand_patterns[i], prefix, -1, buf) ||
+          bt_matches(rand_patterns[i], text, cut, buf) != bt_matches(rand_patterns[i], prefix, -1, buf))
+      {
+        fprintf(stderr, "pattern '%s' on '%s' (cut %d): matchers differ\n", rand_patterns[i], text, cut);
+        nfailed++;
+      }
+    }
+  }
+
+  free(buf);
+
+  printf("%lu/%lu tests succeeded.\n", ntests - nfailed, ntests);
+
+  return (nfailed ? 1 : 0);
+}
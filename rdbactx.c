@@ -32,3 +32,478 @@
  * @update:
  */
 #include "rdbcommon.h"
+
+#include <event2/event.h>
+#include <hiredis/adapters/libevent.h>
+
+
+/**
+ * async request
+ *   argv are copied so that request can be resent on MOVED/ASK
+ */
+typedef struct _RDBACtxRequest_t
+{
+    RDBACtx actx;
+
+    RDBACtxReplyCallback cb;
+    void *arg;
+
+    int redirects;
+
+    int argc;
+    const char *argv[RDBAPI_ARGV_MAXNUM + 4];
+    size_t argvlen[RDBAPI_ARGV_MAXNUM + 4];
+
+    char argbuf[0];
+} RDBACtxRequest_t, *RDBACtxRequest;
+
+
+static RDBAPI_RESULT RDBACtxRequestSend (RDBACtxNode actxnode, RDBACtxRequest req, int asking);
+
+
+static void RDBACtxRequestFree (RDBACtxRequest req, redisReply *reply)
+{
+    if (req->cb) {
+        req->cb(req->actx, reply, req->arg);
+    }
+
+    RDBMemFree(req);
+}
+
+
+static void onRedisConnect (const redisAsyncContext *ac, int status)
+{
+    RDBACtxNode actxnode = (RDBACtxNode) ac->data;
+
+    if (status != REDIS_OK) {
+        snprintf_chkd_V1(actxnode->actx->errmsg, sizeof(actxnode->actx->errmsg), "RDBAPI_ERROR: connect node(%d) failed: %s", actxnode->index, ac->errstr);
+
+        // hiredis will free ac after this callback
+        actxnode->redAsynCtx = NULL;
+    }
+}
+
+
+static void onRedisDisconnect (const redisAsyncContext *ac, int status)
+{
+    RDBACtxNode actxnode = (RDBACtxNode) ac->data;
+
+    if (status != REDIS_OK) {
+        snprintf_chkd_V1(actxnode->actx->errmsg, sizeof(actxnode->actx->errmsg), "RDBAPI_ERROR: node(%d) disconnected: %s", actxnode->index, ac->errstr);
+    }
+
+    // hiredis will free ac after this callback
+    actxnode->redAsynCtx = NULL;
+
+    if (actxnode->actx->activenode == actxnode) {
+        actxnode->actx->activenode = NULL;
+    }
+}
+
+
+// AUTH sent on open: node is closed if password rejected, as RDBCtxNodeOpen
+//
+static void onRedisAuth (redisAsyncContext *ac, void *r, void *privdata)
+{
+    redisReply *reply = (redisReply *) r;
+    RDBACtxNode actxnode = (RDBACtxNode) privdata;
+
+    if (! reply) {
+        // ac being freed: pending callbacks are called with NULL reply
+        return;
+    }
+
+    if (! RedisIsReplyStatusOK(reply)) {
+        snprintf_chkd_V1(actxnode->actx->errmsg, sizeof(actxnode->actx->errmsg), "RDBAPI_ERROR: AUTH node(%d) failed(%d): %s", actxnode->index, reply->type, reply->str? reply->str : "");
+
+        // hiredis frees ac after callbacks return
+        RDBACtxNodeClose(actxnode);
+    }
+}
+
+
+/**
+ * redirected node from error reply:
+ *   'MOVED 7142 127.0.0.1:7002'
+ *   'ASK 7142 127.0.0.1:7002'
+ */
+static RDBACtxNode RDBACtxRedirectNode (RDBACtx actx, const char *errstr, int *slot)
+{
+    RDBEnvNode envnode;
+
+    char host[RDB_HOSTADDR_MAXLEN + 1];
+    const char *start, *end;
+    int port;
+
+    start = strchr(errstr, 32);
+    if (! start) {
+        return NULL;
+    }
+
+    *slot = atoi(++start);
+
+    start = strchr(start, 32);
+    if (! start) {
+        return NULL;
+    }
+
+    end = strrchr(++start, ':');
+    if (! end || end - start > RDB_HOSTADDR_MAXLEN) {
+        return NULL;
+    }
+
+    memcpy(host, start, end - start);
+    host[end - start] = 0;
+
+    port = atoi(end + 1);
+
+    envnode = RDBEnvFindNode(actx->env, host, (ub4) port);
+    if (! envnode) {
+        return NULL;
+    }
+
+    return RDBACtxGetNode(actx, envnode->index);
+}
+
+
+static void onRedisReply (redisAsyncContext *ac, void *r, void *privdata)
+{
+    redisReply *reply = (redisReply *) r;
+    RDBACtxRequest req = (RDBACtxRequest) privdata;
+
+    RDBACtx actx = req->actx;
+
+    if (! reply) {
+        // disconnected or freed
+        snprintf_chkd_V1(actx->errmsg, sizeof(actx->errmsg), "RDBAPI_ERROR: no reply: %s", ac->errstr);
+        RDBACtxRequestFree(req, NULL);
+        return;
+    }
+
+    if (reply->type == REDIS_REPLY_ERROR) {
+        int moved = cstr_startwith(reply->str, reply->len, "MOVED ", 6);
+        int ask = cstr_startwith(reply->str, reply->len, "ASK ", 4);
+
+        if (moved || ask) {
+            int slot = -1;
+
+            RDBACtxNode redirnode = RDBACtxRedirectNode(actx, reply->str, &slot);
+
+            if (redirnode && req->redirects++ < RDBAPI_REDIRECTS_MAXNUM) {
+                if (moved && slot >= 0 && slot < RDBAPI_CLUSTER_SLOTS) {
+                    // slot has been moved: update slots map
+                    threadlock_lock(&actx->env->thrlock);
+                    actx->env->slotsmap[slot] = (sb2) redirnode->index;
+                    threadlock_unlock(&actx->env->thrlock);
+                }
+
+                // ASK: only this request goes to target node after ASKING
+                if (RDBACtxRequestSend(redirnode, req, ask) == RDBAPI_SUCCESS) {
+                    return;
+                }
+            } else {
+                snprintf_chkd_V1(actx->errmsg, sizeof(actx->errmsg), "RDBAPI_ERROR: redirect failed: %s", reply->str);
+            }
+
+            RDBACtxRequestFree(req, NULL);
+            return;
+        }
+
+        snprintf_chkd_V1(actx->errmsg, sizeof(actx->errmsg), "REDIS_REPLY_ERROR: %s", reply->str);
+    }
+
+    RDBACtxRequestFree(req, reply);
+}
+
+
+static RDBAPI_RESULT RDBACtxRequestSend (RDBACtxNode actxnode, RDBACtxRequest req, int asking)
+{
+    if (! RDBACtxNodeIsOpen(actxnode)) {
+        if (RDBACtxNodeOpen(actxnode) != RDBAPI_SUCCESS) {
+            return RDBAPI_ERROR;
+        }
+    }
+
+    if (asking) {
+        const char *argv[] = {"asking"};
+        size_t argvlen[] = {6};
+
+        if (redisAsyncCommandArgv(actxnode->redAsynCtx, NULL, NULL, 1, argv, argvlen) != REDIS_OK) {
+            snprintf_chkd_V1(req->actx->errmsg, sizeof(req->actx->errmsg), "RDBAPI_ERROR: redisAsyncCommandArgv failed");
+            return RDBAPI_ERROR;
+        }
+    }
+
+    if (redisAsyncCommandArgv(actxnode->redAsynCtx, onRedisReply, req, req->argc, req->argv, req->argvlen) != REDIS_OK) {
+        snprintf_chkd_V1(req->actx->errmsg, sizeof(req->actx->errmsg), "RDBAPI_ERROR: redisAsyncCommandArgv failed");
+        return RDBAPI_ERROR;
+    }
+
+    actxnode->actx->activenode = actxnode;
+
+    return RDBAPI_SUCCESS;
+}
+
+
+RDBAPI_RESULT RDBACtxCreate (RDBEnv env, struct event_base *eb, RDBACtx *outactx)
+{
+    int i;
+    RDBCtx ctx = NULL;
+    RDBACtx actx;
+
+    // check cluster and load slots map by a sync ctx
+    if (RDBCtxCreate(env, &ctx) != RDBAPI_SUCCESS) {
+        return RDBAPI_ERROR;
+    }
+
+    RDBCtxFree(ctx);
+
+    actx = (RDBACtx_t *) RDBMemAlloc(sizeof(RDBACtx_t) + env->maxclusternodes * sizeof(RDBACtxNode_t));
+
+    if (! eb) {
+        eb = event_base_new();
+        if (! eb) {
+            RDBMemFree(actx);
+            return RDBAPI_ERR_NOMEM;
+        }
+
+        actx->owneb = 1;
+    }
+
+    actx->eb = eb;
+    actx->env = env;
+    actx->activenode = NULL;
+
+    for (i = 0; i < env->maxclusternodes; i++) {
+        actx->nodes[i].actx = actx;
+        actx->nodes[i].index = i;
+        actx->nodes[i].slot = -1;
+    }
+
+    *outactx = actx;
+    return RDBAPI_SUCCESS;
+}
+
+
+void RDBACtxFree (RDBACtx actx)
+{
+    if (actx) {
+        int i = 0;
+
+        for (; i < RDBEnvNumNodes(actx->env); i++) {
+            RDBACtxNodeClose(RDBACtxGetNode(actx, i));
+        }
+
+        if (actx->owneb) {
+            event_base_free(actx->eb);
+        }
+
+        RDBMemFree(actx);
+    }
+}
+
+
+RDBEnv RDBACtxGetEnv (RDBACtx actx)
+{
+    return actx->env;
+}
+
+
+struct event_base * RDBACtxGetEventBase (RDBACtx actx)
+{
+    return actx->eb;
+}
+
+
+const char * RDBACtxErrMsg (RDBACtx actx)
+{
+    return actx->errmsg;
+}
+
+
+RDBACtxNode RDBACtxGetNode (RDBACtx actx, int nodeindex)
+{
+    if (nodeindex < 0 || nodeindex >= RDBEnvNumNodes(actx->env)) {
+        return NULL;
+    } else {
+        return (&actx->nodes[nodeindex]);
+    }
+}
+
+
+RDBAPI_BOOL RDBACtxNodeIsOpen (RDBACtxNode actxnode)
+{
+    return ((actxnode && actxnode->redAsynCtx) ? RDBAPI_TRUE : RDBAPI_FALSE);
+}
+
+
+RDBAPI_RESULT RDBACtxNodeOpen (RDBACtxNode actxnode)
+{
+    redisAsyncContext *ac;
+
+    RDBACtx actx = actxnode->actx;
+    RDBEnvNode envnode = RDBEnvGetNode(actx->env, actxnode->index);
+
+    RDBACtxNodeClose(actxnode);
+
+    // connect in non-blocking mode. commands sent before connected are queued
+    ac = redisAsyncConnect(envnode->host, envnode->port);
+    if (! ac) {
+        snprintf_chkd_V1(actx->errmsg, sizeof(actx->errmsg), "RDBAPI_ERR_NOMEM: redisAsyncConnect failed");
+        return RDBAPI_ERR_NOMEM;
+    }
+
+    if (ac->err) {
+        snprintf_chkd_V1(actx->errmsg, sizeof(actx->errmsg), "RDBAPI_ERROR: redisAsyncConnect(%s) failed: %s", envnode->key, ac->errstr);
+        redisAsyncFree(ac);
+        return RDBAPI_ERROR;
+    }
+
+    ac->data = actxnode;
+
+    if (redisLibeventAttach(ac, actx->eb) != REDIS_OK) {
+        snprintf_chkd_V1(actx->errmsg, sizeof(actx->errmsg), "RDBAPI_ERROR: redisLibeventAttach failed");
+        redisAsyncFree(ac);
+        return RDBAPI_ERROR;
+    }
+
+    redisAsyncSetConnectCallback(ac, onRedisConnect);
+    redisAsyncSetDisconnectCallback(ac, onRedisDisconnect);
+
+    if (envnode->authpass[0]) {
+        const char *argv[] = {"auth", envnode->authpass};
+        size_t argvlen[] = {4, strlen(envnode->authpass)};
+
+        if (redisAsyncCommandArgv(ac, onRedisAuth, actxnode, 2, argv, argvlen) != REDIS_OK) {
+            snprintf_chkd_V1(actx->errmsg, sizeof(actx->errmsg), "RDBAPI_ERROR: AUTH node(%d) failed: %s", actxnode->index, ac->errstr);
+            redisAsyncFree(ac);
+            return RDBAPI_ERROR;
+        }
+    }
+
+    actxnode->redAsynCtx = ac;
+    actx->activenode = actxnode;
+
+    return RDBAPI_SUCCESS;
+}
+
+
+void RDBACtxNodeClose (RDBACtxNode actxnode)
+{
+    RDBACtx actx = actxnode->actx;
+
+    if (actxnode->redAsynCtx) {
+        redisAsyncContext *ac = actxnode->redAsynCtx;
+        actxnode->redAsynCtx = NULL;
+
+        // pending callbacks are called with NULL reply
+        redisAsyncFree(ac);
+    }
+
+    if (actx->activenode == actxnode) {
+        actx->activenode = NULL;
+    }
+
+    actxnode->slot = -1;
+}
+
+
+RDBAPI_RESULT RDBACtxExecArgvOnNode (RDBACtxNode actxnode, int argc, const char *argv[], const size_t *argvlen, RDBACtxReplyCallback cb, void *arg)
+{
+    int i;
+    size_t len, bufsize = 0;
+    char *argbuf;
+
+    RDBACtxRequest req;
+
+    RDBACtx actx = actxnode->actx;
+
+    *actx->errmsg = 0;
+
+    if (argc < 1 || argc > RDBAPI_ARGV_MAXNUM + 4) {
+        snprintf_chkd_V1(actx->errmsg, sizeof(actx->errmsg), "RDBAPI_ERR_BADARG: argc(%d)", argc);
+        return RDBAPI_ERR_BADARG;
+    }
+
+    for (i = 0; i < argc; i++) {
+        bufsize += (argvlen ? argvlen[i] : strlen(argv[i])) + 1;
+    }
+
+    req = (RDBACtxRequest) RDBMemAlloc(sizeof(RDBACtxRequest_t) + bufsize);
+    if (! req) {
+        snprintf_chkd_V1(actx->errmsg, sizeof(actx->errmsg), "RDBAPI_ERR_NOMEM: out of memory");
+        return RDBAPI_ERR_NOMEM;
+    }
+
+    req->actx = actx;
+    req->cb = cb;
+    req->arg = arg;
+    req->argc = argc;
+
+    argbuf = req->argbuf;
+
+    for (i = 0; i < argc; i++) {
+        len = (argvlen ? argvlen[i] : strlen(argv[i]));
+
+        memcpy(argbuf, argv[i], len);
+        argbuf[len] = 0;
+
+        req->argv[i] = argbuf;
+        req->argvlen[i] = len;
+
+        argbuf += len + 1;
+    }
+
+    if (RDBACtxRequestSend(actxnode, req, 0) != RDBAPI_SUCCESS) {
+        RDBMemFree(req);
+        return RDBAPI_ERROR;
+    }
+
+    return RDBAPI_SUCCESS;
+}
+
+
+RDBAPI_RESULT RDBACtxExecArgv (RDBACtx actx, int argc, const char *argv[], const size_t *argvlen, RDBACtxReplyCallback cb, void *arg)
+{
+    RDBACtxNode actxnode = NULL;
+
+    int keyindex = RedisCommandKeyIndex(argc, argv, argvlen);
+
+    if (keyindex) {
+        // route to master owns the key at first try
+        size_t keylen = (argvlen ? argvlen[keyindex] : strlen(argv[keyindex]));
+
+        int slot = (int) crc16_keyslot(argv[keyindex], (int) keylen);
+
+        actxnode = RDBACtxGetNode(actx, actx->env->slotsmap[slot]);
+    }
+
+    if (! actxnode) {
+        actxnode = actx->activenode;
+    }
+
+    if (! actxnode) {
+        int i = 0;
+
+        // any an master node
+        for (; i < RDBEnvNumNodes(actx->env); i++) {
+            if (RDBEnvNodeGetMaster(RDBEnvGetNode(actx->env, i), NULL)) {
+                actxnode = RDBACtxGetNode(actx, i);
+                break;
+            }
+        }
+    }
+
+    if (! actxnode) {
+        snprintf_chkd_V1(actx->errmsg, sizeof(actx->errmsg), "RDBAPI_ERROR: No active node");
+        return RDBAPI_ERROR;
+    }
+
+    return RDBACtxExecArgvOnNode(actxnode, argc, argv, argvlen, cb, arg);
+}
+
+
+int RDBACtxEventLoop (RDBACtx actx)
+{
+    return event_base_dispatch(actx->eb);
+}
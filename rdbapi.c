@@ -230,6 +230,21 @@ RDBCtx RDBThreadCtxAttach (RDBThreadCtx thrctx, RDBCtx ctx)
 }
 
 
+RDBAPI_RESULT RDBThreadCtxCheckout (RDBThreadCtx thrctx, RDBEnv env)
+{
+    RDBCtx ctx = NULL;
+
+    if (RDBCtxCheckout(env, &ctx) != RDBAPI_SUCCESS) {
+        return RDBAPI_ERROR;
+    }
+
+    // return old ctx (if checked out) to pool
+    RDBCtxFree(RDBThreadCtxAttach(thrctx, ctx));
+
+    return RDBAPI_SUCCESS;
+}
+
+
 RDBCtx RDBThreadCtxGetConn (RDBThreadCtx thrctx)
 {
     return thrctx->ctx;
@@ -513,104 +528,244 @@ void RedisFreeReplyObjects (redisReply **replys, int numReplys)
 }
 
 
-redisReply * RedisExecCommand (RDBCtx ctx, const char *command, RDBCtxNode *whichnode)
+/**
+ * RedisCommandKeyIndex
+ *   get index of the first key in argv for routing by slot.
+ *   returns 0 if command has no key.
+ */
+int RedisCommandKeyIndex (int argc, const char **argv, const size_t *argvlen)
 {
-    RDBCtxNode anode;
-    redisContext *redCtx;
-    redisReply *reply = NULL;
+    char cmd[20];
+    int len;
+
+    // commands without a key at argv[1]
+    const char *nokeycmds[] = {
+        "auth", "asking", "client", "cluster", "command", "config", "dbsize", "debug",
+        "discard", "echo", "exec", "flushall", "flushdb", "info", "keys", "multi",
+        "ping", "readonly", "readwrite", "scan", "script", "select", "slowlog", "time",
+        "unwatch", 0
+    };
+
+    if (argc < 2) {
+        return 0;
+    }
 
-    *ctx->errmsg = 0;
+    len = (int) (argvlen ? argvlen[0] : strlen(argv[0]));
+    if (len <= 0 || len >= sizeof(cmd)) {
+        return 0;
+    }
 
-    anode = RDBCtxGetActiveNode(ctx, NULL, 0);
+    memcpy(cmd, argv[0], len);
+    cmd[len] = 0;
+    cstr_tolower(cmd, len);
 
-    *whichnode = anode;
+    if (cstr_findstr_in(cmd, len, nokeycmds, sizeof(nokeycmds)/sizeof(nokeycmds[0]) - 1) != -1) {
+        return 0;
+    }
 
-    redCtx = RDBCtxNodeGetRedisContext(anode);
-    if (! redCtx) {
-        snprintf_chkd_V1(ctx->errmsg, sizeof(ctx->errmsg), "Active node not found");
+    if (! strcmp(cmd, "eval") || ! strcmp(cmd, "evalsha")) {
+        // eval script numkeys key [key ...] arg [arg ...]
+        if (argc > 3 && atoi(argv[2]) > 0) {
+            return 3;
+        }
+        return 0;
+    }
+
+    return 1;
+}
+
+
+/**
+ * RedisReplyMovedNode
+ *   'MOVED 7142 127.0.0.1:7002'
+ *
+ *   update slots map by MOVED reply and returns the new owner node. only the
+ *   slot is patched when owner is a known master (resharding). topology is
+ *   reloaded for owner unknown (node joined) and, coalesced, for owner not
+ *   master in topology (failover).
+ */
+static RDBCtxNode RedisReplyMovedNode (RDBCtx ctx, redisReply *reply)
+{
+    RDBCtxNode movednode;
+
+    int slot, reloaded = 0;
+    char *start = &(reply->str[6]);
+    char *end = strchr(start, 32);
+
+    if (! end) {
         return NULL;
     }
 
-    reply = (redisReply *) redisCommand(redCtx, command);
+    *end = 0;
+    slot = atoi(start);
 
-    if (! reply) {
-        // failed to exec command
-        if (redCtx->err == REDIS_ERR_IO) {
-            /* hiredis/read.h
-             *
-             * When an error occurs, the err flag in a context is set to hold the type of
-             * error that occurred. REDIS_ERR_IO means there was an I/O error and you
-             * should use the "errno" variable to find out what is wrong.
-             * For other values, the "errstr" field will hold a description.
-             *
-             * Add timeo_data can close this error!!
-             */
-            snprintf_chkd_V1(ctx->errmsg, sizeof(ctx->errmsg), "redisCommandArgv REDIS_ERR_IO(errno=%d): %s", errno, strerror(errno));
+    start = end;
+    ++start;
+
+    end = strchr(start, ':');
+    if (! end) {
+        return NULL;
+    }
+
+    *end++ = 0;
+
+    /**
+     * start => host
+     * end => port
+     */
+    movednode = RDBCtxGetActiveNode(ctx, start, (ub4) atoi(end));
+
+    if (! movednode && ! RDBEnvFindNode(ctx->env, start, (ub4) atoi(end))) {
+        // node joined cluster after env created: load it by topology
+        reloaded = 1;
+
+        if (RDBCtxUpdateTopology(ctx) == RDBAPI_SUCCESS) {
+            movednode = RDBCtxGetActiveNode(ctx, start, (ub4) atoi(end));
         } else {
-            snprintf_chkd_V1(ctx->errmsg, sizeof(ctx->errmsg), "redisCommandArgv RedisContext Error(%d): %.*s", redCtx->err, cstr_length(redCtx->errstr, RDB_ERROR_MSG_LEN), redCtx->errstr);
+            LOGGER_WARN("RDBCtxUpdateTopology failed: %s", ctx->errmsg);
         }
+    }
+
+    if (movednode && slot >= 0 && slot < RDBAPI_CLUSTER_SLOTS) {
+        threadlock_lock(&ctx->env->thrlock);
+        ctx->env->slotsmap[slot] = (sb2) movednode->index;
+        threadlock_unlock(&ctx->env->thrlock);
 
-        RDBCtxNodeClose(anode);
+        // replica promoted by failover: reload roles
+        if (! reloaded && ! RDBCtxNodeIsMaster(ctx, movednode->index) && RDBEnvTopologyReloadDue(ctx->env, RDBAPI_TOPOLOGY_MOVED_MS)) {
+            if (RDBCtxUpdateTopology(ctx) != RDBAPI_SUCCESS) {
+                LOGGER_WARN("RDBCtxUpdateTopology failed: %s", ctx->errmsg);
+            }
+        }
+
+        // command should be sent to moved node
+        ctx->activenode = movednode;
+    }
+
+    return movednode;
+}
+
+
+/**
+ * RedisReplyAskNode
+ *   'ASK 3999 127.0.0.1:6381'
+ *
+ *   returns the importing node for only the next command. neither slots map
+ *   nor active node is changed by ASK.
+ */
+static RDBCtxNode RedisReplyAskNode (RDBCtx ctx, redisReply *reply)
+{
+    RDBEnvNode envnode;
+    RDBCtxNode asknode;
+
+    ub4 port;
+    char host[RDB_HOSTADDR_MAXLEN + 1];
+
+    char *start = strchr(&(reply->str[4]), 32);
+    char *end;
+
+    if (! start) {
         return NULL;
     }
 
-    if (reply->type == REDIS_REPLY_ERROR) {
-        // 'MOVED 7142 127.0.0.1:7002'
-        // if remote call, 127.0.0.1 ?
-        if (cstr_startwith(reply->str, reply->len, "MOVED ", 6)) {
-            char * start = &(reply->str[6]);
-            char * end = strchr(start, 32);
-
-            if (end) {
-                start = end;
-                ++start;
-                *end = 0;
-
-                end = strchr(start, ':');
-
-                if (end) {
-                    *end++ = 0;
-
-                    /**
-                     * start => host
-                     * end => port
-                     */
-                    redCtx = RDBCtxNodeGetRedisContext(RDBCtxGetActiveNode(ctx, start, (ub4) atoi(end)));
-                    if (redCtx) {
-                        RedisFreeReplyObject(&reply);
-                        return RedisExecCommand(ctx, command, whichnode);
-                    }
-                }
-            }
-        } else if (cstr_startwith(reply->str, reply->len, "NOAUTH ", 7)) {
-            /* 'NOAUTH Authentication required.' */
-            RDBEnvNode enode = RDBCtxNodeGetEnvNode(anode);
+    ++start;
 
-            const char *cmds[] = { "auth", enode->authpass };
+    end = strchr(start, ':');
+    if (! end || end - start > RDB_HOSTADDR_MAXLEN) {
+        return NULL;
+    }
 
-            RedisFreeReplyObject(&reply);
+    memcpy(host, start, end - start);
+    host[end - start] = 0;
 
-            reply = RedisExecCommandArgv(ctx, sizeof(cmds)/sizeof(cmds[0]), cmds, 0);
+    port = (ub4) atoi(end + 1);
 
-            if (RedisIsReplyStatusOK(reply)) {
-                // authentication success
-                RedisFreeReplyObject(&reply);
+    envnode = RDBEnvFindNode(ctx->env, host, port);
 
-                // do command
-                return RedisExecCommand(ctx, command, whichnode);
-            }
+    if (! envnode) {
+        // node joined cluster after env created: load it by topology
+        if (RDBCtxUpdateTopology(ctx) != RDBAPI_SUCCESS) {
+            LOGGER_WARN("RDBCtxUpdateTopology failed: %s", ctx->errmsg);
+            return NULL;
+        }
 
-            if (reply) {
-                snprintf_chkd_V1(ctx->errmsg, sizeof(ctx->errmsg), "AUTH failed(%d): %s", reply->type, reply->str);
-                RedisFreeReplyObject(&reply);
-            }
+        envnode = RDBEnvFindNode(ctx->env, host, port);
+        if (! envnode) {
+            return NULL;
+        }
+    }
+
+    asknode = RDBCtxGetNode(ctx, RDBEnvNodeIndex(envnode));
+
+    if (! RDBCtxNodeIsOpen(asknode)) {
+        RDBCtxNode activenode = ctx->activenode;
+
+        RDBCtxNodeOpen(asknode);
+
+        ctx->activenode = activenode;
+    }
+
+    return asknode;
+}
+
+
+/**
+ * RedisRedirectBackoff
+ *   sleep a jittered time in [base/2, base] before retry, where base is
+ *   doubled on each attempt up to RDBAPI_REDIRECT_BACKOFF_MAXMS. jitter
+ *   keeps clients from retrying a migrating slot all at the same time.
+ */
+static void RedisRedirectBackoff (RDBCtx ctx, int attempt)
+{
+    ub4 basems = RDBAPI_REDIRECT_BACKOFF_MS << (attempt < 8? attempt - 1 : 7);
+
+    if (basems > RDBAPI_REDIRECT_BACKOFF_MAXMS) {
+        basems = RDBAPI_REDIRECT_BACKOFF_MAXMS;
+    }
+
+    if (! ctx->backoffseed) {
+        ctx->backoffseed = ((ub4) RDBGetLocalTime(NULL) ^ (ub4) (size_t) ctx) | 1;
+    }
 
+    // xorshift32
+    ctx->backoffseed ^= ctx->backoffseed << 13;
+    ctx->backoffseed ^= ctx->backoffseed >> 17;
+    ctx->backoffseed ^= ctx->backoffseed << 5;
+
+    rdbsleep_msec((int) (basems / 2 + ctx->backoffseed % (basems / 2 + 1)));
+}
+
+
+/**
+ * RedisAskingCommand
+ *   pipeline 'ASKING' and command in one round trip. the reply of ASKING
+ *   is dropped and the reply of command returned.
+ */
+static redisReply * RedisAskingCommand (redisContext *redCtx, const char *command, int argc, const char **argv, const size_t *argvlen)
+{
+    redisReply *reply = NULL;
+
+    if (redisAppendCommand(redCtx, "ASKING") != REDIS_OK) {
+        return NULL;
+    }
+
+    if (command) {
+        if (redisAppendCommand(redCtx, command) != REDIS_OK) {
+            return NULL;
+        }
+    } else {
+        if (redisAppendCommandArgv(redCtx, argc, argv, argvlen) != REDIS_OK) {
             return NULL;
         }
+    }
 
-        snprintf_chkd_V1(ctx->errmsg, sizeof(ctx->errmsg), "REDIS_REPLY_ERROR: %s", reply->str);
+    if (redisGetReply(redCtx, (void **) &reply) != REDIS_OK) {
+        return NULL;
+    }
 
-        RedisFreeReplyObject(&reply);
+    RedisFreeReplyObject(&reply);
+
+    if (redisGetReply(redCtx, (void **) &reply) != REDIS_OK) {
         return NULL;
     }
 
@@ -618,6 +773,28 @@ redisReply * RedisExecCommand (RDBCtx ctx, const char *command, RDBCtxNode *whic
 }
 
 
+/**
+ * RedisNodeMarkIOFailed
+ *   count error on connection of node to its circuit breaker, except read
+ *   timeout (errno saved as err) of a command: a slow but healthy node is
+ *   not failed. connection is closed by caller anyway.
+ */
+static void RedisNodeMarkIOFailed (RDBCtxNode ctxnode, redisContext *redCtx, int err)
+{
+#ifdef REDIS_ERR_TIMEOUT
+    if (redCtx->err == REDIS_ERR_TIMEOUT) {
+        return;
+    }
+#endif
+
+    if (redCtx->err == REDIS_ERR_IO && (err == EAGAIN || err == EWOULDBLOCK || err == ETIMEDOUT)) {
+        return;
+    }
+
+    RDBEnvNodeMarkFailed(RDBCtxNodeGetEnvNode(ctxnode));
+}
+
+
 /**
  *  RedisConnExecCommand/RedisExecCommandArgv
  *
@@ -631,72 +808,96 @@ redisReply * RedisExecCommand (RDBCtx ctx, const char *command, RDBCtxNode *whic
  *   set up a new connection.
  *
  * https://stackoverflow.com/questions/10041120/hiredis-c-socket
+ *
+ *   command (format string) is sent if given, otherwise argv. MOVED, ASK,
+ *   TRYAGAIN and NOAUTH are retried in a loop within RDBAPI_REDIRECTS_MAXNUM
+ *   times. whichnode (if not null) is set to the node replied at last.
  */
-redisReply * RedisExecCommandArgv (RDBCtx ctx, int argc, const char **argv, const size_t *argvlen)
+static redisReply * RedisExecOnCtxNode (RDBCtxNode anode, const char *command, int argc, const char **argv, const size_t *argvlen, RDBCtxNode *whichnode)
 {
     redisReply * reply = NULL;
 
-    *ctx->errmsg = 0;
+    RDBCtx ctx = anode->ctx;
+    RDBCtxNode firstnode = anode;
 
-    RDBCtxNode anode = RDBCtxGetActiveNode(ctx, NULL, 0);
+    int asking = 0;
+    int redirects = 0;
 
-    redisContext * redCtx = RDBCtxNodeGetRedisContext(anode);
-    if (! redCtx) {
-        snprintf_chkd_V1(ctx->errmsg, sizeof(ctx->errmsg), "Active node not found");
-        return NULL;
-    }
+    for (;;) {
+        RDBCtxNode redirnode = NULL;
 
-    reply = (redisReply *) redisCommandArgv(redCtx, argc, argv, argvlen);
+        redisContext * redCtx = RDBCtxNodeGetRedisContext(anode);
+        if (! redCtx) {
+            snprintf_chkd_V1(ctx->errmsg, sizeof(ctx->errmsg), "Active node not found");
+            return NULL;
+        }
 
-    if (! reply) {
-        // failed to exec command
-        if (redCtx->err == REDIS_ERR_IO) {
-            /* hiredis/read.h
-             *
-             * When an error occurs, the err flag in a context is set to hold the type of
-             * error that occurred. REDIS_ERR_IO means there was an I/O error and you
-             * should use the "errno" variable to find out what is wrong.
-             * For other values, the "errstr" field will hold a description.
-             *
-             * Add timeo_data can close this error!!
-             */
-            snprintf_chkd_V1(ctx->errmsg, sizeof(ctx->errmsg), "redisCommandArgv REDIS_ERR_IO(errno=%d): %s", errno, strerror(errno));
+        if (whichnode) {
+            *whichnode = anode;
+        }
+
+        if (asking) {
+            // ASK: only this command goes to importing node
+            reply = RedisAskingCommand(redCtx, command, argc, argv, argvlen);
         } else {
-            snprintf_chkd_V1(ctx->errmsg, sizeof(ctx->errmsg), "redisCommandArgv RedisContext Error(%d): %.*s", redCtx->err, cstr_length(redCtx->errstr, RDB_ERROR_MSG_LEN), redCtx->errstr);
+            ctx->activenode = anode;
+
+            if (command) {
+                reply = (redisReply *) redisCommand(redCtx, command);
+            } else {
+                reply = (redisReply *) redisCommandArgv(redCtx, argc, argv, argvlen);
+            }
         }
 
-        RDBCtxNodeClose(anode);
-        return NULL;
-    }
+        if (! reply) {
+            // failed to exec command
+            int err = errno;
+
+            if (redCtx->err == REDIS_ERR_IO) {
+                /* hiredis/read.h
+                 *
+                 * When an error occurs, the err flag in a context is set to hold the type of
+                 * error that occurred. REDIS_ERR_IO means there was an I/O error and you
+                 * should use the "errno" variable to find out what is wrong.
+                 * For other values, the "errstr" field will hold a description.
+                 *
+                 * Add timeo_data can close this error!!
+                 */
+                snprintf_chkd_V1(ctx->errmsg, sizeof(ctx->errmsg), "redisCommandArgv REDIS_ERR_IO(errno=%d): %s", errno, strerror(errno));
+            } else {
+                snprintf_chkd_V1(ctx->errmsg, sizeof(ctx->errmsg), "redisCommandArgv RedisContext Error(%d): %.*s", redCtx->err, cstr_length(redCtx->errstr, RDB_ERROR_MSG_LEN), redCtx->errstr);
+            }
+
+            RedisNodeMarkIOFailed(anode, redCtx, err);
+            RDBCtxNodeClose(anode);
+            return NULL;
+        }
+
+        RDBEnvNodeMarkHealthy(RDBCtxNodeGetEnvNode(anode));
+
+        if (reply->type != REDIS_REPLY_ERROR) {
+            return reply;
+        }
+
+        if (redirects == RDBAPI_REDIRECTS_MAXNUM) {
+            snprintf_chkd_V1(ctx->errmsg, sizeof(ctx->errmsg), "REDIS_REPLY_ERROR: %s (redirects exhausted)", reply->str);
+            RedisFreeReplyObject(&reply);
+            return NULL;
+        }
 
-    if (reply->type == REDIS_REPLY_ERROR) {
-        // 'MOVED 7142 127.0.0.1:7002'
-        // if remote call, 127.0.0.1 ?
         if (cstr_startwith(reply->str, reply->len, "MOVED ", 6)) {
-            char * start = &(reply->str[6]);
-            char * end = strchr(start, 32);
-
-            if (end) {
-                start = end;
-                ++start;
-                *end = 0;
-
-                end = strchr(start, ':');
-
-                if (end) {
-                    *end++ = 0;
-
-                    /**
-                     * start => host
-                     * end => port
-                     */
-                    redCtx = RDBCtxNodeGetRedisContext(RDBCtxGetActiveNode(ctx, start, (ub4) atoi(end)));
-                    if (redCtx) {
-                        RedisFreeReplyObject(&reply);
-                        return RedisExecCommandArgv(ctx, argc, argv, argvlen);
-                    }
-                }
-            }
+            // 'MOVED 7142 127.0.0.1:7002'
+            // if remote call, 127.0.0.1 ?
+            redirnode = RedisReplyMovedNode(ctx, reply);
+            asking = 0;
+        } else if (cstr_startwith(reply->str, reply->len, "ASK ", 4)) {
+            // 'ASK 3999 127.0.0.1:6381': slot is migrating
+            redirnode = RedisReplyAskNode(ctx, reply);
+            asking = 1;
+        } else if (cstr_startwith(reply->str, reply->len, "TRYAGAIN", 8)) {
+            // multi-key command on slot being migrated: retry on the owner later
+            redirnode = firstnode;
+            asking = 0;
         } else if (cstr_startwith(reply->str, reply->len, "NOAUTH ", 7)) {
             /* 'NOAUTH Authentication required.' */
             RDBEnvNode enode = RDBCtxNodeGetEnvNode(anode);
@@ -705,31 +906,101 @@ redisReply * RedisExecCommandArgv (RDBCtx ctx, int argc, const char **argv, cons
 
             RedisFreeReplyObject(&reply);
 
-            reply = RedisExecCommandArgv(ctx, sizeof(cmds)/sizeof(cmds[0]), cmds, 0);
+            reply = (redisReply *) redisCommandArgv(redCtx, sizeof(cmds)/sizeof(cmds[0]), cmds, NULL);
 
-            if (RedisIsReplyStatusOK(reply)) {
-                // authentication success
-                RedisFreeReplyObject(&reply);
+            if (! RedisIsReplyStatusOK(reply)) {
+                if (reply) {
+                    snprintf_chkd_V1(ctx->errmsg, sizeof(ctx->errmsg), "AUTH failed(%d): %s", reply->type, reply->str);
+                    RedisFreeReplyObject(&reply);
+                } else {
+                    // connection lost in handshake: failed as other io errors
+                    int err = errno;
+
+                    snprintf_chkd_V1(ctx->errmsg, sizeof(ctx->errmsg), "AUTH failed: %s", redCtx->errstr);
 
-                // do command
-                return RedisExecCommandArgv(ctx, argc, argv, argvlen);
+                    RedisNodeMarkIOFailed(anode, redCtx, err);
+                    RDBCtxNodeClose(anode);
+                }
+
+                return NULL;
             }
 
+            // authentication success: do command
+            redirnode = anode;
+        }
+
+        if (! RDBCtxNodeIsOpen(redirnode)) {
             if (reply) {
-                snprintf_chkd_V1(ctx->errmsg, sizeof(ctx->errmsg), "AUTH failed(%d): %s", reply->type, reply->str);
+                snprintf_chkd_V1(ctx->errmsg, sizeof(ctx->errmsg), "REDIS_REPLY_ERROR: %s", reply->str);
                 RedisFreeReplyObject(&reply);
             }
 
             return NULL;
         }
 
-        snprintf_chkd_V1(ctx->errmsg, sizeof(ctx->errmsg), "REDIS_REPLY_ERROR: %s", reply->str);
+        if (reply->type == REDIS_REPLY_ERROR && (cstr_startwith(reply->str, reply->len, "TRYAGAIN", 8) || redirects > 1)) {
+            // wait for migration, and slots ping-pong means cluster in flux
+            RedisRedirectBackoff(ctx, redirects + 1);
+        }
 
         RedisFreeReplyObject(&reply);
+
+        anode = redirnode;
+        redirects++;
+    }
+}
+
+
+redisReply * RedisExecCommand (RDBCtx ctx, const char *command, RDBCtxNode *whichnode)
+{
+    RDBCtxNode anode;
+
+    *ctx->errmsg = 0;
+
+    anode = RDBCtxGetActiveNode(ctx, NULL, 0);
+
+    *whichnode = anode;
+
+    if (! anode) {
+        snprintf_chkd_V1(ctx->errmsg, sizeof(ctx->errmsg), "Active node not found");
         return NULL;
     }
 
-    return reply;
+    return RedisExecOnCtxNode(anode, command, 0, NULL, NULL, whichnode);
+}
+
+
+static redisReply * RedisExecArgvOnCtxNode (RDBCtxNode anode, int argc, const char **argv, const size_t *argvlen)
+{
+    return RedisExecOnCtxNode(anode, NULL, argc, argv, argvlen, NULL);
+}
+
+
+redisReply * RedisExecCommandArgv (RDBCtx ctx, int argc, const char **argv, const size_t *argvlen)
+{
+    RDBCtxNode anode = NULL;
+
+    int keyindex = RedisCommandKeyIndex(argc, argv, argvlen);
+
+    *ctx->errmsg = 0;
+
+    if (keyindex) {
+        // route to master owns the key at first try
+        size_t keylen = (argvlen ? argvlen[keyindex] : strlen(argv[keyindex]));
+
+        anode = RDBCtxGetSlotNode(ctx, (int) crc16_keyslot(argv[keyindex], (int) keylen));
+    }
+
+    if (! anode) {
+        anode = RDBCtxGetActiveNode(ctx, NULL, 0);
+    }
+
+    if (! anode) {
+        snprintf_chkd_V1(ctx->errmsg, sizeof(ctx->errmsg), "Active node not found");
+        return NULL;
+    }
+
+    return RedisExecArgvOnCtxNode(anode, argc, argv, argvlen);
 }
 
 
@@ -744,14 +1015,12 @@ RDBAPI_RESULT RedisExecArgvOnNode (RDBCtxNode ctxnode, int argc, const char *arg
     }
 
     if (RDBCtxNodeIsOpen(ctxnode)) {
-        ctxnode->ctx->activenode = ctxnode;
-
-        redisReply *reply = RedisExecCommandArgv(ctxnode->ctx, argc, argv, argvlen);
+        redisReply *reply = RedisExecArgvOnCtxNode(ctxnode, argc, argv, argvlen);
         if (reply) {
             *outReply = reply;
             return RDBAPI_SUCCESS;
         }
-    } else {
+    } else if (! *ctxnode->ctx->errmsg) {
         snprintf_chkd_V1(ctxnode->ctx->errmsg, sizeof(ctxnode->ctx->errmsg), "RDBAPI_ERROR: No active node");
     }
 
@@ -806,6 +1075,79 @@ RDBAPI_RESULT RedisExecCommandArgvOnNode (RDBCtxNode ctxnode, char *command, red
 }
 
 
+RDBAPI_RESULT RedisAppendArgvOnNode (RDBCtxNode ctxnode, int argc, const char *argv[], const size_t *argvlen)
+{
+    *ctxnode->ctx->errmsg = 0;
+
+    if (! RDBCtxNodeIsOpen(ctxnode)) {
+        RDBCtxNodeOpen(ctxnode);
+    }
+
+    if (! RDBCtxNodeIsOpen(ctxnode)) {
+        snprintf_chkd_V1(ctxnode->ctx->errmsg, sizeof(ctxnode->ctx->errmsg), "RDBAPI_ERROR: No active node");
+        return RDBAPI_ERROR;
+    }
+
+    // only write command into output buffer, sent by the first redisGetReply
+    if (redisAppendCommandArgv(ctxnode->redCtx, argc, argv, argvlen) != REDIS_OK) {
+        snprintf_chkd_V1(ctxnode->ctx->errmsg, sizeof(ctxnode->ctx->errmsg), "RDBAPI_ERR_NOMEM: redisAppendCommandArgv failed");
+        return RDBAPI_ERR_NOMEM;
+    }
+
+    return RDBAPI_SUCCESS;
+}
+
+
+/**
+ * RedisGetReplyOnNode
+ *   get reply for command appended by RedisAppendArgvOnNode. replies MUST be
+ *   read in the same order and number as commands appended.
+ *
+ * returns:
+ *   RDBAPI_SUCCESS: reply returned
+ *   RDBAPI_ERR_REDIS: REDIS_REPLY_ERROR returned (such as MOVED) and freed
+ *   RDBAPI_ERROR: connection error and ctxnode has been closed
+ */
+RDBAPI_RESULT RedisGetReplyOnNode (RDBCtxNode ctxnode, redisReply **outReply)
+{
+    redisReply *reply = NULL;
+    redisContext *redCtx = ctxnode->redCtx;
+
+    RDBCtx ctx = ctxnode->ctx;
+
+    *outReply = NULL;
+
+    if (! redCtx) {
+        snprintf_chkd_V1(ctx->errmsg, sizeof(ctx->errmsg), "RDBAPI_ERROR: No active node");
+        return RDBAPI_ERROR;
+    }
+
+    if (redisGetReply(redCtx, (void **) &reply) != REDIS_OK || ! reply) {
+        int err = errno;
+
+        if (redCtx->err == REDIS_ERR_IO) {
+            snprintf_chkd_V1(ctx->errmsg, sizeof(ctx->errmsg), "redisGetReply REDIS_ERR_IO(errno=%d): %s", errno, strerror(errno));
+        } else {
+            snprintf_chkd_V1(ctx->errmsg, sizeof(ctx->errmsg), "redisGetReply RedisContext Error(%d): %.*s", redCtx->err, cstr_length(redCtx->errstr, RDB_ERROR_MSG_LEN), redCtx->errstr);
+        }
+
+        // pending replies are lost with the connection
+        RedisNodeMarkIOFailed(ctxnode, redCtx, err);
+        RDBCtxNodeClose(ctxnode);
+        return RDBAPI_ERROR;
+    }
+
+    if (reply->type == REDIS_REPLY_ERROR) {
+        snprintf_chkd_V1(ctx->errmsg, sizeof(ctx->errmsg), "REDIS_REPLY_ERROR: %s", reply->str);
+        RedisFreeReplyObject(&reply);
+        return RDBAPI_ERR_REDIS;
+    }
+
+    *outReply = reply;
+    return RDBAPI_SUCCESS;
+}
+
+
 int RedisExecCommandOnAllNodes (RDBCtx ctx, char *command, redisReply **replys, RDBCtxNode *replyNodes)
 {
     const char *argv[256];
@@ -1479,6 +1821,287 @@ int RedisDeleteKey (RDBCtx ctx, const char * key, size_t keylen, const char * fi
 }
 
 
+typedef struct
+{
+    int slot;
+    int index;
+} RedisSlotKey_t;
+
+
+static int RedisSlotKeyCmp (const void *a, const void *b)
+{
+    const RedisSlotKey_t *ka = (const RedisSlotKey_t *) a;
+    const RedisSlotKey_t *kb = (const RedisSlotKey_t *) b;
+
+    if (ka->slot != kb->slot) {
+        return (ka->slot < kb->slot? -1 : 1);
+    }
+
+    return (ka->index < kb->index? -1 : (ka->index > kb->index? 1 : 0));
+}
+
+
+static int RedisUnlinkGroupArgv (const char *keys[], const size_t *keyslen, const RedisSlotKey_t *slotkeys, int numkeys, const char **argv, size_t *argvlen)
+{
+    int i;
+
+    argv[0] = "UNLINK";
+    argvlen[0] = 6;
+
+    for (i = 0; i < numkeys; i++) {
+        argv[i + 1] = keys[slotkeys[i].index];
+        argvlen[i + 1] = keyslen[slotkeys[i].index];
+    }
+
+    return numkeys + 1;
+}
+
+
+static void RedisUnlinkGroupStats (const RedisSlotKey_t *slotkeys, int numkeys, int stat, int *outstats)
+{
+    int i;
+
+    for (i = 0; i < numkeys; i++) {
+        outstats[slotkeys[i].index] = stat;
+    }
+}
+
+
+// UNLINK count tells outcome of every key only if none or all of group removed
+static int RedisUnlinkGroupReply (const RedisSlotKey_t *slotkeys, int numkeys, long long removed, int *outstats)
+{
+    if (removed == 0) {
+        RedisUnlinkGroupStats(slotkeys, numkeys, RDBAPI_KEY_NOTFOUND, outstats);
+    } else if (removed == numkeys) {
+        RedisUnlinkGroupStats(slotkeys, numkeys, RDBAPI_KEY_DELETED, outstats);
+    } else {
+        RedisUnlinkGroupStats(slotkeys, numkeys, RDBAPI_KEY_UNKNOWN, outstats);
+    }
+
+    return (int) removed;
+}
+
+
+/**
+ * RedisUnlinkKeys
+ *   delete keys by UNLINK (values freed by server in background). keys are
+ *   grouped by hash slot, each group is sent as one multi-key UNLINK and
+ *   groups are pipelined per master node. a group failed in pipeline (MOVED,
+ *   I/O error) is executed again by slot routing.
+ *
+ *   outstats[i] is outcome of keys[i]: RDBAPI_KEY_DELETED, RDBAPI_KEY_NOTFOUND
+ *   or error (< 0). UNLINK only returns count of keys removed, so keys of a
+ *   group partially removed are all RDBAPI_KEY_UNKNOWN: none of them remains
+ *   but which ones existed is not known.
+ *
+ * returns:
+ *   number of keys deleted (sum of UNLINK replies)
+ */
+int RedisUnlinkKeys (RDBCtx ctx, const char *keys[], const size_t *keyslen, int numkeys, int *outstats)
+{
+    int i, g, argc, nodeindex;
+    int numgroups = 0, deleted = 0;
+
+    RDBEnv env = ctx->env;
+
+    RedisSlotKey_t *slotkeys;
+    int *groups;
+    int *groupnodes;
+    ub1 *groupsok;
+    ub1 *appended;
+
+    const char **argv;
+    size_t *argvlen;
+
+    if (numkeys <= 0) {
+        return 0;
+    }
+
+    slotkeys = (RedisSlotKey_t *) RDBMemAlloc(sizeof(RedisSlotKey_t) * numkeys);
+
+    // groups[g] is start of group g in slotkeys and groups[numgroups] = numkeys
+    groups = (int *) RDBMemAlloc(sizeof(int) * (numkeys + 1));
+    groupnodes = (int *) RDBMemAlloc(sizeof(int) * numkeys);
+    groupsok = (ub1 *) RDBMemAlloc(numkeys);
+    appended = (ub1 *) RDBMemAlloc(numkeys);
+
+    argv = (const char **) RDBMemAlloc(sizeof(char *) * (RDB_UNLINK_KEYS_MAX + 1));
+    argvlen = (size_t *) RDBMemAlloc(sizeof(size_t) * (RDB_UNLINK_KEYS_MAX + 1));
+
+    for (i = 0; i < numkeys; i++) {
+        slotkeys[i].slot = (int) crc16_keyslot(keys[i], (int) keyslen[i]);
+        slotkeys[i].index = i;
+
+        outstats[i] = RDBAPI_ERROR;
+    }
+
+    qsort(slotkeys, numkeys, sizeof(RedisSlotKey_t), RedisSlotKeyCmp);
+
+    for (i = 0; i < numkeys; i++) {
+        if (! i || slotkeys[i].slot != slotkeys[i - 1].slot || i - groups[numgroups - 1] == RDB_UNLINK_KEYS_MAX) {
+            groupnodes[numgroups] = env->slotsmap[slotkeys[i].slot];
+            groups[numgroups++] = i;
+        }
+    }
+    groups[numgroups] = numkeys;
+
+    for (nodeindex = 0; nodeindex < RDBEnvNumNodes(env); nodeindex++) {
+        RDBCtxNode ctxnode = RDBCtxGetNode(ctx, nodeindex);
+
+        for (g = 0; g < numgroups; g++) {
+            if (groupnodes[g] == nodeindex) {
+                break;
+            }
+        }
+
+        if (g == numgroups) {
+            // no keys for this node
+            continue;
+        }
+
+        if (! RDBCtxNodeIsOpen(ctxnode) && RDBCtxNodeOpen(ctxnode) != RDBAPI_SUCCESS) {
+            continue;
+        }
+
+        for (g = 0; g < numgroups; g++) {
+            appended[g] = 0;
+
+            if (groupnodes[g] == nodeindex) {
+                argc = RedisUnlinkGroupArgv(keys, keyslen, &slotkeys[groups[g]], groups[g + 1] - groups[g], argv, argvlen);
+
+                if (RedisAppendArgvOnNode(ctxnode, argc, argv, argvlen) == RDBAPI_SUCCESS) {
+                    appended[g] = 1;
+                }
+            }
+        }
+
+        for (g = 0; g < numgroups; g++) {
+            if (appended[g]) {
+                redisReply *reply = NULL;
+
+                if (RedisGetReplyOnNode(ctxnode, &reply) == RDBAPI_SUCCESS) {
+                    if (reply->type == REDIS_REPLY_INTEGER) {
+                        deleted += RedisUnlinkGroupReply(&slotkeys[groups[g]], groups[g + 1] - groups[g], reply->integer, outstats);
+                        groupsok[g] = 1;
+                    }
+                    RedisFreeReplyObject(&reply);
+                }
+            }
+        }
+    }
+
+    for (g = 0; g < numgroups; g++) {
+        if (! groupsok[g]) {
+            // execute again by slot routing
+            redisReply *reply;
+
+            argc = RedisUnlinkGroupArgv(keys, keyslen, &slotkeys[groups[g]], groups[g + 1] - groups[g], argv, argvlen);
+
+            reply = RedisExecCommandArgv(ctx, argc, argv, argvlen);
+
+            if (reply && reply->type == REDIS_REPLY_INTEGER) {
+                deleted += RedisUnlinkGroupReply(&slotkeys[groups[g]], groups[g + 1] - groups[g], reply->integer, outstats);
+            } else if (reply) {
+                RedisUnlinkGroupStats(&slotkeys[groups[g]], groups[g + 1] - groups[g], RDBAPI_ERR_TYPE, outstats);
+            }
+
+            RedisFreeReplyObject(&reply);
+        }
+    }
+
+    RDBMemFree(argvlen);
+    RDBMemFree(argv);
+    RDBMemFree(appended);
+    RDBMemFree(groupsok);
+    RDBMemFree(groupnodes);
+    RDBMemFree(groups);
+    RDBMemFree(slotkeys);
+
+    return deleted;
+}
+
+
+/**
+ * RedisExecArgvPipelined
+ *   execute commands (key at argv[1]) pipelined per master node owns key.
+ *   commands on one node are sent in order. a command failed in pipeline
+ *   (MOVED, I/O error) is executed again by slot routing, in order too.
+ *
+ *   outReplies[i] is reply of command i (NULL on error). caller frees them.
+ */
+void RedisExecArgvPipelined (RDBCtx ctx, int numcmds, const int *argcs, const char **argvs[], const size_t *argvlens[], redisReply **outReplies)
+{
+    int i, nodeindex;
+
+    RDBEnv env = ctx->env;
+
+    int *cmdnodes;
+    ub1 *appended;
+
+    if (numcmds <= 0) {
+        return;
+    }
+
+    cmdnodes = (int *) RDBMemAlloc(sizeof(int) * numcmds);
+    appended = (ub1 *) RDBMemAlloc(numcmds);
+
+    for (i = 0; i < numcmds; i++) {
+        outReplies[i] = NULL;
+
+        cmdnodes[i] = env->slotsmap[crc16_keyslot(argvs[i][1], (int) argvlens[i][1])];
+    }
+
+    for (nodeindex = 0; nodeindex < RDBEnvNumNodes(env); nodeindex++) {
+        RDBCtxNode ctxnode = RDBCtxGetNode(ctx, nodeindex);
+
+        for (i = 0; i < numcmds; i++) {
+            if (cmdnodes[i] == nodeindex) {
+                break;
+            }
+        }
+
+        if (i == numcmds) {
+            // no commands for this node
+            continue;
+        }
+
+        if (! RDBCtxNodeIsOpen(ctxnode) && RDBCtxNodeOpen(ctxnode) != RDBAPI_SUCCESS) {
+            continue;
+        }
+
+        for (i = 0; i < numcmds; i++) {
+            appended[i] = 0;
+
+            if (cmdnodes[i] == nodeindex) {
+                if (RedisAppendArgvOnNode(ctxnode, argcs[i], argvs[i], argvlens[i]) == RDBAPI_SUCCESS) {
+                    appended[i] = 1;
+                }
+            }
+        }
+
+        for (i = 0; i < numcmds; i++) {
+            if (appended[i]) {
+                redisReply *reply = NULL;
+
+                if (RedisGetReplyOnNode(ctxnode, &reply) == RDBAPI_SUCCESS) {
+                    outReplies[i] = reply;
+                }
+            }
+        }
+    }
+
+    for (i = 0; i < numcmds; i++) {
+        if (! outReplies[i]) {
+            // execute again by slot routing
+            outReplies[i] = RedisExecCommandArgv(ctx, argcs[i], argvs[i], argvlens[i]);
+        }
+    }
+
+    RDBMemFree(appended);
+    RDBMemFree(cmdnodes);
+}
+
+
 int RedisExistsKey (RDBCtx ctx, const char * key, size_t keylen)
 {
     int ret;
@@ -1514,26 +2137,14 @@ int RedisExistsKey (RDBCtx ctx, const char * key, size_t keylen)
 
 RDBAPI_RESULT RedisClusterKeyslot (RDBCtx ctx, const char *key, sb8 *slot)
 {
-    redisReply *reply = NULL;
-
-    const char *argv[3] = { "cluster", "keyslot", key };
-    size_t argvlen[3] = { 7, 7, strlen(key) };
-
-    reply = RedisExecCommandArgv(ctx, 3, argv, argvlen);
-    if (! reply) {
-        return RDBAPI_ERROR;
-    }
-
-    if (reply->type != REDIS_REPLY_INTEGER) {
-        // bad reply type: REDIS_REPLY_INTEGER required
-        snprintf_chkd_V1(ctx->errmsg, sizeof(ctx->errmsg), "RDBAPI_ERR_TYPE: reply type(%d)", reply->type);
-        RedisFreeReplyObject(&reply);
-        return RDBAPI_ERR_TYPE;
+    if (! key) {
+        snprintf_chkd_V1(ctx->errmsg, sizeof(ctx->errmsg), "RDBAPI_ERR_BADARG: null key");
+        return RDBAPI_ERR_BADARG;
     }
 
-    *slot = (sb8) reply->integer;
+    // same as: cluster keyslot $key
+    *slot = (sb8) crc16_keyslot(key, (int) strlen(key));
 
-    RedisFreeReplyObject(&reply);
     return RDBAPI_SUCCESS;
 }
 
@@ -1804,6 +2415,8 @@ RDBAPI_RESULT RedisClusterCheck (RDBCtx ctx)
 
     int nodeindex, numnodes;
 
+    RDBNodeReplica_t *replicas;
+
     numnodes = RDBEnvNumNodes(ctx->env);
     if (numnodes == 0) {
         snprintf_chkd_V1(ctx->errmsg, sizeof(ctx->errmsg), "nodes not found");
@@ -1820,37 +2433,36 @@ RDBAPI_RESULT RedisClusterCheck (RDBCtx ctx)
         return RDBAPI_ERROR;
     }
 
-    threadlock_lock(&ctx->env->thrlock);
+    // roles are built aside and published as a new topology
+    replicas = (RDBNodeReplica_t *) RDBMemAlloc(sizeof(RDBNodeReplica_t) * numnodes);
 
     for (nodeindex = 0; nodeindex < numnodes; nodeindex++) {
         int len;
         RDBCtxNode ctxnode = RDBCtxGetNode(ctx, nodeindex);
-        RDBEnvNode envnode = RDBCtxNodeGetEnvNode(ctxnode);
-
-        bzero(&envnode->replica, sizeof(envnode->replica));
+        RDBNodeReplica_t *replica = &replicas[nodeindex];
 
         len = RDBNodeInfoQuery(ctxnode, NODEINFO_CLUSTER, "cluster_enabled", propval);
 
         // check cluster_enabled
         if (len != 1 || propval[0] != '1') {
             snprintf_chkd_V1(ctx->errmsg, sizeof(ctx->errmsg), "RDBAPI_ERROR: cluster_enabled=%s", propval);
-            threadlock_unlock(&ctx->env->thrlock);
+            RDBMemFree(replicas);
             return RDBAPI_ERROR;
         }        
     
         len = RDBNodeInfoQuery(ctxnode, NODEINFO_REPLICATION, "role", propval);
         if (len > 0) {
             if (cstr_startwith(propval, len, "master", 6)) {
-                envnode->replica.is_master = 1;
+                replica->is_master = 1;
 
                 len = RDBNodeInfoQuery(ctxnode, NODEINFO_REPLICATION, "connected_slaves", propval);
                 if (len == 1) {
                     int slaveid;
                     char slave[10] = {0};
 
-                    envnode->replica.connected_slaves = atoi(propval);
+                    replica->connected_slaves = atoi(propval);
 
-                    for (slaveid = 0; slaveid < envnode->replica.connected_slaves; slaveid++) {
+                    for (slaveid = 0; slaveid < replica->connected_slaves; slaveid++) {
                         RDBEnvNode slavenode = NULL;
 
                         snprintf_chkd_V1(slave, sizeof(slave), "slave%d", slaveid);
@@ -1881,18 +2493,18 @@ RDBAPI_RESULT RedisClusterCheck (RDBCtx ctx)
 
                         if (! slavenode) {
                             snprintf_chkd_V1(ctx->errmsg, sizeof(ctx->errmsg), "RDBAPI_ERROR: slave%d node not found", slaveid);
-                            threadlock_unlock(&ctx->env->thrlock);
+                            RDBMemFree(replicas);
                             return RDBAPI_ERROR;
                         }
 
                         // set nodeindex for slave
-                        envnode->replica.slaves[slaveid] = slavenode->index;
+                        replica->slaves[slaveid] = slavenode->index;
                     }
                 }
             } else if (cstr_startwith(propval, len, "slave", 5)) {
                 RDBEnvNode masterenode = NULL;
 
-                envnode->replica.is_master = 0;
+                replica->is_master = 0;
 
                 //role:slave
                 //master_host:192.168.39.111
@@ -1907,19 +2519,21 @@ RDBAPI_RESULT RedisClusterCheck (RDBCtx ctx)
 
                 if (! masterenode) {
                     snprintf_chkd_V1(ctx->errmsg, sizeof(ctx->errmsg), "RDBAPI_ERROR: master node not found");
-                    threadlock_unlock(&ctx->env->thrlock);
+                    RDBMemFree(replicas);
                     return RDBAPI_ERROR;
                 }
 
-                envnode->replica.master_nodeindex = masterenode->index;
+                replica->master_nodeindex = masterenode->index;
             } else {
                 snprintf_chkd_V1(ctx->errmsg, sizeof(ctx->errmsg), "RDBAPI_ERR_APP: role prop not found: %s", propval);
-                threadlock_unlock(&ctx->env->thrlock);
+                RDBMemFree(replicas);
                 return RDBAPI_ERR_APP;
             }
         }
     }
 
-    threadlock_unlock(&ctx->env->thrlock);
+    RDBEnvPublishTopology(ctx->env, numnodes, replicas);
+
+    RDBMemFree(replicas);
     return RDBAPI_SUCCESS;
 }
@@ -78,6 +78,26 @@ extern "C"
 # define RDB_TABLE_LIMIT_MIN       10
 #endif
 
+#ifndef RDB_ROWKEY_INDEX_SHARDS
+# define RDB_ROWKEY_INDEX_SHARDS   16    // ZSET shards of rowkey index
+#endif
+
+#ifndef RDB_QUERY_ARENA_CHUNK
+# define RDB_QUERY_ARENA_CHUNK     65536 // bytes of chunk of per-query arena
+#endif
+
+#ifndef RDB_REGEX_AUTOMATON_MINLEN
+# define RDB_REGEX_AUTOMATON_MINLEN  16  // MATCH patterns this long run by automaton (0: never)
+#endif
+
+#ifndef RDB_UNLINK_KEYS_MAX
+# define RDB_UNLINK_KEYS_MAX       512   // keys per multi-key UNLINK command
+#endif
+
+#ifndef RDB_INDEX_ENTRIES_MAX
+# define RDB_INDEX_ENTRIES_MAX     512   // members per ZADD/ZREM command of index
+#endif
+
 #ifndef RDB_PRINT_LINE_INDENT
 # define RDB_PRINT_LINE_INDENT     2
 #endif
@@ -151,6 +171,41 @@ typedef int RDBAPI_BOOL;
 
 #define RDBAPI_SLAVES_MAXNUM       9
 
+// max retries of a command on MOVED, ASK, TRYAGAIN
+#define RDBAPI_REDIRECTS_MAXNUM    8
+
+// jittered backoff (ms) before retry on TRYAGAIN, doubled up to MAXMS
+#define RDBAPI_REDIRECT_BACKOFF_MS     10
+#define RDBAPI_REDIRECT_BACKOFF_MAXMS  200
+
+#define RDBAPI_CLUSTER_SLOTS       16384
+
+// max idle connections kept in pool per node
+#define RDBAPI_POOL_MAXIDLE        16
+
+// idle connection in pool is checked by PING after this time (ms)
+#define RDBAPI_POOL_PINGIDLE_MS    3000
+
+// cached table descriptor is revalidated by timestamp after this time (ms)
+#define RDBAPI_TABLEDES_TTL_MS     5000
+
+// rows per second reclaimed by background DROP TABLE (0: unlimited)
+#define RDBAPI_DROP_RATE_LIMIT     20000
+
+// topology is reloaded by 'cluster nodes' on checkout after this time (ms)
+#define RDBAPI_TOPOLOGY_TTL_MS     30000
+
+// MOVED to a node not master in topology reloads it at most once in (ms)
+#define RDBAPI_TOPOLOGY_MOVED_MS   1000
+
+// circuit breaker on node is opened by consecutive connect or io failures.
+//   read timeout of command is not taken as failure
+#define RDBAPI_BREAKER_FAILURES    3
+
+// reconnect to node with breaker open after backoff (ms), doubled up to MAXMS
+#define RDBAPI_RECONNECT_BACKOFF_MS     100
+#define RDBAPI_RECONNECT_BACKOFF_MAXMS  10000
+
 #define RDBAPI_PROP_MAXSIZE        256
 
 #define RDBAPI_KEY_PERSIST        (-1)
@@ -158,6 +213,9 @@ typedef int RDBAPI_BOOL;
 #define RDBAPI_KEY_DELETED         1
 #define RDBAPI_KEY_NOTFOUND        0
 
+// key removed or not found: not known (by multi-key UNLINK)
+#define RDBAPI_KEY_UNKNOWN         2
+
 #define RDBAPI_SQL_PATTERN_SIZE    256
 #define RDBAPI_SQL_KEYS_MAX        RDBAPI_KEYS_MAXNUM
 #define RDBAPI_SQL_FIELDS_MAX      RDBAPI_ARGV_MAXNUM
@@ -170,6 +228,8 @@ typedef int RDBAPI_BOOL;
 #define RDB_HOSTADDR_MAXLEN            48
 #define RDB_AUTHPASS_MAXLEN            32
 
+#define RDB_CLUSTER_NODEID_LEN         40
+
 #define RDB_PORT_NUMB_MIN              1024
 #define RDB_PORT_NUMB_MAX              65535
 
@@ -226,6 +286,59 @@ typedef struct _RDBCell_t        * RDBCell;
 typedef struct _RDBRow_t         * RDBRow;
 typedef struct _RDBRowIter_t     * RDBRowIter;
 
+typedef struct _RDBCursor_t      * RDBCursor;
+
+typedef struct _RDBColumnBatch_t * RDBColumnBatch;
+
+
+/**
+ * Arrow C Data Interface
+ *   https://arrow.apache.org/docs/format/CDataInterface.html
+ */
+#ifndef ARROW_C_DATA_INTERFACE
+#define ARROW_C_DATA_INTERFACE
+
+#define ARROW_FLAG_DICTIONARY_ORDERED  1
+#define ARROW_FLAG_NULLABLE            2
+#define ARROW_FLAG_MAP_KEYS_SORTED     4
+
+struct ArrowSchema {
+    // Array type description
+    const char *format;
+    const char *name;
+    const char *metadata;
+    int64_t flags;
+    int64_t n_children;
+    struct ArrowSchema **children;
+    struct ArrowSchema *dictionary;
+
+    // Release callback
+    void (*release)(struct ArrowSchema *);
+
+    // Opaque producer-specific data
+    void *private_data;
+};
+
+struct ArrowArray {
+    // Array data description
+    int64_t length;
+    int64_t null_count;
+    int64_t offset;
+    int64_t n_buffers;
+    int64_t n_children;
+    const void **buffers;
+    struct ArrowArray **children;
+    struct ArrowArray *dictionary;
+
+    // Release callback
+    void (*release)(struct ArrowArray *);
+
+    // Opaque producer-specific data
+    void *private_data;
+};
+
+#endif /* ARROW_C_DATA_INTERFACE */
+
 
 typedef struct _RDBBinary_t
 {
@@ -314,9 +427,18 @@ typedef enum
     ,RDB_CELLTYPE_BINARY     = 4  // tpl_bin
     ,RDB_CELLTYPE_REPLY      = 5  // reply string
     ,RDB_CELLTYPE_RESULTMAP  = 6  // nested result map
+    ,RDB_CELLTYPE_SLICE      = 7  // borrowed bytes in key or reply retained by row
 } RDBCellType;
 
 
+typedef enum
+{
+    RDBREAD_MASTER          = 0  // read from master only (default)
+    ,RDBREAD_PREFER_REPLICA = 1  // read from a replica, master if none available
+    ,RDBREAD_NEAREST        = 2  // read from master or replica of least measured RTT
+} RDBReadPreference;
+
+
 // DO NOT CHANGE BELOW!
 typedef enum
 {
@@ -345,10 +467,15 @@ typedef enum
     ,RDBSQL_INFO_SECTION = 7
     ,RDBSQL_SHOW_DATABASES = 8
     ,RDBSQL_SHOW_TABLES = 9
-    ,RDBENV_COMMAND_START = 10
+    ,RDBSQL_CREATE_INDEX = 10
+    ,RDBENV_COMMAND_START = 20
     ,RDBENV_COMMAND_VERBOSE_ON = RDBENV_COMMAND_START
     ,RDBENV_COMMAND_VERBOSE_OFF = RDBENV_COMMAND_START + 1
     ,RDBENV_COMMAND_DELIMITER = RDBENV_COMMAND_START + 2
+    ,RDBENV_COMMAND_PARALLEL_ON = RDBENV_COMMAND_START + 3
+    ,RDBENV_COMMAND_PARALLEL_OFF = RDBENV_COMMAND_START + 4
+    ,RDBENV_COMMAND_PUSHDOWN_ON = RDBENV_COMMAND_START + 5
+    ,RDBENV_COMMAND_PUSHDOWN_OFF = RDBENV_COMMAND_START + 6
 } RDBSQLStmtType;
 
 
@@ -398,6 +525,15 @@ typedef struct _RDBTableDes_t
      */
     int rowkeyid[RDBAPI_KEYS_MAXNUM + 1];
 
+    /**
+     * 1-based field index of secondary indexes
+     * indexids[0] is number of indexes
+     */
+    int indexids[RDBAPI_ARGV_MAXNUM + 1];
+
+    // number of ZSET shards of rowkey index on the first rowkey field
+    int rowkeyshards;
+
     int nfields;
     RDBFieldDes_t fielddes[RDBAPI_ARGV_MAXNUM];
 } RDBTableDes_t;
@@ -465,6 +601,9 @@ extern RDBThreadCtx RDBThreadCtxCreate (ub8 keyExpireMS, ssize_t keyBufSize, ssi
 
 extern RDBCtx RDBThreadCtxAttach (RDBThreadCtx thrctx, RDBCtx ctx);
 
+// attach a ctx checked out from env pool
+extern RDBAPI_RESULT RDBThreadCtxCheckout (RDBThreadCtx thrctx, RDBEnv env);
+
 extern RDBCtx RDBThreadCtxGetConn (RDBThreadCtx thrctx);
 
 extern ub8 RDBThreadCtxGetExpire (RDBThreadCtx thrctx);
@@ -517,6 +656,27 @@ extern RDBAPI_BOOL RDBEnvNodeGetMaster (RDBEnvNode envnode, int *masterindex);
 
 extern int RDBEnvNodeGetSlaves (RDBEnvNode envnode, int slaveindex[RDBAPI_SLAVES_MAXNUM]);
 
+extern RDBAPI_BOOL RDBEnvNodeIsHealthy (RDBEnvNode envnode);
+
+// set max idle connections pooled per node (0 disables pooling)
+extern void RDBEnvSetPoolMaxIdle (RDBEnv env, int maxidle);
+
+// set ttl in ms for cached table descriptors (0 disables cache)
+extern void RDBEnvSetTableDesTTL (RDBEnv env, ub4 ttl_ms);
+
+// drop cached descriptor of table (all tables if tablename is NULL).
+//   could be called on keyspace notification of: {redisdb::$tablespace:$tablename}
+extern void RDBEnvInvalidTableDes (RDBEnv env, const char *tablespace, const char *tablename);
+
+// set rows per second reclaimed by background DROP TABLE (0: unlimited)
+extern void RDBEnvSetDropRateLimit (RDBEnv env, ub4 rows_per_sec);
+
+// set ttl in ms of topology reloaded on RDBCtxCheckout (0: only on MOVED)
+extern void RDBEnvSetTopologyTTL (RDBEnv env, ub4 ttl_ms);
+
+// epoch of current topology, increased whenever roles of nodes change
+extern ub8 RDBEnvTopologyEpoch (RDBEnv env);
+
 
 /**********************************************************************
  *
@@ -536,6 +696,33 @@ extern RDBCtxNode RDBCtxGetNode (RDBCtx ctx, int nodeindex);
 
 extern RDBCtxNode RDBCtxGetActiveNode (RDBCtx ctx, const char *hostp, ub4 port);
 
+// get master node owns the given slot from slots map. NULL if not known.
+extern RDBCtxNode RDBCtxGetSlotNode (RDBCtx ctx, int slot);
+
+// reload slots map of env by command: 'cluster slots'
+extern RDBAPI_RESULT RDBCtxUpdateSlotsMap (RDBCtx ctx);
+
+// reload roles of nodes and slots map of env by one 'cluster nodes'
+extern RDBAPI_RESULT RDBCtxUpdateTopology (RDBCtx ctx);
+
+// set where SELECT reads rows of a master from. replicas are read after
+//   READONLY, so rows written just now may not be seen yet.
+extern void RDBCtxSetReadPreference (RDBCtx ctx, RDBReadPreference readpref);
+
+extern RDBReadPreference RDBCtxGetReadPreference (RDBCtx ctx);
+
+// get node to read slots of the given master by read preference of ctx.
+//   a replica returned is opened. master returned if no replica available.
+extern RDBCtxNode RDBCtxGetReadNode (RDBCtx ctx, int masterindex);
+
+// borrow a ctx whose node connections come from env pool.
+//   cluster is checked only at the first time.
+extern RDBAPI_RESULT RDBCtxCheckout (RDBEnv env, RDBCtx *outctx);
+
+// return connections of ctx to env pool and free ctx.
+//   RDBCtxFree does the same for a checked out ctx.
+extern void RDBCtxCheckin (RDBCtx ctx);
+
 extern RDBAPI_BOOL RDBCtxNodeIsOpen (RDBCtxNode ctxnode);
 
 extern RDBAPI_RESULT RDBCtxNodeOpen (RDBCtxNode ctxnode);
@@ -555,6 +742,46 @@ extern RDBAPI_RESULT RDBCtxCheckInfo (RDBCtx ctx, RDBNodeInfoSection section, in
 extern void RDBCtxPrintInfo (RDBCtx ctx, int nodeindex);
 
 
+/**********************************************************************
+ *
+ * RDBACtx RDBACtxNode API (async on hiredis + libevent)
+ *
+ *********************************************************************/
+struct event_base;
+
+// reply is owned by hiredis and only valid in callback.
+//   reply = NULL: request failed or aborted (see RDBACtxErrMsg)
+typedef void (* RDBACtxReplyCallback) (RDBACtx actx, redisReply *reply, void *arg);
+
+// eb = NULL: event_base created and owned by actx
+extern RDBAPI_RESULT RDBACtxCreate (RDBEnv env, struct event_base *eb, RDBACtx *outactx);
+
+extern void RDBACtxFree (RDBACtx actx);
+
+extern RDBEnv RDBACtxGetEnv (RDBACtx actx);
+
+extern struct event_base * RDBACtxGetEventBase (RDBACtx actx);
+
+extern const char * RDBACtxErrMsg (RDBACtx actx);
+
+extern RDBACtxNode RDBACtxGetNode (RDBACtx actx, int nodeindex);
+
+extern RDBAPI_BOOL RDBACtxNodeIsOpen (RDBACtxNode actxnode);
+
+extern RDBAPI_RESULT RDBACtxNodeOpen (RDBACtxNode actxnode);
+
+extern void RDBACtxNodeClose (RDBACtxNode actxnode);
+
+// send A redis Command to master node owns the key (argv[1]). cb called on reply
+extern RDBAPI_RESULT RDBACtxExecArgv (RDBACtx actx, int argc, const char *argv[], const size_t *argvlen, RDBACtxReplyCallback cb, void *arg);
+
+// send A redis Command on given RDBACtxNode
+extern RDBAPI_RESULT RDBACtxExecArgvOnNode (RDBACtxNode actxnode, int argc, const char *argv[], const size_t *argvlen, RDBACtxReplyCallback cb, void *arg);
+
+// run event loop until no more pending requests
+extern int RDBACtxEventLoop (RDBACtx actx);
+
+
 /**********************************************************************
  *
  * Redis helper API
@@ -571,7 +798,7 @@ extern void RedisFreeReplyObjects (redisReply **replys, int numReplys);
 // exec A redis Command on any an active node
 extern redisReply * RedisExecCommand (RDBCtx ctx, const char *command, RDBCtxNode *whichnode);
 
-// exec A redis Command on any an active node
+// exec A redis Command on master node owns the key (argv[1]), or on any an active node if no key
 extern redisReply * RedisExecCommandArgv (RDBCtx ctx, int argc, const char **argv, const size_t *argvlen);
 
 
@@ -584,6 +811,12 @@ extern RDBAPI_RESULT RedisExecArgvOnNode (RDBCtxNode ctxnode, int argc, const ch
 // exec A redis Command on given RDBCtxNode
 extern RDBAPI_RESULT RedisExecCommandArgvOnNode (RDBCtxNode ctxnode, char *command, redisReply **outReply);
 
+// pipeline: append A redis Command to output buffer of given RDBCtxNode
+extern RDBAPI_RESULT RedisAppendArgvOnNode (RDBCtxNode ctxnode, int argc, const char *argv[], const size_t *argvlen);
+
+// pipeline: get reply in order for Command appended on given RDBCtxNode
+extern RDBAPI_RESULT RedisGetReplyOnNode (RDBCtxNode ctxnode, redisReply **outReply);
+
 
 typedef void (* redisReplyWatchCallback) (int type, void *data, size_t datalen, void *arg);
 
@@ -616,11 +849,18 @@ extern RDBAPI_RESULT RedisHMGetLen (RDBCtx ctx, const char * key, size_t keylen,
 //   RDBAPI_KEY_NOTFOUND
 extern int RedisDeleteKey (RDBCtx ctx, const char * key, size_t keylen, const char * fields[], int numfields);
 
+// delete keys by UNLINK grouped by slot and pipelined per node.
+//   outstats[i]: RDBAPI_KEY_DELETED, RDBAPI_KEY_NOTFOUND, RDBAPI_KEY_UNKNOWN
+//     (group partially removed) or error (< 0)
+// returns number of keys deleted
+extern int RedisUnlinkKeys (RDBCtx ctx, const char *keys[], const size_t *keyslen, int numkeys, int *outstats);
+
 // 0: not existed
 // 1: existed
 // < 0: error
 extern int RedisExistsKey (RDBCtx ctx, const char * key, size_t keylen);
 
+// compute hash slot of key locally (crc16 with hash tags)
 extern RDBAPI_RESULT RedisClusterKeyslot (RDBCtx ctx, const char *key, sb8 *slot);
 
 extern RDBAPI_RESULT RedisClusterCheck (RDBCtx ctx);
@@ -702,6 +942,13 @@ extern RDBAPI_RESULT RDBTableScanFirst (RDBCtx ctx, RDBSQLStmt sqlstmt, RDBResul
 extern ub8 RDBTableScanNext (RDBResultMap hResultMap, ub8 offset, ub8 limit);
 extern RDBAPI_RESULT RDBTableCreate (RDBCtx ctx, const char *tablespace, const char *tablename, const char *tablecomment, int numfields, RDBFieldDes_t *fielddes);
 extern RDBAPI_RESULT RDBTableDescribe (RDBCtx ctx, const char *tablespace, const char *tablename, RDBTableDes_t *tabledes);
+extern RDBAPI_RESULT RDBTableCreateIndex (RDBCtx ctx, const char *tablespace, const char *tablename, const char *fieldname, ub8 *numrows);
+
+// tombstone table at once and reclaim its rows in background
+extern RDBAPI_RESULT RDBTableDrop (RDBCtx ctx, const char *tablespace, const char *tablename);
+
+// RDBAPI_TRUE if table is being dropped. reclaimed: rows reclaimed so far
+extern RDBAPI_BOOL RDBTableDropProgress (RDBCtx ctx, const char *tablespace, const char *tablename, ub8 *reclaimed);
 
 
 /**********************************************************************
@@ -715,10 +962,64 @@ extern void RDBSQLStmtFree (RDBSQLStmt sqlstmt);
 extern RDBSQLStmtType RDBSQLStmtGetSql (RDBSQLStmt sqlstmt, int indent, RDBZString *outsql);
 extern RDBAPI_RESULT RDBSQLStmtExecute (RDBSQLStmt sqlstmt, RDBResultMap *outResultMap);
 
+// number of bind parameters ('?' or ':name') in sqlstmt
+extern int RDBSQLStmtParamCount (RDBSQLStmt sqlstmt);
+
+// 1-based index of the first parameter named ':name'. 0 if not found
+extern int RDBSQLStmtParamIndex (RDBSQLStmt sqlstmt, const char *name);
+
+// bind value to 1-based parameter. all parameters must be bound before execute.
+extern RDBAPI_RESULT RDBSQLStmtBindString (RDBSQLStmt sqlstmt, int paramindex, const char *str, int len);
+extern RDBAPI_RESULT RDBSQLStmtBindSb8 (RDBSQLStmt sqlstmt, int paramindex, sb8 val);
+extern RDBAPI_RESULT RDBSQLStmtBindUb8 (RDBSQLStmt sqlstmt, int paramindex, ub8 val);
+extern RDBAPI_RESULT RDBSQLStmtBindDouble (RDBSQLStmt sqlstmt, int paramindex, double val);
+
+extern void RDBSQLStmtClearBindings (RDBSQLStmt sqlstmt);
+
 extern RDBAPI_RESULT RDBCtxExecuteSql (RDBCtx ctx, RDBZString sqlstr, RDBResultMap *outResultMap);
 extern RDBAPI_RESULT RDBCtxExecuteFile (RDBCtx ctx, const char *sqlfile, RDBResultMap *outResultMap);
 
 
+/**********************************************************************
+ *
+ * RDBCursor API
+ *   stream rows of SELECT in batches rather than all in one result map
+ *
+ *********************************************************************/
+
+// called on each row by RDBCursorForEach. returns 0 to stop
+typedef int (*RDBCursorRowCallback) (RDBRow row, void *arg);
+
+extern RDBAPI_RESULT RDBCursorOpen (RDBSQLStmt sqlstmt, ub4 batchrows, RDBCursor *outcursor);
+extern void RDBCursorClose (RDBCursor cursor);
+
+// next batch of rows valid until next fetch. returns 0 if no more rows, -1 on error
+extern int RDBCursorFetch (RDBCursor cursor, RDBRow **outrows);
+extern ub8 RDBCursorForEach (RDBCursor cursor, RDBCursorRowCallback rowcb, void *arg);
+
+// column heads of rows
+extern RDBResultMap RDBCursorResultMap (RDBCursor cursor);
+
+
+/**********************************************************************
+ *
+ * RDBColumnBatch API
+ *   rows copied into contiguous typed column buffers (Arrow layout):
+ *     int64 for signed, uint64 for unsigned and STAMP, double for FLT64,
+ *     utf8 for others. each column has a validity bitmap.
+ *
+ *********************************************************************/
+
+// rows = NULL for all rows of resultmap
+extern RDBAPI_RESULT RDBColumnBatchCreate (RDBResultMap resultmap, RDBRow *rows, ub8 numrows, RDBColumnBatch *outbatch);
+extern void RDBColumnBatchFree (RDBColumnBatch batch);
+extern ub8 RDBColumnBatchRows (RDBColumnBatch batch);
+extern int RDBColumnBatchCols (RDBColumnBatch batch);
+
+// export batch as a struct array. batch is moved into outarray and must not be used or freed
+extern RDBAPI_RESULT RDBColumnBatchExportArrow (RDBColumnBatch batch, struct ArrowSchema *outschema, struct ArrowArray *outarray);
+
+
 /**********************************************************************
  *
  * RDBResultMap API
@@ -776,6 +1077,9 @@ extern RDBCell RDBCellSetBinary (RDBCell cell, const void *addr, ub4 sz);
 extern RDBCell RDBCellSetReply (RDBCell cell, redisReply *replyString);
 extern RDBCell RDBCellSetResult (RDBCell cell, RDBResultMap resultmap);
 
+// cell refers to bytes not owned by cell, which must outlive the cell
+extern RDBCell RDBCellSetSlice (RDBCell cell, const char *ptr, int len);
+
 extern RDBZString RDBCellGetString (RDBCell cell);
 extern sb8 RDBCellGetInteger (RDBCell cell);
 extern double RDBCellGetDouble (RDBCell cell);
@@ -783,6 +1087,9 @@ extern RDBBinary RDBCellGetBinary (RDBCell cell);
 extern redisReply* RDBCellGetReply (RDBCell cell);
 extern RDBResultMap RDBCellGetResult (RDBCell cell);
 
+// bytes of slice, zstring or reply string cell without copy. NULL for other cells
+extern const char * RDBCellGetSlice (RDBCell cell, int *len);
+
 extern void RDBCellClean (RDBCell cell);
 extern void RDBCellPrint (RDBCell cell, FILE *fout, int colwidth);
 
@@ -78,6 +78,7 @@ void * librdbapi_log4crc;
 #include "common/memapi.h"
 #include "common/cstrut.h"
 #include "common/threadlock.h"
+#include "common/crc16.h"
 
 #include "common/uthash/uthash.h"
 #include "common/uthash/utarray.h"
@@ -88,7 +89,32 @@ void * librdbapi_log4crc;
 #include "common/tinyexpr/tinyexpr.h"
 
 
-typedef struct _RDBEnvNode_t * RDBEnvNodeMap;
+/**
+ * thread for parallel jobs
+ */
+#if defined(__WINDOWS__)
+    typedef HANDLE rdbthread_t;
+
+    # define RDBTHREAD_PROC(proc, arg)  unsigned __stdcall proc (void *arg)
+    # define RDBTHREAD_RETURN  return 0
+
+    # define rdbthread_create(thr, proc, arg)  ((*(thr) = (HANDLE) _beginthreadex(NULL, 0, proc, arg, 0, NULL)) != NULL ? 0 : (-1))
+    # define rdbthread_join(thr)  do { WaitForSingleObject(thr, INFINITE); CloseHandle(thr); } while(0)
+
+    # define rdbsleep_msec(ms)  Sleep(ms)
+#else
+    # include <unistd.h>
+
+    typedef pthread_t rdbthread_t;
+
+    # define RDBTHREAD_PROC(proc, arg)  void * proc (void *arg)
+    # define RDBTHREAD_RETURN  return NULL
+
+    # define rdbthread_create(thr, proc, arg)  pthread_create(thr, NULL, proc, arg)
+    # define rdbthread_join(thr)  pthread_join(thr, NULL)
+
+    # define rdbsleep_msec(ms)  usleep((useconds_t)(ms) * 1000)
+#endif
 
 
 /* Zero ended Ansi string */
@@ -136,6 +162,75 @@ typedef struct _RDBNodeReplica_t
 } RDBNodeReplica_t;
 
 
+/**
+ * immutable snapshot of roles of env nodes. a new one is published on
+ *   topology changed, and the old one is freed after the last ctx pinned
+ *   it unpins. so ctx reads its snapshot without lock.
+ */
+typedef struct _RDBTopology_t
+{
+    // pins by ctxs, plus one by env while it is current
+    ref_counter_t refc;
+
+    // increased by 1 when published
+    ub8 epoch;
+
+    // env nodes [0, numnodes) known by this snapshot
+    int numnodes;
+
+    RDBNodeReplica_t replicas[0];
+} RDBTopology_t, *RDBTopology;
+
+// role of node in topology pinned by ctx (no lock)
+#define RDBCtxNodeIsMaster(ctx, nodeid)  ((nodeid) < (ctx)->topology->numnodes && (ctx)->topology->replicas[nodeid].is_master)
+
+
+/**
+ * node listed by 'cluster nodes'
+ */
+typedef struct _RDBClusterNode_t
+{
+    char id[RDB_CLUSTER_NODEID_LEN + 1];
+
+    // id of master if node is a replica
+    char masterid[RDB_CLUSTER_NODEID_LEN + 1];
+
+    ub4 port;
+    char host[RDB_HOSTADDR_MAXLEN + 1];
+
+    ub1 is_master;
+
+    // flagged 'fail' by cluster
+    ub1 failed;
+} RDBClusterNode_t;
+
+
+/**
+ * idle redis connection in pool
+ */
+typedef struct _RDBPoolConn_t
+{
+    struct _RDBPoolConn_t *next;
+
+    // local time in ms when checked in
+    ub8 idlestamp;
+
+    redisContext *redCtx;
+} RDBPoolConn_t, *RDBPoolConn;
+
+
+// pool of node is sharded to reduce lock contention
+#define RDBENV_POOL_SHARDS   4
+
+typedef struct _RDBNodePool_t
+{
+    thread_lock_t lock;
+
+    int numidle;
+    RDBPoolConn idlelist;
+} RDBNodePool_t;
+
+
 typedef struct _RDBEnvNode_t
 {
     // constants
@@ -156,14 +251,39 @@ typedef struct _RDBEnvNode_t
 
     RDBPropMap nodeinfo[MAX_NODEINFO_SECTIONS];
 
-    // Replication
-    RDBNodeReplica_t replica;
+    // round trip time in microseconds measured when connected or before
+    //   ranking for nearest read (0: unknown). updated without lock since it
+    //   only ranks nodes for reading
+    ub4 rttusec;
 
-    // makes this structure hashable
-	UT_hash_handle hh;
+    // circuit breaker: consecutive connect or io failures, and local time
+    //   (ms) before which connecting to node fails fast (0: closed)
+    ref_counter_t failures;
+    ref_counter_t retrystamp;
+
+    // idle connections
+    RDBNodePool_t pool[RDBENV_POOL_SHARDS];
 } RDBEnvNode_t;
 
 
+/**
+ * cached table descriptor
+ */
+typedef struct _RDBTableDesEntry_t
+{
+    // tablespace.tablename
+    char key[RDB_KEY_NAME_MAXLEN * 2 + 2];
+
+    // local time in ms when checked with redis
+    ub8 checkstamp;
+
+    RDBTableDes_t tabledes;
+
+    // makes this structure hashable
+    UT_hash_handle hh;
+} RDBTableDesEntry_t, *RDBTableDesMap;
+
+
 typedef struct _RDBEnv_t
 {
     // readonly check table for RDBValueType: 0 - bad; 1 - good
@@ -177,13 +297,53 @@ typedef struct _RDBEnv_t
     // 0: OFF; 1: ON (default)
     ub1 verbose;
 
+    // scan masters in parallel threads. 0: OFF (default); 1: ON
+    ub1 parallel;
+
+    // filter fields of SCAN by lua script on server. 0: OFF (default); 1: ON
+    ub1 pushdown;
+
     // delimiter
     char delimiter;
 
     thread_lock_t thrlock;
 
-    RDBEnvNodeMap nodemap;
+    // slot => master nodeindex (-1: unknown), loaded from 'cluster slots'.
+    //   updated under thrlock
+    sb2 slotsmap[RDBAPI_CLUSTER_SLOTS];
+
+    // max idle connections pooled per node
+    int poolmaxidle;
+
+    // 1: RedisClusterCheck has been done once
+    ub1 clusterchecked;
+
+    // table descriptors cache, updated under thrlock
+    RDBTableDesMap tabledesmap;
+
+    // ttl in ms for cached table descriptor. 0: cache disabled
+    ub4 tabledesttl;
+
+    // sha1 of scan filter script loaded on nodes, updated under thrlock
+    char scanscriptsha[41];
+
+    // rows per second reclaimed by background DROP TABLE. 0: unlimited
+    ub4 dropratelimit;
+
+    // background DROP TABLE jobs, updated under thrlock
+    struct _RDBTableDropJob_t *dropjobs;
 
+    // current topology, swapped under thrlock
+    RDBTopology topology;
+
+    // local time in ms when topology loaded from cluster last time
+    ub8 topologystamp;
+
+    // ttl in ms of topology before RDBCtxCheckout reloads it. 0: never
+    ub4 topologyttl;
+
+    // nodes are only appended (under thrlock) and never moved, so
+    //   nodes [0, clusternodes) are read without lock.
     int maxclusternodes;
     int clusternodes;
 
@@ -208,13 +368,28 @@ typedef struct _RDBCtx_t
 
     RDBCtxNode_t *activenode;
 
+    // 1: checked out from env pool
+    ub1 pooled;
+
+    // pool shard of env node used by this ctx
+    int poolshard;
+
+    // RDBReadPreference of SELECT
+    ub1 readpref;
+
+    // topology pinned by this ctx
+    RDBTopology topology;
+
+    // random state of redirect backoff jitter
+    ub4 backoffseed;
+
     char errmsg[RDB_ERROR_MSG_LEN + 1];
 
     RDBCtxNode_t nodes[0];
 } RDBCtx_t;
 
 
-typedef struct _RDBAsynCtxNode_t
+typedef struct _RDBACtxNode_t
 {
     /**
      * redisAsyncContext is NOT thread-safe
@@ -232,10 +407,13 @@ typedef struct _RDBAsynCtxNode_t
  * redis async context
  *   https://blog.csdn.net/l1902090/article/details/38583663
  */
-typedef struct _RDBAsynCtx_t
+typedef struct _RDBACtx_t
 {
     struct event_base * eb;
 
+    // 1: eb created by actx and freed with it
+    int owneb;
+
     RDBEnv env;
 
     RDBACtxNode_t *activenode;
@@ -253,6 +431,9 @@ typedef struct _RDBTableCursor_t
 
     ub4 nodeindex;
     int finished;
+
+    // node the cursor reads from: master or its replica (-1: not chosen)
+    int readindex;
 } RDBTableCursor_t, * RDBTableCursor;
 
 
@@ -283,12 +464,90 @@ int RDBFieldDesUnpack (const void *addrin, ub4 sizein, RDBFieldDes_t * outfielde
 // 1-success
 int RDBFieldDesCheckSet (const RDBZString valtypetable[256], const RDBFieldDes_t * fielddes, int nfields, int rowkeyid[RDBAPI_KEYS_MAXNUM + 1], char *errmsg, size_t msgsz);
 
+// create ctx without cluster check, such as for worker threads
+RDBCtx RDBCtxNew (RDBEnv env);
+
+// pin the current topology of env on ctx if ctx pinned an older one
+void RDBCtxPinTopology (RDBCtx ctx);
+
+// pin current topology of env. unpinned by RDBTopologyUnpin
+RDBTopology RDBEnvPinTopology (RDBEnv env);
+
+void RDBTopologyUnpin (RDBTopology topology);
+
+// publish roles as a new topology if they differ from the current
+void RDBEnvPublishTopology (RDBEnv env, int numnodes, const RDBNodeReplica_t *replicas);
+
+// 1 if topology loaded more than interval ms ago: stamp is taken by caller (under thrlock)
+int RDBEnvTopologyReloadDue (RDBEnv env, ub8 interval);
+
+// append node to env (under thrlock). returns index of node or -1 if full
+int RDBEnvAppendNode (RDBEnv env, const char *host, ub4 port);
+
+// returns 1 if connecting to node is allowed by circuit breaker. only one
+//   caller gets the probe when breaker is half-open
+int RDBEnvNodeBreakerAcquire (RDBEnvNode envnode);
+
+// count a connect or io failure on node, open breaker on too many
+void RDBEnvNodeMarkFailed (RDBEnvNode envnode);
+
+// close breaker on node replied
+void RDBEnvNodeMarkHealthy (RDBEnvNode envnode);
+
+redisContext * RDBEnvNodePoolGet (RDBEnvNode envnode, int shard);
+
+RDBAPI_BOOL RDBEnvNodePoolPut (RDBEnvNode envnode, int shard, redisContext *redCtx);
+
+RDBAPI_RESULT RDBTableDescribeCached (RDBCtx ctx, const char *tablespace, const char *tablename, RDBTableDes_t *tabledes);
+
+ub8 RDBTableGetTimestampCached (RDBCtx ctx, const char *tablespace, const char *tablename);
+
+// index of the first key in argv for slot routing. 0 if no key
+int RedisCommandKeyIndex (int argc, const char **argv, const size_t *argvlen);
+
+// execute commands (key at argv[1]) pipelined per node. failed ones run again by slot routing
+void RedisExecArgvPipelined (RDBCtx ctx, int numcmds, const int *argcs, const char **argvs[], const size_t *argvlens[], redisReply **outReplies);
+
 int RDBNodeInfoQuery (RDBCtxNode ctxnode, RDBNodeInfoSection section, const char *propname, char propvalue[RDBAPI_PROP_MAXSIZE]);
 
 int RDBTableDesFieldIndex (const RDBTableDes_t *tabledes, const char *fieldname, int fieldnamelen);
 
 RDBAPI_RESULT RDBTableScanOnNode (RDBCtxNode ctxnode, RDBTableCursor nodestate, const char *pattern, size_t patternlen, ub8 maxlimit, redisReply **outReply);
 
+// stop background DROP TABLE jobs and wait for them. tombstones are kept
+void RDBTableDropJobsStop (RDBEnv env);
+
+int RDBTableIndexKey (const RDBTableDes_t *tabledes, int fieldid, int shard, char *keybuf, size_t bufsize);
+
+int RDBTableIndexGetValsArgv (const RDBTableDes_t *tabledes, const char *rowkey, size_t rowkeylen, const char *argv[], size_t argvlen[]);
+
+redisReply * RDBTableIndexValsReply (const RDBTableDes_t *tabledes, redisReply *reply);
+
+redisReply * RDBTableIndexGetVals (RDBCtx ctx, const RDBTableDes_t *tabledes, const char *rowkey, size_t rowkeylen);
+
+void RDBTableIndexGetValsRows (RDBCtx ctx, const RDBTableDes_t *tabledes, int numrows, const char *rowkeys[], const size_t *rowkeyslen, redisReply **outVals, int *outExists);
+
+void RDBTableIndexUpdateRow (RDBCtx ctx, const RDBTableDes_t *tabledes, const char *rowkey, size_t rowkeylen, redisReply *oldVals, int deleted);
+
+void RDBTableIndexUpdateRows (RDBCtx ctx, const RDBTableDes_t *tabledes, int numrows, const char *rowkeys[], const size_t *rowkeyslen, redisReply **oldVals, int deleted);
+
+// remove all rows from result map and keep up to maxspares of them for reuse
+void RDBResultMapRecycleAll (RDBResultMap resultmap);
+
+// new row carved from arena (malloc'ed if arena is NULL)
+RDBAPI_RESULT RDBRowNewInArena (RDBResultMap resultmap, mem_arena_t *arena, const char *key, int keylen, RDBRow *outrow);
+
+// new row whose key refers to keyreply without copy. row owns keyreply on success
+RDBAPI_RESULT RDBRowNewOnReply (RDBResultMap resultmap, mem_arena_t *arena, redisReply *keyreply, const char *key, int keylen, RDBRow *outrow);
+
+// parse reply text of 'cluster nodes' in place. nodeslots[slot] is index of
+//   node in nodes (-1: not served). returns number of nodes.
+int RDBClusterNodesParse (char *text, const char *selfhost, RDBClusterNode_t *nodes, int maxnodes, sb2 nodeslots[RDBAPI_CLUSTER_SLOTS]);
+
+// update roles of env nodes and slots map by parsed 'cluster nodes'.
+//   returns number of cluster nodes not found in env.
+int RDBEnvApplyClusterNodes (RDBEnv env, const RDBClusterNode_t *nodes, int numnodes, const sb2 nodeslots[RDBAPI_CLUSTER_SLOTS]);
+
 #if defined(__cplusplus)
 }
 #endif
@@ -34,34 +34,142 @@
 #include "rdbcommon.h"
 
 
-RDBAPI_RESULT RDBCtxCreate (RDBEnv env, RDBCtx *outctx)
+RDBCtx RDBCtxNew (RDBEnv env)
 {
     int i = 0;
 
-    RDBCtx ctx = (RDBCtx_t *) RDBMemAlloc(sizeof(RDBCtx_t) + env->clusternodes * sizeof(RDBCtxNode_t));
+    // room for nodes appended to env while ctx is in use
+    RDBCtx ctx = (RDBCtx_t *) RDBMemAlloc(sizeof(RDBCtx_t) + env->maxclusternodes * sizeof(RDBCtxNode_t));
 
     ctx->env = env;
     ctx->activenode = NULL;
 
-    for (; i < env->clusternodes; i++) {
+    for (; i < env->maxclusternodes; i++) {
         ctx->nodes[i].ctx = ctx;
         ctx->nodes[i].index = i;
         ctx->nodes[i].slot = -1;
     }
 
-    if (RedisClusterCheck(ctx) != RDBAPI_SUCCESS) {
-        printf("RedisClusterCheck failed: %s\n", ctx->errmsg);
-        RDBMemFree(ctx);
+    ctx->topology = RDBEnvPinTopology(env);
+
+    return ctx;
+}
+
+
+void RDBCtxPinTopology (RDBCtx ctx)
+{
+    // unlocked read is only a hint: the newer is pinned under lock
+    if (ctx->topology != ctx->env->topology) {
+        RDBTopology oldtopo = ctx->topology;
+
+        ctx->topology = RDBEnvPinTopology(ctx->env);
+
+        RDBTopologyUnpin(oldtopo);
+    }
+}
+
+
+RDBAPI_RESULT RDBCtxCreate (RDBEnv env, RDBCtx *outctx)
+{
+    RDBCtx ctx = RDBCtxNew(env);
+
+    if (env->clusterchecked) {
+        // topology loaded by env from seed nodes
+        *outctx = ctx;
+        return RDBAPI_SUCCESS;
+    }
+
+    if (RDBCtxUpdateTopology(ctx) != RDBAPI_SUCCESS) {
+        printf("RDBCtxUpdateTopology failed: %s\n", ctx->errmsg);
+        RDBCtxFree(ctx);
         return RDBAPI_ERROR;
     }
 
+    env->clusterchecked = 1;
+
+    RDBCtxPinTopology(ctx);
+
+    do {
+        int i;
+
+        // replicas were connected before known as replicas: reconnect
+        //   them with READONLY when read.
+        for (i = 0; i < ctx->topology->numnodes; i++) {
+            if (! RDBCtxNodeIsMaster(ctx, i)) {
+                RDBCtxNodeClose(RDBCtxGetNode(ctx, i));
+            }
+        }
+    } while(0);
+
+    *outctx = ctx;
+    return RDBAPI_SUCCESS;
+}
+
+
+RDBAPI_RESULT RDBCtxCheckout (RDBEnv env, RDBCtx *outctx)
+{
+    RDBCtx ctx;
+
+    if (! env->clusterchecked) {
+        if (RDBCtxCreate(env, &ctx) != RDBAPI_SUCCESS) {
+            return RDBAPI_ERROR;
+        }
+    } else {
+        ctx = RDBCtxNew(env);
+    }
+
+    ctx->pooled = 1;
+
+    // spread ctxs over pool shards
+    ctx->poolshard = (int) (((uintptr_t) ctx >> 4) % RDBENV_POOL_SHARDS);
+
+    if (env->topologyttl && RDBEnvTopologyReloadDue(env, env->topologyttl)) {
+        // topology may be changed without any MOVED (failover, nodes joined)
+        if (RDBCtxUpdateTopology(ctx) == RDBAPI_SUCCESS) {
+            RDBCtxPinTopology(ctx);
+        } else {
+            LOGGER_WARN("RDBCtxUpdateTopology failed: %s", ctx->errmsg);
+        }
+    }
+
     *outctx = ctx;
     return RDBAPI_SUCCESS;
 }
 
 
+void RDBCtxCheckin (RDBCtx ctx)
+{
+    if (ctx) {
+        int i = 0;
+        int numnodes = RDBEnvNumNodes(RDBCtxGetEnv(ctx));
+
+        for (; i < numnodes; i++) {
+            RDBCtxNode ctxnode = RDBCtxGetNode(ctx, i);
+
+            if (ctxnode->redCtx && ctx->env->poolmaxidle) {
+                if (RDBEnvNodePoolPut(RDBCtxNodeGetEnvNode(ctxnode), ctx->poolshard, ctxnode->redCtx)) {
+                    // connection owned by pool now
+                    ctxnode->redCtx = NULL;
+                }
+            }
+
+            RDBCtxNodeClose(ctxnode);
+        }
+
+        RDBTopologyUnpin(ctx->topology);
+
+        RDBMemFree(ctx);
+    }
+}
+
+
 void RDBCtxFree (RDBCtx ctx)
 {
+    if (ctx && ctx->pooled) {
+        RDBCtxCheckin(ctx);
+        return;
+    }
+
     if (ctx) {
         int i = 0;
         int numnodes = RDBEnvNumNodes(RDBCtxGetEnv(ctx));
@@ -71,6 +179,8 @@ void RDBCtxFree (RDBCtx ctx)
             RDBCtxNodeClose(node);
         }
 
+        RDBTopologyUnpin(ctx->topology);
+
         RDBMemFree(ctx);
     }
 }
@@ -153,6 +263,210 @@ RDBCtxNode RDBCtxGetActiveNode (RDBCtx ctx, const char *hostp, ub4 port)
 }
 
 
+RDBCtxNode RDBCtxGetSlotNode (RDBCtx ctx, int slot)
+{
+    RDBCtxNode ctxnode;
+
+    int nodeindex;
+
+    if (slot < 0 || slot >= RDBAPI_CLUSTER_SLOTS) {
+        return NULL;
+    }
+
+    // read sb2 without lock: a stale index is corrected by MOVED
+    nodeindex = ctx->env->slotsmap[slot];
+
+    ctxnode = RDBCtxGetNode(ctx, nodeindex);
+    if (! ctxnode) {
+        return NULL;
+    }
+
+    if (! ctxnode->redCtx) {
+        if (RDBCtxNodeOpen(ctxnode) != RDBAPI_SUCCESS) {
+            return NULL;
+        }
+    }
+
+    ctx->activenode = ctxnode;
+    return ctxnode;
+}
+
+
+static ub8 RDBCtxClockUsec (void)
+{
+#if defined(__WINDOWS__)
+    LARGE_INTEGER freq, now;
+
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&now);
+
+    return (ub8) (now.QuadPart / freq.QuadPart * 1000000 + now.QuadPart % freq.QuadPart * 1000000 / freq.QuadPart);
+#else
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+
+    return (ub8) tv.tv_sec * 1000000 + tv.tv_usec;
+#endif
+}
+
+
+/**
+ * RDBCtxNodeRttCommand
+ *   run command on connection of node. round trip time of the command is
+ *   taken as rtt of node.
+ */
+static RDBAPI_RESULT RDBCtxNodeRttCommand (RDBEnvNode envnode, redisContext *redCtx, const char *command)
+{
+    ub8 startusec, rttusec;
+    redisReply *reply;
+
+    startusec = RDBCtxClockUsec();
+
+    reply = (redisReply *) redisCommand(redCtx, command);
+    if (! reply || reply->type == REDIS_REPLY_ERROR) {
+        RedisFreeReplyObject(&reply);
+        return RDBAPI_ERROR;
+    }
+
+    RedisFreeReplyObject(&reply);
+
+    rttusec = RDBCtxClockUsec() - startusec;
+
+    if (envnode->rttusec) {
+        // smooth out occasional delays
+        rttusec = (envnode->rttusec * 7 + rttusec) / 8;
+    }
+
+    envnode->rttusec = (ub4) (rttusec? (rttusec < UB4MAXVAL? rttusec : UB4MAXVAL) : 1);
+
+    return RDBAPI_SUCCESS;
+}
+
+
+/**
+ * RDBCtxNodeRtt
+ *   rtt of node for ranking. node not measured yet is PINGed on connection
+ *   (opened or taken from pool without handshake). rtt unknown is taken as
+ *   largest so an unreachable node ranks last.
+ */
+static ub4 RDBCtxNodeRtt (RDBCtx ctx, int nodeindex)
+{
+    RDBCtxNode ctxnode = RDBCtxGetNode(ctx, nodeindex);
+    RDBEnvNode envnode = RDBCtxNodeGetEnvNode(ctxnode);
+
+    if (! envnode->rttusec) {
+        if (RDBCtxNodeIsOpen(ctxnode) || RDBCtxNodeOpen(ctxnode) == RDBAPI_SUCCESS) {
+            if (! envnode->rttusec && RDBCtxNodeRttCommand(envnode, ctxnode->redCtx, "PING") != RDBAPI_SUCCESS) {
+                RDBCtxNodeClose(ctxnode);
+            }
+        }
+    }
+
+    return (envnode->rttusec? envnode->rttusec : UB4MAXVAL);
+}
+
+
+void RDBCtxSetReadPreference (RDBCtx ctx, RDBReadPreference readpref)
+{
+    ctx->readpref = (ub1) readpref;
+}
+
+
+RDBReadPreference RDBCtxGetReadPreference (RDBCtx ctx)
+{
+    return (RDBReadPreference) ctx->readpref;
+}
+
+
+RDBCtxNode RDBCtxGetReadNode (RDBCtx ctx, int masterindex)
+{
+    int i, j, numcands = 0;
+    int cands[RDBAPI_SLAVES_MAXNUM + 1];
+
+    if (ctx->readpref == RDBREAD_MASTER || ! RDBCtxNodeIsMaster(ctx, masterindex)) {
+        return RDBCtxGetNode(ctx, masterindex);
+    }
+
+    // replicas in topology pinned by ctx
+    numcands = ctx->topology->replicas[masterindex].connected_slaves;
+    memcpy(cands, ctx->topology->replicas[masterindex].slaves, sizeof(int) * numcands);
+
+    if (ctx->readpref == RDBREAD_PREFER_REPLICA) {
+        if (numcands > 1) {
+            // spread ctxs over replicas of master
+            int first = ctx->poolshard % numcands;
+            int slaves[RDBAPI_SLAVES_MAXNUM];
+
+            memcpy(slaves, cands, sizeof(int) * numcands);
+
+            for (i = 0; i < numcands; i++) {
+                cands[i] = slaves[(first + i) % numcands];
+            }
+        }
+    } else {
+        // nearest: master competes with replicas. every candidate is measured
+        //   before ranking, so an open master is not taken as nearest for lack
+        //   of rtt.
+        ub4 rtts[RDBAPI_SLAVES_MAXNUM + 1];
+
+        cands[numcands++] = masterindex;
+
+        for (i = 0; i < numcands; i++) {
+            rtts[i] = RDBCtxNodeRtt(ctx, cands[i]);
+        }
+
+        for (i = 1; i < numcands; i++) {
+            int cand = cands[i];
+            ub4 rtt = rtts[i];
+
+            for (j = i; j > 0 && rtts[j - 1] > rtt; j--) {
+                cands[j] = cands[j - 1];
+                rtts[j] = rtts[j - 1];
+            }
+            cands[j] = cand;
+            rtts[j] = rtt;
+        }
+    }
+
+    for (i = 0; i < numcands; i++) {
+        RDBCtxNode ctxnode = RDBCtxGetNode(ctx, cands[i]);
+
+        if (RDBCtxNodeIsOpen(ctxnode) || RDBCtxNodeOpen(ctxnode) == RDBAPI_SUCCESS) {
+            return ctxnode;
+        }
+    }
+
+    // no replica available
+    return RDBCtxGetNode(ctx, masterindex);
+}
+
+
+/**
+ * RDBCtxNodeHandshake
+ *   send READONLY to replica. PING master only when rtt is wanted. round
+ *   trip time of the command is taken as rtt of node.
+ */
+static RDBAPI_RESULT RDBCtxNodeHandshake (RDBCtx ctx, RDBEnvNode envnode, redisContext *redCtx)
+{
+    const char *command;
+
+    // node unknown to topology of ctx is taken as master
+    int is_replica = (envnode->index < ctx->topology->numnodes && ! ctx->topology->replicas[envnode->index].is_master);
+
+    if (ctx->env->clusterchecked && is_replica) {
+        // replica serves reads of its master's slots only in READONLY
+        command = "READONLY";
+    } else if (ctx->readpref == RDBREAD_NEAREST) {
+        command = "PING";
+    } else {
+        return RDBAPI_SUCCESS;
+    }
+
+    return RDBCtxNodeRttCommand(envnode, redCtx, command);
+}
+
+
 RDBAPI_BOOL RDBCtxNodeIsOpen (RDBCtxNode ctxnode)
 {
     return ((ctxnode && ctxnode->redCtx) ? RDBAPI_TRUE : RDBAPI_FALSE);
@@ -168,14 +482,36 @@ RDBAPI_RESULT RDBCtxNodeOpen (RDBCtxNode ctxnode)
 
     RDBCtxNodeClose(ctxnode);
 
+    if (ctx->pooled) {
+        redCtx = RDBEnvNodePoolGet(envnode, ctx->poolshard);
+
+        if (redCtx) {
+            ctxnode->redCtx = redCtx;
+            ctx->activenode = ctxnode;
+
+            return RDBAPI_SUCCESS;
+        }
+    }
+
+    if (! RDBEnvNodeBreakerAcquire(envnode)) {
+        // fail fast instead of waiting ctxtimeo on a dead node
+        snprintf_chkd_V1(ctx->errmsg, sizeof(ctx->errmsg), "RDBAPI_ERROR: node(%s) circuit open", envnode->key);
+        return RDBAPI_ERROR;
+    }
+
     if (envnode->ctxtimeo.tv_sec) {
         redCtx = redisConnectWithTimeout(envnode->host, envnode->port, envnode->ctxtimeo);
     } else {
         redCtx = redisConnect(envnode->host, envnode->port);
     }
 
-    if (! redCtx) {
+    if (! redCtx || redCtx->err) {
         // redis connect failed
+        if (redCtx) {
+            redisFree(redCtx);
+        }
+
+        RDBEnvNodeMarkFailed(envnode);
         return RDBAPI_ERROR;
     }
 
@@ -187,6 +523,14 @@ RDBAPI_RESULT RDBCtxNodeOpen (RDBCtxNode ctxnode)
         }
     }
 
+    if (RDBCtxNodeHandshake(ctx, envnode, redCtx) != RDBAPI_SUCCESS) {
+        redisFree(redCtx);
+        RDBEnvNodeMarkFailed(envnode);
+        return RDBAPI_ERROR;
+    }
+
+    RDBEnvNodeMarkHealthy(envnode);
+
     ctxnode->redCtx = redCtx;
     ctx->activenode = ctxnode;
 
@@ -402,6 +746,360 @@ RDBAPI_RESULT RDBCtxCheckInfo (RDBCtx ctx, RDBNodeInfoSection section, int which
 }
 
 
+/**
+ * RDBCtxUpdateSlotsMap
+ *   load slots map from any an active node by command 'cluster slots':
+ *
+ *   1) 1) (integer) 0             - start slot
+ *      2) (integer) 5460          - end slot
+ *      3) 1) "127.0.0.1"          - master host
+ *         2) (integer) 7001       - master port
+ *         3) "09dbe9720cda62..."  - node id
+ *      4) ...                     - replicas
+ */
+RDBAPI_RESULT RDBCtxUpdateSlotsMap (RDBCtx ctx)
+{
+    RDBAPI_RESULT result;
+    redisReply *reply;
+
+    RDBCtxNode ctxnode;
+    RDBEnvNode envnode;
+
+    size_t i, numslots = 0;
+
+    sb2 slotsmap[RDBAPI_CLUSTER_SLOTS];
+
+    const char *argv[] = {"cluster", "slots"};
+    size_t argvlen[] = {7, 5};
+
+    ctxnode = RDBCtxGetActiveNode(ctx, NULL, 0);
+    if (! ctxnode) {
+        snprintf_chkd_V1(ctx->errmsg, sizeof(ctx->errmsg), "RDBAPI_ERROR: No active node");
+        return RDBAPI_ERROR;
+    }
+
+    result = RedisExecArgvOnNode(ctxnode, 2, argv, argvlen, &reply);
+    if (result != RDBAPI_SUCCESS) {
+        return result;
+    }
+
+    if (reply->type != REDIS_REPLY_ARRAY) {
+        snprintf_chkd_V1(ctx->errmsg, sizeof(ctx->errmsg), "RDBAPI_ERR_TYPE: reply type(%d)", reply->type);
+        RedisFreeReplyObject(&reply);
+        return RDBAPI_ERR_TYPE;
+    }
+
+    memset(slotsmap, 0xff, sizeof(slotsmap));
+
+    for (i = 0; i < reply->elements; i++) {
+        redisReply *range = reply->element[i];
+        redisReply *master;
+
+        long long slot, endslot;
+
+        if (range->type != REDIS_REPLY_ARRAY || range->elements < 3) {
+            continue;
+        }
+
+        master = range->element[2];
+        if (range->element[0]->type != REDIS_REPLY_INTEGER ||
+            range->element[1]->type != REDIS_REPLY_INTEGER ||
+            master->type != REDIS_REPLY_ARRAY || master->elements < 2 ||
+            master->element[0]->type != REDIS_REPLY_STRING ||
+            master->element[1]->type != REDIS_REPLY_INTEGER) {
+            continue;
+        }
+
+        if (master->element[0]->len) {
+            envnode = RDBEnvFindNode(ctx->env, master->element[0]->str, (ub4) master->element[1]->integer);
+        } else {
+            // empty host means the node we are talking to
+            envnode = RDBEnvFindNode(ctx->env, RDBCtxNodeGetEnvNode(ctxnode)->host, (ub4) master->element[1]->integer);
+        }
+
+        if (! envnode) {
+            // master not in env nodes: leave slots unknown and let MOVED do the job
+            continue;
+        }
+
+        slot = range->element[0]->integer;
+        endslot = range->element[1]->integer;
+
+        for (; slot <= endslot && slot < RDBAPI_CLUSTER_SLOTS; slot++) {
+            if (slot >= 0) {
+                slotsmap[slot] = (sb2) envnode->index;
+                numslots++;
+            }
+        }
+    }
+
+    RedisFreeReplyObject(&reply);
+
+    threadlock_lock(&ctx->env->thrlock);
+    memcpy(ctx->env->slotsmap, slotsmap, sizeof(slotsmap));
+    threadlock_unlock(&ctx->env->thrlock);
+
+    if (numslots != RDBAPI_CLUSTER_SLOTS) {
+        LOGGER_WARN("slots not covered: %d", (int) (RDBAPI_CLUSTER_SLOTS - numslots));
+    }
+
+    return RDBAPI_SUCCESS;
+}
+
+
+/**
+ * RDBClusterNodesParse
+ *   parse lines of 'cluster nodes':
+ *
+ *   <id> <ip:port@cport[,hostname]> <flags> <master> <ping-sent> <pong-recv> <config-epoch> <link-state> <slot> <slot> ...
+ *
+ *   07c37dfeb235213a872192d90877d0cd55635b91 127.0.0.1:30004@31004 slave e7d1eecce10fd6bb5eb35b9f99a514335d9ba9ca 0 1426238317239 4 connected
+ *   e7d1eecce10fd6bb5eb35b9f99a514335d9ba9ca 127.0.0.1:30001@31001 myself,master - 0 0 1 connected 0-5460
+ *
+ *   nodes in handshake or without address are skipped. slots being
+ *   migrated or imported ([slot->-id]) are left to MOVED.
+ */
+int RDBClusterNodesParse (char *text, const char *selfhost, RDBClusterNode_t *nodes, int maxnodes, sb2 nodeslots[RDBAPI_CLUSTER_SLOTS])
+{
+    int slot, numnodes = 0;
+
+    char *line, *saveline;
+
+    memset(nodeslots, 0xff, sizeof(sb2) * RDBAPI_CLUSTER_SLOTS);
+
+    for (line = strtok_r(text, "\r\n", &saveline); line && numnodes < maxnodes; line = strtok_r(NULL, "\r\n", &saveline)) {
+        int col = 0, skip = 0, myself = 0;
+
+        char *tok, *savetok;
+
+        RDBClusterNode_t *node = &nodes[numnodes];
+
+        bzero(node, sizeof(*node));
+
+        for (tok = strtok_r(line, " ", &savetok); tok && ! skip; tok = strtok_r(NULL, " ", &savetok), col++) {
+            if (col == 0) {
+                snprintf_chkd_V1(node->id, sizeof(node->id), "%.*s", RDB_CLUSTER_NODEID_LEN, tok);
+            } else if (col == 1) {
+                // ip:port@cport[,hostname]
+                char *port;
+                char *cport = strchr(tok, '@');
+
+                if (cport) {
+                    *cport = 0;
+                }
+
+                port = strrchr(tok, ':');
+                if (! port) {
+                    skip = 1;
+                    continue;
+                }
+                *port++ = 0;
+
+                node->port = (ub4) atoi(port);
+
+                snprintf_chkd_V1(node->host, sizeof(node->host), "%s", tok);
+            } else if (col == 2) {
+                char *flag, *saveflag;
+
+                for (flag = strtok_r(tok, ",", &saveflag); flag; flag = strtok_r(NULL, ",", &saveflag)) {
+                    if (! strcmp(flag, "master")) {
+                        node->is_master = 1;
+                    } else if (! strcmp(flag, "myself")) {
+                        myself = 1;
+                    } else if (! strcmp(flag, "fail")) {
+                        node->failed = 1;
+                    } else if (! strcmp(flag, "handshake") || ! strcmp(flag, "noaddr")) {
+                        skip = 1;
+                    }
+                }
+            } else if (col == 3) {
+                if (strcmp(tok, "-")) {
+                    snprintf_chkd_V1(node->masterid, sizeof(node->masterid), "%.*s", RDB_CLUSTER_NODEID_LEN, tok);
+                }
+            } else if (col >= 8 && tok[0] != '[') {
+                // slot or range of slots: 0-5460
+                char *endp;
+
+                long start = strtol(tok, &endp, 10);
+                long end = start;
+
+                if (*endp == '-') {
+                    end = strtol(endp + 1, NULL, 10);
+                }
+
+                for (; start <= end && start < RDBAPI_CLUSTER_SLOTS; start++) {
+                    if (start >= 0) {
+                        nodeslots[start] = (sb2) numnodes;
+                    }
+                }
+            }
+        }
+
+        if (! *node->host && myself && selfhost) {
+            // node does not know its own ip yet
+            snprintf_chkd_V1(node->host, sizeof(node->host), "%s", selfhost);
+        }
+
+        if (col < 8 || skip || ! node->port || ! *node->host) {
+            // drop slots taken by this line
+            for (slot = 0; slot < RDBAPI_CLUSTER_SLOTS; slot++) {
+                if (nodeslots[slot] == (sb2) numnodes) {
+                    nodeslots[slot] = -1;
+                }
+            }
+            continue;
+        }
+
+        numnodes++;
+    }
+
+    return numnodes;
+}
+
+
+int RDBEnvApplyClusterNodes (RDBEnv env, const RDBClusterNode_t *nodes, int numnodes, const sb2 nodeslots[RDBAPI_CLUSTER_SLOTS])
+{
+    int i, j, slot, numenvnodes, unknown = 0;
+
+    int envindex[RDB_CLUSTER_NODES_MAX];
+    sb2 slotsmap[RDBAPI_CLUSTER_SLOTS];
+
+    RDBNodeReplica_t *replicas;
+
+    // nodes are appended under lock by one writer at a time
+    threadlock_lock(&env->thrlock);
+
+    for (i = 0; i < numnodes; i++) {
+        RDBEnvNode envnode = RDBEnvFindNode(env, nodes[i].host, nodes[i].port);
+
+        if (envnode) {
+            envindex[i] = envnode->index;
+        } else {
+            // node joined cluster
+            envindex[i] = RDBEnvAppendNode(env, nodes[i].host, nodes[i].port);
+
+            if (envindex[i] == -1) {
+                unknown++;
+            }
+        }
+    }
+
+    numenvnodes = env->clusternodes;
+
+    threadlock_unlock(&env->thrlock);
+
+    replicas = (RDBNodeReplica_t *) RDBMemAlloc(sizeof(RDBNodeReplica_t) * numenvnodes);
+
+    for (i = 0; i < numenvnodes; i++) {
+        // node not listed serves nothing
+        replicas[i].master_nodeindex = -1;
+    }
+
+    for (i = 0; i < numnodes; i++) {
+        if (envindex[i] != -1 && nodes[i].is_master) {
+            replicas[envindex[i]].is_master = 1;
+            replicas[envindex[i]].master_nodeindex = envindex[i];
+        }
+    }
+
+    for (i = 0; i < numnodes; i++) {
+        if (envindex[i] == -1 || nodes[i].is_master || ! *nodes[i].masterid) {
+            continue;
+        }
+
+        for (j = 0; j < numnodes; j++) {
+            if (envindex[j] != -1 && nodes[j].is_master && ! strcmp(nodes[j].id, nodes[i].masterid)) {
+                RDBNodeReplica_t *master = &replicas[envindex[j]];
+
+                replicas[envindex[i]].master_nodeindex = envindex[j];
+
+                // failed replica is not read from
+                if (! nodes[i].failed && master->connected_slaves < RDBAPI_SLAVES_MAXNUM) {
+                    master->slaves[master->connected_slaves++] = envindex[i];
+                }
+                break;
+            }
+        }
+    }
+
+    for (slot = 0; slot < RDBAPI_CLUSTER_SLOTS; slot++) {
+        slotsmap[slot] = (nodeslots[slot] == -1? -1 : (sb2) envindex[nodeslots[slot]]);
+    }
+
+    // slots map is a hint read without lock and corrected by MOVED
+    threadlock_lock(&env->thrlock);
+    memcpy(env->slotsmap, slotsmap, sizeof(slotsmap));
+    threadlock_unlock(&env->thrlock);
+
+    RDBEnvPublishTopology(env, numenvnodes, replicas);
+
+    RDBMemFree(replicas);
+
+    return unknown;
+}
+
+
+/**
+ * RDBCtxUpdateTopology
+ *   roles of nodes and slots map are all got by one 'cluster nodes' from
+ *   any an active node, rather than INFO on every node.
+ */
+RDBAPI_RESULT RDBCtxUpdateTopology (RDBCtx ctx)
+{
+    RDBAPI_RESULT result;
+    redisReply *reply;
+
+    RDBCtxNode ctxnode;
+
+    int numnodes, unknown;
+
+    RDBClusterNode_t *nodes;
+    sb2 nodeslots[RDBAPI_CLUSTER_SLOTS];
+
+    const char *argv[] = {"cluster", "nodes"};
+    size_t argvlen[] = {7, 5};
+
+    ctxnode = RDBCtxGetActiveNode(ctx, NULL, 0);
+    if (! ctxnode) {
+        snprintf_chkd_V1(ctx->errmsg, sizeof(ctx->errmsg), "RDBAPI_ERROR: No active node");
+        return RDBAPI_ERROR;
+    }
+
+    result = RedisExecArgvOnNode(ctxnode, 2, argv, argvlen, &reply);
+    if (result != RDBAPI_SUCCESS) {
+        return result;
+    }
+
+    if (reply->type != REDIS_REPLY_STRING) {
+        snprintf_chkd_V1(ctx->errmsg, sizeof(ctx->errmsg), "RDBAPI_ERR_TYPE: reply type(%d)", reply->type);
+        RedisFreeReplyObject(&reply);
+        return RDBAPI_ERR_TYPE;
+    }
+
+    nodes = (RDBClusterNode_t *) RDBMemAlloc(sizeof(RDBClusterNode_t) * RDB_CLUSTER_NODES_MAX);
+
+    numnodes = RDBClusterNodesParse(reply->str, RDBCtxNodeGetEnvNode(ctxnode)->host, nodes, RDB_CLUSTER_NODES_MAX, nodeslots);
+
+    RedisFreeReplyObject(&reply);
+
+    if (! numnodes) {
+        RDBMemFree(nodes);
+        snprintf_chkd_V1(ctx->errmsg, sizeof(ctx->errmsg), "RDBAPI_ERROR: no nodes in cluster");
+        return RDBAPI_ERROR;
+    }
+
+    unknown = RDBEnvApplyClusterNodes(ctx->env, nodes, numnodes, nodeslots);
+
+    RDBMemFree(nodes);
+
+    if (unknown) {
+        LOGGER_WARN("cluster nodes exceed RDB_CLUSTER_NODES_MAX: %d", unknown);
+    }
+
+    return RDBAPI_SUCCESS;
+}
+
+
 static void RDBCtxNodePrintInfo (RDBCtxNode ctxnode, const char *sections[])
 {
     int section;
@@ -234,13 +234,17 @@ exit_return:
 
 static void RDBEnvSetNode (RDBEnvNode node, const char *host, ub4 port, ub4 ctxtimeout, ub4 sotimeoms, const char *authpass)
 {
-    int keylen;
+    int shard;
+
+    for (shard = 0; shard < RDBENV_POOL_SHARDS; shard++) {
+        threadlock_init(&node->pool[shard].lock);
+    }
 
     node->port = port;
 
     snprintf_chkd_V1(node->host, sizeof(node->host), "%.*s", (int) strnlen(host, RDB_HOSTADDR_MAXLEN), host);
 
-    keylen = snprintf_chkd_V1(node->key, sizeof(node->key), "%s:%d", node->host, (int) node->port);
+    snprintf_chkd_V1(node->key, sizeof(node->key), "%s:%d", node->host, (int) node->port);
 
     if (authpass) {
         snprintf_chkd_V1(node->authpass, sizeof(node->authpass), "%.*s", (int) strnlen(authpass, RDB_AUTHPASS_MAXLEN), authpass);
@@ -262,8 +266,6 @@ static void RDBEnvSetNode (RDBEnvNode node, const char *host, ub4 port, ub4 ctxt
     } else {
         memset(&node->sotimeo, 0, sizeof(node->sotimeo));
     }
-
-    HASH_ADD_STR_LEN(node->env->nodemap, key, keylen, node);
 }
 
 
@@ -274,7 +276,7 @@ static void RDBEnvInitInternal (RDBEnv env, RDBNodeCfg nodecfgs[])
     for (i = 0; i < (int) env->clusternodes; i++) {
         env->nodes[i].env = env;            
         env->nodes[i].index = i;
-        
+
         RDBEnvSetNode(&(env->nodes[i]), nodecfgs[i]->host, nodecfgs[i]->port, nodecfgs[i]->ctxtimeout, nodecfgs[i]->sotimeo_ms, nodecfgs[i]->authpass);
     }
 
@@ -397,6 +399,69 @@ static size_t RDBEnvLoadCfgfile (const char *cfgfile, char **outCluster, int *io
 }
 
 
+/**
+ * RDBEnvDiscoverNodes
+ *   ask seed nodes in turn for 'cluster nodes' until one answers.
+ *   returns number of nodes found and seed answered.
+ */
+static int RDBEnvDiscoverNodes (RDBNodeCfg seeds[], int numseeds, RDBClusterNode_t *nodes, sb2 nodeslots[RDBAPI_CLUSTER_SLOTS], int *seedindex)
+{
+    int i, numnodes = 0;
+
+    for (i = 0; i < numseeds && ! numnodes; i++) {
+        redisContext *redCtx;
+        redisReply *reply = NULL;
+
+        RDBNodeCfg seed = seeds[i];
+
+        if (seed->ctxtimeout) {
+            struct timeval tv = {seed->ctxtimeout, 0};
+            redCtx = redisConnectWithTimeout(seed->host, (int) seed->port, tv);
+        } else {
+            redCtx = redisConnect(seed->host, (int) seed->port);
+        }
+
+        if (! redCtx || redCtx->err) {
+            printf("(%s:%d) seed node(%s:%u) connect failed\n", __FILE__, __LINE__, seed->host, seed->port);
+            if (redCtx) {
+                redisFree(redCtx);
+            }
+            continue;
+        }
+
+        if (seed->sotimeo_ms) {
+            struct timeval tv = {seed->sotimeo_ms / 1000, (seed->sotimeo_ms % 1000) * 1000};
+            redisSetTimeout(redCtx, tv);
+        }
+
+        if (*seed->authpass) {
+            reply = (redisReply *) redisCommand(redCtx, "AUTH %s", seed->authpass);
+
+            if (! reply || reply->type == REDIS_REPLY_ERROR) {
+                printf("(%s:%d) seed node(%s:%u) auth failed\n", __FILE__, __LINE__, seed->host, seed->port);
+                RedisFreeReplyObject(&reply);
+                redisFree(redCtx);
+                continue;
+            }
+
+            RedisFreeReplyObject(&reply);
+        }
+
+        reply = (redisReply *) redisCommand(redCtx, "CLUSTER NODES");
+
+        if (reply && reply->type == REDIS_REPLY_STRING) {
+            numnodes = RDBClusterNodesParse(reply->str, seed->host, nodes, RDB_CLUSTER_NODES_MAX, nodeslots);
+            *seedindex = i;
+        }
+
+        RedisFreeReplyObject(&reply);
+        redisFree(redCtx);
+    }
+
+    return numnodes;
+}
+
+
 RDBAPI_RESULT RDBEnvCreate (const char *cluster, int ctxtimeout, int sotimeo_ms, RDBEnv *outenv)
 {
     if (sotimeo_ms == 0) {
@@ -420,9 +485,12 @@ RDBAPI_RESULT RDBEnvCreate (const char *cluster, int ctxtimeout, int sotimeo_ms,
     } else {
         RDBEnv env;
 
-        int numnodes;
+        int i, numnodes, numfound, seed = 0;
         RDBNodeCfg nodecfgs[RDB_CLUSTER_NODES_MAX] = {0};
 
+        RDBClusterNode_t *clustnodes;
+        sb2 nodeslots[RDBAPI_CLUSTER_SLOTS];
+
         numnodes = RDBParseClusterNodes(cluster, ctxtimeout, sotimeo_ms, nodecfgs);
 
         if (numnodes < 1) {
@@ -430,23 +498,79 @@ RDBAPI_RESULT RDBEnvCreate (const char *cluster, int ctxtimeout, int sotimeo_ms,
             return RDBAPI_ERR_NODES;
         }
 
-        env = (RDBEnv_t *) RDBMemAlloc(sizeof(RDBEnv_t) + (int) numnodes * sizeof(RDBEnvNode_t));
+        // nodes given are seeds: the whole cluster is got by one of them
+        clustnodes = (RDBClusterNode_t *) RDBMemAlloc(sizeof(RDBClusterNode_t) * RDB_CLUSTER_NODES_MAX);
+
+        numfound = RDBEnvDiscoverNodes(nodecfgs, numnodes, clustnodes, nodeslots, &seed);
+
+        if (numfound) {
+            // all nodes are accessed as the seed answered
+            RDBNodeCfg_t seedcfg = *nodecfgs[seed];
+
+            for (i = 0; i < numnodes; i++) {
+                RDBMemFree(nodecfgs[i]);
+                nodecfgs[i] = NULL;
+            }
+
+            for (numnodes = 0; numnodes < numfound; numnodes++) {
+                RDBNodeCfg nodecfg = (RDBNodeCfg) RDBMemAlloc(sizeof(RDBNodeCfg_t));
+
+                memcpy(nodecfg, &seedcfg, sizeof(seedcfg));
+
+                snprintf_chkd_V1(nodecfg->host, sizeof(nodecfg->host), "%s", clustnodes[numnodes].host);
+                nodecfg->port = clustnodes[numnodes].port;
+
+                nodecfgs[numnodes] = nodecfg;
+            }
+        } else {
+            printf("(%s:%d) no seed node answered 'cluster nodes', nodes are used as given.\n", __FILE__, __LINE__);
+        }
+
+        // room for nodes joined later
+        env = (RDBEnv_t *) RDBMemAlloc(sizeof(RDBEnv_t) + RDB_CLUSTER_NODES_MAX * sizeof(RDBEnvNode_t));
 
-        env->nodemap = NULL;
+        env->maxclusternodes = RDB_CLUSTER_NODES_MAX;
         env->clusternodes = numnodes;
 
+        // all slots are unknown until RDBCtxUpdateSlotsMap
+        memset(env->slotsmap, 0xff, sizeof(env->slotsmap));
+
         RDBEnvInitInternal(env, nodecfgs);
 
-        while(numnodes-- > 0) {
-            RDBMemFree(nodecfgs[numnodes]);
+        for (i = 0; i < numnodes; i++) {
+            RDBMemFree(nodecfgs[i]);
         }
 
         threadlock_init(&env->thrlock);
 
+        // no roles known until cluster checked
+        env->topologyttl = RDBAPI_TOPOLOGY_TTL_MS;
+        env->topology = (RDBTopology) RDBMemAlloc(sizeof(RDBTopology_t) + sizeof(RDBNodeReplica_t) * numnodes);
+        env->topology->refc = 1;
+        env->topology->epoch = 1;
+        env->topology->numnodes = numnodes;
+
+        if (numfound) {
+            RDBEnvApplyClusterNodes(env, clustnodes, numfound, nodeslots);
+
+            // RDBCtxCreate need not check cluster any more
+            env->clusterchecked = 1;
+        }
+
+        RDBMemFree(clustnodes);
+
         // set env readonly attributes
         env->verbose = (ub1)1;
         env->delimiter = RDB_TABLE_DELIMITER_CHAR;
 
+        env->poolmaxidle = RDBAPI_POOL_MAXIDLE;
+
+        env->tabledesmap = NULL;
+        env->tabledesttl = RDBAPI_TABLEDES_TTL_MS;
+
+        env->dropratelimit = RDBAPI_DROP_RATE_LIMIT;
+        env->dropjobs = NULL;
+
         snprintf_chkd_V1(env->_exprstr, sizeof(env->_exprstr), "%s", "=,LLIKE,RLIKE,LIKE,MATCH,!=,>,<,>=,<=");
         do {
             char *saveptr;
@@ -464,15 +588,48 @@ RDBAPI_RESULT RDBEnvCreate (const char *cluster, int ctxtimeout, int sotimeo_ms,
 }
 
 
+static void RDBEnvNodePoolClear (RDBEnvNode envnode)
+{
+    int shard;
+
+    for (shard = 0; shard < RDBENV_POOL_SHARDS; shard++) {
+        RDBNodePool_t *pool = &envnode->pool[shard];
+
+        threadlock_lock(&pool->lock);
+
+        while (pool->idlelist) {
+            RDBPoolConn conn = pool->idlelist;
+            pool->idlelist = conn->next;
+
+            redisFree(conn->redCtx);
+            RDBMemFree(conn);
+        }
+
+        pool->numidle = 0;
+
+        threadlock_unlock(&pool->lock);
+    }
+}
+
+
 void RDBEnvDestroy (RDBEnv env)
 {
     int i, s;
 
+    // reclaiming of dropped tables is resumed by DROP TABLE again
+    RDBTableDropJobsStop(env);
+
     threadlock_lock(&env->thrlock);
 
     for (i = 0; i < env->clusternodes; i++) {
         RDBEnvNode envnode = RDBEnvGetNode(env, i);
 
+        RDBEnvNodePoolClear(envnode);
+
+        for (s = 0; s < RDBENV_POOL_SHARDS; s++) {
+            threadlock_destroy(&envnode->pool[s].lock);
+        }
+
         for (s = (int) NODEINFO_SERVER; s != (int) MAX_NODEINFO_SECTIONS; s++) {
             RDBPropMap propmap = envnode->nodeinfo[s];
             envnode->nodeinfo[s] = NULL;
@@ -481,7 +638,17 @@ void RDBEnvDestroy (RDBEnv env)
         }
     }
 
-    HASH_CLEAR(hh, env->nodemap);
+    RDBTopologyUnpin(env->topology);
+    env->topology = NULL;
+
+    do {
+        RDBTableDesEntry_t *entry, *tmp;
+
+        HASH_ITER(hh, env->tabledesmap, entry, tmp) {
+            HASH_DEL(env->tabledesmap, entry);
+            RDBMemFree(entry);
+        }
+    } while(0);
 
     for (i = 0; i < sizeof(env->valtypetable)/sizeof(env->valtypetable[0]); i++) {
         RDBZStringFree(env->valtypetable[i]);
@@ -510,14 +677,16 @@ int RDBEnvNumMasterNodes (RDBEnv env)
     int masters = 0;
     int nodeindex = 0;
 
-    for (; nodeindex < env->clusternodes; nodeindex++) {
-        RDBEnvNode envnode = RDBEnvGetNode(env, nodeindex);
+    RDBTopology topology = RDBEnvPinTopology(env);
 
-        if (envnode->replica.is_master) {
+    for (; nodeindex < topology->numnodes; nodeindex++) {
+        if (topology->replicas[nodeindex].is_master) {
             masters++;
         }
     }
 
+    RDBTopologyUnpin(topology);
+
     return masters;
 }
 
@@ -534,19 +703,25 @@ RDBEnvNode RDBEnvGetNode (RDBEnv env, int nodeindex)
 
 RDBEnvNode RDBEnvFindNode (RDBEnv env, const char *host, ub4 port)
 {
-    RDBEnvNode node = NULL;
+    int nodeindex;
+
+    char key[RDB_HOSTADDR_MAXLEN + 12];
 
     if (! port || port == (ub4) -1) {
-        HASH_FIND_STR(env->nodemap, host, node);
+        // host is 'host:port'
+        snprintf_chkd_V1(key, sizeof(key), "%s", host);
     } else {
-        char key[RDB_HOSTADDR_MAXLEN + 12];
-
         snprintf_chkd_V1(key, sizeof(key), "%s:%u", host, port);
+    }
 
-        HASH_FIND_STR(env->nodemap, key, node);
+    // nodes are few and only appended, so no lock for a linear search
+    for (nodeindex = 0; nodeindex < env->clusternodes; nodeindex++) {
+        if (! strcmp(env->nodes[nodeindex].key, key)) {
+            return &env->nodes[nodeindex];
+        }
     }
 
-    return node;
+    return NULL;
 }
 
 
@@ -588,32 +763,422 @@ const char * RDBEnvNodeHostPort (RDBEnvNode envnode)
 
 RDBAPI_BOOL RDBEnvNodeGetMaster (RDBEnvNode envnode, int *masterindex)
 {
-    if (envnode->replica.is_master) {
-        if (masterindex) {
-            *masterindex = envnode->index;
-        }
-        return RDBAPI_TRUE;
-    } else {
-        if (masterindex) {
-            *masterindex = envnode->replica.master_nodeindex;
+    RDBAPI_BOOL is_master = RDBAPI_FALSE;
+
+    RDBTopology topology = RDBEnvPinTopology(envnode->env);
+
+    if (masterindex) {
+        *masterindex = -1;
+    }
+
+    if (envnode->index < topology->numnodes) {
+        const RDBNodeReplica_t *replica = &topology->replicas[envnode->index];
+
+        if (replica->is_master) {
+            if (masterindex) {
+                *masterindex = envnode->index;
+            }
+            is_master = RDBAPI_TRUE;
+        } else {
+            if (masterindex) {
+                *masterindex = replica->master_nodeindex;
+            }
         }
-        return RDBAPI_FALSE;
     }
+
+    RDBTopologyUnpin(topology);
+
+    return is_master;
 }
 
 
 int RDBEnvNodeGetSlaves (RDBEnvNode envnode, int slaveindex[RDBAPI_SLAVES_MAXNUM])
 {
-    if (envnode->replica.is_master) {
+    int numslaves = 0;
+
+    RDBTopology topology = RDBEnvPinTopology(envnode->env);
+
+    // no slaves for slave node
+    if (envnode->index < topology->numnodes && topology->replicas[envnode->index].is_master) {
+        const RDBNodeReplica_t *replica = &topology->replicas[envnode->index];
+
+        numslaves = replica->connected_slaves;
+
         if (slaveindex) {
             int i = 0;
-            for (i = 0; i < envnode->replica.connected_slaves; i++) {
-                slaveindex[i] = envnode->replica.slaves[i];
+            for (i = 0; i < numslaves; i++) {
+                slaveindex[i] = replica->slaves[i];
             }
         }
-        return envnode->replica.connected_slaves;
-    } else {
-        // no slaves for slave node
+    }
+
+    RDBTopologyUnpin(topology);
+
+    return numslaves;
+}
+
+
+static sb8 RDBEnvNodeBackoffMs (sb8 failures)
+{
+    sb8 backoffms = RDBAPI_RECONNECT_BACKOFF_MS;
+
+    while (failures-- > RDBAPI_BREAKER_FAILURES && backoffms < RDBAPI_RECONNECT_BACKOFF_MAXMS) {
+        backoffms <<= 1;
+    }
+
+    return (backoffms < RDBAPI_RECONNECT_BACKOFF_MAXMS? backoffms : RDBAPI_RECONNECT_BACKOFF_MAXMS);
+}
+
+
+/**
+ * RDBEnvNodeIsHealthy
+ *   returns RDBAPI_FALSE while circuit breaker on node is open, that is
+ *   connecting to node fails fast until backoff elapsed.
+ */
+RDBAPI_BOOL RDBEnvNodeIsHealthy (RDBEnvNode envnode)
+{
+    sb8 retrystamp = envnode->retrystamp;
+
+    if (! retrystamp || (sb8) RDBGetLocalTime(NULL) >= retrystamp) {
+        return RDBAPI_TRUE;
+    }
+
+    return RDBAPI_FALSE;
+}
+
+
+int RDBEnvNodeBreakerAcquire (RDBEnvNode envnode)
+{
+    sb8 now;
+    sb8 retrystamp = envnode->retrystamp;
+
+    if (! retrystamp) {
+        // closed
+        return 1;
+    }
+
+    now = (sb8) RDBGetLocalTime(NULL);
+    if (now < retrystamp) {
+        // open
         return 0;
-    }    
+    }
+
+    // half-open: one caller probes, others fail fast until it reports
+    return __interlock_cas(&envnode->retrystamp, retrystamp, now + RDBEnvNodeBackoffMs(envnode->failures));
+}
+
+
+void RDBEnvNodeMarkFailed (RDBEnvNode envnode)
+{
+    sb8 failures = __interlock_add(&envnode->failures);
+
+    if (failures >= RDBAPI_BREAKER_FAILURES) {
+        __interlock_set(&envnode->retrystamp, (sb8) RDBGetLocalTime(NULL) + RDBEnvNodeBackoffMs(failures));
+
+        if (failures == RDBAPI_BREAKER_FAILURES) {
+            LOGGER_WARN("circuit breaker opened on node(%s) by %d failures", envnode->key, (int) failures);
+        }
+    }
+}
+
+
+void RDBEnvNodeMarkHealthy (RDBEnvNode envnode)
+{
+    // read first: no write on shared node in normal
+    if (envnode->failures) {
+        __interlock_set(&envnode->retrystamp, 0);
+        __interlock_set(&envnode->failures, 0);
+    }
+}
+
+
+RDBTopology RDBEnvPinTopology (RDBEnv env)
+{
+    RDBTopology topology;
+
+    threadlock_lock(&env->thrlock);
+
+    topology = env->topology;
+    __interlock_add(&topology->refc);
+
+    threadlock_unlock(&env->thrlock);
+
+    return topology;
+}
+
+
+void RDBTopologyUnpin (RDBTopology topology)
+{
+    if (topology && __interlock_sub(&topology->refc) == 0) {
+        RDBMemFree(topology);
+    }
+}
+
+
+/**
+ * RDBEnvTopologyReloadDue
+ *   coalesce topology reloads: the first caller after topology loaded for
+ *   interval ms takes the stamp and reloads, the others do not.
+ */
+int RDBEnvTopologyReloadDue (RDBEnv env, ub8 interval)
+{
+    int due = 0;
+    ub8 now = RDBGetLocalTime(NULL);
+
+    threadlock_lock(&env->thrlock);
+    if (now > env->topologystamp + interval) {
+        env->topologystamp = now;
+        due = 1;
+    }
+    threadlock_unlock(&env->thrlock);
+
+    return due;
+}
+
+
+void RDBEnvPublishTopology (RDBEnv env, int numnodes, const RDBNodeReplica_t *replicas)
+{
+    RDBTopology oldtopo, newtopo;
+
+    threadlock_lock(&env->thrlock);
+
+    env->topologystamp = RDBGetLocalTime(NULL);
+
+    oldtopo = env->topology;
+
+    if (oldtopo->numnodes == numnodes && ! memcmp(oldtopo->replicas, replicas, sizeof(RDBNodeReplica_t) * numnodes)) {
+        // unchanged
+        threadlock_unlock(&env->thrlock);
+        return;
+    }
+
+    newtopo = (RDBTopology) RDBMemAlloc(sizeof(RDBTopology_t) + sizeof(RDBNodeReplica_t) * numnodes);
+
+    newtopo->refc = 1;
+    newtopo->epoch = oldtopo->epoch + 1;
+    newtopo->numnodes = numnodes;
+
+    memcpy(newtopo->replicas, replicas, sizeof(RDBNodeReplica_t) * numnodes);
+
+    env->topology = newtopo;
+
+    threadlock_unlock(&env->thrlock);
+
+    // ctxs pinned old topology keep it until unpinned
+    RDBTopologyUnpin(oldtopo);
+}
+
+
+int RDBEnvAppendNode (RDBEnv env, const char *host, ub4 port)
+{
+    RDBEnvNode envnode;
+
+    // new node is accessed as the first node
+    RDBEnvNode firstnode = &env->nodes[0];
+
+    if (env->clusternodes >= env->maxclusternodes) {
+        return -1;
+    }
+
+    envnode = &env->nodes[env->clusternodes];
+
+    envnode->env = env;
+    envnode->index = env->clusternodes;
+
+    RDBEnvSetNode(envnode, host, port, (ub4) firstnode->ctxtimeo.tv_sec, RDBEnvNodeSotimeo(firstnode), firstnode->authpass);
+
+    // node is ready before it can be seen by lock-free readers
+    __interlock_barrier();
+
+    env->clusternodes++;
+
+    return envnode->index;
+}
+
+
+void RDBEnvSetPoolMaxIdle (RDBEnv env, int maxidle)
+{
+    int i;
+
+    env->poolmaxidle = (maxidle > 0 ? maxidle : 0);
+
+    if (! env->poolmaxidle) {
+        for (i = 0; i < env->clusternodes; i++) {
+            RDBEnvNodePoolClear(RDBEnvGetNode(env, i));
+        }
+    }
+}
+
+
+static RDBPoolConn RDBNodePoolPop (RDBNodePool_t *pool, int trylock)
+{
+    RDBPoolConn conn = NULL;
+
+    if (trylock) {
+        if (threadlock_trylock(&pool->lock) != 0) {
+            return NULL;
+        }
+    } else {
+        threadlock_lock(&pool->lock);
+    }
+
+    if (pool->idlelist) {
+        conn = pool->idlelist;
+        pool->idlelist = conn->next;
+        pool->numidle--;
+    }
+
+    threadlock_unlock(&pool->lock);
+
+    return conn;
+}
+
+
+/**
+ * take an idle connection from pool of node: own shard first, then
+ *   steal from other shards which are not locked. a connection idle
+ *   longer than RDBAPI_POOL_PINGIDLE_MS is checked by PING.
+ *
+ * returns:
+ *   NULL if no healthy connection in pool
+ */
+redisContext * RDBEnvNodePoolGet (RDBEnvNode envnode, int shard)
+{
+    int i;
+    RDBPoolConn conn;
+
+    for (i = 0; i < RDBENV_POOL_SHARDS; i++) {
+        RDBNodePool_t *pool = &envnode->pool[(shard + i) % RDBENV_POOL_SHARDS];
+
+        while ((conn = RDBNodePoolPop(pool, i)) != NULL) {
+            redisContext *redCtx = conn->redCtx;
+            ub8 idlestamp = conn->idlestamp;
+
+            RDBMemFree(conn);
+
+            if (RDBGetLocalTime(NULL) - idlestamp > RDBAPI_POOL_PINGIDLE_MS) {
+                redisReply *reply = (redisReply *) redisCommand(redCtx, "PING");
+
+                if (! reply || reply->type != REDIS_REPLY_STATUS) {
+                    // dead connection
+                    if (reply) {
+                        freeReplyObject(reply);
+                    }
+                    redisFree(redCtx);
+                    continue;
+                }
+
+                freeReplyObject(reply);
+            }
+
+            return redCtx;
+        }
+    }
+
+    return NULL;
+}
+
+
+/**
+ * put a connection back to pool of node.
+ *
+ * returns:
+ *   RDBAPI_FALSE if pool is full or redCtx is in error (caller frees it)
+ */
+RDBAPI_BOOL RDBEnvNodePoolPut (RDBEnvNode envnode, int shard, redisContext *redCtx)
+{
+    RDBPoolConn conn;
+    RDBNodePool_t *pool = &envnode->pool[shard % RDBENV_POOL_SHARDS];
+
+    // per shard bound
+    int maxidle = (envnode->env->poolmaxidle + RDBENV_POOL_SHARDS - 1) / RDBENV_POOL_SHARDS;
+
+    if (redCtx->err || pool->numidle >= maxidle) {
+        return RDBAPI_FALSE;
+    }
+
+    conn = (RDBPoolConn) RDBMemAlloc(sizeof(RDBPoolConn_t));
+    if (! conn) {
+        return RDBAPI_FALSE;
+    }
+
+    conn->redCtx = redCtx;
+    conn->idlestamp = RDBGetLocalTime(NULL);
+
+    threadlock_lock(&pool->lock);
+
+    if (pool->numidle >= maxidle) {
+        threadlock_unlock(&pool->lock);
+        RDBMemFree(conn);
+        return RDBAPI_FALSE;
+    }
+
+    conn->next = pool->idlelist;
+    pool->idlelist = conn;
+    pool->numidle++;
+
+    threadlock_unlock(&pool->lock);
+
+    return RDBAPI_TRUE;
+}
+
+
+void RDBEnvSetTableDesTTL (RDBEnv env, ub4 ttl_ms)
+{
+    env->tabledesttl = ttl_ms;
+
+    if (! ttl_ms) {
+        RDBEnvInvalidTableDes(env, NULL, NULL);
+    }
+}
+
+
+void RDBEnvSetDropRateLimit (RDBEnv env, ub4 rows_per_sec)
+{
+    env->dropratelimit = rows_per_sec;
+}
+
+
+void RDBEnvSetTopologyTTL (RDBEnv env, ub4 ttl_ms)
+{
+    env->topologyttl = ttl_ms;
+}
+
+
+ub8 RDBEnvTopologyEpoch (RDBEnv env)
+{
+    ub8 epoch;
+
+    threadlock_lock(&env->thrlock);
+    epoch = env->topology->epoch;
+    threadlock_unlock(&env->thrlock);
+
+    return epoch;
+}
+
+
+void RDBEnvInvalidTableDes (RDBEnv env, const char *tablespace, const char *tablename)
+{
+    RDBTableDesEntry_t *entry, *tmp;
+
+    threadlock_lock(&env->thrlock);
+
+    if (! tablename) {
+        HASH_ITER(hh, env->tabledesmap, entry, tmp) {
+            HASH_DEL(env->tabledesmap, entry);
+            RDBMemFree(entry);
+        }
+    } else {
+        char key[RDB_KEY_NAME_MAXLEN * 2 + 2];
+        int keylen = snprintf_chkd_V1(key, sizeof(key), "%s.%s", tablespace, tablename);
+
+        HASH_FIND(hh, env->tabledesmap, key, keylen, entry);
+
+        if (entry) {
+            HASH_DEL(env->tabledesmap, entry);
+            RDBMemFree(entry);
+        }
+    }
+
+    threadlock_unlock(&env->thrlock);
 }
@@ -103,6 +103,15 @@ void RDBResultMapDestroy (RDBResultMap resultmap)
 
         RDBResultMapDeleteAll(resultmap);
 
+        while (resultmap->sparerows) {
+            RDBRowNode row = resultmap->sparerows;
+            resultmap->sparerows = row->nextspare;
+
+            if (! row->inarena) {
+                RDBMemFree(row);
+            }
+        }
+
         if (resultmap->filter) {
             RDBTableFilterFree(resultmap->filter);
         }
@@ -159,18 +168,104 @@ void RDBResultMapDeleteAll (RDBResultMap resultmap)
 }
 
 
-void RDBResultMapDeleteAllOnCluster (RDBResultMap resultmap)
+void RDBResultMapRecycleAll (RDBResultMap resultmap)
 {
     RDBRowNode curnode, tmpnode;
     HASH_ITER(hh, resultmap->rowsmap, curnode, tmpnode) {
-        if (RedisDeleteKey(resultmap->ctx, curnode->key, curnode->keylen, NULL, 0) != RDBAPI_KEY_DELETED) {
-            HASH_DEL(resultmap->rowsmap, curnode);
+        HASH_DEL(resultmap->rowsmap, curnode);
+
+        if (resultmap->numspares < resultmap->maxspares) {
+            int colindex = curnode->count;
+
+            while (colindex-- > 0) {
+                RDBCellClean(RDBRowCell(curnode, colindex));
+            }
+
+            RedisFreeReplyObject(&curnode->keyreply);
+
+            curnode->nextspare = resultmap->sparerows;
+            resultmap->sparerows = curnode;
+            resultmap->numspares++;
+        } else {
             RDBRowFree(curnode);
         }
     }
 }
 
 
+void RDBResultMapDeleteAllOnCluster (RDBResultMap resultmap)
+{
+    RDBRowNode curnode, tmpnode;
+
+    int i, numrows, numdeleted = 0;
+
+    RDBRow *rows;
+    const char **keys;
+    size_t *keyslen;
+    int *stats;
+    redisReply **oldVals = NULL;
+
+    // table descriptor only if indexes to maintain
+    RDBTableDes_t *tabledes = (resultmap->filter? resultmap->filter->tabledes : NULL);
+
+    numrows = (int) HASH_COUNT(resultmap->rowsmap);
+    if (! numrows) {
+        return;
+    }
+
+    rows = (RDBRow *) RDBMemAlloc(sizeof(RDBRow) * numrows);
+    keys = (const char **) RDBMemAlloc(sizeof(char *) * numrows);
+    keyslen = (size_t *) RDBMemAlloc(sizeof(size_t) * numrows);
+    stats = (int *) RDBMemAlloc(sizeof(int) * numrows);
+
+    i = 0;
+    HASH_ITER(hh, resultmap->rowsmap, curnode, tmpnode) {
+        rows[i] = curnode;
+        keys[i] = curnode->key;
+        keyslen[i] = curnode->keylen;
+        i++;
+    }
+
+    if (tabledes && tabledes->indexids[0]) {
+        // index values of rows to remove from indexes, pipelined per node
+        oldVals = (redisReply **) RDBMemAlloc(sizeof(redisReply *) * numrows);
+
+        RDBTableIndexGetValsRows(resultmap->ctx, tabledes, numrows, keys, keyslen, oldVals, NULL);
+    }
+
+    // UNLINK keys grouped by slot and pipelined per node
+    RedisUnlinkKeys(resultmap->ctx, keys, keyslen, numrows, stats);
+
+    for (i = 0; i < numrows; i++) {
+        // key with unknown outcome is gone anyway: taken as deleted
+        if (stats[i] != RDBAPI_KEY_DELETED && stats[i] != RDBAPI_KEY_UNKNOWN) {
+            HASH_DEL(resultmap->rowsmap, rows[i]);
+            RDBRowFree(rows[i]);
+
+            if (oldVals) {
+                RedisFreeReplyObject(&oldVals[i]);
+            }
+        } else if (oldVals) {
+            // rows deleted are moved ahead for index update
+            keys[numdeleted] = keys[i];
+            keyslen[numdeleted] = keyslen[i];
+            oldVals[numdeleted++] = oldVals[i];
+        }
+    }
+
+    if (oldVals) {
+        RDBTableIndexUpdateRows(resultmap->ctx, tabledes, numdeleted, keys, keyslen, oldVals, 1);
+
+        RedisFreeReplyObjects(oldVals, numdeleted);
+        RDBMemFree(oldVals);
+    }
+    RDBMemFree(stats);
+    RDBMemFree(keyslen);
+    RDBMemFree(keys);
+    RDBMemFree(rows);
+}
+
+
 RDBZString RDBResultMapTitle (RDBResultMap resultmap)
 {
     return resultmap->title;
@@ -368,6 +463,452 @@ void RDBResultMapPrint (RDBCtx ctx, RDBResultMap resultmap, FILE *fout)
 }
 
 
+/**************************************
+ *
+ * RDBColumnBatch
+ *
+ **************************************/
+
+static RDBValueType ColumnBatchInferType (RDBRow *rows, ub8 numrows, int colindex)
+{
+    ub8 i;
+
+    for (i = 0; i < numrows; i++) {
+        switch (RDBRowCell(rows[i], colindex)->type) {
+        case RDB_CELLTYPE_INVALID:
+            continue;
+
+        case RDB_CELLTYPE_INTEGER:
+            return RDBVT_SB8;
+
+        case RDB_CELLTYPE_DOUBLE:
+            return RDBVT_FLT64;
+
+        default:
+            break;
+        }
+
+        break;
+    }
+
+    return RDBVT_STR;
+}
+
+
+static const char * ColumnBatchFormat (RDBValueType valtype)
+{
+    switch (valtype) {
+    case RDBVT_SB2:
+    case RDBVT_SB4:
+    case RDBVT_SB8:
+    case RDBVT_CHAR:
+        return "l";
+
+    case RDBVT_UB2:
+    case RDBVT_UB4:
+    case RDBVT_UB4X:
+    case RDBVT_UB8:
+    case RDBVT_UB8X:
+    case RDBVT_BYTE:
+    case RDBVT_STAMP:
+        return "L";
+
+    case RDBVT_FLT64:
+        return "g";
+
+    default:
+        break;
+    }
+
+    return "u";
+}
+
+
+// string of cell value. NULL for null
+static const char * ColumnBatchCellStr (RDBCell cell, char buf[32], int *len)
+{
+    switch (cell->type) {
+    case RDB_CELLTYPE_ZSTRING:
+    case RDB_CELLTYPE_REPLY:
+    case RDB_CELLTYPE_SLICE:
+        return RDBCellGetSlice(cell, len);
+
+    case RDB_CELLTYPE_BINARY:
+        *len = (int) cell->bin->sz;
+        return (const char *) cell->bin->addr;
+
+    case RDB_CELLTYPE_INTEGER:
+        *len = snprintf_chkd_V1(buf, 32, "%"PRId64, cell->integer);
+        return buf;
+
+    case RDB_CELLTYPE_DOUBLE:
+        *len = snprintf_chkd_V1(buf, 32, "%.17g", cell->dblval);
+        return buf;
+
+    default:
+        break;
+    }
+
+    *len = 0;
+    return NULL;
+}
+
+
+// set value of numeric column at row. returns 0 if null
+static int ColumnBatchCellNum (RDBColumn col, RDBCell cell, ub8 row)
+{
+    char buf[32];
+    int len;
+    const char *str;
+
+    switch (*col->format) {
+    case 'l':
+        if (cell->type == RDB_CELLTYPE_INTEGER) {
+            ((sb8 *) col->buffers[1])[row] = cell->integer;
+            return 1;
+        }
+        str = ColumnBatchCellStr(cell, buf, &len);
+        return (str && cstr_to_sb8(10, str, len, &((sb8 *) col->buffers[1])[row]) > 0);
+
+    case 'L':
+        if (cell->type == RDB_CELLTYPE_INTEGER) {
+            ((ub8 *) col->buffers[1])[row] = (ub8) cell->integer;
+            return 1;
+        }
+        str = ColumnBatchCellStr(cell, buf, &len);
+        return (str && cstr_to_ub8((col->valtype == RDBVT_UB4X || col->valtype == RDBVT_UB8X)? 16 : 10, str, len, &((ub8 *) col->buffers[1])[row]) > 0);
+
+    case 'g':
+        if (cell->type == RDB_CELLTYPE_DOUBLE) {
+            ((double *) col->buffers[1])[row] = cell->dblval;
+            return 1;
+        }
+        if (cell->type == RDB_CELLTYPE_INTEGER) {
+            ((double *) col->buffers[1])[row] = (double) cell->integer;
+            return 1;
+        }
+        str = ColumnBatchCellStr(cell, buf, &len);
+        return (str && cstr_to_dbl(str, len, &((double *) col->buffers[1])[row]) > 0);
+    }
+
+    return 0;
+}
+
+
+static void ColumnFree (RDBColumn col)
+{
+    if (col) {
+        int i;
+        for (i = 0; i < col->numbuffers; i++) {
+            RDBMemFree((void *) col->buffers[i]);
+        }
+
+        RDBZStringFree(col->name);
+        RDBMemFree(col);
+    }
+}
+
+
+static RDBAPI_RESULT ColumnBatchBuild (RDBColumn col, RDBRow *rows, ub8 numrows, int colindex)
+{
+    ub8 i;
+
+    ub1 *validity = (ub1 *) RDBMemAlloc((size_t)((numrows + 7) / 8) + 1);
+
+    col->buffers[0] = validity;
+    col->numbuffers = 1;
+
+    if (! validity) {
+        return RDBAPI_ERR_NOMEM;
+    }
+
+    if (*col->format != 'u') {
+        col->buffers[1] = RDBMemAlloc(sizeof(ub8) * (size_t) numrows + 1);
+        col->numbuffers = 2;
+
+        if (! col->buffers[1]) {
+            return RDBAPI_ERR_NOMEM;
+        }
+
+        for (i = 0; i < numrows; i++) {
+            if (ColumnBatchCellNum(col, RDBRowCell(rows[i], colindex), i)) {
+                validity[i / 8] |= (ub1)(1 << (i % 8));
+            } else {
+                col->nullcount++;
+            }
+        }
+    } else {
+        char buf[32];
+        int len;
+        const char *str;
+
+        char *data;
+        ub8 datasize = 0;
+
+        for (i = 0; i < numrows; i++) {
+            if (ColumnBatchCellStr(RDBRowCell(rows[i], colindex), buf, &len)) {
+                datasize += len;
+            }
+        }
+
+        if (datasize > SB4MAXVAL) {
+            // offsets exceed int32: large utf8
+            col->format = "U";
+            col->buffers[1] = RDBMemAlloc(sizeof(sb8) * (size_t)(numrows + 1));
+        } else {
+            col->buffers[1] = RDBMemAlloc(sizeof(sb4) * (size_t)(numrows + 1));
+        }
+
+        col->buffers[2] = data = (char *) RDBMemAlloc((size_t) datasize + 1);
+        col->numbuffers = 3;
+
+        if (! col->buffers[1] || ! data) {
+            return RDBAPI_ERR_NOMEM;
+        }
+
+        datasize = 0;
+
+        for (i = 0; i < numrows; i++) {
+            str = ColumnBatchCellStr(RDBRowCell(rows[i], colindex), buf, &len);
+
+            if (str) {
+                memcpy(data + datasize, str, len);
+                datasize += len;
+
+                validity[i / 8] |= (ub1)(1 << (i % 8));
+            } else {
+                col->nullcount++;
+            }
+
+            if (*col->format == 'U') {
+                ((sb8 *) col->buffers[1])[i + 1] = (sb8) datasize;
+            } else {
+                ((sb4 *) col->buffers[1])[i + 1] = (sb4) datasize;
+            }
+        }
+    }
+
+    return RDBAPI_SUCCESS;
+}
+
+
+RDBAPI_RESULT RDBColumnBatchCreate (RDBResultMap resultmap, RDBRow *rows, ub8 numrows, RDBColumnBatch *outbatch)
+{
+    RDBAPI_RESULT result = RDBAPI_SUCCESS;
+
+    int colindex;
+    RDBColumnBatch batch;
+
+    RDBRow *maprows = NULL;
+
+    int numcols = RDBResultMapColHeads(resultmap);
+
+    // value types of table columns. inferred from cells if not a table scan
+    const RDBValueType *valtypes = ((resultmap->filter && ! resultmap->filter->sqlfunc)? resultmap->filter->colvaltypes : NULL);
+
+    *outbatch = NULL;
+
+    if (! rows) {
+        RDBRowIter rowiter;
+
+        numrows = RDBResultMapRows(resultmap);
+
+        maprows = (RDBRow *) RDBMemAlloc(sizeof(RDBRow) * (size_t) numrows + 1);
+        if (! maprows) {
+            return RDBAPI_ERR_NOMEM;
+        }
+
+        numrows = 0;
+        for (rowiter = RDBResultMapFirstRow(resultmap); rowiter; rowiter = RDBResultMapNextRow(rowiter)) {
+            maprows[numrows++] = RDBRowIterGetRow(rowiter);
+        }
+
+        rows = maprows;
+    }
+
+    batch = (RDBColumnBatch) RDBMemAlloc(sizeof(RDBColumnBatch_t) + sizeof(RDBColumn) * numcols);
+    if (! batch) {
+        RDBMemFree(maprows);
+        return RDBAPI_ERR_NOMEM;
+    }
+
+    batch->numrows = numrows;
+    batch->numcols = numcols;
+
+    for (colindex = 0; result == RDBAPI_SUCCESS && colindex < numcols; colindex++) {
+        RDBColumn col = (RDBColumn) RDBMemAlloc(sizeof(RDBColumn_t));
+
+        batch->columns[colindex] = col;
+
+        if (! col) {
+            result = RDBAPI_ERR_NOMEM;
+            break;
+        }
+
+        col->valtype = (valtypes? valtypes[colindex] : ColumnBatchInferType(rows, numrows, colindex));
+        col->format = ColumnBatchFormat(col->valtype);
+        col->name = RDBZStringNew(RDBCZSTR(RDBResultMapColHeadName(resultmap, colindex)), RDBZStringLen(RDBResultMapColHeadName(resultmap, colindex)));
+
+        result = ColumnBatchBuild(col, rows, numrows, colindex);
+    }
+
+    RDBMemFree(maprows);
+
+    if (result != RDBAPI_SUCCESS) {
+        RDBColumnBatchFree(batch);
+        return result;
+    }
+
+    *outbatch = batch;
+    return RDBAPI_SUCCESS;
+}
+
+
+void RDBColumnBatchFree (RDBColumnBatch batch)
+{
+    if (batch) {
+        while (batch->numcols-- > 0) {
+            ColumnFree(batch->columns[batch->numcols]);
+        }
+
+        RDBMemFree(batch);
+    }
+}
+
+
+ub8 RDBColumnBatchRows (RDBColumnBatch batch)
+{
+    return batch->numrows;
+}
+
+
+int RDBColumnBatchCols (RDBColumnBatch batch)
+{
+    return batch->numcols;
+}
+
+
+// release of schema: private_data is name of child or children of root
+static void ColumnBatchReleaseSchema (struct ArrowSchema *schema)
+{
+    int64_t i;
+
+    for (i = 0; i < schema->n_children; i++) {
+        struct ArrowSchema *child = schema->children[i];
+
+        if (child->release) {
+            child->release(child);
+        }
+    }
+
+    RDBMemFree(schema->private_data);
+    schema->release = NULL;
+}
+
+
+// release of child array: private_data is column which owns buffers
+static void ColumnBatchReleaseColumn (struct ArrowArray *array)
+{
+    ColumnFree((RDBColumn) array->private_data);
+    array->release = NULL;
+}
+
+
+// release of struct array: private_data holds buffers and children
+static void ColumnBatchReleaseStruct (struct ArrowArray *array)
+{
+    int64_t i;
+
+    for (i = 0; i < array->n_children; i++) {
+        struct ArrowArray *child = array->children[i];
+
+        if (child->release) {
+            child->release(child);
+        }
+    }
+
+    RDBMemFree(array->private_data);
+    array->release = NULL;
+}
+
+
+RDBAPI_RESULT RDBColumnBatchExportArrow (RDBColumnBatch batch, struct ArrowSchema *outschema, struct ArrowArray *outarray)
+{
+    int colindex;
+
+    int numcols = batch->numcols;
+
+    // root array: buffers[1] + children pointers + children
+    void **arrayblock = (void **) RDBMemAlloc(sizeof(void *) * (numcols + 1) + sizeof(struct ArrowArray) * numcols);
+
+    // root schema: children pointers + children
+    void **schemablock = (void **) RDBMemAlloc(sizeof(void *) * numcols + sizeof(struct ArrowSchema) * numcols + 1);
+
+    struct ArrowArray **arrays;
+    struct ArrowSchema **schemas;
+
+    bzero(outschema, sizeof(*outschema));
+    bzero(outarray, sizeof(*outarray));
+
+    if (! arrayblock || ! schemablock) {
+        RDBMemFree(arrayblock);
+        RDBMemFree(schemablock);
+        return RDBAPI_ERR_NOMEM;
+    }
+
+    arrays = (struct ArrowArray **) &arrayblock[1];
+    schemas = (struct ArrowSchema **) schemablock;
+
+    for (colindex = 0; colindex < numcols; colindex++) {
+        RDBColumn col = batch->columns[colindex];
+
+        struct ArrowArray *child = &((struct ArrowArray *) &arrays[numcols])[colindex];
+        struct ArrowSchema *field = &((struct ArrowSchema *) &schemas[numcols])[colindex];
+
+        char *name = (char *) RDBMemAlloc(RDBZStringLen(col->name) + 1);
+        if (name) {
+            memcpy(name, RDBCZSTR(col->name), RDBZStringLen(col->name));
+        }
+
+        field->format = col->format;
+        field->name = name;
+        field->flags = ARROW_FLAG_NULLABLE;
+        field->release = ColumnBatchReleaseSchema;
+        field->private_data = name;
+
+        child->length = (int64_t) batch->numrows;
+        child->null_count = (int64_t) col->nullcount;
+        child->n_buffers = col->numbuffers;
+        child->buffers = col->buffers;
+        child->release = ColumnBatchReleaseColumn;
+        child->private_data = col;
+
+        arrays[colindex] = child;
+        schemas[colindex] = field;
+    }
+
+    outschema->format = "+s";
+    outschema->name = "";
+    outschema->n_children = numcols;
+    outschema->children = schemas;
+    outschema->release = ColumnBatchReleaseSchema;
+    outschema->private_data = schemablock;
+
+    outarray->length = (int64_t) batch->numrows;
+    outarray->n_buffers = 1;
+    outarray->buffers = (const void **) arrayblock;
+    outarray->n_children = numcols;
+    outarray->children = arrays;
+    outarray->release = ColumnBatchReleaseStruct;
+    outarray->private_data = arrayblock;
+
+    // columns are owned by children arrays now
+    RDBMemFree(batch);
+
+    return RDBAPI_SUCCESS;
+}
+
+
 /**************************************
  *
  * RDBRow
@@ -375,6 +916,27 @@ void RDBResultMapPrint (RDBCtx ctx, RDBResultMap resultmap, FILE *fout)
  **************************************/
 
 RDBAPI_RESULT RDBRowNew (RDBResultMap resultmap, const char *key, int keylen, RDBRow *outrow)
+{
+    return RDBRowNewInArena(resultmap, resultmap->arena, key, keylen, outrow);
+}
+
+
+static RDBRow RDBRowAlloc (mem_arena_t *arena, size_t sizeb)
+{
+    RDBRow row;
+
+    if (arena) {
+        row = (RDBRow) mem_arena_alloc(arena, sizeb);
+        row->inarena = 1;
+    } else {
+        row = (RDBRow) RDBMemAlloc(sizeb);
+    }
+
+    return row;
+}
+
+
+RDBAPI_RESULT RDBRowNewInArena (RDBResultMap resultmap, mem_arena_t *arena, const char *key, int keylen, RDBRow *outrow)
 {
     if (! key) {
         char kbuf[22];
@@ -383,12 +945,13 @@ RDBAPI_RESULT RDBRowNew (RDBResultMap resultmap, const char *key, int keylen, RD
 
         int klen = snprintf_chkd_V1(kbuf, sizeof(kbuf), "%"PRIu64, (ub8)(rowid + 1));
 
-        RDBRow row = (RDBRow) RDBMemAlloc(sizeof(RDBRow_t) + sizeof(RDBCell_t) * RDBResultMapColHeads(resultmap) + klen + 1);
+        RDBRow row = RDBRowAlloc(arena, sizeof(RDBRow_t) + sizeof(RDBCell_t) * RDBResultMapColHeads(resultmap) + klen + 1);
         if (row) {
             row->count = RDBResultMapColHeads(resultmap);
 
             row->key = (char *) &row->cells[row->count];
             row->keylen = klen;
+            row->keycap = klen;
     
             memcpy(row->key, kbuf, klen);
 
@@ -403,12 +966,32 @@ RDBAPI_RESULT RDBRowNew (RDBResultMap resultmap, const char *key, int keylen, RD
         }
 
         if (keylen > 0 && keylen < RDB_KEY_VALUE_SIZE) {
-            RDBRow row = (RDBRow) RDBMemAlloc(sizeof(RDBRow_t) + sizeof(RDBCell_t) * RDBResultMapColHeads(resultmap) + keylen + 1);
+            RDBRow row = resultmap->sparerows;
+
+            if (row && row->keycap >= keylen) {
+                // reuse spare row with cells cleaned
+                resultmap->sparerows = row->nextspare;
+                resultmap->numspares--;
+
+                row->nextspare = NULL;
+                row->key = (char *) &row->cells[row->count];
+                row->keylen = keylen;
+
+                memcpy(row->key, key, keylen);
+                row->key[keylen] = 0;
+
+                *outrow = row;
+                return RDBAPI_SUCCESS;
+            }
+
+            // round up key buffer of rows to be recycled
+            row = RDBRowAlloc(arena, sizeof(RDBRow_t) + sizeof(RDBCell_t) * RDBResultMapColHeads(resultmap) + (resultmap->maxspares? (keylen | 63) : keylen) + 1);
             if (row) {
                 row->count = RDBResultMapColHeads(resultmap);
 
                 row->key = (char *) &row->cells[row->count];
                 row->keylen = keylen;
+                row->keycap = (resultmap->maxspares? (keylen | 63) : keylen);
     
                 memcpy(row->key, key, keylen);
 
@@ -424,13 +1007,52 @@ RDBAPI_RESULT RDBRowNew (RDBResultMap resultmap, const char *key, int keylen, RD
 }
 
 
+RDBAPI_RESULT RDBRowNewOnReply (RDBResultMap resultmap, mem_arena_t *arena, redisReply *keyreply, const char *key, int keylen, RDBRow *outrow)
+{
+    RDBRow row;
+
+    if (keylen <= 0 || keylen >= RDB_KEY_VALUE_SIZE) {
+        return RDBAPI_ERR_BADARG;
+    }
+
+    row = resultmap->sparerows;
+
+    if (row) {
+        // reuse spare row with cells cleaned. key buffer not used
+        resultmap->sparerows = row->nextspare;
+        resultmap->numspares--;
+
+        row->nextspare = NULL;
+    } else {
+        row = RDBRowAlloc(arena, sizeof(RDBRow_t) + sizeof(RDBCell_t) * RDBResultMapColHeads(resultmap));
+        if (! row) {
+            return RDBAPI_ERR_NOMEM;
+        }
+
+        row->count = RDBResultMapColHeads(resultmap);
+    }
+
+    row->keyreply = keyreply;
+    row->key = (char *) key;
+    row->keylen = keylen;
+
+    *outrow = row;
+    return RDBAPI_SUCCESS;
+}
+
+
 void RDBRowFree (RDBRow row)
 {
     while (row->count-- > 0) {
         RDBCellClean(RDBRowCell(row, row->count));
     }
 
-    RDBMemFree(row);
+    RedisFreeReplyObject(&row->keyreply);
+
+    // row in arena is freed with arena
+    if (! row->inarena) {
+        RDBMemFree(row);
+    }
 }
 
 
@@ -492,6 +1114,11 @@ RDBCell RDBCellSetValue (RDBCell cell, RDBCellType type, void *value)
         cell->resultmap = (RDBResultMap) value;
         break;
 
+    case RDB_CELLTYPE_SLICE:
+        cell->slice.ptr = (const char *) value;
+        cell->slice.len = (value? cstr_length(cell->slice.ptr, RDB_KEY_VALUE_SIZE) : 0);
+        break;
+
     default:
         cell->type = RDB_CELLTYPE_INVALID;
         return cell;
@@ -530,6 +1157,10 @@ RDBCellType RDBCellGetValue (RDBCell cell, void **outvalue)
             *outvalue = (void*)cell->resultmap;
             break;
 
+        case RDB_CELLTYPE_SLICE:
+            *outvalue = (void*)cell->slice.ptr;
+            break;
+
         default:
             *outvalue = NULL;
             break;
@@ -545,6 +1176,14 @@ RDBCell RDBCellSetString (RDBCell cell, const char *str, int len)
 }
 
 
+RDBCell RDBCellSetSlice (RDBCell cell, const char *ptr, int len)
+{
+    RDBCellSetValue(cell, RDB_CELLTYPE_SLICE, (void*) ptr);
+    cell->slice.len = len;
+    return cell;
+}
+
+
 RDBCell RDBCellSetInteger (RDBCell cell, sb8 value)
 {
     return RDBCellSetValue(cell, RDB_CELLTYPE_INTEGER, (void*) &value);
@@ -611,6 +1250,33 @@ RDBResultMap RDBCellGetResult (RDBCell cell)
 }
 
 
+const char * RDBCellGetSlice (RDBCell cell, int *len)
+{
+    switch (cell->type) {
+    case RDB_CELLTYPE_SLICE:
+        *len = cell->slice.len;
+        return cell->slice.ptr;
+
+    case RDB_CELLTYPE_ZSTRING:
+        *len = RDBZSTRLEN(cell->zstr);
+        return RDBCZSTR(cell->zstr);
+
+    case RDB_CELLTYPE_REPLY:
+        if (cell->reply && cell->reply->str) {
+            *len = (int) cell->reply->len;
+            return cell->reply->str;
+        }
+        break;
+
+    default:
+        break;
+    }
+
+    *len = 0;
+    return NULL;
+}
+
+
 void RDBCellClean (RDBCell cell)
 {
     switch (cell->type) {
@@ -649,6 +1315,10 @@ extern void RDBCellPrint (RDBCell cell, FILE *fout, int colwidth)
             fprintf(fout, format, RDBZSTRLEN(cell->zstr), RDBCZSTR(cell->zstr));
             break;
 
+        case RDB_CELLTYPE_SLICE:
+            fprintf(fout, format, cell->slice.len, cell->slice.ptr);
+            break;
+
         case RDB_CELLTYPE_REPLY:
             fprintf(fout, format, (int) cell->reply->len, cell->reply->str);
             break;
@@ -685,6 +1355,10 @@ extern void RDBCellPrint (RDBCell cell, FILE *fout, int colwidth)
             fprintf(fout, " %.*s ", RDBZSTRLEN(cell->zstr), RDBCZSTR(cell->zstr));
             break;
 
+        case RDB_CELLTYPE_SLICE:
+            fprintf(fout, " %.*s ", cell->slice.len, cell->slice.ptr);
+            break;
+
         case RDB_CELLTYPE_REPLY:
             fprintf(fout, " %.*s ", (int) cell->reply->len, cell->reply->str);
             break;
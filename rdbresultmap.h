@@ -64,6 +64,12 @@ typedef struct _RDBCell_t
 
         // RDB_COLTYPE_RESULTMAP
         RDBResultMap resultmap; /* nested result map */
+
+        // RDB_CELLTYPE_SLICE
+        struct {
+            const char *ptr;
+            int len;
+        } slice;
     };
 } RDBCell_t;
 
@@ -73,12 +79,24 @@ typedef struct _RDBRow_t
     char *key;
     int keylen;
 
+    /* reply retained by row where key (and slice cells) refer to */
+    redisReply *keyreply;
+
     /* makes this structure hashable */
     UT_hash_handle hh;
 
     /* count of cells */
     int count;
 
+    /* capacity of key buffer */
+    int keycap;
+
+    /* 1: row carved from arena of result map */
+    int inarena;
+
+    /* next row in spare rows of result map */
+    struct _RDBRow_t *nextspare;
+
     /* cell values of row */
     RDBCell_t cells[0];
 } RDBRow_t, *RDBRowNode, *RDBRowsHashMap;
@@ -92,6 +110,33 @@ typedef struct _RDBRowIter_t
 } RDBRowIter_t;
 
 
+/* column of RDBColumnBatch in Arrow layout */
+typedef struct _RDBColumn_t
+{
+    RDBValueType valtype;
+
+    /* Arrow format: "l" int64, "L" uint64, "g" double, "u" or "U" (large) utf8 */
+    const char *format;
+
+    RDBZString name;
+
+    ub8 nullcount;
+
+    /* buffers of Arrow array: validity bitmap, values (or offsets), utf8 data */
+    int numbuffers;
+    const void *buffers[3];
+} RDBColumn_t, *RDBColumn;
+
+
+typedef struct _RDBColumnBatch_t
+{
+    ub8 numrows;
+
+    int numcols;
+    RDBColumn columns[0];
+} RDBColumnBatch_t;
+
+
 /* ResultMap */
 typedef struct _RDBResultMap_t
 {
@@ -99,6 +144,9 @@ typedef struct _RDBResultMap_t
 
     RDBTableFilter filter;
 
+    /* arena of filter where rows are carved. NULL if rows are malloc'ed */
+    mem_arena_t *arena;
+
     /* user-specified title for this result */
     RDBZString title;
 
@@ -111,6 +159,11 @@ typedef struct _RDBResultMap_t
     /* number of rowid columns */
     int numrowidcols;
 
+    /* rows recycled by RDBResultMapRecycleAll for reuse in RDBRowNew */
+    RDBRowNode sparerows;
+    ub4 numspares;
+    ub4 maxspares;
+
     /* number of columns and names for column headers */
     int colheads;
     RDBZString colheadnames[0];
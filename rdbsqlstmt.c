@@ -32,31 +32,7 @@
  * @update:
  */
 #include "rdbsqlstmt.h"
-
-
-static ub8 RDBTableGetTimestamp (RDBCtx ctx, const char *tablespace, const char *tablename)
-{
-    ub8 u8val = (ub8)(-1);
-
-    redisReply *reply = NULL;
-
-    char table_rowkey[256] = {0};
-
-    const char *fldnames[] = {"timestamp", 0};
-
-    snprintf_chkd_V1(table_rowkey, sizeof(table_rowkey), "{%s::%s:%s}", RDB_SYSTEM_TABLE_PREFIX, tablespace, tablename);
-
-    // HMGET {redisdb::$tablespace:$tablename} timestamp
-    if (RedisHMGet(ctx, table_rowkey, fldnames, &reply) == RDBAPI_SUCCESS) {
-        cstr_to_ub8(10, reply->element[0]->str, reply->element[0]->len, &u8val);
-    }
-
-    if (reply) {
-        freeReplyObject(reply);
-    }
-
-    return u8val;
-}
+#include "rdbtablefilter.h"
 
 
 // create stmt object and trim sql unnecessary whilespaces
@@ -953,6 +929,25 @@ static char * parse_upsert_value (char *sqlblockaddr, char *sql, char **value, i
 }
 
 
+// find ')' closing the VALUES tuple, ignore chars in quotes
+//
+static char * find_tuple_end (char *sql)
+{
+    int quot = 0;
+
+    while (*sql) {
+        if (*sql == 39) {
+            quot = !quot;
+        } else if (*sql == 41 && ! quot) {
+            return sql;
+        }
+        sql++;
+    }
+
+    return NULL;
+}
+
+
 // UPDATE a=b, c=c+1, e='hello= , world';
 //
 static char * parse_upsert_col (char *sqlblockaddr, char *sql, char **colname, int *colnamelen, char **colvalue, int *colvaluelen)
@@ -1211,6 +1206,7 @@ void SQLStmtParseUpsert (RDBCtx ctx, RDBSQLStmt sqlstmt)
     int i, np, len;
 
     char *startp, *endp;
+    char *tupend = NULL;
 
     int numfields = 0;
     int numvalues = 0;
@@ -1346,6 +1342,13 @@ void SQLStmtParseUpsert (RDBCtx ctx, RDBSQLStmt sqlstmt)
         *endp++ = 0;
 
         sqlc = cstr_Ltrim_whitespace(sqlc + 1);
+
+        // VALUES (a,b), (c,d), ...
+        tupend = find_tuple_end(sqlc);
+        if (tupend) {
+            *tupend++ = 0;
+        }
+
         len = cstr_Rtrim_whitespace(sqlc, cstr_length(sqlc, -1));
 
         // ( a,b,'hello,shanghai' )
@@ -1368,6 +1371,70 @@ void SQLStmtParseUpsert (RDBCtx ctx, RDBSQLStmt sqlstmt)
             return;
         }
 
+        sqlstmt->upsert.numrows = 1;
+
+        if (tupend) {
+            // max rows could be
+            int maxrows = 1;
+            for (startp = tupend; *startp; startp++) {
+                if (*startp == 40) {
+                    maxrows++;
+                }
+            }
+
+            sqlstmt->upsert.rowvalues = (char **) RDBMemAlloc(sizeof(char *) * maxrows * numfields);
+            sqlstmt->upsert.rowvalueslen = (int *) RDBMemAlloc(sizeof(int) * maxrows * numfields);
+        }
+
+        while (tupend) {
+            char **rowvalues;
+            int *rowvalueslen;
+
+            sqlc = cstr_Ltrim_whitespace(tupend);
+            if (*sqlc != 44 || *(sqlc = cstr_Ltrim_whitespace(sqlc + 1)) != 40) {
+                snprintf_chkd_V1(ctx->errmsg, sizeof(ctx->errmsg), "SQLStmtError: bad VALUES tuple. errat(%d): '%s'", (int)(sqlc - sqlstmt->sqlblock), sqlc);
+                return;
+            }
+
+            sqlc = cstr_Ltrim_whitespace(sqlc + 1);
+
+            tupend = find_tuple_end(sqlc);
+            if (tupend) {
+                *tupend++ = 0;
+            }
+
+            cstr_Rtrim_whitespace(sqlc, cstr_length(sqlc, -1));
+
+            rowvalues = &sqlstmt->upsert.rowvalues[(sqlstmt->upsert.numrows - 1) * numfields];
+            rowvalueslen = &sqlstmt->upsert.rowvalueslen[(sqlstmt->upsert.numrows - 1) * numfields];
+
+            numvalues = 0;
+
+            while (sqlc && numvalues < numfields + 1) {
+                char *value = NULL;
+                int valuelen = 0;
+                sqlc = parse_upsert_value(sqlstmt->sqlblock, sqlc, &value, &valuelen);
+                if (value) {
+                    if (numvalues == numfields) {
+                        free(value);
+                        numvalues++;
+                        break;
+                    }
+                    rowvalues[numvalues] = value;
+                    rowvalueslen[numvalues] = valuelen;
+                    numvalues++;
+                }
+            }
+
+            // row counted for being freed
+            sqlstmt->upsert.numrows++;
+
+            if (numvalues != numfields) {
+                snprintf_chkd_V1(ctx->errmsg, sizeof(ctx->errmsg), "SQLStmtError: values not match fields in row(%d)", sqlstmt->upsert.numrows);
+                return;
+            }
+        }
+
         sqlstmt->upsert.upsertmode = RDBSQL_UPSERT_MODE_INSERT;
 
         sqlc = endp;
@@ -1390,6 +1457,11 @@ void SQLStmtParseUpsert (RDBCtx ctx, RDBSQLStmt sqlstmt)
             }
         }
 
+        if (sqlstmt->upsert.numrows > 1 && sqlstmt->upsert.upsertmode == RDBSQL_UPSERT_MODE_UPDATE) {
+            snprintf_chkd_V1(ctx->errmsg, sizeof(ctx->errmsg), "SQLStmtError: multi-row VALUES not supported for ON DUPLICATE KEY UPDATE");
+            return;
+        }
+
         if (sqlstmt->upsert.upsertmode == RDBSQL_UPSERT_MODE_UPDATE) {
             // UPDATE a=b, c=c+1, e='hello= , world';
             while (sqlc && sqlstmt->upsert.updcols < RDBAPI_ARGV_MAXNUM + 1) {
@@ -1680,6 +1752,55 @@ void SQLStmtParseDrop (RDBCtx ctx, RDBSQLStmt sqlstmt)
     sqlstmt->stmt = RDBSQL_DROP_TABLE;
 }
 
+
+// CREATE INDEX $database.$table($field)
+//
+void SQLStmtParseCreateIndex (RDBCtx ctx, RDBSQLStmt sqlstmt)
+{
+    char table[RDB_KEY_NAME_MAXLEN * 2 + 4] = {0};
+
+    char *fldc, *endc;
+    int len;
+
+    char *sqlc = cstr_Ltrim_whitespace(strstr(sqlstmt->sqloffset + 6, "INDEX") + 6);
+
+    fldc = strchr(sqlc, '(');
+    endc = (fldc? strchr(fldc, ')') : NULL);
+    if (! endc) {
+        RDBSQLStmtError(RDBSQL_ERR_INVAL_SQL, sqlc);
+        return;
+    }
+
+    len = cstr_Rtrim_whitespace(sqlc, (int)(fldc - sqlc));
+    if (len <= 0 || len >= (int) sizeof(table)) {
+        RDBSQLStmtError(RDBSQL_ERR_INVAL_TABLE, sqlc);
+        return;
+    }
+    snprintf_chkd_V1(table, sizeof(table), "%.*s", len, sqlc);
+
+    if (parse_table(table, sqlstmt->createindex.tablespace, sqlstmt->createindex.tablename) != 1) {
+        RDBSQLStmtError(RDBSQL_ERR_INVAL_TABLE, sqlc);
+        return;
+    }
+
+    fldc = cstr_Ltrim_whitespace(fldc + 1);
+    len = cstr_Rtrim_whitespace(fldc, (int)(endc - fldc));
+
+    if (! RDBSQLNameValidate(fldc, len, RDB_KEY_NAME_MAXLEN)) {
+        RDBSQLStmtError(RDBSQL_ERR_ILLEGAL_CHAR, fldc);
+        return;
+    }
+    snprintf_chkd_V1(sqlstmt->createindex.fieldname, sizeof(sqlstmt->createindex.fieldname), "%.*s", len, fldc);
+
+    sqlc = cstr_Ltrim_whitespace(endc + 1);
+    if (*sqlc && *sqlc != ';') {
+        RDBSQLStmtError(RDBSQL_ERR_ILLEGAL_CHAR, sqlc);
+        return;
+    }
+
+    sqlstmt->stmt = RDBSQL_CREATE_INDEX;
+}
+
 // COMMAND
 //
 void SQLStmtParseCommand (RDBCtx ctx, RDBSQLStmt sqlstmt, int envcmd)
@@ -1696,6 +1817,30 @@ void SQLStmtParseCommand (RDBCtx ctx, RDBSQLStmt sqlstmt, int envcmd)
         return;
     }
 
+    if (envcmd == RDBENV_COMMAND_PARALLEL_ON) {
+        ctx->env->parallel = 1;
+        sqlstmt->stmt = envcmd;
+        return;
+    }
+
+    if (envcmd == RDBENV_COMMAND_PARALLEL_OFF) {
+        ctx->env->parallel = 0;
+        sqlstmt->stmt = envcmd;
+        return;
+    }
+
+    if (envcmd == RDBENV_COMMAND_PUSHDOWN_ON) {
+        ctx->env->pushdown = 1;
+        sqlstmt->stmt = envcmd;
+        return;
+    }
+
+    if (envcmd == RDBENV_COMMAND_PUSHDOWN_OFF) {
+        ctx->env->pushdown = 0;
+        sqlstmt->stmt = envcmd;
+        return;
+    }
+
     if (envcmd == RDBENV_COMMAND_DELIMITER) {
         char *p1 = strchr(sqlstmt->sqloffset, 39);
         char *p2 = strrchr(sqlstmt->sqloffset, 39);
@@ -1726,6 +1871,63 @@ void SQLStmtParseCommand (RDBCtx ctx, RDBSQLStmt sqlstmt, int envcmd)
  * 
  **********************************************************************/
 
+// '?' or ':name'
+//
+static void SQLStmtAddParam (RDBSQLStmt sqlstmt, char **pvalue, int *pvaluelen, int quotable)
+{
+    RDBSQLParam_t *param;
+
+    const char *val = *pvalue;
+    int len = *pvaluelen;
+
+    if (! val || sqlstmt->numparams > RDBAPI_ARGV_MAXNUM) {
+        return;
+    }
+
+    if (len == 1 && val[0] == '?') {
+        param = &sqlstmt->params[sqlstmt->numparams++];
+        *param->name = 0;
+    } else if (len > 1 && len <= RDB_KEY_NAME_MAXLEN + 1 && val[0] == ':' && RDBSQLNameValidateMaxLen(&val[1], RDB_KEY_NAME_MAXLEN) == len - 1) {
+        param = &sqlstmt->params[sqlstmt->numparams++];
+        memcpy(param->name, &val[1], len - 1);
+        param->name[len - 1] = 0;
+    } else {
+        return;
+    }
+
+    param->quotable = quotable;
+    param->bound = 0;
+    param->pvalue = pvalue;
+    param->pvaluelen = pvaluelen;
+}
+
+
+static void SQLStmtParseParams (RDBSQLStmt sqlstmt)
+{
+    int i;
+
+    sqlstmt->numparams = 0;
+
+    if (sqlstmt->stmt == RDBSQL_SELECT || sqlstmt->stmt == RDBSQL_DELETE) {
+        for (i = 0; i < sqlstmt->select.numwhere; i++) {
+            SQLStmtAddParam(sqlstmt, &sqlstmt->select.fieldvals[i], &sqlstmt->select.fieldvalslen[i], 0);
+        }
+    } else if (sqlstmt->stmt == RDBSQL_UPSERT) {
+        for (i = 0; i < sqlstmt->upsert.numfields; i++) {
+            SQLStmtAddParam(sqlstmt, &sqlstmt->upsert.fieldvalues[i], &sqlstmt->upsert.fieldvalueslen[i], 1);
+        }
+
+        for (i = 0; i < (sqlstmt->upsert.numrows - 1) * sqlstmt->upsert.numfields; i++) {
+            SQLStmtAddParam(sqlstmt, &sqlstmt->upsert.rowvalues[i], &sqlstmt->upsert.rowvalueslen[i], 1);
+        }
+
+        for (i = 0; i < sqlstmt->upsert.updcols; i++) {
+            SQLStmtAddParam(sqlstmt, &sqlstmt->upsert.updcolvalues[i], &sqlstmt->upsert.updcolvalueslen[i], 1);
+        }
+    }
+}
+
+
 RDBAPI_RESULT RDBSQLStmtCreate (RDBCtx ctx, const char *sql_block, size_t sql_len, RDBSQLStmt *outsqlstmt)
 {
     RDBSQLStmt sqlstmt;
@@ -1795,6 +1997,11 @@ RDBAPI_RESULT RDBSQLStmtCreate (RDBCtx ctx, const char *sql_block, size_t sql_le
         goto parse_finished;
     }
 
+    if (re_match(RDBSQL_PATTERN_CREATE_INDEX, sqlstmt->sqloffset) == 0) {
+        SQLStmtParseCreateIndex(ctx, sqlstmt);
+        goto parse_finished;
+    }
+
     if (re_match(RDBSQL_PATTERN_CREATE_TABLE, sqlstmt->sqloffset) == 0) {
         SQLStmtParseCreate(ctx, sqlstmt);
         goto parse_finished;
@@ -1810,6 +2017,26 @@ RDBAPI_RESULT RDBSQLStmtCreate (RDBCtx ctx, const char *sql_block, size_t sql_le
         goto parse_finished;
     }
 
+    if (re_match(RDBSQL_COMMAND_PARALLEL_ON, sqlstmt->sqloffset) == 0) {
+        SQLStmtParseCommand(ctx, sqlstmt, RDBENV_COMMAND_PARALLEL_ON);
+        goto parse_finished;
+    }
+
+    if (re_match(RDBSQL_COMMAND_PARALLEL_OFF, sqlstmt->sqloffset) == 0) {
+        SQLStmtParseCommand(ctx, sqlstmt, RDBENV_COMMAND_PARALLEL_OFF);
+        goto parse_finished;
+    }
+
+    if (re_match(RDBSQL_COMMAND_PUSHDOWN_ON, sqlstmt->sqloffset) == 0) {
+        SQLStmtParseCommand(ctx, sqlstmt, RDBENV_COMMAND_PUSHDOWN_ON);
+        goto parse_finished;
+    }
+
+    if (re_match(RDBSQL_COMMAND_PUSHDOWN_OFF, sqlstmt->sqloffset) == 0) {
+        SQLStmtParseCommand(ctx, sqlstmt, RDBENV_COMMAND_PUSHDOWN_OFF);
+        goto parse_finished;
+    }
+
     if (re_match(RDBSQL_COMMAND_DELIMITER, sqlstmt->sqloffset) == 0) {
         SQLStmtParseCommand(ctx, sqlstmt, RDBENV_COMMAND_DELIMITER);
         goto parse_finished;
@@ -1823,6 +2050,8 @@ parse_finished:
         return RDBAPI_ERR_RDBSQL;
     }
 
+    SQLStmtParseParams(sqlstmt);
+
     // all is ok
     *ctx->errmsg = 0;
     *outsqlstmt = sqlstmt;
@@ -1846,6 +2075,27 @@ void RDBSQLStmtFree (RDBSQLStmt sqlstmt)
         cstr_varray_free(sqlstmt->upsert.updcolnames, RDBAPI_ARGV_MAXNUM);
         cstr_varray_free(sqlstmt->upsert.updcolvalues, RDBAPI_ARGV_MAXNUM);
 
+        if (sqlstmt->upsert.rowvalues) {
+            int i, num = (sqlstmt->upsert.numrows - 1) * sqlstmt->upsert.numfields;
+
+            for (i = 0; i < num; i++) {
+                free(sqlstmt->upsert.rowvalues[i]);
+            }
+
+            RDBMemFree(sqlstmt->upsert.rowvalues);
+            RDBMemFree(sqlstmt->upsert.rowvalueslen);
+        }
+
+        if (sqlstmt->upsert.literals) {
+            int i, num = sqlstmt->upsert.numrows * sqlstmt->upsert.numfields;
+
+            for (i = 0; i < num; i++) {
+                free(sqlstmt->upsert.literals[i]);
+            }
+
+            RDBMemFree(sqlstmt->upsert.literals);
+        }
+
         RDBSQLStmtFree(sqlstmt->upsert.selectstmt);
 
         zstringbufFree(&sqlstmt->upsert.prepare.keypattern);
@@ -1857,6 +2107,125 @@ void RDBSQLStmtFree (RDBSQLStmt sqlstmt)
 }
 
 
+int RDBSQLStmtParamCount (RDBSQLStmt sqlstmt)
+{
+    return sqlstmt->numparams;
+}
+
+
+int RDBSQLStmtParamIndex (RDBSQLStmt sqlstmt, const char *name)
+{
+    int i;
+
+    if (name && *name == ':') {
+        name++;
+    }
+
+    for (i = 0; name && i < sqlstmt->numparams; i++) {
+        if (! strcmp(sqlstmt->params[i].name, name)) {
+            return i + 1;
+        }
+    }
+
+    return 0;
+}
+
+
+static RDBAPI_RESULT SQLStmtBindValue (RDBSQLStmt sqlstmt, int paramindex, const char *str, int len, int quot)
+{
+    char *value;
+    RDBSQLParam_t *param;
+
+    RDBCtx ctx = sqlstmt->ctx;
+
+    if (paramindex < 1 || paramindex > sqlstmt->numparams) {
+        snprintf_chkd_V1(ctx->errmsg, sizeof(ctx->errmsg), "RDBAPI_ERR_BADARG: invalid parameter index(%d)", paramindex);
+        return RDBAPI_ERR_BADARG;
+    }
+
+    param = &sqlstmt->params[paramindex - 1];
+
+    if (len < 0) {
+        len = cstr_length(str, RDB_SQLSTMT_SQLBLOCK_MAXLEN + 1);
+    }
+
+    // WHERE value is never quoted
+    if (! param->quotable) {
+        quot = 0;
+
+        if (len >= RDB_KEY_VALUE_SIZE) {
+            snprintf_chkd_V1(ctx->errmsg, sizeof(ctx->errmsg), "RDBAPI_ERR_BADARG: too long value for parameter(%d)", paramindex);
+            return RDBAPI_ERR_BADARG;
+        }
+    }
+
+    if (len > RDB_SQLSTMT_SQLBLOCK_MAXLEN) {
+        snprintf_chkd_V1(ctx->errmsg, sizeof(ctx->errmsg), "RDBAPI_ERR_BADARG: too long value for parameter(%d)", paramindex);
+        return RDBAPI_ERR_BADARG;
+    }
+
+    value = RDBMemAlloc(len + 1 + quot + quot);
+    if (! value) {
+        snprintf_chkd_V1(ctx->errmsg, sizeof(ctx->errmsg), "RDBAPI_ERR_NOMEM: out of memory");
+        return RDBAPI_ERR_NOMEM;
+    }
+
+    // the same as value parsed from sql
+    if (quot) {
+        *param->pvaluelen = snprintf_chkd_V1(value, len + 1 + quot + quot, "'%.*s'", len, str);
+    } else {
+        *param->pvaluelen = snprintf_chkd_V1(value, len + 1 + quot + quot, "%.*s", len, str);
+    }
+
+    free(*param->pvalue);
+    *param->pvalue = value;
+
+    param->bound = 1;
+
+    return RDBAPI_SUCCESS;
+}
+
+
+RDBAPI_RESULT RDBSQLStmtBindString (RDBSQLStmt sqlstmt, int paramindex, const char *str, int len)
+{
+    return SQLStmtBindValue(sqlstmt, paramindex, str, len, 1);
+}
+
+
+RDBAPI_RESULT RDBSQLStmtBindSb8 (RDBSQLStmt sqlstmt, int paramindex, sb8 val)
+{
+    char numbuf[24];
+    int len = snprintf_chkd_V1(numbuf, sizeof(numbuf), "%"PRId64, val);
+    return SQLStmtBindValue(sqlstmt, paramindex, numbuf, len, 0);
+}
+
+
+RDBAPI_RESULT RDBSQLStmtBindUb8 (RDBSQLStmt sqlstmt, int paramindex, ub8 val)
+{
+    char numbuf[24];
+    int len = snprintf_chkd_V1(numbuf, sizeof(numbuf), "%"PRIu64, val);
+    return SQLStmtBindValue(sqlstmt, paramindex, numbuf, len, 0);
+}
+
+
+RDBAPI_RESULT RDBSQLStmtBindDouble (RDBSQLStmt sqlstmt, int paramindex, double val)
+{
+    char numbuf[40];
+    int len = snprintf_chkd_V1(numbuf, sizeof(numbuf), "%.17g", val);
+    return SQLStmtBindValue(sqlstmt, paramindex, numbuf, len, 0);
+}
+
+
+void RDBSQLStmtClearBindings (RDBSQLStmt sqlstmt)
+{
+    int i;
+
+    for (i = 0; i < sqlstmt->numparams; i++) {
+        sqlstmt->params[i].bound = 0;
+    }
+}
+
+
 RDBSQLStmtType RDBSQLStmtGetSql (RDBSQLStmt sqlstmt, int indent, RDBZString *outsql)
 {
     int j;
@@ -2045,6 +2414,11 @@ RDBSQLStmtType RDBSQLStmtGetSql (RDBSQLStmt sqlstmt, int indent, RDBZString *out
         sqlbuf = zstringbufCat(sqlbuf, "%sDESC %s.%s\n", indents, sqlstmt->desctable.tablespace, sqlstmt->desctable.tablename);
         stmt = sqlstmt->stmt;
         break;
+
+    case RDBSQL_CREATE_INDEX:
+        sqlbuf = zstringbufCat(sqlbuf, "%sCREATE INDEX %s.%s (%s)\n", indents, sqlstmt->createindex.tablespace, sqlstmt->createindex.tablename, sqlstmt->createindex.fieldname);
+        stmt = sqlstmt->stmt;
+        break;
     }
 
     if (sqlbuf) {
@@ -2071,194 +2445,342 @@ static int assign_fieldvalue (const char *valstr, int len, const char **ppvalout
 }
 
 
-RDBAPI_RESULT RDBSQLStmtPrepare (RDBSQLStmt sqlstmt)
+// NOWDATE(), TODATE(...), NOWTIME(), TOTIME(...), NOWSTAMP(), TOSTAMP(...)
+//
+static RDBAPI_RESULT SQLStmtUpsertConvValue (RDBCtx ctx, int fieldtype, char **pvalue, int *pvaluelen)
 {
-    int i, j, k;
+    int vpos;
 
     ub8 tstamp = -1;
     char tmbuf[24] = {0};
 
-    RDBCtx ctx = sqlstmt->ctx;
- 
-    if (sqlstmt->stmt == RDBSQL_SELECT) {
-        if (! strcmp(sqlstmt->select.tablespace, RDB_SYSTEM_TABLE_PREFIX) &&
-            ! strcmp(sqlstmt->select.tablename, "dual") &&
-            1) {
-            sqlstmt->select.dual = 1;
-        }
-    } else if (sqlstmt->stmt == RDBSQL_DELETE) {
-        // TODO:
+    char *val = *pvalue;
 
-    } else if (sqlstmt->stmt == RDBSQL_UPSERT) {
-        zstringbuf keypattern;
+    switch (fieldtype) {
+    case RDBVT_DATE:
+        vpos = re_match("NOWDATE\\s*(\\s*)", val);
+        if (vpos == 0) {
+            if (RDBGetServerTime(ctx, tmbuf) == RDBAPI_ERROR) {
+                return RDBAPI_ERROR;
+            }
 
-        RDBTableDes_t *tabledes = &sqlstmt->upsert.prepare.tabledes;
+            tmbuf[10] = 0;
+            *pvaluelen = 10;
+            *pvalue = strdup(tmbuf);
+            free(val);
+            break;
+        }
 
-        int *fields = sqlstmt->upsert.prepare.fields;
-        int *rowids = sqlstmt->upsert.prepare.rowids;
+        vpos = re_match("TODATE\\s*(\\s*", val);
+        if (vpos == 0) {
+            char *p = strchr(val, 40);
+            char *q = strrchr(val, 41);
 
-        sqlstmt->upsert.prepare.attfields = 0;
-        sqlstmt->upsert.prepare.dupkey = 1;
+            *tmbuf = 0;
 
-        bzero(fields, sizeof(sqlstmt->upsert.prepare.fields));
-        bzero(rowids, sizeof(sqlstmt->upsert.prepare.rowids));
+            if (p && q && q > p) {
+                *p++ = 0;
+                *q-- = 0;
 
-        bzero(&sqlstmt->upsert.prepare.tabledes, sizeof(sqlstmt->upsert.prepare.tabledes));
+                if (cstr_timestamp_to_datetime(p, -1, tmbuf)) {
+                    tmbuf[10] = 0;
+                    *pvaluelen = 10;
+                    *pvalue = strdup(tmbuf);
+                    free(val);
+                }
+            }
 
-        zstringbufFree(&sqlstmt->upsert.prepare.keypattern);
-        sqlstmt->upsert.prepare.keypattern = zstringbufNew(RDB_ROWKEY_MAX_SIZE, NULL, 0);
+            if (! *tmbuf) {
+                snprintf_chkd_V1(ctx->errmsg, sizeof(ctx->errmsg), "error TODATE(%s)", val);
+                return RDBAPI_ERROR;
+            }
+        }
+        break;
 
-        keypattern = sqlstmt->upsert.prepare.keypattern;
+    case RDBVT_TIME:
+        vpos = re_match("NOWTIME\\s*(\\s*)", val);
+        if (vpos == 0) {
+            if (RDBGetServerTime(ctx, tmbuf) == RDBAPI_ERROR) {
+                return RDBAPI_ERROR;
+            }
 
-        if (RDBTableDescribe(ctx, sqlstmt->upsert.tablespace, sqlstmt->upsert.tablename, tabledes) != RDBAPI_SUCCESS) {
-            return RDBAPI_ERROR;
+            tmbuf[19] = 0;
+            *pvaluelen = 19;
+            *pvalue = strdup(tmbuf);
+            free(val);
+            break;
         }
 
-        for (i = 0; i < sqlstmt->upsert.numfields; i++) {
-            char *val = sqlstmt->upsert.fieldvalues[i];
-            int vlen = sqlstmt->upsert.fieldvalueslen[i];
-            int vpos;
+        vpos = re_match("TOTIME\\s*(\\s*", val);
+        if (vpos == 0) {
+            char *p = strchr(val, 40);
+            char *q = strrchr(val, 41);
 
-            j = RDBTableDesFieldIndex(tabledes, sqlstmt->upsert.fieldnames[i], sqlstmt->upsert.fieldnameslen[i]);
-            if (j == -1) {
-                snprintf_chkd_V1(ctx->errmsg, sizeof(ctx->errmsg), "field not found: '%.*s'", sqlstmt->upsert.fieldnameslen[i], sqlstmt->upsert.fieldnames[i]);
+            *tmbuf = 0;
+
+            if (p && q && q > p) {
+                *p++ = 0;
+                *q-- = 0;
+
+                if (cstr_timestamp_to_datetime(p, -1, tmbuf)) {
+                    tmbuf[19] = 0;
+                    *pvaluelen = 19;
+                    *pvalue = strdup(tmbuf);
+                    free(val);
+                }
+            }
+
+            if (! *tmbuf) {
+                snprintf_chkd_V1(ctx->errmsg, sizeof(ctx->errmsg), "error TOTIME(%s)", val);
                 return RDBAPI_ERROR;
             }
+        }
+        break;
 
-            sqlstmt->upsert.fielddesid[i] = j;
+    case RDBVT_STAMP:
+        tstamp = (ub8)(-1);
 
-            if (fields[j + 1]) {
-                snprintf_chkd_V1(ctx->errmsg, sizeof(ctx->errmsg), "duplicated field: '%.*s'", sqlstmt->upsert.fieldnameslen[i], sqlstmt->upsert.fieldnames[i]);
+        vpos = re_match("NOWSTAMP\\s*(\\s*)", val);
+        if (vpos == 0) {
+            tstamp = RDBGetServerTime(ctx, NULL);
+            if (tstamp == (ub8)(-1)) {
                 return RDBAPI_ERROR;
             }
 
-            switch (tabledes->fielddes[j].fieldtype) {
-            case RDBVT_DATE:
-                vpos = re_match("NOWDATE\\s*(\\s*)", val);
-                if (vpos == 0) {
-                    if (RDBGetServerTime(ctx, tmbuf) == RDBAPI_ERROR) {
-                        return RDBAPI_ERROR;
-                    }
+            *pvaluelen = snprintf_chkd_V1(tmbuf, sizeof(tmbuf), "%"PRIu64, tstamp);
+            *pvalue = strdup(tmbuf);
+            free(val);
+            break;
+        }
 
-                    tmbuf[10] = 0;
-                    sqlstmt->upsert.fieldvalueslen[i] = 10;
-                    sqlstmt->upsert.fieldvalues[i] = strdup(tmbuf);
+        vpos = re_match("TOSTAMP\\s*(\\s*", val);
+        if (vpos == 0) {
+            char *p = strchr(val, 40);
+            char *q = strrchr(val, 41);
+
+            if (p && q && q > p) {
+                *p++ = 0;
+                *q-- = 0;
+
+                tstamp = cstr_parse_timestamp(p);
+                if (tstamp != (ub8)(-1)) {
+                    *pvaluelen = snprintf_chkd_V1(tmbuf, sizeof(tmbuf), "%"PRIu64, tstamp);
+                    *pvalue = strdup(tmbuf);
                     free(val);
-                    break;
                 }
+            }
 
-                vpos = re_match("TODATE\\s*(\\s*", val);
-                if (vpos == 0) {
-                    char *p = strchr(val, 40);
-                    char *q = strrchr(val, 41);
+            if (tstamp == (ub8)(-1)) {
+                snprintf_chkd_V1(ctx->errmsg, sizeof(ctx->errmsg), "error stamp format: %s", val);
+                return RDBAPI_ERROR;
+            }
+        }
+        break;
 
-                    *tmbuf = 0;
+    case RDBVT_SET:
 
-                    if (p && q && q > p) {
-                        *p++ = 0;
-                        *q-- = 0;
+        break;
+    }
 
-                        int lll = q - p;
+    return RDBAPI_SUCCESS;
+}
 
-                        if (cstr_timestamp_to_datetime(p, -1, tmbuf)) {
-                            tmbuf[10] = 0;
-                            sqlstmt->upsert.fieldvalueslen[i] = 10;
-                            sqlstmt->upsert.fieldvalues[i] = strdup(tmbuf);
-                            free(val);
-                        }
-                    }
 
-                    if (! *tmbuf) {
-                        snprintf_chkd_V1(ctx->errmsg, sizeof(ctx->errmsg), "error TODATE(%s)", val);
-                        return RDBAPI_ERROR;
-                    }
-                }
-                break;
+// values bound after prepare replace the converted ones: convert them again.
+//   values converted before are left unchanged.
+//
+static RDBAPI_RESULT SQLStmtUpsertConvParams (RDBSQLStmt sqlstmt)
+{
+    int i, k, numvalues;
 
-            case RDBVT_TIME:
-                vpos = re_match("NOWTIME\\s*(\\s*)", val);
-                if (vpos == 0) {
-                    if (RDBGetServerTime(ctx, tmbuf) == RDBAPI_ERROR) {
-                        return RDBAPI_ERROR;
-                    }
+    RDBSQLParam_t *param;
+    RDBTableDes_t *tabledes = &sqlstmt->upsert.prepare.tabledes;
 
-                    tmbuf[19] = 0;
-                    sqlstmt->upsert.fieldvalueslen[i] = 19;
-                    sqlstmt->upsert.fieldvalues[i] = strdup(tmbuf);
-                    free(val);
-                    break;
-                }
+    numvalues = (sqlstmt->upsert.numrows - 1) * sqlstmt->upsert.numfields;
 
-                vpos = re_match("TOTIME\\s*(\\s*", val);
-                if (vpos == 0) {
-                    char *p = strchr(val, 40);
-                    char *q = strrchr(val, 41);
+    for (i = 0; i < sqlstmt->numparams; i++) {
+        param = &sqlstmt->params[i];
 
-                    *tmbuf = 0;
+        if (param->pvalue >= sqlstmt->upsert.fieldvalues && param->pvalue < sqlstmt->upsert.fieldvalues + sqlstmt->upsert.numfields) {
+            k = (int) (param->pvalue - sqlstmt->upsert.fieldvalues);
+        } else if (numvalues > 0 && param->pvalue >= sqlstmt->upsert.rowvalues && param->pvalue < sqlstmt->upsert.rowvalues + numvalues) {
+            k = (int) (param->pvalue - sqlstmt->upsert.rowvalues) % sqlstmt->upsert.numfields;
+        } else {
+            // not a value of VALUES (...)
+            continue;
+        }
 
-                    if (p && q && q > p) {
-                        *p++ = 0;
-                        *q-- = 0;
+        if (SQLStmtUpsertConvValue(sqlstmt->ctx, tabledes->fielddes[sqlstmt->upsert.fielddesid[k]].fieldtype, param->pvalue, param->pvaluelen) != RDBAPI_SUCCESS) {
+            return RDBAPI_ERROR;
+        }
+    }
 
-                        int lll = q-p;
-                        if (cstr_timestamp_to_datetime(p, -1, tmbuf)) {
-                            tmbuf[19] = 0;
-                            sqlstmt->upsert.fieldvalueslen[i] = 19;
-                            sqlstmt->upsert.fieldvalues[i] = strdup(tmbuf);
-                            free(val);
-                        }
-                    }
+    return RDBAPI_SUCCESS;
+}
 
-                    if (! *tmbuf) {
-                        snprintf_chkd_V1(ctx->errmsg, sizeof(ctx->errmsg), "error TOTIME(%s)", val);
-                        return RDBAPI_ERROR;
-                    }
-                }
-                break;
 
-            case RDBVT_STAMP:
-                tstamp = (ub8)(-1);
+// value k of VALUES (...), (...): literal converted from its original text
+//   kept in upsert.literals on every execute, bound value as it is.
+//
+static RDBAPI_RESULT SQLStmtUpsertConvLiteral (RDBSQLStmt sqlstmt, int k)
+{
+    int i;
 
-                vpos = re_match("NOWSTAMP\\s*(\\s*)", val);
-                if (vpos == 0) {
-                    tstamp = RDBGetServerTime(ctx, NULL);
-                    if (tstamp == (ub8)(-1)) {
-                        return RDBAPI_ERROR;
-                    }
+    char *text, *val;
 
-                    sqlstmt->upsert.fieldvalueslen[i] = snprintf_chkd_V1(tmbuf, sizeof(tmbuf), "%"PRIu64, tstamp);
-                    sqlstmt->upsert.fieldvalues[i] = strdup(tmbuf);
-                    free(val);
-                    break;
-                }
+    int numfields = sqlstmt->upsert.numfields;
+    int fieldtype = sqlstmt->upsert.prepare.tabledes.fielddes[sqlstmt->upsert.fielddesid[k % numfields]].fieldtype;
 
-                vpos = re_match("TOSTAMP\\s*(\\s*", val);
-                if (vpos == 0) {
-                    char *p = strchr(val, 40);
-                    char *q = strrchr(val, 41);
+    char **pvalue = (k < numfields? &sqlstmt->upsert.fieldvalues[k] : &sqlstmt->upsert.rowvalues[k - numfields]);
+    int *pvaluelen = (k < numfields? &sqlstmt->upsert.fieldvalueslen[k] : &sqlstmt->upsert.rowvalueslen[k - numfields]);
 
-                    if (p && q && q > p) {
-                        *p++ = 0;
-                        *q-- = 0;
+    for (i = 0; i < sqlstmt->numparams; i++) {
+        if (sqlstmt->params[i].pvalue == pvalue) {
+            return SQLStmtUpsertConvValue(sqlstmt->ctx, fieldtype, pvalue, pvaluelen);
+        }
+    }
 
-                        tstamp = cstr_parse_timestamp(p);
-                        if (tstamp != (ub8)(-1)) {
-                            sqlstmt->upsert.fieldvalueslen[i] = snprintf_chkd_V1(tmbuf, sizeof(tmbuf), "%"PRIu64, tstamp);
-                            sqlstmt->upsert.fieldvalues[i] = strdup(tmbuf);
-                            free(val);
-                        }
-                    }
+    if (! sqlstmt->upsert.literals) {
+        sqlstmt->upsert.literals = (char **) RDBMemAlloc(sizeof(char *) * sqlstmt->upsert.numrows * numfields);
+    }
 
-                    if (tstamp == (ub8)(-1)) {
-                        snprintf_chkd_V1(ctx->errmsg, sizeof(ctx->errmsg), "error stamp format: %s", val);
-                        return RDBAPI_ERROR;
-                    }
-                }
-                break;
+    text = sqlstmt->upsert.literals[k];
 
-            case RDBVT_SET:
+    if (text) {
+        free(*pvalue);
+        *pvalue = strdup(text);
+        *pvaluelen = (int) strlen(text);
+    } else if (*pvalue) {
+        text = strdup(*pvalue);
+    }
 
-                break;
+    val = *pvalue;
+
+    if (SQLStmtUpsertConvValue(sqlstmt->ctx, fieldtype, pvalue, pvaluelen) != RDBAPI_SUCCESS) {
+        if (text != sqlstmt->upsert.literals[k]) {
+            free(text);
+        }
+        return RDBAPI_ERROR;
+    }
+
+    if (text != sqlstmt->upsert.literals[k]) {
+        if (*pvalue != val) {
+            // converted: keep original text for next execute
+            sqlstmt->upsert.literals[k] = text;
+        } else {
+            free(text);
+        }
+    }
+
+    return RDBAPI_SUCCESS;
+}
+
+
+// literal values converted at prepare are converted again from their text
+//
+static RDBAPI_RESULT SQLStmtUpsertConvLiterals (RDBSQLStmt sqlstmt)
+{
+    int k;
+
+    if (sqlstmt->upsert.literals) {
+        for (k = 0; k < sqlstmt->upsert.numrows * sqlstmt->upsert.numfields; k++) {
+            if (sqlstmt->upsert.literals[k] && SQLStmtUpsertConvLiteral(sqlstmt, k) != RDBAPI_SUCCESS) {
+                return RDBAPI_ERROR;
+            }
+        }
+    }
+
+    return RDBAPI_SUCCESS;
+}
+
+
+// {tablespace::tablename:key1:key2...}
+//
+static void SQLStmtUpsertKeyPattern (RDBSQLStmt sqlstmt)
+{
+    int i, j;
+
+    RDBTableDes_t *tabledes = &sqlstmt->upsert.prepare.tabledes;
+    int *rowids = sqlstmt->upsert.prepare.rowids;
+
+    zstringbuf keypattern = sqlstmt->upsert.prepare.keypattern;
+
+    if (keypattern) {
+        keypattern->len = 0;
+        keypattern->str[0] = 0;
+    } else {
+        keypattern = zstringbufNew(RDB_ROWKEY_MAX_SIZE, NULL, 0);
+    }
+
+    sqlstmt->upsert.prepare.dupkey = 1;
+
+    keypattern = zstringbufCat(keypattern, "{%s::%s", sqlstmt->upsert.tablespace, sqlstmt->upsert.tablename);
+    for (i = 1; i <= tabledes->rowkeyid[0]; i++) {
+        j = rowids[i];
+
+        if (j > 0) {
+            keypattern = zstringbufCat(keypattern, ":%.*s", sqlstmt->upsert.fieldvalueslen[j - 1], sqlstmt->upsert.fieldvalues[j - 1]);
+        } else {
+            sqlstmt->upsert.prepare.dupkey = 0;
+            keypattern = zstringbufCat(keypattern, ":*");
+        }
+    }
+
+    sqlstmt->upsert.prepare.keypattern = zstringbufCat(keypattern, "}");
+}
+
+
+RDBAPI_RESULT RDBSQLStmtPrepare (RDBSQLStmt sqlstmt)
+{
+    int i, j, k;
+
+    RDBCtx ctx = sqlstmt->ctx;
+ 
+    if (sqlstmt->stmt == RDBSQL_SELECT) {
+        if (! strcmp(sqlstmt->select.tablespace, RDB_SYSTEM_TABLE_PREFIX) &&
+            ! strcmp(sqlstmt->select.tablename, "dual") &&
+            1) {
+            sqlstmt->select.dual = 1;
+        }
+    } else if (sqlstmt->stmt == RDBSQL_DELETE) {
+        // TODO:
+
+    } else if (sqlstmt->stmt == RDBSQL_UPSERT) {
+        RDBTableDes_t *tabledes = &sqlstmt->upsert.prepare.tabledes;
+
+        int *fields = sqlstmt->upsert.prepare.fields;
+        int *rowids = sqlstmt->upsert.prepare.rowids;
+
+        sqlstmt->upsert.prepare.attfields = 0;
+        sqlstmt->upsert.prepare.dupkey = 1;
+
+        bzero(fields, sizeof(sqlstmt->upsert.prepare.fields));
+        bzero(rowids, sizeof(sqlstmt->upsert.prepare.rowids));
+
+        bzero(&sqlstmt->upsert.prepare.tabledes, sizeof(sqlstmt->upsert.prepare.tabledes));
+
+        zstringbufFree(&sqlstmt->upsert.prepare.keypattern);
+
+        if (RDBTableDescribeCached(ctx, sqlstmt->upsert.tablespace, sqlstmt->upsert.tablename, tabledes) != RDBAPI_SUCCESS) {
+            return RDBAPI_ERROR;
+        }
+
+        for (i = 0; i < sqlstmt->upsert.numfields; i++) {
+            j = RDBTableDesFieldIndex(tabledes, sqlstmt->upsert.fieldnames[i], sqlstmt->upsert.fieldnameslen[i]);
+            if (j == -1) {
+                snprintf_chkd_V1(ctx->errmsg, sizeof(ctx->errmsg), "field not found: '%.*s'", sqlstmt->upsert.fieldnameslen[i], sqlstmt->upsert.fieldnames[i]);
+                return RDBAPI_ERROR;
+            }
+
+            sqlstmt->upsert.fielddesid[i] = j;
+
+            if (fields[j + 1]) {
+                snprintf_chkd_V1(ctx->errmsg, sizeof(ctx->errmsg), "duplicated field: '%.*s'", sqlstmt->upsert.fieldnameslen[i], sqlstmt->upsert.fieldnames[i]);
+                return RDBAPI_ERROR;
+            }
+
+            if (SQLStmtUpsertConvLiteral(sqlstmt, i) != RDBAPI_SUCCESS) {
+                return RDBAPI_ERROR;
             }
 
             if (fields[0] < j + 1) {
@@ -2281,6 +2803,13 @@ RDBAPI_RESULT RDBSQLStmtPrepare (RDBSQLStmt sqlstmt)
             }
         }
 
+        // values of the other rows in VALUES (...), (...)
+        for (k = sqlstmt->upsert.numfields; k < sqlstmt->upsert.numrows * sqlstmt->upsert.numfields; k++) {
+            if (SQLStmtUpsertConvLiteral(sqlstmt, k) != RDBAPI_SUCCESS) {
+                return RDBAPI_ERROR;
+            }
+        }
+
         for (i = 0; i < sqlstmt->upsert.updcols; i++) {
             j = RDBTableDesFieldIndex(tabledes, sqlstmt->upsert.updcolnames[i], sqlstmt->upsert.updcolnameslen[i]);
             if (j == -1) {
@@ -2296,19 +2825,23 @@ RDBAPI_RESULT RDBSQLStmtPrepare (RDBSQLStmt sqlstmt)
             }
         }
 
-        keypattern = zstringbufCat(keypattern, "{%s::%s", sqlstmt->upsert.tablespace, sqlstmt->upsert.tablename);
+        sqlstmt->upsert.prepare.keyparams = 0;
+
         for (i = 1; i <= tabledes->rowkeyid[0]; i++) {
             j = rowids[i];
 
-            if (j > 0) {
-                keypattern = zstringbufCat(keypattern, ":%.*s", sqlstmt->upsert.fieldvalueslen[j - 1], sqlstmt->upsert.fieldvalues[j - 1]);
-            } else {
-                sqlstmt->upsert.prepare.dupkey = 0;
-                keypattern = zstringbufCat(keypattern, ":*");
+            for (k = 0; j > 0 && k < sqlstmt->numparams; k++) {
+                if (sqlstmt->params[k].pvalue == &sqlstmt->upsert.fieldvalues[j - 1]) {
+                    sqlstmt->upsert.prepare.keyparams = 1;
+                }
+            }
+
+            if (j > 0 && sqlstmt->upsert.literals && sqlstmt->upsert.literals[j - 1]) {
+                sqlstmt->upsert.prepare.keyparams = 1;
             }
         }
 
-        sqlstmt->upsert.prepare.keypattern = zstringbufCat(keypattern, "}");
+        SQLStmtUpsertKeyPattern(sqlstmt);
 
         if (sqlstmt->upsert.selectstmt) {
             if (RDBSQLStmtPrepare(sqlstmt->upsert.selectstmt) != RDBAPI_SUCCESS) {
@@ -2325,29 +2858,362 @@ RDBAPI_RESULT RDBSQLStmtPrepare (RDBSQLStmt sqlstmt)
 }
 
 
-RDBAPI_RESULT RDBSQLStmtExecute (RDBSQLStmt sqlstmt, RDBResultMap *outResultMap)
+#define SQLSTMT_ROW_PENDING    0
+#define SQLSTMT_ROW_OK         1
+#define SQLSTMT_ROW_IGNORED    2
+#define SQLSTMT_ROW_ERROR      3
+#define SQLSTMT_ROW_NOTEXISTS  4
+
+#define SQLSTMT_OLDVALS_APPENDED  1
+#define SQLSTMT_OLDVALS_READ      2
+
+// HMSET {tablespace::tablename:key1:key2...} fld1 val1 fld2 val2 ...
+//
+static int SQLStmtUpsertRowArgv (RDBSQLStmt sqlstmt, int row, zstringbuf *rowkey, const char *argv[], size_t argvlen[])
 {
-    RDBAPI_RESULT res;
+    int i, j, argc = 0;
 
-    int i, j, k;
+    char **values = sqlstmt->upsert.fieldvalues;
+    int *valueslen = sqlstmt->upsert.fieldvalueslen;
+
+    zstringbuf key = *rowkey;
+
+    if (row > 0) {
+        values = &sqlstmt->upsert.rowvalues[(row - 1) * sqlstmt->upsert.numfields];
+        valueslen = &sqlstmt->upsert.rowvalueslen[(row - 1) * sqlstmt->upsert.numfields];
+    }
+
+    if (! key) {
+        key = zstringbufNew(RDB_ROWKEY_MAX_SIZE, NULL, 0);
+
+        key = zstringbufCat(key, "{%s::%s", sqlstmt->upsert.tablespace, sqlstmt->upsert.tablename);
+        for (i = 1; i <= sqlstmt->upsert.prepare.tabledes.rowkeyid[0]; i++) {
+            j = sqlstmt->upsert.prepare.rowids[i];
+            key = zstringbufCat(key, ":%.*s", valueslen[j - 1], values[j - 1]);
+        }
+        key = zstringbufCat(key, "}");
+
+        *rowkey = key;
+    }
+
+    argv[argc] = "HMSET";
+    argvlen[argc++] = 5;
+
+    argv[argc] = key->str;
+    argvlen[argc++] = key->len;
+
+    for (j = 1; j <= sqlstmt->upsert.prepare.fields[0]; j++) {
+        i = sqlstmt->upsert.prepare.fields[j];
+
+        if (i > 0) {
+            argv[argc] = sqlstmt->upsert.fieldnames[i-1];
+            argvlen[argc] = sqlstmt->upsert.fieldnameslen[i-1];
+            argc++;
+
+            argvlen[argc] = assign_fieldvalue(values[i-1], valueslen[i-1], &argv[argc]);
+            argc++;
+        }
+    }
+
+    return argc;
+}
 
-    int keylen;
-    char keybuf[RDB_KEY_VALUE_SIZE];
+
+// read replies of HMGET index values appended on node
+static void SQLStmtUpsertOldValsReply (RDBCtxNode ctxnode, const RDBTableDes_t *tabledes, int numrows, ub1 *oldstats, redisReply **oldVals)
+{
+    int row;
+
+    if (! oldVals) {
+        return;
+    }
+
+    for (row = 0; row < numrows; row++) {
+        if (oldstats[row] == SQLSTMT_OLDVALS_APPENDED) {
+            redisReply *reply = NULL;
+
+            oldstats[row] = 0;
+
+            if (RedisGetReplyOnNode(ctxnode, &reply) == RDBAPI_SUCCESS) {
+                oldVals[row] = RDBTableIndexValsReply(tabledes, reply);
+                oldstats[row] = SQLSTMT_OLDVALS_READ;
+            }
+        }
+    }
+}
+
+
+/**
+ * UPSERT INTO ... VALUES (...), (...), ... [ON DUPLICATE KEY IGNORE]
+ *   rows are grouped by the master node which owns slot of rowkey, then
+ *   commands (HMGET of index values, EXISTS for IGNORE, HMSET) are pipelined
+ *   per node. a row failed in pipeline (MOVED, I/O error) is executed again
+ *   one by one. indexes are updated by RDBTableIndexUpdateRows at last.
+ */
+static RDBAPI_RESULT SQLStmtExecuteUpsertRows (RDBSQLStmt sqlstmt, RDBResultMap *outResultMap)
+{
+    int row, argc, nodeindex;
+    int numok = 0, numignored = 0, numerror = 0;
+
+    const char *argv[RDBAPI_ARGV_MAXNUM + 4] = {0};
+    size_t argvlen[RDBAPI_ARGV_MAXNUM + 4] = {0};
+
+    const char *colnames[] = {"$rowkey", "status", 0};
+    int colnameslen[] = {7, 6, 0};
+
+    const char *statusnames[] = {"ERROR", "OK", "IGNORED", "ERROR", "ERROR"};
+
+    char title[128];
 
     RDBResultMap resultmap = NULL;
 
     RDBCtx ctx = sqlstmt->ctx;
     RDBEnv env = ctx->env;
 
-    *outResultMap = NULL;
+    int numrows = sqlstmt->upsert.numrows;
+    int ignore = (sqlstmt->upsert.upsertmode == RDBSQL_UPSERT_MODE_IGNORE);
 
-    if (sqlstmt->upsert.prepare.tabledes.table_timestamp != RDBTableGetTimestamp(ctx, sqlstmt->upsert.tablespace, sqlstmt->upsert.tablename)) {
-        res = RDBSQLStmtPrepare(sqlstmt);
-        if (res != RDBAPI_SUCCESS) {
-            return res;
+    zstringbuf *rowkeys;
+    int *rownodes;
+    ub1 *rowstats;
+    ub1 *appended;
+
+    // index values of rows before changed
+    RDBTableDes_t *tabledes = &sqlstmt->upsert.prepare.tabledes;
+    redisReply **oldVals = NULL;
+    ub1 *oldstats = NULL;
+    int numupdated = 0;
+
+    if (! sqlstmt->upsert.prepare.attfields) {
+        snprintf_chkd_V1(ctx->errmsg, sizeof(ctx->errmsg), "upsert no field for rows");
+        return RDBAPI_ERROR;
+    }
+
+    if (! sqlstmt->upsert.prepare.dupkey) {
+        snprintf_chkd_V1(ctx->errmsg, sizeof(ctx->errmsg), "not all fields of rowkey assigned");
+        return RDBAPI_ERROR;
+    }
+
+    rowkeys = (zstringbuf *) RDBMemAlloc(sizeof(zstringbuf) * numrows);
+    rownodes = (int *) RDBMemAlloc(sizeof(int) * numrows);
+    rowstats = (ub1 *) RDBMemAlloc(numrows);
+    appended = (ub1 *) RDBMemAlloc(numrows);
+
+    for (row = 0; row < numrows; row++) {
+        SQLStmtUpsertRowArgv(sqlstmt, row, &rowkeys[row], argv, argvlen);
+
+        rownodes[row] = env->slotsmap[crc16_keyslot(rowkeys[row]->str, (int) rowkeys[row]->len)];
+    }
+
+    if (tabledes->indexids[0]) {
+        // index values are read by HMGET pipelined ahead of EXISTS or HMSET
+        oldVals = (redisReply **) RDBMemAlloc(sizeof(redisReply *) * numrows);
+        oldstats = (ub1 *) RDBMemAlloc(numrows);
+    }
+
+    for (nodeindex = 0; nodeindex < RDBEnvNumNodes(env); nodeindex++) {
+        RDBCtxNode ctxnode = RDBCtxGetNode(ctx, nodeindex);
+
+        for (row = 0; row < numrows; row++) {
+            if (rownodes[row] == nodeindex) {
+                break;
+            }
+        }
+
+        if (row == numrows) {
+            // no rows for this node
+            continue;
+        }
+
+        if (! RDBCtxNodeIsOpen(ctxnode) && RDBCtxNodeOpen(ctxnode) != RDBAPI_SUCCESS) {
+            continue;
+        }
+
+        if (oldVals) {
+            // HMGET index values of rows before changed
+            for (row = 0; row < numrows; row++) {
+                if (rownodes[row] == nodeindex) {
+                    argc = RDBTableIndexGetValsArgv(tabledes, rowkeys[row]->str, rowkeys[row]->len, argv, argvlen);
+
+                    if (RedisAppendArgvOnNode(ctxnode, argc, argv, argvlen) == RDBAPI_SUCCESS) {
+                        oldstats[row] = SQLSTMT_OLDVALS_APPENDED;
+                    }
+                }
+            }
+        }
+
+        if (ignore) {
+            // EXISTS key
+            argv[0] = "EXISTS";
+            argvlen[0] = 6;
+
+            for (row = 0; row < numrows; row++) {
+                appended[row] = 0;
+
+                if (rownodes[row] == nodeindex) {
+                    argv[1] = rowkeys[row]->str;
+                    argvlen[1] = rowkeys[row]->len;
+
+                    if (RedisAppendArgvOnNode(ctxnode, 2, argv, argvlen) == RDBAPI_SUCCESS) {
+                        appended[row] = 1;
+                    }
+                }
+            }
+
+            SQLStmtUpsertOldValsReply(ctxnode, tabledes, numrows, oldstats, oldVals);
+
+            for (row = 0; row < numrows; row++) {
+                if (appended[row]) {
+                    redisReply *reply = NULL;
+
+                    if (RedisGetReplyOnNode(ctxnode, &reply) == RDBAPI_SUCCESS) {
+                        if (reply->type == REDIS_REPLY_INTEGER) {
+                            rowstats[row] = (reply->integer ? SQLSTMT_ROW_IGNORED : SQLSTMT_ROW_NOTEXISTS);
+                        }
+                        RedisFreeReplyObject(&reply);
+                    }
+                }
+            }
+        }
+
+        for (row = 0; row < numrows; row++) {
+            appended[row] = 0;
+
+            if (rownodes[row] == nodeindex && rowstats[row] == (ignore ? SQLSTMT_ROW_NOTEXISTS : SQLSTMT_ROW_PENDING)) {
+                argc = SQLStmtUpsertRowArgv(sqlstmt, row, &rowkeys[row], argv, argvlen);
+
+                if (RedisAppendArgvOnNode(ctxnode, argc, argv, argvlen) == RDBAPI_SUCCESS) {
+                    appended[row] = 1;
+                }
+            }
+        }
+
+        SQLStmtUpsertOldValsReply(ctxnode, tabledes, numrows, oldstats, oldVals);
+
+        for (row = 0; row < numrows; row++) {
+            if (appended[row]) {
+                redisReply *reply = NULL;
+
+                if (RedisGetReplyOnNode(ctxnode, &reply) == RDBAPI_SUCCESS) {
+                    if (RedisCheckReplyStatus(reply, "OK", 2)) {
+                        rowstats[row] = SQLSTMT_ROW_OK;
+                    }
+                    RedisFreeReplyObject(&reply);
+                }
+            }
+        }
+    }
+
+    for (row = 0; row < numrows; row++) {
+        if (rowstats[row] == SQLSTMT_ROW_PENDING || rowstats[row] == SQLSTMT_ROW_NOTEXISTS) {
+            // execute again by slot routing
+            if (ignore && RedisExistsKey(ctx, rowkeys[row]->str, rowkeys[row]->len) == 1) {
+                rowstats[row] = SQLSTMT_ROW_IGNORED;
+            } else {
+                redisReply *reply;
+
+                if (oldVals && oldstats[row] != SQLSTMT_OLDVALS_READ) {
+                    RedisFreeReplyObject(&oldVals[row]);
+                    oldVals[row] = RDBTableIndexGetVals(ctx, tabledes, rowkeys[row]->str, rowkeys[row]->len);
+                }
+
+                argc = SQLStmtUpsertRowArgv(sqlstmt, row, &rowkeys[row], argv, argvlen);
+
+                reply = RedisExecCommandArgv(ctx, argc, argv, argvlen);
+
+                rowstats[row] = (RedisCheckReplyStatus(reply, "OK", 2) ? SQLSTMT_ROW_OK : SQLSTMT_ROW_ERROR);
+
+                RedisFreeReplyObject(&reply);
+            }
+        }
+
+        if (rowstats[row] == SQLSTMT_ROW_OK) {
+            numok++;
+        } else if (rowstats[row] == SQLSTMT_ROW_IGNORED) {
+            numignored++;
+        } else {
+            numerror++;
+        }
+    }
+
+    if (oldVals) {
+        // update indexes of rows written
+        const char **keys = (const char **) RDBMemAlloc(sizeof(char *) * numrows);
+        size_t *keyslen = (size_t *) RDBMemAlloc(sizeof(size_t) * numrows);
+
+        for (row = 0; row < numrows; row++) {
+            if (rowstats[row] == SQLSTMT_ROW_OK) {
+                keys[numupdated] = rowkeys[row]->str;
+                keyslen[numupdated] = rowkeys[row]->len;
+                oldVals[numupdated++] = oldVals[row];
+            } else {
+                RedisFreeReplyObject(&oldVals[row]);
+            }
+        }
+
+        RDBTableIndexUpdateRows(ctx, tabledes, numupdated, keys, keyslen, oldVals, 0);
+
+        RedisFreeReplyObjects(oldVals, numupdated);
+
+        RDBMemFree(keyslen);
+        RDBMemFree(keys);
+        RDBMemFree(oldstats);
+    }
+
+    snprintf_chkd_V1(title, sizeof(title), "%s rows: %d ok, %d ignored, %d error", (numerror ? "FAILED" : "SUCCESS"), numok, numignored, numerror);
+
+    RDBResultMapCreate(title, colnames, colnameslen, 2, 0, &resultmap);
+
+    for (row = 0; row < numrows; row++) {
+        RDBRow rowobj;
+        const char *status = statusnames[rowstats[row]];
+
+        if (RDBRowNew(resultmap, rowkeys[row]->str, rowkeys[row]->len, &rowobj) == RDBAPI_SUCCESS) {
+            RDBCellSetString(RDBRowCell(rowobj, 0), rowkeys[row]->str, rowkeys[row]->len);
+            RDBCellSetString(RDBRowCell(rowobj, 1), status, (int) strlen(status));
+
+            if (RDBResultMapInsertRow(resultmap, rowobj) != RDBAPI_SUCCESS) {
+                // the same rowkey: the latest status is kept
+                RDBRow dup = RDBResultMapFindRow(resultmap, rowkeys[row]->str, rowkeys[row]->len);
+                if (dup) {
+                    RDBCellSetString(RDBRowCell(dup, 1), status, (int) strlen(status));
+                }
+                RDBRowFree(rowobj);
+            }
         }
+
+        zstringbufFree(&rowkeys[row]);
     }
 
+    if (numerror) {
+        snprintf_chkd_V1(ctx->errmsg, sizeof(ctx->errmsg), "RDBAPI_ERROR: %d rows failed to upsert", numerror);
+    }
+
+    RDBMemFree(rowkeys);
+    RDBMemFree(rownodes);
+    RDBMemFree(rowstats);
+    RDBMemFree(appended);
+    RDBMemFree(oldVals);
+
+    *outResultMap = resultmap;
+    return RDBAPI_SUCCESS;
+}
+
+
+static RDBAPI_RESULT SQLStmtExecutePrepared (RDBSQLStmt sqlstmt, RDBResultMap *outResultMap)
+{
+    RDBAPI_RESULT res;
+
+    int i, j, k;
+
+    int keylen;
+    char keybuf[RDB_KEY_VALUE_SIZE];
+
+    RDBResultMap resultmap = NULL;
+
+    RDBCtx ctx = sqlstmt->ctx;
+    RDBEnv env = ctx->env;
+
     if (sqlstmt->stmt == RDBSQL_SELECT) {
         if (sqlstmt->select.dual) {
             RDBRow row;
@@ -2420,7 +3286,7 @@ RDBAPI_RESULT RDBSQLStmtExecute (RDBSQLStmt sqlstmt, RDBResultMap *outResultMap)
                 ub8 offset = RDBTableScanNext(resultmap, sqlstmt->select.offset, sqlstmt->select.limit);
 
                 if (offset != RDB_ERROR_OFFSET) {
-                    if (sqlstmt->stmt == RDBSQL_DELETE) {
+                    if (sqlstmt->stmt == RDBSQL_DELETE && ! resultmap->filter->scandeleted) {
                         RDBResultMapDeleteAllOnCluster(resultmap);
                     }
 
@@ -2437,7 +3303,7 @@ RDBAPI_RESULT RDBSQLStmtExecute (RDBSQLStmt sqlstmt, RDBResultMap *outResultMap)
             ub8 offset = RDBTableScanNext(resultmap, sqlstmt->select.offset, sqlstmt->select.limit);
 
             if (offset != RDB_ERROR_OFFSET) {
-                if (sqlstmt->stmt == RDBSQL_DELETE) {
+                if (sqlstmt->stmt == RDBSQL_DELETE && ! resultmap->filter->scandeleted) {
                     RDBResultMapDeleteAllOnCluster(resultmap);
                 }
 
@@ -2461,7 +3327,18 @@ RDBAPI_RESULT RDBSQLStmtExecute (RDBSQLStmt sqlstmt, RDBResultMap *outResultMap)
         const char *colnames[] = {"$rowkey", 0};
         int colnameslen[] = {7, 0};
 
-        zstringbuf keypattern = sqlstmt->upsert.prepare.keypattern;
+        zstringbuf keypattern;
+
+        if (sqlstmt->upsert.prepare.keyparams) {
+            // rowkey values have been rebound
+            SQLStmtUpsertKeyPattern(sqlstmt);
+        }
+
+        keypattern = sqlstmt->upsert.prepare.keypattern;
+
+        if (sqlstmt->upsert.numrows > 1) {
+            return SQLStmtExecuteUpsertRows(sqlstmt, outResultMap);
+        }
 
         if (sqlstmt->upsert.upsertmode == RDBSQL_UPSERT_MODE_INSERT) {
             if (! sqlstmt->upsert.prepare.attfields) {
@@ -2517,15 +3394,13 @@ RDBAPI_RESULT RDBSQLStmtExecute (RDBSQLStmt sqlstmt, RDBResultMap *outResultMap)
                 int haserror = 0;
 
                 // result cursor state
-                RDBTableCursor_t *nodestates = RDBMemAlloc(sizeof(RDBTableCursor_t) * RDBEnvNumNodes(ctx->env));
+                RDBTableCursor_t *nodestates = RDBMemAlloc(sizeof(RDBTableCursor_t) * ctx->topology->numnodes);
 
                 RDBResultMapCreate("SUCCESS results", colnames, colnameslen, 1, 0, &resultmap);
 
-                while (! haserror && nodeindex < RDBEnvNumNodes(ctx->env)) {
-                    RDBEnvNode envnode = RDBEnvGetNode(ctx->env, nodeindex);
-
-                    // scan only on master node
-                    if (RDBEnvNodeGetMaster(envnode, NULL) == RDBAPI_TRUE) {
+                while (! haserror && nodeindex < ctx->topology->numnodes) {
+                    // scan only on master node of topology pinned by ctx
+                    if (RDBCtxNodeIsMaster(ctx, nodeindex)) {
                         redisReply *replyRows = NULL;
                         RDBCtxNode ctxnode = RDBCtxGetNode(ctx, nodeindex);
 
@@ -2537,7 +3412,10 @@ RDBAPI_RESULT RDBSQLStmtExecute (RDBSQLStmt sqlstmt, RDBResultMap *outResultMap)
                         }
 
                         res = RDBTableScanOnNode(ctxnode, nodestate, keypattern->str, keypattern->len, 200, &replyRows);
-                        if (res == RDBAPI_SUCCESS) {
+                        if (res == RDBAPI_CONTINUE && *ctx->errmsg) {
+                            // node failed (or circuit open)
+                            haserror = 1;
+                        } else if (res == RDBAPI_SUCCESS) {
                             // here we should update rows
                             for (i = 0; ! haserror && i != replyRows->elements; i++) {
                                 // get row first
@@ -2565,6 +3443,8 @@ RDBAPI_RESULT RDBSQLStmtExecute (RDBSQLStmt sqlstmt, RDBResultMap *outResultMap)
                                 if (replyGet && replyGet->type == REDIS_REPLY_ARRAY && replyGet->elements == sqlstmt->upsert.prepare.attfields) {
                                     redisReply *replySet;
 
+                                    redisReply *oldVals = RDBTableIndexGetVals(ctx, &sqlstmt->upsert.prepare.tabledes, replyRows->element[i]->str, replyRows->element[i]->len);
+
                                     argc = 0;
 
                                     argv[argc] = "HMSET";
@@ -2599,6 +3479,9 @@ RDBAPI_RESULT RDBSQLStmtExecute (RDBSQLStmt sqlstmt, RDBResultMap *outResultMap)
                                         haserror = 1;
                                     }
 
+                                    RDBTableIndexUpdateRow(ctx, &sqlstmt->upsert.prepare.tabledes, replyRows->element[i]->str, replyRows->element[i]->len, oldVals, 0);
+                                    RedisFreeReplyObject(&oldVals);
+
                                     RedisFreeReplyObject(&replySet);
                                 }
 
@@ -2965,12 +3848,20 @@ RDBAPI_RESULT RDBSQLStmtExecute (RDBSQLStmt sqlstmt, RDBResultMap *outResultMap)
         RDBTableDes_t tabledes = {0};
         res = RDBTableDescribe(ctx, sqlstmt->create.tablespace, sqlstmt->create.tablename, &tabledes);
 
+        if (res == RDBAPI_ERR_REJECTED) {
+            // table is being dropped in background
+            return res;
+        }
+
         if (res == RDBAPI_SUCCESS && sqlstmt->create.fail_on_exists) {
             snprintf_chkd_V1(ctx->errmsg, sizeof(ctx->errmsg), "RDBAPI_ERROR: table already existed");
             return RDBAPI_ERROR;
         }
 
         res = RDBTableCreate(ctx, sqlstmt->create.tablespace, sqlstmt->create.tablename, sqlstmt->create.tablecomment, sqlstmt->create.numfields, sqlstmt->create.fielddefs);
+
+        RDBEnvInvalidTableDes(env, sqlstmt->create.tablespace, sqlstmt->create.tablename);
+
         if (res == RDBAPI_SUCCESS) {
             bzero(&tabledes, sizeof(tabledes));
 
@@ -2991,11 +3882,25 @@ RDBAPI_RESULT RDBSQLStmtExecute (RDBSQLStmt sqlstmt, RDBResultMap *outResultMap)
         resultmap = ResultMapBuildDescTable(sqlstmt->desctable.tablespace, sqlstmt->desctable.tablename, env->valtypetable, &tabledes);
         *outResultMap = resultmap;
         return RDBAPI_SUCCESS;
-    } else if (sqlstmt->stmt == RDBSQL_DROP_TABLE) {
-        keylen = snprintf_chkd_V1(keybuf, sizeof(keybuf), "{%s::%s:%s}", RDB_SYSTEM_TABLE_PREFIX, sqlstmt->droptable.tablespace, sqlstmt->droptable.tablename);
+    } else if (sqlstmt->stmt == RDBSQL_CREATE_INDEX) {
+        ub8 numrows = 0;
+
+        res = RDBTableCreateIndex(ctx, sqlstmt->createindex.tablespace, sqlstmt->createindex.tablename, sqlstmt->createindex.fieldname, &numrows);
+        if (res != RDBAPI_SUCCESS) {
+            return res;
+        }
+
+        snprintf_chkd_V1(keybuf, sizeof(keybuf), "SUCCESS: index '%s' on table '%s.%s' created with %"PRIu64" rows.",
+            sqlstmt->createindex.fieldname, sqlstmt->createindex.tablespace, sqlstmt->createindex.tablename, numrows);
 
-        if (RedisDeleteKey(ctx, keybuf, keylen, NULL, 0) == RDBAPI_KEY_DELETED) {
-            snprintf_chkd_V1(keybuf, sizeof(keybuf), "SUCCESS: table '%s.%s' drop okay.", sqlstmt->droptable.tablespace, sqlstmt->droptable.tablename);
+        RDBResultMapCreate(keybuf, NULL, NULL, 0, 0, &resultmap);
+
+        *outResultMap = resultmap;
+        return RDBAPI_SUCCESS;
+    } else if (sqlstmt->stmt == RDBSQL_DROP_TABLE) {
+        // table is tombstoned at once and rows are reclaimed in background
+        if (RDBTableDrop(ctx, sqlstmt->droptable.tablespace, sqlstmt->droptable.tablename) == RDBAPI_SUCCESS) {
+            snprintf_chkd_V1(keybuf, sizeof(keybuf), "SUCCESS: table '%s.%s' drop okay. rows are reclaimed in background.", sqlstmt->droptable.tablespace, sqlstmt->droptable.tablename);
         } else {
             snprintf_chkd_V1(keybuf, sizeof(keybuf), "FAILED: table '%s.%s' not found !", sqlstmt->droptable.tablespace, sqlstmt->droptable.tablename);
         }
@@ -3083,7 +3988,7 @@ RDBAPI_RESULT RDBSQLStmtExecute (RDBSQLStmt sqlstmt, RDBResultMap *outResultMap)
         RDBBlob_t pattern = {0};
 
         // result cursor state
-        RDBTableCursor_t *nodestates = RDBMemAlloc(sizeof(RDBTableCursor_t) * RDBEnvNumNodes(ctx->env));
+        RDBTableCursor_t *nodestates = RDBMemAlloc(sizeof(RDBTableCursor_t) * ctx->topology->numnodes);
 
         int nodeindex = 0;
         int prefixlen = (int) strlen(RDB_SYSTEM_TABLE_PREFIX) + 3;
@@ -3094,11 +3999,9 @@ RDBAPI_RESULT RDBSQLStmtExecute (RDBSQLStmt sqlstmt, RDBResultMap *outResultMap)
 
         RDBResultMapCreate("DATABASES:", names, NULL, 1, 0, &resultmap);
 
-        while (nodeindex < RDBEnvNumNodes(ctx->env)) {
-            RDBEnvNode envnode = RDBEnvGetNode(ctx->env, nodeindex);
-
-            // scan only on master node
-            if (RDBEnvNodeGetMaster(envnode, NULL) == RDBAPI_TRUE) {
+        while (nodeindex < ctx->topology->numnodes) {
+            // scan only on master node of topology pinned by ctx
+            if (RDBCtxNodeIsMaster(ctx, nodeindex)) {
                 RDBCtxNode ctxnode = RDBCtxGetNode(ctx, nodeindex);
 
                 RDBTableCursor nodestate = &nodestates[nodeindex];
@@ -3110,6 +4013,14 @@ RDBAPI_RESULT RDBSQLStmtExecute (RDBSQLStmt sqlstmt, RDBResultMap *outResultMap)
 
                 res = RDBTableScanOnNode(ctxnode, nodestate, pattern.str, pattern.length, 200, &replyRows);
 
+                if (res == RDBAPI_CONTINUE && *ctx->errmsg) {
+                    // node failed (or circuit open)
+                    RDBMemFree(nodestates);
+                    RDBMemFree(pattern.str);
+                    RDBResultMapDestroy(resultmap);
+                    return RDBAPI_ERROR;
+                }
+
                 if (res == RDBAPI_SUCCESS) {
                     // here we should add new rows
                     size_t i = 0;
@@ -3155,7 +4066,7 @@ RDBAPI_RESULT RDBSQLStmtExecute (RDBSQLStmt sqlstmt, RDBResultMap *outResultMap)
         RDBBlob_t pattern = {0};
 
         // result cursor state
-        RDBTableCursor_t *nodestates = RDBMemAlloc(sizeof(RDBTableCursor_t) * RDBEnvNumNodes(ctx->env));
+        RDBTableCursor_t *nodestates = RDBMemAlloc(sizeof(RDBTableCursor_t) * ctx->topology->numnodes);
 
         int nodeindex = 0;
         int dbnlen = cstr_length(sqlstmt->showtables.tablespace, RDB_KEY_NAME_MAXLEN);
@@ -3167,11 +4078,9 @@ RDBAPI_RESULT RDBSQLStmtExecute (RDBSQLStmt sqlstmt, RDBResultMap *outResultMap)
 
         RDBResultMapCreate("TABLES:", names, NULL, 1, 0, &resultmap);
 
-        while (nodeindex < RDBEnvNumNodes(ctx->env)) {
-            RDBEnvNode envnode = RDBEnvGetNode(ctx->env, nodeindex);
-
-            // scan only on master node
-            if (RDBEnvNodeGetMaster(envnode, NULL) == RDBAPI_TRUE) {
+        while (nodeindex < ctx->topology->numnodes) {
+            // scan only on master node of topology pinned by ctx
+            if (RDBCtxNodeIsMaster(ctx, nodeindex)) {
                 RDBCtxNode ctxnode = RDBCtxGetNode(ctx, nodeindex);
 
                 RDBTableCursor nodestate = &nodestates[nodeindex];
@@ -3183,6 +4092,14 @@ RDBAPI_RESULT RDBSQLStmtExecute (RDBSQLStmt sqlstmt, RDBResultMap *outResultMap)
 
                 res = RDBTableScanOnNode(ctxnode, nodestate, pattern.str, pattern.length, 200, &replyRows);
 
+                if (res == RDBAPI_CONTINUE && *ctx->errmsg) {
+                    // node failed (or circuit open)
+                    RDBMemFree(nodestates);
+                    RDBMemFree(pattern.str);
+                    RDBResultMapDestroy(resultmap);
+                    return RDBAPI_ERROR;
+                }
+
                 if (res == RDBAPI_SUCCESS) {
                     // here we should add new rows
                     size_t i = 0;
@@ -3227,6 +4144,75 @@ RDBAPI_RESULT RDBSQLStmtExecute (RDBSQLStmt sqlstmt, RDBResultMap *outResultMap)
 }
 
 
+RDBAPI_RESULT RDBSQLStmtExecute (RDBSQLStmt sqlstmt, RDBResultMap *outResultMap)
+{
+    RDBAPI_RESULT res;
+
+    int i;
+
+    RDBCtx ctx = sqlstmt->ctx;
+
+    // index values of upsert row before changed
+    int indexed = 0;
+    redisReply *oldVals = NULL;
+
+    *outResultMap = NULL;
+
+    // statement sees latest topology published to env
+    RDBCtxPinTopology(ctx);
+
+    for (i = 0; i < sqlstmt->numparams; i++) {
+        if (! sqlstmt->params[i].bound) {
+            snprintf_chkd_V1(ctx->errmsg, sizeof(ctx->errmsg), "RDBAPI_ERR_BADARG: parameter(%d) not bound", i + 1);
+            return RDBAPI_ERR_BADARG;
+        }
+    }
+
+    // prepared upsert is renewed only if table has been changed
+    if (sqlstmt->stmt != RDBSQL_UPSERT ||
+        sqlstmt->upsert.prepare.tabledes.table_timestamp != RDBTableGetTimestampCached(ctx, sqlstmt->upsert.tablespace, sqlstmt->upsert.tablename)) {
+        res = RDBSQLStmtPrepare(sqlstmt);
+        if (res != RDBAPI_SUCCESS) {
+            return res;
+        }
+    } else {
+        // NOWDATE(), TODATE(...)... of bound and literal values are converted on every execute
+        res = SQLStmtUpsertConvParams(sqlstmt);
+        if (res == RDBAPI_SUCCESS) {
+            res = SQLStmtUpsertConvLiterals(sqlstmt);
+        }
+        if (res != RDBAPI_SUCCESS) {
+            return res;
+        }
+    }
+
+    if (sqlstmt->stmt == RDBSQL_UPSERT && sqlstmt->upsert.numrows <= 1 && sqlstmt->upsert.prepare.tabledes.indexids[0]) {
+        if (sqlstmt->upsert.prepare.keyparams) {
+            SQLStmtUpsertKeyPattern(sqlstmt);
+        }
+
+        if (sqlstmt->upsert.prepare.dupkey) {
+            zstringbuf keypattern = sqlstmt->upsert.prepare.keypattern;
+
+            oldVals = RDBTableIndexGetVals(ctx, &sqlstmt->upsert.prepare.tabledes, keypattern->str, keypattern->len);
+            indexed = 1;
+        }
+    }
+
+    res = SQLStmtExecutePrepared(sqlstmt, outResultMap);
+
+    if (indexed) {
+        zstringbuf keypattern = sqlstmt->upsert.prepare.keypattern;
+
+        // sync index entries with the row whatever upsert succeeded or not
+        RDBTableIndexUpdateRow(ctx, &sqlstmt->upsert.prepare.tabledes, keypattern->str, keypattern->len, oldVals, 0);
+        RedisFreeReplyObject(&oldVals);
+    }
+
+    return res;
+}
+
+
 RDBAPI_RESULT RDBCtxExecuteSql (RDBCtx ctx, RDBZString sqlstr, RDBResultMap *outResultMap)
 {
     RDBResultMap resultmap = NULL;
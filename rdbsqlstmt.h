@@ -47,6 +47,7 @@ extern "C"
 #define RDBSQL_PATTERN_DELETE_FROM     "DELETE[\\s]+FROM[\\s]+"
 #define RDBSQL_PATTERN_UPSERT_INTO     "UPSERT[\\s]+INTO[\\s]+"
 #define RDBSQL_PATTERN_CREATE_TABLE    "CREATE[\\s]+TABLE[\\s]+"
+#define RDBSQL_PATTERN_CREATE_INDEX    "CREATE[\\s]+INDEX[\\s]+"
 #define RDBSQL_PATTERN_DESC_TABLE      "DESC[\\s]+"
 #define RDBSQL_PATTERN_INFO_SECTION    "INFO[\\W]*"
 #define RDBSQL_PATTERN_SHOW_DATABASES  "SHOW[\\s]+DATABASES[\\s]*$"
@@ -56,6 +57,10 @@ extern "C"
 #define RDBSQL_COMMAND_VERBOSE_ON      "VERBOSE[\\s]+ON[\\s]*$"
 #define RDBSQL_COMMAND_VERBOSE_OFF     "VERBOSE[\\s]+OFF[\\s]*$"
 #define RDBSQL_COMMAND_DELIMITER       "DELIMITER[\\s]+"
+#define RDBSQL_COMMAND_PARALLEL_ON     "PARALLEL[\\s]+ON[\\s]*$"
+#define RDBSQL_COMMAND_PARALLEL_OFF    "PARALLEL[\\s]+OFF[\\s]*$"
+#define RDBSQL_COMMAND_PUSHDOWN_ON     "PUSHDOWN[\\s]+ON[\\s]*$"
+#define RDBSQL_COMMAND_PUSHDOWN_OFF    "PUSHDOWN[\\s]+OFF[\\s]*$"
 
 
 /**
@@ -81,6 +86,26 @@ extern "C"
 #define RDBSQL_FUNC_COUNT             1
 
 
+/**
+ * bind parameter: '?' or ':name' as value in VALUES, UPDATE and WHERE
+ */
+typedef struct _RDBSQLParam_t
+{
+    // name of ':name', empty for '?'
+    char name[RDB_KEY_NAME_MAXLEN + 1];
+
+    // 1: value of UPSERT (string value is quoted)
+    int quotable;
+
+    // 1: value has been bound
+    int bound;
+
+    // value slot in sqlstmt bound to
+    char **pvalue;
+    int *pvaluelen;
+} RDBSQLParam_t;
+
+
 typedef struct _RDBSQLStmt_t
 {
     RDBCtx ctx;
@@ -137,6 +162,16 @@ typedef struct _RDBSQLStmt_t
             int   fieldvalueslen[RDBAPI_ARGV_MAXNUM + 1];
             int   fielddesid[RDBAPI_ARGV_MAXNUM + 1];
 
+            // VALUES (...), (...), ...
+            //   rows after the first one keep numfields values per row
+            int numrows;
+            char **rowvalues;
+            int *rowvalueslen;
+
+            // original text of literal values converted by NOWDATE(), TODATE(...)...
+            //   k < numfields: fieldvalues[k], else rowvalues[k - numfields]
+            char **literals;
+
             int updcols;
             char *updcolnames[RDBAPI_ARGV_MAXNUM + 1];
             int   updcolnameslen[RDBAPI_ARGV_MAXNUM + 1];
@@ -162,6 +197,9 @@ typedef struct _RDBSQLStmt_t
                 int attfields;
                 int dupkey;
 
+                // 1: rowkey value is a bind parameter or converted literal
+                int keyparams;
+
                 int fields[RDBAPI_ARGV_MAXNUM + 1];
                 int rowids[RDBAPI_KEYS_MAXNUM + 1];               
             } prepare;
@@ -193,6 +231,12 @@ typedef struct _RDBSQLStmt_t
             char tablename[RDB_KEY_NAME_MAXLEN + 1];
         } droptable;
 
+        struct CREATE_INDEX {
+            char tablespace[RDB_KEY_NAME_MAXLEN + 1];
+            char tablename[RDB_KEY_NAME_MAXLEN + 1];
+            char fieldname[RDB_KEY_NAME_MAXLEN + 1];
+        } createindex;
+
         struct INFO_SECTION {
             RDBNodeInfoSection section;
 
@@ -201,6 +245,10 @@ typedef struct _RDBSQLStmt_t
         } info;
     };
 
+    // bind parameters
+    int numparams;
+    RDBSQLParam_t params[RDBAPI_ARGV_MAXNUM + 1];
+
     // offset to sqlblock
     int offsetlen;
     char *sqloffset;
@@ -306,6 +354,7 @@ void SQLStmtParseCreate        (RDBCtx ctx, RDBSQLStmt sqlstmt);
 void SQLStmtParseDesc          (RDBCtx ctx, RDBSQLStmt sqlstmt);
 void SQLStmtParseInfo          (RDBCtx ctx, RDBSQLStmt sqlstmt);
 void SQLStmtParseDrop          (RDBCtx ctx, RDBSQLStmt sqlstmt);
+void SQLStmtParseCreateIndex   (RDBCtx ctx, RDBSQLStmt sqlstmt);
 void SQLStmtParseShowDatabases (RDBCtx ctx, RDBSQLStmt sqlstmt);
 void SQLStmtParseShowTables    (RDBCtx ctx, RDBSQLStmt sqlstmt);
 
@@ -71,6 +71,310 @@ ub8 RDBResultMapGetOffset (RDBResultMap resultmap)
 }
 
 
+/**
+ * secondary index
+ *
+ *   one ZSET per indexed field: {redisdb::$tablespace:$tablename:$field}
+ *     numeric field: score = value, member = rowkey
+ *     STR field:     score = 0, member = value + '\0' + rowkey (lex order)
+ *
+ *   rowkey index on the first rowkey field is sharded by hash tag into
+ *   rowkeyshards ZSETs: {redisdb::$tablespace:$tablename:$rowkey:$shard}
+ *     numeric field: score = value, member = rowkey
+ *     STR field:     score = 0, member = rowkey (lex order)
+ *
+ *   entries are maintained by client on UPSERT and DELETE, not atomic with
+ *   the row. a stale entry only costs one more HMGET since rows found by
+ *   index are always filtered again.
+ */
+static int RDBTableIndexType (RDBValueType valtype)
+{
+    switch (valtype) {
+    case RDBVT_SB2:
+    case RDBVT_UB2:
+    case RDBVT_SB4:
+    case RDBVT_UB4:
+    case RDBVT_UB4X:
+    case RDBVT_SB8:
+    case RDBVT_UB8:
+    case RDBVT_UB8X:
+    case RDBVT_CHAR:
+    case RDBVT_BYTE:
+    case RDBVT_FLT64:
+    case RDBVT_STAMP:
+        // ZRANGEBYSCORE
+        return 1;
+
+    case RDBVT_STR:
+        // ZRANGEBYLEX
+        return 2;
+
+    default:
+        break;
+    }
+
+    // not indexable
+    return 0;
+}
+
+
+/**
+ * RDBTableIndexKey
+ *   key of index on field. shard is used only for rowkey index
+ */
+int RDBTableIndexKey (const RDBTableDes_t *tabledes, int fieldid, int shard, char *keybuf, size_t bufsize)
+{
+    const RDBFieldDes_t *fdes = &tabledes->fielddes[fieldid - 1];
+
+    int len = cstr_length(tabledes->table_rowkey, sizeof(tabledes->table_rowkey));
+
+    if (fdes->rowkey) {
+        // {redisdb::$tablespace:$tablename} => {redisdb::$tablespace:$tablename:$rowkey:$shard}
+        return snprintf_chkd_V1(keybuf, bufsize, "%.*s:$rowkey:%d}", len - 1, tabledes->table_rowkey, shard);
+    }
+
+    // {redisdb::$tablespace:$tablename} => {redisdb::$tablespace:$tablename:$field}
+    return snprintf_chkd_V1(keybuf, bufsize, "%.*s:%.*s}", len - 1, tabledes->table_rowkey, fdes->namelen, fdes->fieldname);
+}
+
+
+// value of the first rowkey field in rowkey: {$tablespace::$tablename:$value:...}
+static const char * RDBTableRowkeyFirstVal (const char *rowkey, size_t rowkeylen, int *vallen)
+{
+    const char *end = rowkey + rowkeylen;
+    const char *val = strstr(rowkey, "::");
+
+    if (val) {
+        val = memchr(val + 2, ':', end - val - 2);
+    }
+
+    if (val++) {
+        const char *p = val;
+
+        while (p < end && *p != ':' && *p != '}') {
+            p++;
+        }
+
+        *vallen = (int)(p - val);
+        return val;
+    }
+
+    *vallen = 0;
+    return NULL;
+}
+
+
+// score and member of index entry. returns length of member (freed by caller) or 0 if value is invalid
+static int RDBTableIndexEntry (const RDBFieldDes_t *fdes, const char *val, int vallen, const char *rowkey, size_t rowkeylen, char score[32], char **member)
+{
+    sb8 s8val;
+    ub8 u8val;
+    double dbval;
+
+    char *mbuf;
+    int mlen;
+
+    switch (fdes->fieldtype) {
+    case RDBVT_SB8:
+    case RDBVT_SB4:
+    case RDBVT_SB2:
+    case RDBVT_CHAR:
+        if (cstr_to_sb8(10, val, vallen, &s8val) <= 0) {
+            return 0;
+        }
+        snprintf_chkd_V1(score, 32, "%"PRId64, s8val);
+        break;
+
+    case RDBVT_UB8:
+    case RDBVT_UB4:
+    case RDBVT_UB2:
+    case RDBVT_BYTE:
+    case RDBVT_STAMP:
+        if (cstr_to_ub8(10, val, vallen, &u8val) <= 0) {
+            return 0;
+        }
+        snprintf_chkd_V1(score, 32, "%"PRIu64, u8val);
+        break;
+
+    case RDBVT_UB8X:
+    case RDBVT_UB4X:
+        if (cstr_to_ub8(16, val, vallen, &u8val) <= 0) {
+            return 0;
+        }
+        snprintf_chkd_V1(score, 32, "%"PRIu64, u8val);
+        break;
+
+    case RDBVT_FLT64:
+        if (cstr_to_dbl(val, vallen, &dbval) <= 0) {
+            return 0;
+        }
+        snprintf_chkd_V1(score, 32, "%.17g", dbval);
+        break;
+
+    case RDBVT_STR:
+        snprintf_chkd_V1(score, 32, "0");
+
+        if (fdes->rowkey) {
+            // rowkey itself is in lex order of the first rowkey field
+            break;
+        }
+
+        mlen = vallen + 1 + (int) rowkeylen;
+        mbuf = (char *) RDBMemAlloc(mlen + 1);
+
+        memcpy(mbuf, val, vallen);
+        memcpy(mbuf + vallen + 1, rowkey, rowkeylen);
+
+        *member = mbuf;
+        return mlen;
+
+    default:
+        return 0;
+    }
+
+    mbuf = (char *) RDBMemAlloc(rowkeylen + 1);
+    memcpy(mbuf, rowkey, rowkeylen);
+
+    *member = mbuf;
+    return (int) rowkeylen;
+}
+
+
+/**
+ * RDBTableIndexPlan
+ *   use index on the first indexed field with filters of:
+ *     numeric: EQUAL, or range by GREAT_THAN/EQUAL, LESS_THAN/EQUAL
+ *     STR: EQUAL, LEFT_LIKE
+ *   bounds are inclusive since filters always run on rows found.
+ */
+static int RDBTableIndexPlan (RDBTableFilter filter, const RDBTableDes_t *tabledes)
+{
+    int i, j, fieldid, indextype;
+
+    RDBFilterNode node, nodes;
+
+    // members of lex rowkey index start with: {$tablespace::$tablename:
+    char prefix[RDB_KEY_NAME_MAXLEN * 2 + 8];
+    int prefixlen;
+
+    for (i = 1; i <= tabledes->indexids[0]; i++) {
+        const RDBFieldDes_t *fdes;
+        int minlen = 0, maxlen = 0;
+
+        fieldid = tabledes->indexids[i];
+        fdes = &tabledes->fielddes[fieldid - 1];
+
+        indextype = RDBTableIndexType(fdes->fieldtype);
+        if (! indextype) {
+            continue;
+        }
+
+        if (fdes->rowkey) {
+            if (tabledes->rowkeyshards < 1) {
+                continue;
+            }
+
+            nodes = filter->rowkeyfilters[fdes->rowkey];
+            prefixlen = snprintf_chkd_V1(prefix, sizeof(prefix), "{%s::%s:", filter->sqlstmt->select.tablespace, filter->sqlstmt->select.tablename);
+        } else {
+            for (j = 1; j <= filter->getfieldids[0]; j++) {
+                if (filter->getfieldids[j] == fieldid) {
+                    break;
+                }
+            }
+
+            if (j > filter->getfieldids[0]) {
+                continue;
+            }
+
+            nodes = filter->fieldfilters[j];
+            prefixlen = 0;
+        }
+
+        for (node = nodes; node; node = node->next) {
+            if (node->null_dest) {
+                continue;
+            }
+
+            if (indextype == 1) {
+                double val;
+
+                if (node->val_dest == 3) {
+                    val = (double) node->sb8_dest;
+                } else if (node->val_dest == 1 || node->val_dest == 2) {
+                    val = (double) node->ub8_dest;
+                } else if (node->val_dest == 4) {
+                    val = node->dbl_dest;
+                } else {
+                    continue;
+                }
+
+                if (node->expr == RDBFIL_EQUAL) {
+                    minlen = snprintf_chkd_V1(filter->indexmin, sizeof(filter->indexmin), "%.17g", val);
+                    maxlen = snprintf_chkd_V1(filter->indexmax, sizeof(filter->indexmax), "%.17g", val);
+                    break;
+                }
+
+                if (! minlen && (node->expr == RDBFIL_GREAT_THAN || node->expr == RDBFIL_GREAT_EQUAL)) {
+                    minlen = snprintf_chkd_V1(filter->indexmin, sizeof(filter->indexmin), "%.17g", val);
+                } else if (! maxlen && (node->expr == RDBFIL_LESS_THAN || node->expr == RDBFIL_LESS_EQUAL)) {
+                    maxlen = snprintf_chkd_V1(filter->indexmax, sizeof(filter->indexmax), "%.17g", val);
+                }
+            } else if (node->destlen > 0 && node->destlen < RDB_KEY_VALUE_SIZE) {
+                if (node->expr == RDBFIL_EQUAL) {
+                    minlen = snprintf_chkd_V1(filter->indexmin, sizeof(filter->indexmin), "[%.*s%.*s", prefixlen, prefix, node->destlen, node->dest);
+                    maxlen = snprintf_chkd_V1(filter->indexmax, sizeof(filter->indexmax), "(%.*s%.*s", prefixlen, prefix, node->destlen, node->dest);
+
+                    if (! fdes->rowkey) {
+                        // [value\0 .. (value\1
+                        filter->indexmin[minlen++] = 0;
+                        filter->indexmax[maxlen++] = 1;
+                    } else if (filter->rowkeyids[0] == 1) {
+                        // [rowkey .. [rowkey
+                        filter->indexmin[minlen++] = '}';
+                        filter->indexmax[0] = '[';
+                        filter->indexmax[maxlen++] = '}';
+                    } else {
+                        // [prefix:value: .. (prefix:value;
+                        filter->indexmin[minlen++] = ':';
+                        filter->indexmax[maxlen++] = ';';
+                    }
+                    break;
+                }
+
+                if (node->expr == RDBFIL_LEFT_LIKE && (ub1) node->dest[node->destlen - 1] != 0xff) {
+                    // [left .. (left+1
+                    minlen = snprintf_chkd_V1(filter->indexmin, sizeof(filter->indexmin), "[%.*s%.*s", prefixlen, prefix, node->destlen, node->dest);
+                    maxlen = snprintf_chkd_V1(filter->indexmax, sizeof(filter->indexmax), "(%.*s%.*s", prefixlen, prefix, node->destlen, node->dest);
+
+                    filter->indexmax[maxlen - 1] += 1;
+                    break;
+                }
+            }
+        }
+
+        if (minlen || maxlen) {
+            if (! minlen) {
+                minlen = snprintf_chkd_V1(filter->indexmin, sizeof(filter->indexmin), "-inf");
+            }
+            if (! maxlen) {
+                maxlen = snprintf_chkd_V1(filter->indexmax, sizeof(filter->indexmax), "+inf");
+            }
+
+            filter->useindex = indextype;
+            filter->indexfieldid = fieldid;
+            filter->indexshards = (fdes->rowkey? tabledes->rowkeyshards : 1);
+            filter->indexminlen = minlen;
+            filter->indexmaxlen = maxlen;
+
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+
 RDBAPI_RESULT RDBTableScanFirst (RDBCtx ctx, RDBSQLStmt sqlstmt, RDBResultMap *outresultmap)
 {
     int i, j, n, fieldid, rowkeyid;
@@ -92,7 +396,7 @@ RDBAPI_RESULT RDBTableScanFirst (RDBCtx ctx, RDBSQLStmt sqlstmt, RDBResultMap *o
 
     *outresultmap = NULL;
 
-    if (RDBTableDescribe(ctx, sqlstmt->select.tablespace, sqlstmt->select.tablename, &tabledes) != RDBAPI_SUCCESS) {
+    if (RDBTableDescribeCached(ctx, sqlstmt->select.tablespace, sqlstmt->select.tablename, &tabledes) != RDBAPI_SUCCESS) {
         return RDBAPI_ERROR;
     }
 
@@ -111,6 +415,7 @@ RDBAPI_RESULT RDBTableScanFirst (RDBCtx ctx, RDBSQLStmt sqlstmt, RDBResultMap *o
             
             colnames[colindex] = tabledes.fielddes[i].fieldname;
             colnameslen[colindex] = tabledes.fielddes[i].namelen;
+            filter->colvaltypes[colindex] = tabledes.fielddes[i].fieldtype;
             colindex++;
         }
     }
@@ -177,13 +482,13 @@ RDBAPI_RESULT RDBTableScanFirst (RDBCtx ctx, RDBSQLStmt sqlstmt, RDBResultMap *o
                 return RDBAPI_ERR_BADARG;
             }
 
-            filter->rowkeyfilters[ rowkeyid ] = RDBFilterNodeAdd(filter->rowkeyfilters[ rowkeyid ], sqlstmt->select.fieldexprs[i], valtype, sqlstmt->select.fieldvals[i], sqlstmt->select.fieldvalslen[i]);
+            filter->rowkeyfilters[ rowkeyid ] = RDBFilterNodeAdd(&filter->arena, filter->rowkeyfilters[ rowkeyid ], sqlstmt->select.fieldexprs[i], valtype, sqlstmt->select.fieldvals[i], sqlstmt->select.fieldvalslen[i]);
         } else {
             n = filter->getfieldids[0];
             for (j = 1; j <= n; j++) {
                 if (filter->getfieldids[j] == fieldid) {
                     // found existed field
-                    filter->fieldfilters[j] = RDBFilterNodeAdd(filter->fieldfilters[j], sqlstmt->select.fieldexprs[i], valtype, sqlstmt->select.fieldvals[i], sqlstmt->select.fieldvalslen[i]);
+                    filter->fieldfilters[j] = RDBFilterNodeAdd(&filter->arena, filter->fieldfilters[j], sqlstmt->select.fieldexprs[i], valtype, sqlstmt->select.fieldvals[i], sqlstmt->select.fieldvalslen[i]);
                     fieldid = 0;
                     break;
                 }
@@ -192,11 +497,19 @@ RDBAPI_RESULT RDBTableScanFirst (RDBCtx ctx, RDBSQLStmt sqlstmt, RDBResultMap *o
                 // add new field at last
                 filter->getfieldids[0] = ++n;
                 filter->getfieldids[ n ] = fieldid;
-                filter->fieldfilters[ n ] = RDBFilterNodeAdd(filter->fieldfilters[ n ], sqlstmt->select.fieldexprs[i], valtype, sqlstmt->select.fieldvals[i], sqlstmt->select.fieldvalslen[i]);
+                filter->fieldfilters[ n ] = RDBFilterNodeAdd(&filter->arena, filter->fieldfilters[ n ], sqlstmt->select.fieldexprs[i], valtype, sqlstmt->select.fieldvals[i], sqlstmt->select.fieldvalslen[i]);
             }
         }
     }
 
+    if (tabledes.indexids[0]) {
+        // keep descriptor to maintain indexes on DELETE
+        filter->tabledes = (RDBTableDes_t *) RDBMemAlloc(sizeof(RDBTableDes_t));
+        memcpy(filter->tabledes, &tabledes, sizeof(tabledes));
+
+        RDBTableIndexPlan(filter, &tabledes);
+    }
+
     // build keypattern
     filter->patternprefixlen = snprintf_chkd_V1(filter->keypattern, sizeof(filter->keypattern), "{%s::%s", sqlstmt->select.tablespace, sqlstmt->select.tablename);
     offsz = filter->patternprefixlen++;
@@ -230,7 +543,8 @@ RDBAPI_RESULT RDBTableScanFirst (RDBCtx ctx, RDBSQLStmt sqlstmt, RDBResultMap *o
                 n = snprintf_chkd_V1(filter->keypattern + offsz, sizeof(filter->keypattern) - offsz, ":*%.*s*", rknode->destlen, rknode->dest);
                 break;
             }
-            if (n) {
+            if (n && ! filter->useindex) {
+                // rowkeys found by index are not matched by pattern
                 rknode->expr = RDBFIL_IGNORE;
             }
         }
@@ -245,6 +559,8 @@ RDBAPI_RESULT RDBTableScanFirst (RDBCtx ctx, RDBSQLStmt sqlstmt, RDBResultMap *o
 
     if (filter->use_hmget != filter->rowkeyids[0]) {
         filter->use_hmget = 0;
+    } else {
+        filter->useindex = 0;
     }
 
     if (offsz >= sizeof(filter->keypattern) || filter->keypattern[offsz - 1] != '}') {
@@ -265,6 +581,7 @@ RDBAPI_RESULT RDBTableScanFirst (RDBCtx ctx, RDBSQLStmt sqlstmt, RDBResultMap *o
             // only for result display
             colnames[colindex] = tabledes.fielddes[i].fieldname;
             colnameslen[colindex] = tabledes.fielddes[i].namelen;
+            filter->colvaltypes[colindex] = tabledes.fielddes[i].fieldtype;
             colindex++;
         }
     }
@@ -272,6 +589,16 @@ RDBAPI_RESULT RDBTableScanFirst (RDBCtx ctx, RDBSQLStmt sqlstmt, RDBResultMap *o
     filter->getfieldnames[RDBAPI_ARGV_MAXNUM] = 0;
     filter->getfieldnameslen[RDBAPI_ARGV_MAXNUM] = 0;
 
+    filter->sqlfunc = sqlstmt->sqlfunc;
+
+    // WHERE is compiled once here and run on every row
+    RDBTableFilterCompile(filter);
+
+    if (ctx->env->pushdown && ! filter->use_hmget && ! filter->useindex) {
+        // run fieldfilters on server if all of them can be pushed down
+        RDBTableFilterPushdown(filter);
+    }
+
     if (! sqlstmt->sqlfunc) {
         if (sqlstmt->select.limit == (ub8)(-1)) {
             LmtRows = RDB_TABLE_LIMIT_MAX;
@@ -290,6 +617,19 @@ RDBAPI_RESULT RDBTableScanFirst (RDBCtx ctx, RDBSQLStmt sqlstmt, RDBResultMap *o
                 printf(" %.*s", (int) filter->getfieldnameslen[j], filter->getfieldnames[j]);
             }
             printf("\n");
+        } else if (filter->useindex) {
+            char indexkey[RDB_KEY_NAME_MAXLEN * 4];
+            int indexkeylen = RDBTableIndexKey(&tabledes, filter->indexfieldid, 0, indexkey, sizeof(indexkey));
+
+            printf("$%s %.*s %.*s %.*s LIMIT %"PRIu64" %"PRIu64" (shards: %d)\n", (filter->useindex == 2? "ZRANGEBYLEX" : "ZRANGEBYSCORE"),
+                indexkeylen, indexkey, filter->indexminlen, filter->indexmin, filter->indexmaxlen, filter->indexmax,
+                sqlstmt->select.offset, sqlstmt->select.limit, filter->indexshards);
+        } else if (filter->pushdown) {
+            printf("$EVALSHA {scan} 0 %"PRIu64" %.*s %"PRIu64, sqlstmt->select.offset, filter->patternlen, filter->keypattern, sqlstmt->select.limit);
+            for (j = 0; j < filter->pushargc; j++) {
+                printf(" %.*s", (int) filter->pushargvlen[j], filter->pushargv[j]);
+            }
+            printf("\n");
         } else {
             printf("$SCAN %"PRIu64" MATCH %.*s COUNT %"PRIu64"\n", sqlstmt->select.offset, filter->patternlen, filter->keypattern, sqlstmt->select.limit);
         }
@@ -300,10 +640,10 @@ RDBAPI_RESULT RDBTableScanFirst (RDBCtx ctx, RDBSQLStmt sqlstmt, RDBResultMap *o
         char maptitle[RDB_KEY_VALUE_SIZE] = {0};
 
         if (filter->sqlstmt->stmt == RDBSQL_SELECT) {
-            if (! filter->sqlstmt->sqlfunc) {
+            if (! filter->sqlfunc) {
                 snprintf_chkd_V1(maptitle, sizeof(maptitle), "# SELECT on '%s':", filter->table);
             } else {
-                if (filter->sqlstmt->sqlfunc == RDBSQL_FUNC_COUNT) {
+                if (filter->sqlfunc == RDBSQL_FUNC_COUNT) {
                     snprintf_chkd_V1(maptitle, sizeof(maptitle), "# SELECT COUNT(*) on '%s':", filter->table);
 
                     if (RDBResultMapCreate(maptitle, (const char **)filter->sqlstmt->select.selectfields, filter->sqlstmt->select.selectfieldslen, 1, 0, &resultmap) == RDBAPI_SUCCESS) {
@@ -333,9 +673,12 @@ RDBAPI_RESULT RDBTableScanFirst (RDBCtx ctx, RDBSQLStmt sqlstmt, RDBResultMap *o
 
     resultmap->ctx = ctx;
     resultmap->filter = filter;
+    resultmap->arena = &filter->arena;
 
-    for (i = 0; i < RDBEnvNumNodes(ctx->env); i++) {
+    // including nodes may be appended to env later
+    for (i = 0; i < ctx->env->maxclusternodes; i++) {
         RDBResultNodeState(resultmap, i)->nodeindex = i;
+        RDBResultNodeState(resultmap, i)->readindex = -1;
     }
 
     *outresultmap = resultmap;
@@ -343,6 +686,47 @@ RDBAPI_RESULT RDBTableScanFirst (RDBCtx ctx, RDBSQLStmt sqlstmt, RDBResultMap *o
 }
 
 
+// node which SELECT scans a master from by read preference. chosen on first
+//   page and pinned since SCAN cursor is valid only on the node issued it.
+static RDBCtxNode RDBTableScanReadNode (RDBCtx ctx, RDBTableFilter filter, RDBTableCursor nodestate)
+{
+    if (filter->sqlstmt->stmt != RDBSQL_SELECT) {
+        return RDBCtxGetNode(ctx, (int) nodestate->nodeindex);
+    }
+
+    if (nodestate->readindex == -1) {
+        nodestate->readindex = RDBCtxNodeIndex(RDBCtxGetReadNode(ctx, (int) nodestate->nodeindex));
+    }
+
+    return RDBCtxGetNode(ctx, nodestate->readindex);
+}
+
+
+/**
+ * RDBTableScanNodeDown
+ *   returns 1 if node to scan is not connected and its circuit breaker is
+ *   open. a replica may still serve SELECT if read node not chosen yet.
+ */
+static int RDBTableScanNodeDown (RDBCtx ctx, RDBTableFilter filter, RDBTableCursor nodestate)
+{
+    int index = nodestate->readindex;
+
+    if (index == -1) {
+        if (filter->sqlstmt->stmt == RDBSQL_SELECT && ctx->readpref != RDBREAD_MASTER) {
+            return 0;
+        }
+
+        index = (int) nodestate->nodeindex;
+    }
+
+    if (RDBCtxNodeIsOpen(RDBCtxGetNode(ctx, index))) {
+        return 0;
+    }
+
+    return (RDBEnvNodeIsHealthy(RDBEnvGetNode(ctx->env, index))? 0 : 1);
+}
+
+
 // internal api only on single node
 //
 RDBAPI_RESULT RDBTableScanOnNode (RDBCtxNode ctxnode, RDBTableCursor nodestate, const char *pattern, size_t patternlen, ub8 maxlimit, redisReply **outReply)
@@ -429,135 +813,1282 @@ RDBAPI_RESULT RDBTableScanOnNode (RDBCtxNode ctxnode, RDBTableCursor nodestate,
 
 
 /**
- * RDBTableScanNext
- *
- * returns:
- *   = 0: finished
- *   > 0: numrows
+ * scan filter script
+ *   SCAN a page on node, HMGET fields of each key and run the filters
+ *   compiled by RDBTableFilterPushdown. only keys accepted and their
+ *   selected fields are returned:
  *
+ *     {cursor, {key, ...}, {{val, ...}, ...}}
  *
- * | MaxRows  |                        LmtRows
- * O----------+---.------+----------+---V====--+---...-->
- *                |                     |    |
- *             lastOffs              OffRows |
- *                |<-------- ReqRows ------->|
+ *   string compare is the same as cstr_compare_len: shorter is less.
  */
-ub8 RDBTableScanNext (RDBResultMap resultmap, ub8 OffRows, ub8 limit)
+static const char RDBTableScanScript[] =
+    "local r = redis.call('SCAN', ARGV[1], 'MATCH', ARGV[2], 'COUNT', ARGV[3])\n"
+    "local nget, nsel = tonumber(ARGV[4]), tonumber(ARGV[5])\n"
+    "local fields, keys, rows = {}, {}, {}\n"
+    "for i = 1, nget do fields[i] = ARGV[5 + i] end\n"
+    "for _, key in ipairs(r[2]) do\n"
+    "  local vals = redis.pcall('HMGET', key, unpack(fields))\n"
+    "  local ok = type(vals) == 'table' and vals.err == nil\n"
+    "  local a = 6 + nget\n"
+    "  while ok and a <= #ARGV do\n"
+    "    local v, op, kind, d = vals[tonumber(ARGV[a])], ARGV[a + 1], ARGV[a + 2], ARGV[a + 3]\n"
+    "    local c = nil\n"
+    "    if kind == 'z' then\n"
+    "      ok = (op == 'eq') == (v == false)\n"
+    "    elseif kind == 'n' then\n"
+    "      local x, y = tonumber(v), tonumber(d)\n"
+    "      if x == nil then ok = false else c = (x > y and 1) or (x < y and -1) or 0 end\n"
+    "    elseif op == 'll' then\n"
+    "      ok = v ~= false and string.sub(v, 1, #d) == d\n"
+    "    elseif op == 'rl' then\n"
+    "      ok = v ~= false and #d <= #v and string.sub(v, #v - #d + 1) == d\n"
+    "    elseif op == 'lk' then\n"
+    "      ok = v ~= false and string.find(v, d, 1, true) ~= nil\n"
+    "    elseif v == false then\n"
+    "      c = -1\n"
+    "    elseif #v ~= #d then\n"
+    "      c = (#v > #d and 1) or -1\n"
+    "    else\n"
+    "      local i = 1\n"
+    "      while i <= #v and string.byte(v, i) == string.byte(d, i) do i = i + 1 end\n"
+    "      c = (i > #v and 0) or (string.byte(v, i) > string.byte(d, i) and 1) or -1\n"
+    "    end\n"
+    "    if c ~= nil then\n"
+    "      if op == 'eq' then ok = c == 0\n"
+    "      elseif op == 'ne' then ok = c ~= 0\n"
+    "      elseif op == 'gt' then ok = c > 0\n"
+    "      elseif op == 'lt' then ok = c < 0\n"
+    "      elseif op == 'ge' then ok = c >= 0\n"
+    "      else ok = c <= 0 end\n"
+    "    end\n"
+    "    a = a + 4\n"
+    "  end\n"
+    "  if ok then\n"
+    "    local sel = {}\n"
+    "    for i = 1, nsel do sel[i] = vals[i] end\n"
+    "    keys[#keys + 1] = key\n"
+    "    rows[#rows + 1] = sel\n"
+    "  end\n"
+    "end\n"
+    "return {r[1], keys, rows}\n";
+
+
+// load scan script on node and save its sha1 into env
+static RDBAPI_RESULT RDBTableScanScriptLoad (RDBCtxNode ctxnode, char sha[41])
+{
+    redisReply *reply = NULL;
+
+    RDBEnv env = ctxnode->ctx->env;
+
+    const char *argv[] = {"script", "load", RDBTableScanScript};
+    size_t argvlen[] = {6, 4, sizeof(RDBTableScanScript) - 1};
+
+    if (RedisExecArgvOnNode(ctxnode, 3, argv, argvlen, &reply) != RDBAPI_SUCCESS) {
+        return RDBAPI_ERROR;
+    }
+
+    if (reply->type != REDIS_REPLY_STRING || reply->len != 40) {
+        snprintf_chkd_V1(ctxnode->ctx->errmsg, sizeof(ctxnode->ctx->errmsg), "RDBAPI_ERROR: script load reply type(%d).", reply->type);
+        RedisFreeReplyObject(&reply);
+        return RDBAPI_ERROR;
+    }
+
+    memcpy(sha, reply->str, 40);
+    sha[40] = 0;
+
+    RedisFreeReplyObject(&reply);
+
+    threadlock_lock(&env->thrlock);
+    memcpy(env->scanscriptsha, sha, 41);
+    threadlock_unlock(&env->thrlock);
+
+    return RDBAPI_SUCCESS;
+}
+
+
+/**
+ * RDBTableScanPushdownOnNode
+ *   scan a page on single node with fieldfilters run by scan script.
+ *   returns the same as RDBTableScanOnNode, with columns of rows in
+ *   outCols. nodestate->offset counts rows accepted rather than scanned.
+ */
+static RDBAPI_RESULT RDBTableScanPushdownOnNode (RDBCtxNode ctxnode, RDBTableCursor nodestate, RDBTableFilter filter, ub8 maxlimit, redisReply **outRows, redisReply **outCols)
 {
     RDBAPI_RESULT result;
-    int  nodeindex, colindex;
 
-    redisReply     *replyRows;
-    redisReply     *replyCols;
-    redisReply     *replyCol;
+    int j, argc = 0;
 
-    const char *rkvals[RDBAPI_KEYS_MAXNUM + 1] = {0};
-    int rkvalslen[RDBAPI_KEYS_MAXNUM + 1] = {0};
+    char sha[41];
+    char cursor[22];
+    char count[22];
 
-    ub8 LastOffs = RDB_ERROR_OFFSET;
+    const char *argv[RDBAPI_ARGV_MAXNUM + 16];
+    size_t argvlen[RDBAPI_ARGV_MAXNUM + 16];
 
-    int rowkeynum = resultmap->filter->rowkeyids[0];
-    int fieldsnum = resultmap->filter->getfieldids[0];
+    const char **pargv = argv;
+    size_t *pargvlen = argvlen;
 
-    RDBCtx ctx = resultmap->ctx;
+    redisReply *reply = NULL;
+    RDBEnv env = ctxnode->ctx->env;
 
-    if (resultmap->filter->use_hmget) {
-        if (RedisExistsKey(ctx, resultmap->filter->keypattern, resultmap->filter->patternlen) == RDBAPI_TRUE) {
-            // use HMGET rather than SCAN
-            if (RedisHMGetLen(ctx, resultmap->filter->keypattern, resultmap->filter->patternlen,
-                    resultmap->filter->getfieldnames, resultmap->filter->getfieldnameslen, &replyCols) == RDBAPI_SUCCESS) {
+    *outRows = NULL;
+    *outCols = NULL;
 
-                // filter fields by fieldfilters
-                if (RDBTableFilterReplyCols(resultmap->filter, replyCols) == fieldsnum) {
+    if (6 + filter->pushargc > sizeof(argv)/sizeof(argv[0])) {
+        pargv = (const char **) RDBMemAlloc((sizeof(char *) + sizeof(size_t)) * (6 + filter->pushargc));
+        pargvlen = (size_t *) &pargv[6 + filter->pushargc];
+    }
 
-                    // split rowkey str into vals without rowkeyfilters
-                    if (RDBTableFilterRowkeyVals(NULL, resultmap->filter->patternprefixlen, resultmap->filter->keypattern, resultmap->filter->patternlen, rkvals, rkvalslen) == rowkeynum) {
-                        RDBRow row = NULL;
+    threadlock_lock(&env->thrlock);
+    memcpy(sha, env->scanscriptsha, sizeof(sha));
+    threadlock_unlock(&env->thrlock);
 
-                        if (RDBRowNew(resultmap, resultmap->filter->keypattern, resultmap->filter->patternlen, &row) == RDBAPI_SUCCESS) {
-                            if (RDBResultMapInsertRow(resultmap, row) == RDBAPI_SUCCESS) {
-                                // set rowkey fields
-                                for (colindex = 0; colindex < rowkeynum; colindex++) {
-                                    RDBCellSetString(RDBRowCell(row, colindex), rkvals[colindex], rkvalslen[colindex]);
-                                }
+    if (! *sha && RDBTableScanScriptLoad(ctxnode, sha) != RDBAPI_SUCCESS) {
+        result = RDBAPI_ERROR;
+        goto exit_free;
+    }
 
-                                // set attr fields
-                                for (colindex = 0; colindex < resultmap->filter->selfieldnum; colindex++) {
-                                    replyCol = replyCols->element[colindex];
-                                    replyCols->element[colindex] = NULL;
-                                    RDBCellSetReply(RDBRowCell(row, rowkeynum + colindex), replyCol);
-                                }
+    // evalsha sha 0 cursor pattern count numget numsel fields... filters...
+    pargv[argc] = "evalsha";
+    pargvlen[argc++] = 7;
 
-                                LastOffs = RDBResultMapGetOffset(resultmap);
-                            } else {
-                                // insert failed
-                                RDBRowFree(row);
-                            }
-                        }
-                    }
-                }
+    pargv[argc] = sha;
+    pargvlen[argc++] = 40;
 
-                RedisFreeReplyObject(&replyCols);
-            }
-        }
-    } else {
-        RDBEnvNode  envnode;
-        RDBCtxNode  ctxnode;
-        RDBTableCursor  nodestate;
+    pargv[argc] = "0";
+    pargvlen[argc++] = 1;
 
-        int numMasters = 0;
-        int finMasters = 0;
+    pargv[argc] = cursor;
+    pargvlen[argc++] = snprintf_chkd_V1(cursor, sizeof(cursor), "%"PRIu64, nodestate->cursor);
 
-        // number of rows now to fetch
-        sb8 CurRows;
+    pargv[argc] = filter->keypattern;
+    pargvlen[argc++] = filter->patternlen;
 
-        // number of rows we fetched
-        ub8 NumRows = 0;
+    pargv[argc] = count;
+    pargvlen[argc++] = snprintf_chkd_V1(count, sizeof(count), "%"PRIu64, maxlimit);
 
-        // number of rows returned
-        ub8 LmtRows = limit;
+    for (j = 0; j < filter->pushargc; j++) {
+        pargv[argc] = filter->pushargv[j];
+        pargvlen[argc++] = filter->pushargvlen[j];
+    }
 
-        // validate limit rows
-        if (limit == (ub8)(-1)) {
-            LmtRows = RDB_TABLE_LIMIT_MAX;
-        } else if (limit < RDB_TABLE_LIMIT_MIN) {
-            LmtRows = RDB_TABLE_LIMIT_MIN;
-        }
+    result = RedisExecArgvOnNode(ctxnode, argc, pargv, pargvlen, &reply);
 
-        // get rows from all nodes
-        LastOffs = RDBResultMapGetOffset(resultmap);
-        if (LastOffs >= OffRows + LmtRows) {
-            return LastOffs;
+    if (result != RDBAPI_SUCCESS && strstr(ctxnode->ctx->errmsg, "NOSCRIPT")) {
+        // script flushed or node restarted: load again and retry once
+        if (RDBTableScanScriptLoad(ctxnode, sha) == RDBAPI_SUCCESS) {
+            result = RedisExecArgvOnNode(ctxnode, argc, pargv, pargvlen, &reply);
         }
+    }
 
-        // get number of finished nodes
-        for (nodeindex = 0; nodeindex < RDBEnvNumNodes(ctx->env); nodeindex++) {
-            envnode = RDBEnvGetNode(ctx->env, nodeindex);
+    if (result != RDBAPI_SUCCESS) {
+        result = RDBAPI_ERROR;
+        goto exit_free;
+    }
 
-            if (RDBEnvNodeGetMaster(envnode, NULL) == RDBAPI_TRUE) {
-                numMasters++;
+    if (reply->type == REDIS_REPLY_ARRAY && reply->elements == 3 &&
+        reply->element[0]->type == REDIS_REPLY_STRING &&
+        reply->element[1]->type == REDIS_REPLY_ARRAY &&
+        reply->element[2]->type == REDIS_REPLY_ARRAY &&
+        reply->element[1]->elements == reply->element[2]->elements) {
 
-                nodestate = RDBResultNodeState(resultmap, nodeindex);
-                if (nodestate->finished) {
-                    finMasters++;
-                }
-            }
+        nodestate->cursor = strtoull(reply->element[0]->str, 0, 10);
+
+        if (! nodestate->cursor) {
+            nodestate->finished = 1;
         }
 
-        if (numMasters == finMasters) {
-            return RDB_ERROR_OFFSET;
+        if (reply->element[1]->elements == 0) {
+            // no rows accepted in page, expect next
+            RedisFreeReplyObject(&reply);
+            result = RDBAPI_CONTINUE;
+            goto exit_free;
         }
 
-        nodeindex = 0;
-        while (NumRows < LmtRows && nodeindex < RDBEnvNumNodes(ctx->env)) {
-            envnode = RDBEnvGetNode(ctx->env, nodeindex);
+        nodestate->offset += reply->element[1]->elements;
 
-            // scan only on master node
-            if (RDBEnvNodeGetMaster(envnode, NULL) == RDBAPI_TRUE) {
-                ctxnode = RDBCtxGetNode(ctx, nodeindex);
-                ub8 SaveOffs = LastOffs;
+        *outRows = reply->element[1];
+        *outCols = reply->element[2];
 
-                nodestate = RDBResultNodeState(resultmap, nodeindex);
+        reply->element[1] = NULL;
+        reply->element[2] = NULL;
+        reply->elements = 1;
+
+        RedisFreeReplyObject(&reply);
+
+        result = RDBAPI_SUCCESS;
+    } else {
+        snprintf_chkd_V1(ctxnode->ctx->errmsg, sizeof(ctxnode->ctx->errmsg), "RDBAPI_ERROR: reply type(%d).", reply->type);
+        RedisFreeReplyObject(&reply);
+        result = RDBAPI_ERROR;
+    }
+
+exit_free:
+    if (pargv != argv) {
+        RDBMemFree(pargv);
+    }
+
+    return result;
+}
+
+
+/**
+ * RDBTableFetchRowsOnNode
+ *   filter rowkeys of a SCAN page and pipeline HMGET of accepted rows to the
+ *   node the page scanned from. so a page costs 1 RTT rather than 1 per row.
+ *
+ *   rowsok[i] = 1: row i accepted by rowkeyfilters
+ *   rowscols[i]: HMGET reply for accepted row i if it has fields to get
+ *
+ *   replyRowsCols is columns of rows returned by scan script (pushdown),
+ *   which are taken into rowscols without HMGET.
+ */
+static void RDBTableFetchRowsOnNode (RDBCtxNode ctxnode, RDBTableFilter filter, redisReply *replyRows, redisReply *replyRowsCols, size_t start, ub1 *rowsok, redisReply **rowscols)
+{
+    size_t i;
+    int j;
+
+    const char *rkvals[RDBAPI_KEYS_MAXNUM + 1];
+    int rkvalslen[RDBAPI_KEYS_MAXNUM + 1];
+
+    const char *argv[RDBAPI_ARGV_MAXNUM + 4];
+    size_t argvlen[RDBAPI_ARGV_MAXNUM + 4];
+
+    int rowkeynum = filter->rowkeyids[0];
+    int fieldsnum = filter->getfieldids[0];
+
+    if (replyRowsCols) {
+        for (i = start; i < replyRows->elements; i++) {
+            redisReply *replyRowkey = replyRows->element[i];
+
+            rowsok[i] = 0;
+            rowscols[i] = NULL;
+
+            if (replyRowkey && replyRowkey->type == REDIS_REPLY_STRING && replyRowkey->len) {
+                if (RDBTableFilterRowkeyVals(filter, filter->patternprefixlen, replyRowkey->str, (int)replyRowkey->len, rkvals, rkvalslen) == rowkeynum) {
+                    rowsok[i] = 1;
+
+                    rowscols[i] = replyRowsCols->element[i];
+                    replyRowsCols->element[i] = NULL;
+                }
+            }
+        }
+
+        return;
+    }
+
+    argv[0] = "hmget";
+    argvlen[0] = 5;
+
+    for (j = 0; j < fieldsnum; j++) {
+        argv[j + 2] = filter->getfieldnames[j];
+        argvlen[j + 2] = filter->getfieldnameslen[j];
+    }
+
+    for (i = start; i < replyRows->elements; i++) {
+        redisReply *replyRowkey = replyRows->element[i];
+
+        // 0: rejected; 1: accepted; 2: accepted and hmget appended
+        rowsok[i] = 0;
+
+        if (replyRowkey && replyRowkey->type == REDIS_REPLY_STRING && replyRowkey->len) {
+            // split rowkey str into vals with rowkeyfilters
+            if (RDBTableFilterRowkeyVals(filter, filter->patternprefixlen, replyRowkey->str, (int)replyRowkey->len, rkvals, rkvalslen) == rowkeynum) {
+                rowsok[i] = 1;
+
+                if (fieldsnum) {
+                    argv[1] = replyRowkey->str;
+                    argvlen[1] = replyRowkey->len;
+
+                    if (RedisAppendArgvOnNode(ctxnode, fieldsnum + 2, argv, argvlen) == RDBAPI_SUCCESS) {
+                        rowsok[i] = 2;
+                    }
+                }
+            }
+        }
+    }
+
+    for (i = start; i < replyRows->elements; i++) {
+        redisReply *replyRowkey = replyRows->element[i];
+        redisReply *replyCols = NULL;
+
+        if (rowsok[i] == 2) {
+            // all appended replies must be read in order
+            if (RedisGetReplyOnNode(ctxnode, &replyCols) == RDBAPI_SUCCESS) {
+                if (replyCols->type != REDIS_REPLY_ARRAY || replyCols->elements != (size_t) fieldsnum) {
+                    RedisFreeReplyObject(&replyCols);
+                }
+            }
+        }
+
+        if (rowsok[i] && fieldsnum && ! replyCols) {
+            // connection broken or key moved: get row by slot routing
+            RedisHMGetLen(ctxnode->ctx, replyRowkey->str, replyRowkey->len, filter->getfieldnames, filter->getfieldnameslen, &replyCols);
+        }
+
+        rowscols[i] = replyCols;
+    }
+}
+
+
+/**
+ * parallel scan
+ *
+ *   one worker thread per master with its own RDBCtx (connections) and
+ *   cursor. rows passed filters are merged into resultmap under lock
+ *   where OFFSET/LIMIT applied. so a query costs max-node time rather than
+ *   sum-node time.
+ */
+typedef struct _RDBScanMerge_t
+{
+    thread_lock_t lock;
+
+    RDBResultMap resultmap;
+
+    // OFFSET and LIMIT on rows passed filters
+    ub8 offset;
+    ub8 limit;
+
+    // rows passed filters
+    ub8 matched;
+
+    // rows merged into resultmap
+    ub8 merged;
+
+    // total rows of COUNT(*)
+    ub8 count;
+
+    // stop all workers if limit reached or error
+    volatile int stopped;
+} RDBScanMerge_t, *RDBScanMerge;
+
+
+typedef struct _RDBScanWorker_t
+{
+    rdbthread_t thread;
+
+    RDBScanMerge merge;
+
+    // private ctx for this worker
+    RDBCtx ctx;
+
+    int nodeindex;
+
+    // 0: run in current thread
+    int threaded;
+
+    // rows carved by this worker
+    mem_arena_t arena;
+
+    RDBAPI_RESULT result;
+} RDBScanWorker_t, *RDBScanWorker;
+
+
+// merge a row into resultmap. returns 1 if merged
+static int RDBScanMergeRow (RDBScanMerge merge, RDBRow row)
+{
+    int merged = 0;
+
+    threadlock_lock(&merge->lock);
+
+    if (! merge->stopped) {
+        if (merge->matched++ >= merge->offset) {
+            if (RDBResultMapInsertRow(merge->resultmap, row) == RDBAPI_SUCCESS) {
+                merged = 1;
+
+                if (++merge->merged >= merge->limit) {
+                    merge->stopped = 1;
+                }
+            }
+        }
+    }
+
+    threadlock_unlock(&merge->lock);
+
+    return merged;
+}
+
+
+// delete rows merged from a page of worker by UNLINK grouped by slot
+static void RDBScanDeleteRows (RDBScanWorker worker, RDBRow *rows, int numrows)
+{
+    int i, numdeleted = 0;
+
+    RDBTableDes_t *tabledes = worker->merge->resultmap->filter->tabledes;
+
+    const char **keys = (const char **) RDBMemAlloc(sizeof(char *) * numrows);
+    size_t *keyslen = (size_t *) RDBMemAlloc(sizeof(size_t) * numrows);
+    int *stats = (int *) RDBMemAlloc(sizeof(int) * numrows);
+
+    redisReply **oldVals = NULL;
+
+    for (i = 0; i < numrows; i++) {
+        keys[i] = rows[i]->key;
+        keyslen[i] = rows[i]->keylen;
+    }
+
+    if (tabledes && tabledes->indexids[0]) {
+        // index values of rows to remove from indexes, pipelined per node
+        oldVals = (redisReply **) RDBMemAlloc(sizeof(redisReply *) * numrows);
+
+        RDBTableIndexGetValsRows(worker->ctx, tabledes, numrows, keys, keyslen, oldVals, NULL);
+    }
+
+    RedisUnlinkKeys(worker->ctx, keys, keyslen, numrows, stats);
+
+    for (i = 0; i < numrows; i++) {
+        // key with unknown outcome is gone anyway: taken as deleted
+        int deleted = (stats[i] == RDBAPI_KEY_DELETED || stats[i] == RDBAPI_KEY_UNKNOWN);
+
+        if (oldVals && deleted) {
+            // rows deleted are moved ahead for index update
+            keys[numdeleted] = keys[i];
+            keyslen[numdeleted] = keyslen[i];
+            oldVals[numdeleted++] = oldVals[i];
+        } else if (oldVals) {
+            RedisFreeReplyObject(&oldVals[i]);
+        }
+
+        if (! deleted) {
+            // remove row not deleted from result
+            threadlock_lock(&worker->merge->lock);
+            RDBResultMapDeleteOne(worker->merge->resultmap, rows[i]);
+            threadlock_unlock(&worker->merge->lock);
+        }
+    }
+
+    if (oldVals) {
+        RDBTableIndexUpdateRows(worker->ctx, tabledes, numdeleted, keys, keyslen, oldVals, 1);
+
+        RedisFreeReplyObjects(oldVals, numdeleted);
+        RDBMemFree(oldVals);
+    }
+
+    RDBMemFree(stats);
+    RDBMemFree(keyslen);
+    RDBMemFree(keys);
+}
+
+
+static RDBTHREAD_PROC(RDBTableScanWorker, arg)
+{
+    RDBAPI_RESULT result;
+    int colindex;
+    size_t i;
+
+    redisReply *replyRows;
+    redisReply *replyRowsCols = NULL;
+    redisReply *replyCols;
+
+    const char *rkvals[RDBAPI_KEYS_MAXNUM + 1] = {0};
+    int rkvalslen[RDBAPI_KEYS_MAXNUM + 1] = {0};
+
+    RDBScanWorker worker = (RDBScanWorker) arg;
+    RDBScanMerge merge = worker->merge;
+    RDBTableFilter filter = merge->resultmap->filter;
+
+    // rows of worker are carved from its own arena merged after join
+    mem_arena_t *arena = (merge->resultmap->arena? &worker->arena : NULL);
+
+    RDBTableCursor nodestate = RDBResultNodeState(merge->resultmap, worker->nodeindex);
+    RDBCtxNode ctxnode = RDBTableScanReadNode(worker->ctx, filter, nodestate);
+
+    int rowkeynum = filter->rowkeyids[0];
+    int fieldsnum = filter->getfieldids[0];
+    int sqlfunc = filter->sqlfunc;
+    int stmt = filter->sqlstmt->stmt;
+
+    ub8 count = 0;
+
+    // rows per SCAN page
+    ub8 maxlimit = RDB_TABLE_LIMIT_MAX;
+    if (! sqlfunc && merge->offset + merge->limit < maxlimit) {
+        maxlimit = merge->offset + merge->limit;
+    }
+
+    worker->result = RDBAPI_SUCCESS;
+
+    while (! nodestate->finished && ! merge->stopped) {
+        ub1 *rowsok;
+        redisReply **rowscols;
+
+        RDBRow *rows = NULL;
+        int numrows = 0;
+
+        if (filter->pushdown) {
+            result = RDBTableScanPushdownOnNode(ctxnode, nodestate, filter, maxlimit, &replyRows, &replyRowsCols);
+        } else {
+            result = RDBTableScanOnNode(ctxnode, nodestate, filter->keypattern, filter->patternlen, maxlimit, &replyRows);
+        }
+
+        if (result != RDBAPI_SUCCESS) {
+            if (result == RDBAPI_CONTINUE && ! *worker->ctx->errmsg) {
+                // empty page
+                continue;
+            }
+
+            worker->result = RDBAPI_ERROR;
+            merge->stopped = 1;
+            break;
+        }
+
+        rowsok = (ub1 *) RDBMemAlloc(sizeof(ub1) * replyRows->elements);
+        rowscols = (redisReply **) RDBMemAlloc(sizeof(redisReply *) * replyRows->elements);
+
+        if (stmt == RDBSQL_DELETE) {
+            rows = (RDBRow *) RDBMemAlloc(sizeof(RDBRow) * replyRows->elements);
+        }
+
+        RDBTableFetchRowsOnNode(ctxnode, filter, replyRows, replyRowsCols, 0, rowsok, rowscols);
+
+        for (i = 0; i < replyRows->elements; i++) {
+            redisReply *replyRowkey = replyRows->element[i];
+            RDBRow row = NULL;
+
+            replyCols = rowscols[i];
+            rowscols[i] = NULL;
+
+            if (! rowsok[i] || merge->stopped) {
+                RedisFreeReplyObject(&replyCols);
+                continue;
+            }
+
+            if (fieldsnum) {
+                if (! replyCols || RDBTableFilterReplyCols(filter, replyCols) != fieldsnum) {
+                    // rejected by WHERE
+                    RedisFreeReplyObject(&replyCols);
+                    continue;
+                }
+            }
+
+            if (sqlfunc == RDBSQL_FUNC_COUNT) {
+                count++;
+                RedisFreeReplyObject(&replyCols);
+                continue;
+            }
+
+            if (RDBRowNewOnReply(merge->resultmap, arena, replyRowkey, replyRowkey->str, (int) replyRowkey->len, &row) == RDBAPI_SUCCESS) {
+                // rowkey reply is owned by row now
+                replyRows->element[i] = NULL;
+
+                // split rowkey str into vals (already filtered)
+                RDBTableFilterRowkeyVals(NULL, filter->patternprefixlen, replyRowkey->str, (int)replyRowkey->len, rkvals, rkvalslen);
+
+                for (colindex = 0; colindex < rowkeynum; colindex++) {
+                    RDBCellSetSlice(RDBRowCell(row, colindex), rkvals[colindex], rkvalslen[colindex]);
+                }
+
+                for (colindex = 0; replyCols && colindex < filter->selfieldnum; colindex++) {
+                    if (RDBCellSetReply(RDBRowCell(row, rowkeynum + colindex), replyCols->element[colindex])) {
+                        replyCols->element[colindex] = NULL;
+                    }
+                }
+
+                if (RDBScanMergeRow(merge, row)) {
+                    if (rows) {
+                        rows[numrows++] = row;
+                    }
+                } else {
+                    RDBRowFree(row);
+                }
+            }
+
+            RedisFreeReplyObject(&replyCols);
+        }
+
+        if (numrows) {
+            RDBScanDeleteRows(worker, rows, numrows);
+        }
+
+        RDBMemFree(rows);
+        RDBMemFree(rowscols);
+        RDBMemFree(rowsok);
+
+        RedisFreeReplyObject(&replyRowsCols);
+        RedisFreeReplyObject(&replyRows);
+    }
+
+    if (count) {
+        threadlock_lock(&merge->lock);
+        merge->count += count;
+        threadlock_unlock(&merge->lock);
+    }
+
+    RDBTHREAD_RETURN;
+}
+
+
+static void RDBTableScanWorkerInit (RDBScanWorker worker, RDBScanMerge merge, RDBCtx ctx, int nodeindex)
+{
+    bzero(worker, sizeof(*worker));
+
+    worker->merge = merge;
+    worker->ctx = RDBCtxNew(ctx->env);
+    worker->ctx->readpref = ctx->readpref;
+    worker->nodeindex = nodeindex;
+
+    mem_arena_init(&worker->arena, RDB_QUERY_ARENA_CHUNK);
+}
+
+
+/**
+ * RDBTableScanParallel
+ *   scan all masters in parallel. OffRows and LmtRows apply on rows passed
+ *   filters. all rows required are fetched in one call.
+ */
+static ub8 RDBTableScanParallel (RDBResultMap resultmap, ub8 OffRows, ub8 LmtRows)
+{
+    int nodeindex, numworkers = 0, numdeferred = 0;
+
+    RDBScanMerge_t merge = {0};
+    RDBScanWorker_t workers[RDB_CLUSTER_NODES_MAX];
+
+    int deferred[RDB_CLUSTER_NODES_MAX];
+
+    RDBCtx ctx = resultmap->ctx;
+    RDBTableFilter filter = resultmap->filter;
+
+    threadlock_init(&merge.lock);
+
+    merge.resultmap = resultmap;
+    merge.offset = OffRows;
+    merge.limit = LmtRows;
+
+    if (filter->sqlfunc == RDBSQL_FUNC_COUNT) {
+        merge.offset = 0;
+        merge.limit = (ub8) SB8MAXVAL;
+    }
+
+    for (nodeindex = 0; nodeindex < ctx->topology->numnodes; nodeindex++) {
+        if (RDBCtxNodeIsMaster(ctx, nodeindex) && ! RDBResultNodeState(resultmap, nodeindex)->finished) {
+            RDBScanWorker worker;
+
+            if (RDBTableScanNodeDown(ctx, filter, RDBResultNodeState(resultmap, nodeindex))) {
+                // no thread is held by node down: scan it after others started
+                deferred[numdeferred++] = nodeindex;
+                continue;
+            }
+
+            worker = &workers[numworkers++];
+
+            RDBTableScanWorkerInit(worker, &merge, ctx, nodeindex);
+
+            if (rdbthread_create(&worker->thread, RDBTableScanWorker, worker) == 0) {
+                worker->threaded = 1;
+            } else {
+                // run in current thread if failed to create thread
+                RDBTableScanWorker(worker);
+            }
+        }
+    }
+
+    for (nodeindex = 0; nodeindex < numdeferred; nodeindex++) {
+        RDBScanWorker worker = &workers[numworkers++];
+
+        RDBTableScanWorkerInit(worker, &merge, ctx, deferred[nodeindex]);
+
+        // in current thread: fails fast if circuit still open
+        RDBTableScanWorker(worker);
+    }
+
+    for (nodeindex = 0; nodeindex < numworkers; nodeindex++) {
+        RDBScanWorker worker = &workers[nodeindex];
+
+        if (worker->threaded) {
+            rdbthread_join(worker->thread);
+        }
+
+        if (worker->result != RDBAPI_SUCCESS) {
+            snprintf_chkd_V1(ctx->errmsg, sizeof(ctx->errmsg), "RDBAPI_ERROR: scan node(%d) failed: %s", worker->nodeindex, worker->ctx->errmsg);
+            merge.stopped = -1;
+        }
+
+        // finish scan on node: all rows required are fetched in one call
+        RDBResultNodeState(resultmap, worker->nodeindex)->finished = 1;
+
+        // rows of worker are freed with result map
+        mem_arena_merge(&filter->arena, &worker->arena);
+
+        RDBCtxFree(worker->ctx);
+    }
+
+    threadlock_destroy(&merge.lock);
+
+    if (filter->sqlstmt->stmt == RDBSQL_DELETE) {
+        filter->scandeleted = 1;
+    }
+
+    if (merge.stopped == -1) {
+        return RDB_ERROR_OFFSET;
+    }
+
+    if (filter->sqlfunc == RDBSQL_FUNC_COUNT) {
+        RDBRow row = RDBRowIterGetRow(RDBResultMapFirstRow(resultmap));
+        RDBCell cell = RDBRowCell(row, 0);
+
+        RDBCellSetInteger(cell, RDBCellGetInteger(cell) + (sb8) merge.count);
+        return merge.count;
+    }
+
+    return OffRows + merge.merged;
+}
+
+
+// filter rowkeys found by index and get fields of rows in pipeline grouped by node
+static void RDBTableFetchIndexRows (RDBCtx ctx, RDBTableFilter filter, const char **rowkeys, const size_t *rowkeyslen, size_t numrows, ub1 *rowsok, redisReply **rowscols)
+{
+    size_t i;
+    int j, nodeindex;
+
+    const char *rkvals[RDBAPI_KEYS_MAXNUM + 1];
+    int rkvalslen[RDBAPI_KEYS_MAXNUM + 1];
+
+    const char *argv[RDBAPI_ARGV_MAXNUM + 4];
+    size_t argvlen[RDBAPI_ARGV_MAXNUM + 4];
+
+    int rowkeynum = filter->rowkeyids[0];
+    int fieldsnum = filter->getfieldids[0];
+
+    int *rownodes = (int *) RDBMemAlloc(sizeof(int) * numrows);
+
+    for (i = 0; i < numrows; i++) {
+        rowsok[i] = 0;
+        rowscols[i] = NULL;
+        rownodes[i] = -1;
+
+        if (rowkeyslen[i] && RDBTableFilterRowkeyVals(filter, filter->patternprefixlen, (char *) rowkeys[i], (int) rowkeyslen[i], rkvals, rkvalslen) == rowkeynum) {
+            rowsok[i] = 1;
+            rownodes[i] = ctx->env->slotsmap[crc16_keyslot(rowkeys[i], (int) rowkeyslen[i])];
+        }
+    }
+
+    argv[0] = "hmget";
+    argvlen[0] = 5;
+
+    for (j = 0; j < fieldsnum; j++) {
+        argv[j + 2] = filter->getfieldnames[j];
+        argvlen[j + 2] = filter->getfieldnameslen[j];
+    }
+
+    for (nodeindex = 0; fieldsnum && nodeindex < RDBEnvNumNodes(ctx->env); nodeindex++) {
+        RDBCtxNode ctxnode;
+
+        for (i = 0; i < numrows; i++) {
+            if (rownodes[i] == nodeindex) {
+                break;
+            }
+        }
+
+        if (i == numrows) {
+            // no rows for this node
+            continue;
+        }
+
+        if (filter->sqlstmt->stmt == RDBSQL_SELECT) {
+            ctxnode = RDBCtxGetReadNode(ctx, nodeindex);
+        } else {
+            ctxnode = RDBCtxGetNode(ctx, nodeindex);
+        }
+
+        if (! RDBCtxNodeIsOpen(ctxnode) && RDBCtxNodeOpen(ctxnode) != RDBAPI_SUCCESS) {
+            continue;
+        }
+
+        for (; i < numrows; i++) {
+            if (rownodes[i] == nodeindex) {
+                argv[1] = rowkeys[i];
+                argvlen[1] = rowkeyslen[i];
+
+                if (RedisAppendArgvOnNode(ctxnode, fieldsnum + 2, argv, argvlen) == RDBAPI_SUCCESS) {
+                    rowsok[i] = 2;
+                }
+            }
+        }
+
+        for (i = 0; i < numrows; i++) {
+            if (rownodes[i] == nodeindex && rowsok[i] == 2) {
+                redisReply *replyCols = NULL;
+
+                // all appended replies must be read in order
+                if (RedisGetReplyOnNode(ctxnode, &replyCols) == RDBAPI_SUCCESS) {
+                    if (replyCols->type != REDIS_REPLY_ARRAY || replyCols->elements != (size_t) fieldsnum) {
+                        RedisFreeReplyObject(&replyCols);
+                    }
+                }
+
+                rowscols[i] = replyCols;
+                rowsok[i] = 1;
+            }
+        }
+    }
+
+    for (i = 0; fieldsnum && i < numrows; i++) {
+        if (rowsok[i] && ! rowscols[i]) {
+            // connection broken or key moved: get row by slot routing
+            RedisHMGetLen(ctx, rowkeys[i], rowkeyslen[i], filter->getfieldnames, filter->getfieldnameslen, &rowscols[i]);
+        }
+    }
+
+    RDBMemFree(rownodes);
+}
+
+
+// order of head members of shards
+static int RDBIndexShardCmp (RDBIndexShard_t *a, RDBIndexShard_t *b, int withscores)
+{
+    int cmp;
+
+    redisReply *ma = a->page->element[a->next];
+    redisReply *mb = b->page->element[b->next];
+
+    if (withscores) {
+        double sa = strtod(a->page->element[a->next + 1]->str, NULL);
+        double sb = strtod(b->page->element[b->next + 1]->str, NULL);
+
+        if (sa != sb) {
+            return (sa < sb? -1 : 1);
+        }
+    }
+
+    cmp = memcmp(ma->str, mb->str, (ma->len < mb->len? ma->len : mb->len));
+    if (! cmp) {
+        cmp = (ma->len < mb->len? -1 : (ma->len > mb->len? 1 : 0));
+    }
+
+    return cmp;
+}
+
+
+/**
+ * RDBTableScanIndex
+ *   rows are found by range on index rather than SCAN on all masters.
+ *   shards of rowkey index are merged so rows are in order of index.
+ *   OffRows and LmtRows apply on rows passed filters. all rows required
+ *   are fetched in one call unless filter is streaming, which resumes
+ *   the merge on next call.
+ */
+static ub8 RDBTableScanIndex (RDBResultMap resultmap, ub8 OffRows, ub8 LmtRows)
+{
+    int colindex, shard;
+    size_t i, numrows;
+
+    const char *rkvals[RDBAPI_KEYS_MAXNUM + 1] = {0};
+    int rkvalslen[RDBAPI_KEYS_MAXNUM + 1] = {0};
+
+    char indexkey[RDB_KEY_NAME_MAXLEN * 4];
+    char cursor[22];
+    char pagesize[22];
+
+    const char *argv[8];
+    size_t argvlen[8];
+    int argc = 7;
+
+    RDBCtx ctx = resultmap->ctx;
+    RDBTableFilter filter = resultmap->filter;
+
+    int rowkeynum = filter->rowkeyids[0];
+    int fieldsnum = filter->getfieldids[0];
+    int sqlfunc = filter->sqlfunc;
+
+    int numshards = filter->indexshards;
+    int rowkeyindex = filter->tabledes->fielddes[filter->indexfieldid - 1].rowkey;
+    int withscores = (filter->useindex == 1 && numshards > 1);
+    int failed = 0;
+    int finished = 0;
+
+    RDBIndexShard_t *shards;
+
+    const char **rowkeys;
+    size_t *rowkeyslen;
+    redisReply ***memberslots;
+    ub1 *rowsok;
+    redisReply **rowscols;
+
+    ub8 merged = 0;
+    ub8 count = 0;
+
+    // rows per ZRANGEBY page
+    ub8 maxlimit = RDB_TABLE_LIMIT_MAX;
+
+    if (filter->indexstate.finished) {
+        return RDB_ERROR_OFFSET;
+    }
+
+    if (sqlfunc == RDBSQL_FUNC_COUNT) {
+        OffRows = 0;
+        LmtRows = (ub8) SB8MAXVAL;
+    } else if (OffRows + LmtRows < maxlimit) {
+        maxlimit = OffRows + LmtRows;
+    }
+
+    // ZRANGEBYSCORE|ZRANGEBYLEX $indexkey $min $max LIMIT $cursor $maxlimit [WITHSCORES]
+    argv[0] = (filter->useindex == 2? "ZRANGEBYLEX" : "ZRANGEBYSCORE");
+    argvlen[0] = strlen(argv[0]);
+
+    argv[1] = indexkey;
+
+    argv[2] = filter->indexmin;
+    argvlen[2] = filter->indexminlen;
+
+    argv[3] = filter->indexmax;
+    argvlen[3] = filter->indexmaxlen;
+
+    argv[4] = "LIMIT";
+    argvlen[4] = 5;
+
+    argv[5] = cursor;
+
+    argv[6] = pagesize;
+    argvlen[6] = snprintf_chkd_V1(pagesize, sizeof(pagesize), "%"PRIu64, maxlimit);
+
+    if (withscores) {
+        argv[7] = "WITHSCORES";
+        argvlen[7] = 10;
+        argc = 8;
+    }
+
+    if (! filter->indexcursors) {
+        filter->indexcursors = (RDBIndexShard_t *) RDBMemAlloc(sizeof(RDBIndexShard_t) * numshards);
+    }
+    shards = filter->indexcursors;
+
+    rowkeys = (const char **) RDBMemAlloc(sizeof(char *) * maxlimit);
+    rowkeyslen = (size_t *) RDBMemAlloc(sizeof(size_t) * maxlimit);
+    memberslots = (redisReply ***) RDBMemAlloc(sizeof(redisReply **) * maxlimit);
+    rowsok = (ub1 *) RDBMemAlloc(sizeof(ub1) * maxlimit);
+    rowscols = (redisReply **) RDBMemAlloc(sizeof(redisReply *) * maxlimit);
+
+    while (! failed && merged < LmtRows) {
+        int stalled = 0;
+
+        // get next page for shards whose page used up
+        for (shard = 0; shard < numshards; shard++) {
+            RDBIndexShard_t *sh = &shards[shard];
+            size_t nummembers;
+
+            if (sh->finished || (sh->page && sh->next < sh->page->elements)) {
+                continue;
+            }
+
+            RedisFreeReplyObject(&sh->page);
+            sh->next = 0;
+
+            argvlen[1] = RDBTableIndexKey(filter->tabledes, filter->indexfieldid, shard, indexkey, sizeof(indexkey));
+            argvlen[5] = snprintf_chkd_V1(cursor, sizeof(cursor), "%"PRIu64, sh->cursor);
+
+            sh->page = RedisExecCommandArgv(ctx, argc, argv, argvlen);
+
+            if (! sh->page || sh->page->type != REDIS_REPLY_ARRAY) {
+                snprintf_chkd_V1(ctx->errmsg, sizeof(ctx->errmsg), "RDBAPI_ERROR: %s failed on index: %.*s", argv[0], (int) argvlen[1], indexkey);
+                failed = 1;
+                break;
+            }
+
+            nummembers = sh->page->elements / (withscores? 2 : 1);
+
+            sh->cursor += nummembers;
+            if (nummembers < maxlimit) {
+                sh->finished = 1;
+            }
+        }
+
+        if (failed) {
+            break;
+        }
+
+        // merge members of shards in order until page of any unfinished shard used up.
+        //   no more members than rows wanted are taken so that none is lost for next call.
+        numrows = 0;
+
+        while (numrows < maxlimit && numrows < LmtRows - merged + (filter->indexmatched < OffRows? OffRows - filter->indexmatched : 0)) {
+            RDBIndexShard_t *head = NULL;
+            redisReply *member;
+
+            for (shard = 0; shard < numshards; shard++) {
+                RDBIndexShard_t *sh = &shards[shard];
+
+                if (sh->page && sh->next < sh->page->elements) {
+                    if (! head || RDBIndexShardCmp(sh, head, withscores) < 0) {
+                        head = sh;
+                    }
+                } else if (! sh->finished) {
+                    stalled = 1;
+                }
+            }
+
+            if (! head || stalled) {
+                break;
+            }
+
+            member = head->page->element[head->next];
+            memberslots[numrows] = &head->page->element[head->next];
+            head->next += (withscores? 2 : 1);
+
+            if (member->type != REDIS_REPLY_STRING) {
+                continue;
+            }
+
+            if (filter->useindex == 2 && ! rowkeyindex) {
+                // member of lex field index: value + '\0' + rowkey
+                const char *rowkey = memchr(member->str, 0, member->len);
+
+                if (! rowkey++) {
+                    continue;
+                }
+
+                rowkeys[numrows] = rowkey;
+                rowkeyslen[numrows] = member->len - (size_t)(rowkey - member->str);
+            } else {
+                rowkeys[numrows] = member->str;
+                rowkeyslen[numrows] = member->len;
+            }
+
+            numrows++;
+        }
+
+        if (! numrows) {
+            if (stalled) {
+                continue;
+            }
+
+            // all shards finished
+            finished = 1;
+            break;
+        }
+
+        filter->indexstate.offset += numrows;
+
+        RDBTableFetchIndexRows(ctx, filter, rowkeys, rowkeyslen, numrows, rowsok, rowscols);
+
+        for (i = 0; i < numrows; i++) {
+            redisReply *replyCols = rowscols[i];
+            RDBRow row = NULL;
+
+            rowscols[i] = NULL;
+
+            if (! rowsok[i] || merged >= LmtRows) {
+                RedisFreeReplyObject(&replyCols);
+                continue;
+            }
+
+            if (fieldsnum && (! replyCols || RDBTableFilterReplyCols(filter, replyCols) != fieldsnum)) {
+                // rejected by WHERE
+                RedisFreeReplyObject(&replyCols);
+                continue;
+            }
+
+            if (sqlfunc == RDBSQL_FUNC_COUNT) {
+                count++;
+                RedisFreeReplyObject(&replyCols);
+                continue;
+            }
+
+            if (filter->indexmatched++ < OffRows) {
+                RedisFreeReplyObject(&replyCols);
+                continue;
+            }
+
+            if (RDBRowNewOnReply(resultmap, resultmap->arena, *memberslots[i], rowkeys[i], (int) rowkeyslen[i], &row) == RDBAPI_SUCCESS) {
+                // member reply of index page is owned by row now
+                *memberslots[i] = NULL;
+
+                if (RDBResultMapInsertRow(resultmap, row) == RDBAPI_SUCCESS) {
+                    // split rowkey str into vals (already filtered)
+                    RDBTableFilterRowkeyVals(NULL, filter->patternprefixlen, (char *) rowkeys[i], (int) rowkeyslen[i], rkvals, rkvalslen);
+
+                    for (colindex = 0; colindex < rowkeynum; colindex++) {
+                        RDBCellSetSlice(RDBRowCell(row, colindex), rkvals[colindex], rkvalslen[colindex]);
+                    }
+
+                    for (colindex = 0; replyCols && colindex < filter->selfieldnum; colindex++) {
+                        if (RDBCellSetReply(RDBRowCell(row, rowkeynum + colindex), replyCols->element[colindex])) {
+                            replyCols->element[colindex] = NULL;
+                        }
+                    }
+
+                    merged++;
+                } else {
+                    // failed on duplicated rowkey
+                    RDBRowFree(row);
+                }
+            }
+
+            RedisFreeReplyObject(&replyCols);
+        }
+    }
+
+    RDBMemFree(rowkeys);
+    RDBMemFree(rowkeyslen);
+    RDBMemFree(memberslots);
+    RDBMemFree(rowsok);
+    RDBMemFree(rowscols);
+
+    if (failed || finished || ! filter->streaming) {
+        // finish scan on index: all rows required are fetched in one call
+        filter->indexstate.finished = 1;
+    }
+
+    if (failed) {
+        return RDB_ERROR_OFFSET;
+    }
+
+    if (sqlfunc == RDBSQL_FUNC_COUNT) {
+        RDBRow row = RDBRowIterGetRow(RDBResultMapFirstRow(resultmap));
+        RDBCell cell = RDBRowCell(row, 0);
+
+        RDBCellSetInteger(cell, RDBCellGetInteger(cell) + (sb8) count);
+        return count;
+    }
+
+    return OffRows + merged;
+}
+
+
+/**
+ * RDBTableScanNext
+ *
+ * returns:
+ *   = 0: finished
+ *   > 0: numrows
+ *
+ *
+ * | MaxRows  |                        LmtRows
+ * O----------+---.------+----------+---V====--+---...-->
+ *                |                     |    |
+ *             lastOffs              OffRows |
+ *                |<-------- ReqRows ------->|
+ */
+ub8 RDBTableScanNext (RDBResultMap resultmap, ub8 OffRows, ub8 limit)
+{
+    RDBAPI_RESULT result;
+    int  nodeindex, colindex;
+
+    redisReply     *replyRows;
+    redisReply     *replyRowsCols = NULL;
+    redisReply     *replyCols;
+    redisReply     *replyCol;
+
+    const char *rkvals[RDBAPI_KEYS_MAXNUM + 1] = {0};
+    int rkvalslen[RDBAPI_KEYS_MAXNUM + 1] = {0};
+
+    ub8 LastOffs = RDB_ERROR_OFFSET;
+
+    int rowkeynum = resultmap->filter->rowkeyids[0];
+    int fieldsnum = resultmap->filter->getfieldids[0];
+
+    RDBCtx ctx = resultmap->ctx;
+
+    if (resultmap->filter->use_hmget) {
+        if (RedisExistsKey(ctx, resultmap->filter->keypattern, resultmap->filter->patternlen) == RDBAPI_TRUE) {
+            // use HMGET rather than SCAN
+            if (RedisHMGetLen(ctx, resultmap->filter->keypattern, resultmap->filter->patternlen,
+                    resultmap->filter->getfieldnames, resultmap->filter->getfieldnameslen, &replyCols) == RDBAPI_SUCCESS) {
+
+                // filter fields by fieldfilters
+                if (RDBTableFilterReplyCols(resultmap->filter, replyCols) == fieldsnum) {
+
+                    // split rowkey str into vals without rowkeyfilters
+                    if (RDBTableFilterRowkeyVals(NULL, resultmap->filter->patternprefixlen, resultmap->filter->keypattern, resultmap->filter->patternlen, rkvals, rkvalslen) == rowkeynum) {
+                        RDBRow row = NULL;
+
+                        if (RDBRowNew(resultmap, resultmap->filter->keypattern, resultmap->filter->patternlen, &row) == RDBAPI_SUCCESS) {
+                            if (RDBResultMapInsertRow(resultmap, row) == RDBAPI_SUCCESS) {
+                                // set rowkey fields
+                                for (colindex = 0; colindex < rowkeynum; colindex++) {
+                                    RDBCellSetString(RDBRowCell(row, colindex), rkvals[colindex], rkvalslen[colindex]);
+                                }
+
+                                // set attr fields
+                                for (colindex = 0; colindex < resultmap->filter->selfieldnum; colindex++) {
+                                    replyCol = replyCols->element[colindex];
+                                    replyCols->element[colindex] = NULL;
+                                    RDBCellSetReply(RDBRowCell(row, rowkeynum + colindex), replyCol);
+                                }
+
+                                LastOffs = RDBResultMapGetOffset(resultmap);
+                            } else {
+                                // insert failed
+                                RDBRowFree(row);
+                            }
+                        }
+                    }
+                }
+
+                RedisFreeReplyObject(&replyCols);
+            }
+        }
+    } else if (resultmap->filter->useindex) {
+        ub8 LmtRows = limit;
+
+        if (limit == (ub8)(-1)) {
+            LmtRows = RDB_TABLE_LIMIT_MAX;
+        } else if (limit < RDB_TABLE_LIMIT_MIN) {
+            LmtRows = RDB_TABLE_LIMIT_MIN;
+        }
+
+        LastOffs = RDBTableScanIndex(resultmap, OffRows, LmtRows);
+    } else {
+        RDBCtxNode  ctxnode;
+        RDBTableCursor  nodestate;
+
+        int numMasters = 0;
+        int finMasters = 0;
+
+        // 1: nodes down are skipped and deferred; -1: scan deferred nodes
+        int deferred = 0;
+
+        // number of rows now to fetch
+        sb8 CurRows;
+
+        // number of rows we fetched
+        ub8 NumRows = 0;
+
+        // number of rows returned
+        ub8 LmtRows = limit;
+
+        // validate limit rows
+        if (limit == (ub8)(-1)) {
+            LmtRows = RDB_TABLE_LIMIT_MAX;
+        } else if (limit < RDB_TABLE_LIMIT_MIN) {
+            LmtRows = RDB_TABLE_LIMIT_MIN;
+        }
+
+        // get rows from all nodes
+        LastOffs = RDBResultMapGetOffset(resultmap);
+        if (LastOffs >= OffRows + LmtRows) {
+            return LastOffs;
+        }
+
+        // get number of finished nodes
+        for (nodeindex = 0; nodeindex < ctx->topology->numnodes; nodeindex++) {
+            if (RDBCtxNodeIsMaster(ctx, nodeindex)) {
+                numMasters++;
+
+                nodestate = RDBResultNodeState(resultmap, nodeindex);
+                if (nodestate->finished) {
+                    finMasters++;
+                }
+            }
+        }
+
+        if (numMasters == finMasters) {
+            return RDB_ERROR_OFFSET;
+        }
+
+        if (ctx->env->parallel && numMasters - finMasters > 1 && ! resultmap->filter->streaming) {
+            return RDBTableScanParallel(resultmap, OffRows, LmtRows);
+        }
+
+        nodeindex = 0;
+
+scan_nodes:
+        while (NumRows < LmtRows && nodeindex < ctx->topology->numnodes) {
+            // scan only on master node of topology pinned by ctx
+            if (RDBCtxNodeIsMaster(ctx, nodeindex)) {
+                ub8 SaveOffs = LastOffs;
+
+                nodestate = RDBResultNodeState(resultmap, nodeindex);
 
                 if (nodestate->finished) {
                     // goto next node since this current node has finished
@@ -565,219 +2096,1621 @@ ub8 RDBTableScanNext (RDBResultMap resultmap, ub8 OffRows, ub8 limit)
                     continue;
                 }
 
-                // calc rows now to fetch
-                CurRows = (sb8) (OffRows + LmtRows - SaveOffs - NumRows);
+                if (deferred != -1 && RDBTableScanNodeDown(ctx, resultmap->filter, nodestate)) {
+                    // scan other nodes first, come back after them
+                    deferred = 1;
+                    nodeindex++;
+                    continue;
+                }
+
+                ctxnode = RDBTableScanReadNode(ctx, resultmap->filter, nodestate);
+
+                // calc rows now to fetch
+                CurRows = (sb8) (OffRows + LmtRows - SaveOffs - NumRows);
+
+                if (NumRows) {
+                    CurRows = LmtRows - NumRows;
+                }
+
+                if (CurRows > 0) {
+                    if (resultmap->filter->pushdown) {
+                        result = RDBTableScanPushdownOnNode(ctxnode, nodestate, resultmap->filter, CurRows, &replyRows, &replyRowsCols);
+
+                        if (result == RDBAPI_ERROR) {
+                            LastOffs = RDB_ERROR_OFFSET;
+                            goto return_offset;
+                        }
+                    } else {
+                        result = RDBTableScanOnNode(ctxnode, nodestate, resultmap->filter->keypattern, resultmap->filter->patternlen, CurRows, &replyRows);
+
+                        if (result == RDBAPI_CONTINUE && *ctx->errmsg) {
+                            // node failed (or circuit open)
+                            LastOffs = RDB_ERROR_OFFSET;
+                            goto return_offset;
+                        }
+                    }
+                } else {
+                    LastOffs = RDBResultMapGetOffset(resultmap);
+                    goto return_offset;
+                }
+
+                if (result == RDBAPI_SUCCESS) {
+                    LastOffs = RDBResultMapGetOffset(resultmap);
+
+                    if (LastOffs > OffRows) {
+                        // here we should add new rows
+                        size_t i = 0;
+
+                        if (OffRows > SaveOffs) {
+                            i = OffRows - SaveOffs;
+                        }
+
+                        ub1 *rowsok = (ub1 *) RDBMemAlloc(sizeof(ub1) * replyRows->elements);
+                        redisReply **rowscols = (redisReply **) RDBMemAlloc(sizeof(redisReply *) * replyRows->elements);
+
+                        // filter rowkeys and get fields of rows in batch
+                        RDBTableFetchRowsOnNode(ctxnode, resultmap->filter, replyRows, replyRowsCols, i, rowsok, rowscols);
+
+                        for (; i != replyRows->elements; i++) {
+                            int addcount = 0;
+                            redisReply *replyRowkey = replyRows->element[i];
+
+                            if (rowsok[i]) {
+                                // split rowkey str into vals (already filtered)
+                                RDBTableFilterRowkeyVals(NULL, resultmap->filter->patternprefixlen, replyRowkey->str, (int)replyRowkey->len, rkvals, rkvalslen);
+
+                                if (resultmap->filter->getfieldids[0]) {
+                                    replyCols = rowscols[i];
+                                    rowscols[i] = NULL;
+
+                                    if (replyCols) {
+                                        if (RDBTableFilterReplyCols(resultmap->filter, replyCols) == fieldsnum) {
+                                            // passed WHERE filter ok
+
+                                            if (! resultmap->filter->sqlfunc) {
+                                                RDBRow row = NULL;
+
+                                                if (RDBRowNewOnReply(resultmap, resultmap->arena, replyRowkey, replyRowkey->str, (int) replyRowkey->len, &row) == RDBAPI_SUCCESS) {
+                                                    // rowkey reply is owned by row now
+                                                    replyRows->element[i] = NULL;
+
+                                                    if (RDBResultMapInsertRow(resultmap, row) == RDBAPI_SUCCESS) {
+                                                        // set rowkey fields without copy
+                                                        for (colindex = 0; colindex < rowkeynum; colindex++) {
+                                                            RDBCellSetSlice(RDBRowCell(row, colindex), rkvals[colindex], rkvalslen[colindex]);
+                                                        }
+
+                                                        // set attr fields
+                                                        for (colindex = 0; colindex < resultmap->filter->selfieldnum; colindex++) {
+                                                            replyCol = replyCols->element[colindex];
+
+                                                            if (RDBCellSetReply(RDBRowCell(row, rowkeynum + colindex), replyCol)) {
+                                                                replyCols->element[colindex] = NULL;
+                                                            }
+                                                        }
+                                                    } else {
+                                                        // failed on duplicated rowkey
+                                                        RDBRowFree(row);
+                                                    }
+                                                }
+                                            } else {
+                                                if (resultmap->filter->sqlfunc == RDBSQL_FUNC_COUNT) {
+                                                    addcount = 1;
+                                                }
+                                            }
+                                        }
+
+                                        RedisFreeReplyObject(&replyCols);
+                                    }
+                                } else {
+                                    if (resultmap->filter->sqlfunc == RDBSQL_FUNC_COUNT) {
+                                        addcount = 1;
+                                    }
+                                }
+                            }
+
+                            if (addcount) {
+                                RDBRowIter rowiter = RDBResultMapFirstRow(resultmap);
+                                RDBRow row = RDBRowIterGetRow(rowiter);
+                                RDBCell cell = RDBRowCell(row, 0);
+
+                                RDBCellSetInteger(cell, RDBCellGetInteger(cell) + 1);
+                            }
+                        }
+
+                        RDBMemFree(rowscols);
+                        RDBMemFree(rowsok);
+                    }
+
+                    RedisFreeReplyObject(&replyRowsCols);
+                    RedisFreeReplyObject(&replyRows);
+                }
+            } else {
+                nodeindex++;
+            }
+        }
+
+        if (deferred == 1 && NumRows < LmtRows) {
+            // other nodes done. scan deferred nodes (fail fast if still down)
+            deferred = -1;
+            nodeindex = 0;
+            goto scan_nodes;
+        }
+    }
+
+return_offset:
+    return LastOffs;
+}
+
+
+/**
+ * RDBCursor
+ *   streams rows of SELECT batch by batch on RDBTableScanFirst and
+ *   RDBTableScanNext. rows of a batch are recycled by the next fetch, so
+ *   memory is bounded by batchrows whatever the number of rows in table.
+ */
+typedef struct _RDBCursor_t
+{
+    RDBResultMap resultmap;
+
+    // rows scanned per batch
+    ub4 batchrows;
+
+    // OFFSET and LIMIT of SELECT. limit = -1 for all rows
+    ub8 offset;
+    ub8 limit;
+
+    // rows returned so far
+    ub8 fetched;
+
+    int finished;
+
+    // rows of current batch
+    ub4 maxrows;
+    RDBRow *rows;
+} RDBCursor_t;
+
+
+RDBAPI_RESULT RDBCursorOpen (RDBSQLStmt sqlstmt, ub4 batchrows, RDBCursor *outcursor)
+{
+    int i;
+
+    RDBCursor cursor;
+    RDBResultMap resultmap = NULL;
+
+    RDBCtx ctx = sqlstmt->ctx;
+
+    *outcursor = NULL;
+
+    if (sqlstmt->stmt != RDBSQL_SELECT || sqlstmt->sqlfunc) {
+        snprintf_chkd_V1(ctx->errmsg, sizeof(ctx->errmsg), "RDBAPI_ERR_BADARG: cursor only for SELECT rows");
+        return RDBAPI_ERR_BADARG;
+    }
+
+    for (i = 0; i < sqlstmt->numparams; i++) {
+        if (! sqlstmt->params[i].bound) {
+            snprintf_chkd_V1(ctx->errmsg, sizeof(ctx->errmsg), "RDBAPI_ERR_BADARG: parameter(%d) not bound", i + 1);
+            return RDBAPI_ERR_BADARG;
+        }
+    }
+
+    if (batchrows < RDB_TABLE_LIMIT_MIN) {
+        batchrows = RDB_TABLE_LIMIT_MIN;
+    } else if (batchrows > RDB_TABLE_LIMIT_MAX) {
+        batchrows = RDB_TABLE_LIMIT_MAX;
+    }
+
+    if (RDBTableScanFirst(ctx, sqlstmt, &resultmap) != RDBAPI_SUCCESS) {
+        return RDBAPI_ERROR;
+    }
+
+    cursor = (RDBCursor) RDBMemAlloc(sizeof(RDBCursor_t));
+    if (! cursor) {
+        RDBResultMapDestroy(resultmap);
+        return RDBAPI_ERR_NOMEM;
+    }
+
+    // rows are recycled between batches rather than carved from arena
+    resultmap->arena = NULL;
+    resultmap->maxspares = batchrows;
+    resultmap->filter->streaming = 1;
+
+    cursor->resultmap = resultmap;
+    cursor->batchrows = batchrows;
+    cursor->offset = sqlstmt->select.offset;
+    cursor->limit = sqlstmt->select.limit;
+
+    *outcursor = cursor;
+    return RDBAPI_SUCCESS;
+}
+
+
+void RDBCursorClose (RDBCursor cursor)
+{
+    if (cursor) {
+        RDBResultMapDestroy(cursor->resultmap);
+        RDBMemFree(cursor->rows);
+        RDBMemFree(cursor);
+    }
+}
+
+
+/**
+ * RDBCursorFetch
+ *   get next batch of rows. rows are valid until next fetch or close.
+ *
+ * returns:
+ *   > 0: number of rows in outrows
+ *   = 0: no more rows
+ *   < 0: error
+ */
+int RDBCursorFetch (RDBCursor cursor, RDBRow **outrows)
+{
+    int numrows = 0;
+
+    RDBResultMap resultmap = cursor->resultmap;
+    RDBCtx ctx = resultmap->ctx;
+
+    *outrows = NULL;
+
+    // rows of last batch (and those over limit) are reused
+    RDBResultMapRecycleAll(resultmap);
+
+    while (! numrows && ! cursor->finished) {
+        RDBRowIter rowiter;
+        ub4 rows;
+
+        ub8 offset = RDBResultMapGetOffset(resultmap);
+
+        if (offset < cursor->offset) {
+            offset = cursor->offset;
+        }
+
+        *ctx->errmsg = 0;
+
+        if (RDBTableScanNext(resultmap, offset, cursor->batchrows) == RDB_ERROR_OFFSET) {
+            cursor->finished = 1;
+
+            if (*ctx->errmsg) {
+                return (-1);
+            }
+        }
+
+        if (resultmap->filter->use_hmget) {
+            // only one row by HMGET
+            cursor->finished = 1;
+        }
+
+        rows = RDBResultMapRows(resultmap);
+
+        if (rows > cursor->maxrows) {
+            cursor->rows = (RDBRow *) RDBMemRealloc(cursor->rows, sizeof(RDBRow) * cursor->maxrows, sizeof(RDBRow) * rows);
+            cursor->maxrows = rows;
+        }
+
+        for (rowiter = RDBResultMapFirstRow(resultmap); rowiter; rowiter = RDBResultMapNextRow(rowiter)) {
+            if (cursor->limit != (ub8)(-1) && cursor->fetched >= cursor->limit) {
+                cursor->finished = 1;
+                break;
+            }
+
+            cursor->rows[numrows++] = RDBRowIterGetRow(rowiter);
+            cursor->fetched++;
+        }
+    }
+
+    *outrows = cursor->rows;
+    return numrows;
+}
+
+
+/**
+ * RDBCursorForEach
+ *   fetch all rows left and call rowcb on each row till it returns 0.
+ *   returns number of rows passed to rowcb or RDB_ERROR_OFFSET on error.
+ */
+ub8 RDBCursorForEach (RDBCursor cursor, RDBCursorRowCallback rowcb, void *arg)
+{
+    int i, numrows;
+    RDBRow *rows;
+
+    ub8 count = 0;
+
+    while ((numrows = RDBCursorFetch(cursor, &rows)) > 0) {
+        for (i = 0; i < numrows; i++) {
+            count++;
+
+            if (! rowcb(rows[i], arg)) {
+                return count;
+            }
+        }
+    }
+
+    return (numrows < 0? RDB_ERROR_OFFSET : count);
+}
+
+
+RDBResultMap RDBCursorResultMap (RDBCursor cursor)
+{
+    return cursor->resultmap;
+}
+
+
+RDBAPI_RESULT RDBTableCreate (RDBCtx ctx, const char *tablespace, const char *tablename, const char *tablecomment, int nfields, RDBFieldDes_t *fieldes)
+{
+    RDBAPI_RESULT  result;
+
+    int rowkeyid[RDBAPI_SQL_KEYS_MAX + 1] = {0};
+
+    int tablespacelen = cstr_length(tablespace, RDB_KEY_NAME_MAXLEN + 1);
+    int tablenamelen = cstr_length(tablename, RDB_KEY_NAME_MAXLEN + 1);
+    int commentlen = cstr_length(tablecomment, RDB_KEY_VALUE_SIZE - 1);
+
+    char table_rowkey[RDB_KEY_NAME_MAXLEN * 3];
+
+    char timestamp[22] = {0};
+    char numfields[10] = {0};
+
+    tpl_bin outbin = {0};
+
+    const char * fields[] = {"numfields", "fieldes", "timestamp", "comment", 0};
+    const char * values[5];
+
+    size_t valueslen[5];
+
+    if (tablespacelen < 2 || tablespacelen > RDB_KEY_NAME_MAXLEN) {
+        snprintf_chkd_V1(ctx->errmsg, sizeof(ctx->errmsg), "RDBAPI_ERR_BADARG: invalid tablespace: %s", tablespace);
+        return RDBAPI_ERR_BADARG;
+    }
+    if (tablenamelen < 4 || tablenamelen > RDB_KEY_NAME_MAXLEN) {
+        snprintf_chkd_V1(ctx->errmsg, sizeof(ctx->errmsg), "RDBAPI_ERR_BADARG: invalid tablename: %s", tablename);
+        return RDBAPI_ERR_BADARG;
+    }
+
+    if (! RDBFieldDesCheckSet(ctx->env->valtypetable, fieldes, nfields, rowkeyid, ctx->errmsg, sizeof(ctx->errmsg))) {
+        return RDBAPI_ERROR;
+    }
+
+    // {redisdb::$tablespace:$tablename}
+    snprintf_chkd_V1(table_rowkey, sizeof(table_rowkey), "{%s::%.*s:%.*s}", RDB_SYSTEM_TABLE_PREFIX, tablespacelen, tablespace, tablenamelen, tablename);
+
+    if (RDBFieldDesPack(fieldes, nfields, &outbin) != 0) {
+        snprintf_chkd_V1(ctx->errmsg, sizeof(ctx->errmsg), "(%s:%d) RDBAPI_ERROR: RDBFieldDesPack failed.", __FILE__, __LINE__);
+        return RDBAPI_ERROR;
+    }
+
+    values[0] = numfields;
+    values[1] = (char *) outbin.addr;
+    values[2] = timestamp;
+    values[3] = tablecomment;
+    values[4] = 0;
+
+    valueslen[0] = snprintf_chkd_V1(numfields, sizeof(numfields), "%d", nfields);
+    valueslen[1] = outbin.sz;
+    valueslen[2] = snprintf_chkd_V1(timestamp, sizeof(timestamp), "%"PRIu64, RDBGetLocalTime(NULL));
+    valueslen[3] = commentlen;
+    valueslen[4] = 0;
+
+    result = RedisHMSet(ctx, table_rowkey, fields, values, valueslen, RDBAPI_KEY_PERSIST);
+    free(outbin.addr);
+    return result;
+}
+
+
+RDBAPI_RESULT RDBTableDescribe (RDBCtx ctx, const char *tablespace, const char *tablename, RDBTableDes_t *tabledes)
+{
+    ub8 u8val;
+    redisReply *tableReply = NULL;
+
+    const char *fldnames[] = {"numfields", "fieldes", "timestamp", "comment", "indexes", "rowkeyshards", "dropping", 0};
+
+    bzero(tabledes, sizeof(*tabledes));
+
+    if (! strcmp(tablespace, RDB_SYSTEM_TABLE_PREFIX)) {
+        snprintf_chkd_V1(ctx->errmsg, sizeof(ctx->errmsg), "(%s:%d) RDBAPI_ERROR: system tablespace: %s", __FILE__, __LINE__, tablespace);
+        return RDBAPI_ERROR;
+    }
+
+    // hmget {redisdb::$tablespace:$tablename} numfields fieldes timestamp comment indexes rowkeyshards dropping
+    snprintf_chkd_V1(tabledes->table_rowkey, sizeof(tabledes->table_rowkey) - 1, "{%s::%s:%s}", RDB_SYSTEM_TABLE_PREFIX, tablespace, tablename);
+
+    if (RedisHMGet(ctx, tabledes->table_rowkey, fldnames, &tableReply) != RDBAPI_SUCCESS) {
+        snprintf_chkd_V1(ctx->errmsg, sizeof(ctx->errmsg), "RDBAPI_ERROR: key not found: %s", tabledes->table_rowkey);
+        return RDBAPI_ERROR;
+    }
+
+    if (tableReply->element[6]->type == REDIS_REPLY_STRING) {
+        // tombstone of DROP TABLE: rows are being reclaimed
+        snprintf_chkd_V1(ctx->errmsg, sizeof(ctx->errmsg), "RDBAPI_ERR_REJECTED: table is being dropped: %s", tabledes->table_rowkey);
+        RedisFreeReplyObject(&tableReply);
+        return RDBAPI_ERR_REJECTED;
+    }
+
+    u8val = 0;
+    cstr_to_ub8(10, tableReply->element[0]->str, tableReply->element[0]->len, &u8val);
+    tabledes->nfields = (int) u8val;
+
+    if (!tableReply->element[1]->str || ! tableReply->element[1]->len || ! tabledes->nfields) {
+        snprintf_chkd_V1(ctx->errmsg, sizeof(ctx->errmsg), "RDBAPI_ERROR: invalid fieldes: %s", tabledes->table_rowkey);
+        RedisFreeReplyObject(&tableReply);
+        return RDBAPI_ERROR;
+    }
+
+    if (! RDBFieldDesUnpack(tableReply->element[1]->str, tableReply->element[1]->len, tabledes->fielddes, tabledes->nfields)) {
+        snprintf_chkd_V1(ctx->errmsg, sizeof(ctx->errmsg), "RDBAPI_ERROR: RDBFieldDesUnpack: %s", tabledes->table_rowkey);
+        RedisFreeReplyObject(&tableReply);
+        return RDBAPI_ERROR;
+    }
+
+    cstr_to_ub8(10, tableReply->element[2]->str, (int) tableReply->element[2]->len, &tabledes->table_timestamp);
+
+    snprintf_chkd_V1(tabledes->table_comment, sizeof(tabledes->table_comment), "%.*s", (int)tableReply->element[3]->len, tableReply->element[3]->str);
+
+    if (tableReply->element[4]->type == REDIS_REPLY_STRING) {
+        // indexes: "field1,field2,..."
+        char *names[RDBAPI_ARGV_MAXNUM] = {0};
+        int nameslen[RDBAPI_ARGV_MAXNUM] = {0};
+
+        int i, fieldid;
+        int n = cstr_slpit_chr(tableReply->element[4]->str, (int) tableReply->element[4]->len, ',', names, nameslen, RDBAPI_ARGV_MAXNUM);
+
+        for (i = 0; i < n; i++) {
+            fieldid = RDBTableDesFieldIndex(tabledes, names[i], nameslen[i]) + 1;
+            if (fieldid) {
+                tabledes->indexids[++tabledes->indexids[0]] = fieldid;
+            }
+        }
+
+        cstr_varray_free(names, n);
+    }
+
+    if (tableReply->element[5]->type == REDIS_REPLY_STRING) {
+        u8val = 0;
+        cstr_to_ub8(10, tableReply->element[5]->str, (int) tableReply->element[5]->len, &u8val);
+        tabledes->rowkeyshards = (int) u8val;
+    }
+
+    RedisFreeReplyObject(&tableReply);
+
+    if (! RDBFieldDesCheckSet(ctx->env->valtypetable, tabledes->fielddes, tabledes->nfields, tabledes->rowkeyid, ctx->errmsg, sizeof(ctx->errmsg))) {
+        return RDBAPI_ERROR;
+    }
+
+    return RDBAPI_SUCCESS;
+}
+
+
+/**
+ * RDBTableIndexGetValsArgv
+ *   HMGET command of values of all indexed fields of row. argv has room for
+ *   indexids[0] + 2 args. returns argc, 0 if table has no index
+ */
+int RDBTableIndexGetValsArgv (const RDBTableDes_t *tabledes, const char *rowkey, size_t rowkeylen, const char *argv[], size_t argvlen[])
+{
+    int i, argc = 0;
+
+    if (! tabledes || ! tabledes->indexids[0]) {
+        return 0;
+    }
+
+    argv[argc] = "HMGET";
+    argvlen[argc++] = 5;
+
+    argv[argc] = rowkey;
+    argvlen[argc++] = rowkeylen;
+
+    for (i = 1; i <= tabledes->indexids[0]; i++) {
+        const RDBFieldDes_t *fdes = &tabledes->fielddes[tabledes->indexids[i] - 1];
+
+        argv[argc] = fdes->fieldname;
+        argvlen[argc++] = fdes->namelen;
+    }
+
+    return argc;
+}
+
+
+/**
+ * RDBTableIndexValsReply
+ *   reply of HMGET by RDBTableIndexGetValsArgv. freed and NULL if invalid
+ */
+redisReply * RDBTableIndexValsReply (const RDBTableDes_t *tabledes, redisReply *reply)
+{
+    if (reply && (reply->type != REDIS_REPLY_ARRAY || reply->elements != (size_t) tabledes->indexids[0])) {
+        RedisFreeReplyObject(&reply);
+    }
+
+    return reply;
+}
+
+
+/**
+ * RDBTableIndexGetVals
+ *   HMGET values of all indexed fields of row. NULL if table has no index
+ */
+redisReply * RDBTableIndexGetVals (RDBCtx ctx, const RDBTableDes_t *tabledes, const char *rowkey, size_t rowkeylen)
+{
+    int argc;
+
+    const char *argv[RDBAPI_ARGV_MAXNUM + 3];
+    size_t argvlen[RDBAPI_ARGV_MAXNUM + 3];
+
+    argc = RDBTableIndexGetValsArgv(tabledes, rowkey, rowkeylen, argv, argvlen);
+    if (! argc) {
+        return NULL;
+    }
+
+    return RDBTableIndexValsReply(tabledes, RedisExecCommandArgv(ctx, argc, argv, argvlen));
+}
+
+
+/**
+ * RDBTableIndexGetValsRows
+ *   RDBTableIndexGetVals of rows pipelined per node. outExists[i] (if not
+ *   NULL) is 0 only if rows[i] is known not existed, by EXISTS in the same
+ *   pipeline.
+ */
+void RDBTableIndexGetValsRows (RDBCtx ctx, const RDBTableDes_t *tabledes, int numrows, const char *rowkeys[], const size_t *rowkeyslen, redisReply **outVals, int *outExists)
+{
+    int row, numcmds = 0;
+
+    int *argcs;
+    const char ***argvs;
+    const size_t **argvlens;
+    redisReply **replies;
+
+    const char **argvbuf;
+    size_t *argvlenbuf;
+
+    // args of HMGET and EXISTS of a row
+    int rowargs = tabledes->indexids[0] + 4;
+
+    for (row = 0; row < numrows; row++) {
+        outVals[row] = NULL;
+
+        if (outExists) {
+            outExists[row] = 1;
+        }
+    }
+
+    if (! tabledes->indexids[0] || numrows <= 0) {
+        return;
+    }
+
+    argcs = (int *) RDBMemAlloc(sizeof(int) * numrows * 2);
+    argvs = (const char ***) RDBMemAlloc(sizeof(char **) * numrows * 2);
+    argvlens = (const size_t **) RDBMemAlloc(sizeof(size_t *) * numrows * 2);
+    replies = (redisReply **) RDBMemAlloc(sizeof(redisReply *) * numrows * 2);
+
+    argvbuf = (const char **) RDBMemAlloc(sizeof(char *) * rowargs * numrows);
+    argvlenbuf = (size_t *) RDBMemAlloc(sizeof(size_t) * rowargs * numrows);
+
+    for (row = 0; row < numrows; row++) {
+        const char **argv = &argvbuf[rowargs * row];
+        size_t *argvlen = &argvlenbuf[rowargs * row];
+
+        argcs[numcmds] = RDBTableIndexGetValsArgv(tabledes, rowkeys[row], rowkeyslen[row], argv, argvlen);
+        argvs[numcmds] = argv;
+        argvlens[numcmds++] = argvlen;
+
+        if (outExists) {
+            // EXISTS $rowkey: row not existed if write failed
+            argv += rowargs - 2;
+            argvlen += rowargs - 2;
+
+            argv[0] = "EXISTS";
+            argvlen[0] = 6;
+
+            argv[1] = rowkeys[row];
+            argvlen[1] = rowkeyslen[row];
+
+            argcs[numcmds] = 2;
+            argvs[numcmds] = argv;
+            argvlens[numcmds++] = argvlen;
+        }
+    }
+
+    RedisExecArgvPipelined(ctx, numcmds, argcs, argvs, argvlens, replies);
+
+    numcmds = 0;
+    for (row = 0; row < numrows; row++) {
+        outVals[row] = RDBTableIndexValsReply(tabledes, replies[numcmds]);
+        replies[numcmds++] = NULL;
+
+        if (outExists) {
+            redisReply *reply = replies[numcmds++];
+
+            if (reply && reply->type == REDIS_REPLY_INTEGER && reply->integer == 0) {
+                outExists[row] = 0;
+            }
+        }
+    }
+
+    RedisFreeReplyObjects(replies, numcmds);
+
+    RDBMemFree(argvlenbuf);
+    RDBMemFree(argvbuf);
+    RDBMemFree(replies);
+    RDBMemFree(argvlens);
+    RDBMemFree(argvs);
+    RDBMemFree(argcs);
+}
+
+
+// index entry to add or remove
+typedef struct
+{
+    // 1..indexids[0]
+    int indexno;
+
+    // shard of rowkey index
+    int shard;
+
+    // 1 for ZADD, 0 for ZREM
+    int add;
+
+    int memberlen;
+    char *member;
+    char score[32];
+} RDBTableIndexEntry_t;
+
+
+// by index key then ZREM before ZADD
+static int RDBTableIndexEntryCmp (const void *a, const void *b)
+{
+    const RDBTableIndexEntry_t *ea = (const RDBTableIndexEntry_t *) a;
+    const RDBTableIndexEntry_t *eb = (const RDBTableIndexEntry_t *) b;
+
+    if (ea->indexno != eb->indexno) {
+        return (ea->indexno < eb->indexno? -1 : 1);
+    }
+    if (ea->shard != eb->shard) {
+        return (ea->shard < eb->shard? -1 : 1);
+    }
+    if (ea->add != eb->add) {
+        return (ea->add < eb->add? -1 : 1);
+    }
+    return 0;
+}
+
+
+/**
+ * RDBTableIndexUpdateRows
+ *   move index entries of rows from oldVals (by RDBTableIndexGetValsRows
+ *   before rows changed) to current values. all entries of rows are removed
+ *   if deleted. oldVals (or any of it) could be NULL if row not existed.
+ *
+ *   current values are read by one pipeline per node. entries are grouped
+ *   by index key, each group is sent as one multi-member ZREM or ZADD and
+ *   groups are pipelined per node. a member is never both removed and added
+ *   on one index key, so failed groups could be executed again in any order.
+ */
+void RDBTableIndexUpdateRows (RDBCtx ctx, const RDBTableDes_t *tabledes, int numrows, const char *rowkeys[], const size_t *rowkeyslen, redisReply **oldVals, int deleted)
+{
+    int row, i, k, c;
+    int numentries = 0, numcmds = 0, numargs = 0;
+
+    redisReply **newVals = NULL;
+    int *exists = NULL;
+
+    RDBTableIndexEntry_t *entries;
+    int *starts;
+
+    int *argcs;
+    const char ***argvs;
+    const size_t **argvlens;
+    redisReply **replies;
+
+    const char **argvbuf;
+    size_t *argvlenbuf;
+    char *keysbuf;
+
+    const size_t keysize = RDB_KEY_NAME_MAXLEN * 4;
+
+    if (! tabledes || ! tabledes->indexids[0] || numrows <= 0) {
+        return;
+    }
+
+    if (! deleted) {
+        newVals = (redisReply **) RDBMemAlloc(sizeof(redisReply *) * numrows);
+        exists = (int *) RDBMemAlloc(sizeof(int) * numrows);
+
+        RDBTableIndexGetValsRows(ctx, tabledes, numrows, rowkeys, rowkeyslen, newVals, exists);
+    }
+
+    // at most one ZREM and one ZADD per index of row
+    entries = (RDBTableIndexEntry_t *) RDBMemAlloc(sizeof(RDBTableIndexEntry_t) * numrows * tabledes->indexids[0] * 2);
+
+    for (row = 0; row < numrows; row++) {
+        const char *rowkey = rowkeys[row];
+        size_t rowkeylen = rowkeyslen[row];
+
+        for (i = 1; i <= tabledes->indexids[0]; i++) {
+            const RDBFieldDes_t *fdes = &tabledes->fielddes[tabledes->indexids[i] - 1];
+
+            redisReply *oldVal = ((oldVals && oldVals[row])? oldVals[row]->element[i - 1] : NULL);
+            redisReply *newVal = ((newVals && newVals[row])? newVals[row]->element[i - 1] : NULL);
+
+            RDBTableIndexEntry_t *entry = &entries[numentries];
+            RDBTableIndexEntry_t *added = NULL;
+
+            if (fdes->rowkey) {
+                // rowkey index: entry is bound to rowkey, not to value of field
+                int vallen;
+                const char *val = RDBTableRowkeyFirstVal(rowkey, rowkeylen, &vallen);
+
+                if (! val || tabledes->rowkeyshards < 1) {
+                    continue;
+                }
+
+                entry->memberlen = RDBTableIndexEntry(fdes, val, vallen, rowkey, rowkeylen, entry->score, &entry->member);
+                if (entry->memberlen) {
+                    entry->indexno = i;
+                    entry->shard = (int)(crc16_keyslot(rowkey, (int) rowkeylen) % tabledes->rowkeyshards);
+                    entry->add = (! deleted && exists[row]);
+                    numentries++;
+                }
+
+                continue;
+            }
+
+            if (oldVal && oldVal->type != REDIS_REPLY_STRING) {
+                oldVal = NULL;
+            }
+            if (newVal && newVal->type != REDIS_REPLY_STRING) {
+                newVal = NULL;
+            }
+
+            if (! oldVal && ! newVal) {
+                continue;
+            }
+
+            if (oldVal && newVal && ! cstr_compare_len(oldVal->str, (int) oldVal->len, newVal->str, (int) newVal->len)) {
+                // index value not changed
+                continue;
+            }
+
+            if (newVal) {
+                // ZADD $indexkey $score $member
+                entry->memberlen = RDBTableIndexEntry(fdes, newVal->str, (int) newVal->len, rowkey, rowkeylen, entry->score, &entry->member);
+                if (entry->memberlen) {
+                    entry->indexno = i;
+                    entry->shard = 0;
+                    entry->add = 1;
+
+                    added = entry;
+                    entry = &entries[++numentries];
+                }
+            }
+
+            if (oldVal) {
+                // ZREM $indexkey $member
+                entry->memberlen = RDBTableIndexEntry(fdes, oldVal->str, (int) oldVal->len, rowkey, rowkeylen, entry->score, &entry->member);
+                if (entry->memberlen) {
+                    if (added && ! cstr_compare_len(entry->member, entry->memberlen, added->member, added->memberlen)) {
+                        // member of numeric index is rowkey: ZADD updates its score
+                        RDBMemFree(entry->member);
+                        entry->member = NULL;
+                    } else {
+                        entry->indexno = i;
+                        entry->shard = 0;
+                        entry->add = 0;
+                        numentries++;
+                    }
+                }
+            }
+        }
+    }
+
+    if (newVals) {
+        RedisFreeReplyObjects(newVals, numrows);
+        RDBMemFree(newVals);
+    }
+    RDBMemFree(exists);
+
+    if (! numentries) {
+        RDBMemFree(entries);
+        return;
+    }
+
+    qsort(entries, numentries, sizeof(RDBTableIndexEntry_t), RDBTableIndexEntryCmp);
+
+    // starts[c] is the first entry of command c and starts[numcmds] = numentries
+    starts = (int *) RDBMemAlloc(sizeof(int) * (numentries + 1));
+
+    for (k = 0; k < numentries; k++) {
+        if (! k || RDBTableIndexEntryCmp(&entries[k], &entries[k - 1]) || k - starts[numcmds - 1] == RDB_INDEX_ENTRIES_MAX) {
+            starts[numcmds++] = k;
+        }
+    }
+    starts[numcmds] = numentries;
+
+    argcs = (int *) RDBMemAlloc(sizeof(int) * numcmds);
+    argvs = (const char ***) RDBMemAlloc(sizeof(char **) * numcmds);
+    argvlens = (const size_t **) RDBMemAlloc(sizeof(size_t *) * numcmds);
+    replies = (redisReply **) RDBMemAlloc(sizeof(redisReply *) * numcmds);
+
+    argvbuf = (const char **) RDBMemAlloc(sizeof(char *) * (numcmds + numentries) * 2);
+    argvlenbuf = (size_t *) RDBMemAlloc(sizeof(size_t) * (numcmds + numentries) * 2);
+    keysbuf = (char *) RDBMemAlloc(keysize * numcmds);
+
+    for (c = 0; c < numcmds; c++) {
+        const RDBTableIndexEntry_t *entry = &entries[starts[c]];
+
+        const char **argv = &argvbuf[numargs];
+        size_t *argvlen = &argvlenbuf[numargs];
+        char *indexkey = &keysbuf[keysize * c];
+
+        int argc = 0;
+
+        // ZREM $indexkey $member ... or ZADD $indexkey $score $member ...
+        argv[argc] = (entry->add? "ZADD" : "ZREM");
+        argvlen[argc++] = 4;
+
+        argv[argc] = indexkey;
+        argvlen[argc++] = RDBTableIndexKey(tabledes, tabledes->indexids[entry->indexno], entry->shard, indexkey, keysize);
+
+        for (k = starts[c]; k < starts[c + 1]; k++) {
+            if (entries[k].add) {
+                argv[argc] = entries[k].score;
+                argvlen[argc++] = strlen(entries[k].score);
+            }
+
+            argv[argc] = entries[k].member;
+            argvlen[argc++] = entries[k].memberlen;
+        }
+
+        argcs[c] = argc;
+        argvs[c] = argv;
+        argvlens[c] = argvlen;
+
+        numargs += argc;
+    }
+
+    RedisExecArgvPipelined(ctx, numcmds, argcs, argvs, argvlens, replies);
+
+    RedisFreeReplyObjects(replies, numcmds);
+
+    for (k = 0; k < numentries; k++) {
+        RDBMemFree(entries[k].member);
+    }
+
+    RDBMemFree(keysbuf);
+    RDBMemFree(argvlenbuf);
+    RDBMemFree(argvbuf);
+    RDBMemFree(replies);
+    RDBMemFree(argvlens);
+    RDBMemFree(argvs);
+    RDBMemFree(argcs);
+    RDBMemFree(starts);
+    RDBMemFree(entries);
+}
+
+
+/**
+ * RDBTableIndexUpdateRow
+ *   RDBTableIndexUpdateRows of one row
+ */
+void RDBTableIndexUpdateRow (RDBCtx ctx, const RDBTableDes_t *tabledes, const char *rowkey, size_t rowkeylen, redisReply *oldVals, int deleted)
+{
+    RDBTableIndexUpdateRows(ctx, tabledes, 1, &rowkey, &rowkeylen, &oldVals, deleted);
+}
+
+
+/**
+ * RDBTableCreateIndex
+ *   add field into indexes of table and build index for existed rows.
+ *   numrows: rows indexed
+ */
+RDBAPI_RESULT RDBTableCreateIndex (RDBCtx ctx, const char *tablespace, const char *tablename, const char *fieldname, ub8 *numrows)
+{
+    RDBAPI_RESULT result;
+
+    int i, fieldid, nodeindex;
+
+    RDBTableDes_t tabledes;
+
+    char indexes[RDB_KEY_VALUE_SIZE * 4];
+    int len = 0;
+
+    char timestamp[22];
+    char rowkeyshards[22];
+
+    char pattern[RDB_KEY_NAME_MAXLEN * 3];
+    int patternlen;
+
+    const char *fields[] = {"indexes", "timestamp", "rowkeyshards", 0};
+    const char *values[4];
+    size_t valueslen[4];
+
+    ub8 rows = 0;
+
+    if (numrows) {
+        *numrows = 0;
+    }
+
+    if (RDBTableDescribe(ctx, tablespace, tablename, &tabledes) != RDBAPI_SUCCESS) {
+        return RDBAPI_ERROR;
+    }
+
+    fieldid = RDBTableDesFieldIndex(&tabledes, fieldname, -1) + 1;
+    if (! fieldid) {
+        snprintf_chkd_V1(ctx->errmsg, sizeof(ctx->errmsg), "RDBAPI_ERR_BADARG: field not found: '%s'", fieldname);
+        return RDBAPI_ERR_BADARG;
+    }
+
+    if (tabledes.fielddes[fieldid - 1].rowkey > 1) {
+        snprintf_chkd_V1(ctx->errmsg, sizeof(ctx->errmsg), "RDBAPI_ERR_BADARG: only the first field of rowkey can be indexed: '%s'", fieldname);
+        return RDBAPI_ERR_BADARG;
+    }
+
+    if (! RDBTableIndexType(tabledes.fielddes[fieldid - 1].fieldtype)) {
+        snprintf_chkd_V1(ctx->errmsg, sizeof(ctx->errmsg), "RDBAPI_ERR_BADARG: type of field can not be indexed: '%s'", fieldname);
+        return RDBAPI_ERR_BADARG;
+    }
+
+    for (i = 1; i <= tabledes.indexids[0]; i++) {
+        const RDBFieldDes_t *fdes = &tabledes.fielddes[tabledes.indexids[i] - 1];
+
+        if (tabledes.indexids[i] == fieldid) {
+            snprintf_chkd_V1(ctx->errmsg, sizeof(ctx->errmsg), "RDBAPI_ERR_BADARG: index already existed: '%s'", fieldname);
+            return RDBAPI_ERR_BADARG;
+        }
+
+        len += snprintf_chkd_V1(indexes + len, sizeof(indexes) - len, "%.*s,", fdes->namelen, fdes->fieldname);
+    }
+
+    len += snprintf_chkd_V1(indexes + len, sizeof(indexes) - len, "%.*s", tabledes.fielddes[fieldid - 1].namelen, tabledes.fielddes[fieldid - 1].fieldname);
+
+    values[0] = indexes;
+    values[1] = timestamp;
+    values[2] = 0;
+    values[3] = 0;
+
+    valueslen[0] = len;
+    valueslen[1] = snprintf_chkd_V1(timestamp, sizeof(timestamp), "%"PRIu64, RDBGetLocalTime(NULL));
+    valueslen[2] = 0;
+    valueslen[3] = 0;
+
+    if (tabledes.fielddes[fieldid - 1].rowkey) {
+        // number of shards of rowkey index never changes once created
+        tabledes.rowkeyshards = RDB_ROWKEY_INDEX_SHARDS;
+
+        values[2] = rowkeyshards;
+        valueslen[2] = snprintf_chkd_V1(rowkeyshards, sizeof(rowkeyshards), "%d", tabledes.rowkeyshards);
+    } else {
+        fields[2] = 0;
+    }
+
+    // HMSET {redisdb::$tablespace:$tablename} indexes $indexes timestamp $timestamp [rowkeyshards $rowkeyshards]
+    result = RedisHMSet(ctx, tabledes.table_rowkey, fields, values, valueslen, RDBAPI_KEY_PERSIST);
+
+    RDBEnvInvalidTableDes(ctx->env, tablespace, tablename);
+
+    if (result != RDBAPI_SUCCESS) {
+        return result;
+    }
+
+    // rows upserted from now on maintain the new index. existed rows are
+    //   indexed only by the new index here.
+    tabledes.indexids[0] = 1;
+    tabledes.indexids[1] = fieldid;
+
+    patternlen = snprintf_chkd_V1(pattern, sizeof(pattern), "{%s::%s:*}", tablespace, tablename);
+
+    *ctx->errmsg = 0;
+
+    for (nodeindex = 0; nodeindex < ctx->topology->numnodes; nodeindex++) {
+        RDBTableCursor_t nodestate = {0};
+
+        RDBCtxNode ctxnode = RDBCtxGetNode(ctx, nodeindex);
+
+        if (! RDBCtxNodeIsMaster(ctx, nodeindex)) {
+            continue;
+        }
+
+        while (! nodestate.finished) {
+            size_t k;
+            redisReply *replyRows = NULL;
+
+            result = RDBTableScanOnNode(ctxnode, &nodestate, pattern, patternlen, RDB_TABLE_LIMIT_MAX, &replyRows);
+            if (result != RDBAPI_SUCCESS) {
+                if (result == RDBAPI_CONTINUE && ! *ctx->errmsg) {
+                    continue;
+                }
+
+                return RDBAPI_ERROR;
+            }
+
+            for (k = 0; k < replyRows->elements; k++) {
+                redisReply *replyRowkey = replyRows->element[k];
+
+                if (replyRowkey->type == REDIS_REPLY_STRING) {
+                    RDBTableIndexUpdateRow(ctx, &tabledes, replyRowkey->str, replyRowkey->len, NULL, 0);
+                    rows++;
+                }
+            }
+
+            RedisFreeReplyObject(&replyRows);
+        }
+    }
+
+    if (numrows) {
+        *numrows = rows;
+    }
+
+    return RDBAPI_SUCCESS;
+}
+
+
+/**
+ * background DROP TABLE
+ *   table is tombstoned at once by field 'dropping' of its descriptor so it
+ *   is invisible to RDBTableDescribe. rows are reclaimed by one job per
+ *   table: a worker for each master SCANs rows of table and UNLINKs them
+ *   page by page under rate limit. the descriptor is deleted when all rows
+ *   have been reclaimed. a job stopped (RDBEnvDestroy) or failed keeps the
+ *   tombstone and is resumed by DROP TABLE again.
+ */
+typedef struct _RDBTableDropJob_t
+{
+    struct _RDBTableDropJob_t *next;
+
+    rdbthread_t thread;
+
+    // 0: run in current thread
+    int threaded;
+
+    RDBEnv env;
+
+    char tablespace[RDB_KEY_NAME_MAXLEN + 1];
+    char tablename[RDB_KEY_NAME_MAXLEN + 1];
+
+    // {redisdb::$tablespace:$tablename}
+    char table_rowkey[256];
+
+    // {$tablespace::$tablename:* matches rows and SET fields of rows
+    char pattern[RDB_KEY_NAME_MAXLEN * 2 + 8];
+    int patternlen;
+
+    volatile int stopped;
+    volatile int finished;
+} RDBTableDropJob_t, *RDBTableDropJob;
+
+
+typedef struct _RDBTableDropWorker_t
+{
+    rdbthread_t thread;
+
+    RDBTableDropJob job;
+
+    // private ctx for this worker
+    RDBCtx ctx;
+
+    int nodeindex;
+
+    // 0: run in current thread
+    int threaded;
+
+    // rows per second reclaimed on this node. 0: unlimited
+    ub4 ratelimit;
+
+    RDBAPI_RESULT result;
+} RDBTableDropWorker_t, *RDBTableDropWorker;
+
+
+static RDBTHREAD_PROC(RDBTableDropWorkerProc, arg)
+{
+    RDBTableDropWorker worker = (RDBTableDropWorker) arg;
+    RDBTableDropJob job = worker->job;
+
+    RDBCtxNode ctxnode = RDBCtxGetNode(worker->ctx, worker->nodeindex);
+    RDBTableCursor_t nodestate = {0};
+
+    ub8 reclaimed = 0;
+    ub8 startms = RDBGetLocalTime(NULL);
+
+    worker->result = RDBAPI_SUCCESS;
+
+    while (! job->stopped && ! nodestate.finished) {
+        redisReply *replyKeys = NULL;
+
+        const char **keys;
+        size_t *keyslen;
+        int *stats;
+
+        int i, numkeys = 0, deleted;
+
+        if (RDBTableScanOnNode(ctxnode, &nodestate, job->pattern, job->patternlen, RDB_UNLINK_KEYS_MAX, &replyKeys) != RDBAPI_SUCCESS) {
+            if (! *worker->ctx->errmsg) {
+                // empty page
+                continue;
+            }
+
+            worker->result = RDBAPI_ERROR;
+            break;
+        }
+
+        keys = (const char **) RDBMemAlloc(sizeof(char *) * replyKeys->elements);
+        keyslen = (size_t *) RDBMemAlloc(sizeof(size_t) * replyKeys->elements);
+        stats = (int *) RDBMemAlloc(sizeof(int) * replyKeys->elements);
+
+        for (i = 0; i < (int) replyKeys->elements; i++) {
+            redisReply *key = replyKeys->element[i];
+
+            if (key->type == REDIS_REPLY_STRING) {
+                keys[numkeys] = key->str;
+                keyslen[numkeys++] = key->len;
+            }
+        }
+
+        deleted = RedisUnlinkKeys(worker->ctx, keys, keyslen, numkeys, stats);
+
+        RDBMemFree(stats);
+        RDBMemFree(keyslen);
+        RDBMemFree(keys);
+
+        RedisFreeReplyObject(&replyKeys);
+
+        if (deleted > 0) {
+            // HINCRBY {redisdb::$tablespace:$tablename} reclaimed $deleted
+            char num[22];
+            const char *argv[4] = {"HINCRBY", job->table_rowkey, "reclaimed", num};
+            size_t argvlen[4] = {7, strlen(job->table_rowkey), 9, 0};
+
+            redisReply *reply;
+
+            argvlen[3] = snprintf_chkd_V1(num, sizeof(num), "%d", deleted);
+
+            reply = RedisExecCommandArgv(worker->ctx, 4, argv, argvlen);
+            RedisFreeReplyObject(&reply);
+
+            reclaimed += deleted;
+        }
+
+        if (worker->ratelimit) {
+            // sleep in short steps so stop request is seen in time
+            ub8 expectms = reclaimed * 1000 / worker->ratelimit;
+            ub8 elapsedms = RDBGetLocalTime(NULL) - startms;
+
+            while (! job->stopped && expectms > elapsedms) {
+                rdbsleep_msec((int) (expectms - elapsedms < 100? expectms - elapsedms : 100));
+                elapsedms = RDBGetLocalTime(NULL) - startms;
+            }
+        }
+    }
+
+    RDBTHREAD_RETURN;
+}
+
+
+static RDBTHREAD_PROC(RDBTableDropJobProc, arg)
+{
+    RDBTableDropJob job = (RDBTableDropJob) arg;
+    RDBEnv env = job->env;
+
+    int nodeindex, numworkers = 0, failed = 0;
+
+    RDBTableDropWorker_t workers[RDB_CLUSTER_NODES_MAX];
+
+    // rate limit of env is shared by masters
+    ub4 ratelimit = env->dropratelimit;
+    int nummasters = RDBEnvNumMasterNodes(env);
+
+    if (ratelimit && nummasters > 1) {
+        ratelimit = (ratelimit / nummasters? ratelimit / nummasters : 1);
+    }
+
+    for (nodeindex = 0; nodeindex < RDBEnvNumNodes(env); nodeindex++) {
+        RDBEnvNode envnode = RDBEnvGetNode(env, nodeindex);
+
+        if (RDBEnvNodeGetMaster(envnode, NULL) == RDBAPI_TRUE) {
+            RDBTableDropWorker worker = &workers[numworkers++];
+
+            bzero(worker, sizeof(*worker));
+
+            worker->job = job;
+            worker->ctx = RDBCtxNew(env);
+            worker->nodeindex = nodeindex;
+            worker->ratelimit = ratelimit;
+
+            if (rdbthread_create(&worker->thread, RDBTableDropWorkerProc, worker) == 0) {
+                worker->threaded = 1;
+            } else {
+                // run in current thread if failed to create thread
+                RDBTableDropWorkerProc(worker);
+            }
+        }
+    }
 
-                if (NumRows) {
-                    CurRows = LmtRows - NumRows;
-                }
+    for (nodeindex = 0; nodeindex < numworkers; nodeindex++) {
+        RDBTableDropWorker worker = &workers[nodeindex];
 
-                if (CurRows > 0) {
-                    result = RDBTableScanOnNode(ctxnode, nodestate, resultmap->filter->keypattern, resultmap->filter->patternlen, CurRows, &replyRows);
-                } else {
-                    LastOffs = RDBResultMapGetOffset(resultmap);
-                    goto return_offset;
-                }
+        if (worker->threaded) {
+            rdbthread_join(worker->thread);
+        }
 
-                if (result == RDBAPI_SUCCESS) {
-                    LastOffs = RDBResultMapGetOffset(resultmap);
+        if (worker->result != RDBAPI_SUCCESS) {
+            LOGGER_WARN("drop table '%s.%s' on node(%d) failed: %s", job->tablespace, job->tablename, worker->nodeindex, worker->ctx->errmsg);
+            failed = 1;
+        }
 
-                    if (LastOffs > OffRows) {
-                        // here we should add new rows
-                        size_t i = 0;
+        RDBCtxFree(worker->ctx);
+    }
 
-                        if (OffRows > SaveOffs) {
-                            i = OffRows - SaveOffs;
-                        }
+    if (! failed && ! job->stopped) {
+        // all rows reclaimed: remove tombstone
+        RDBCtx ctx = RDBCtxNew(env);
 
-                        for (; i != replyRows->elements; i++) {
-                            int addcount = 0;
-                            redisReply *replyRowkey = replyRows->element[i];
+        RedisDeleteKey(ctx, job->table_rowkey, strlen(job->table_rowkey), NULL, 0);
 
-                            if (replyRowkey && replyRowkey->type == REDIS_REPLY_STRING && replyRowkey->len) {
-                                // split rowkey str into vals with rowkeyfilters
-                                if (RDBTableFilterRowkeyVals(resultmap->filter, resultmap->filter->patternprefixlen, replyRowkey->str, (int)replyRowkey->len, rkvals, rkvalslen) != rowkeynum) {
-                                    // filter by rowkeyfilters failed
-                                    continue;
-                                }
+        RDBCtxFree(ctx);
 
-                                if (resultmap->filter->getfieldids[0]) {
-                                    // cal hmget to get values of fields
-                                    if (RedisHMGetLen(ctx, replyRowkey->str, replyRowkey->len, resultmap->filter->getfieldnames, resultmap->filter->getfieldnameslen, &replyCols) == RDBAPI_SUCCESS) {
+        RDBEnvInvalidTableDes(env, job->tablespace, job->tablename);
+    }
 
-                                        if (RDBTableFilterReplyCols(resultmap->filter, replyCols) == fieldsnum) {
-                                            // passed WHERE filter ok
+    job->finished = 1;
 
-                                            if (! resultmap->filter->sqlstmt->sqlfunc) {
-                                                RDBRow row = NULL;
+    RDBTHREAD_RETURN;
+}
 
-                                                if (RDBRowNew(resultmap, replyRowkey->str, replyRowkey->len, &row) == RDBAPI_SUCCESS) {
-                                                    if (RDBResultMapInsertRow(resultmap, row) == RDBAPI_SUCCESS) {
-                                                        // set rowkey fields
-                                                        for (colindex = 0; colindex < rowkeynum; colindex++) {
-                                                            RDBCellSetString(RDBRowCell(row, colindex), rkvals[colindex], rkvalslen[colindex]);
-                                                        }
 
-                                                        // set attr fields
-                                                        for (colindex = 0; colindex < resultmap->filter->selfieldnum; colindex++) {
-                                                            replyCol = replyCols->element[colindex];
+/**
+ * RDBTableDrop
+ *   tombstone table and its indexes at once and reclaim rows in background.
+ *   DROP TABLE on a table being dropped resumes its reclaiming.
+ *
+ * returns:
+ *   RDBAPI_SUCCESS: table dropped (rows are being reclaimed)
+ *   RDBAPI_ERROR: table not found
+ */
+RDBAPI_RESULT RDBTableDrop (RDBCtx ctx, const char *tablespace, const char *tablename)
+{
+    RDBAPI_RESULT res;
 
-                                                            if (RDBCellSetReply(RDBRowCell(row, rowkeynum + colindex), replyCol)) {
-                                                                replyCols->element[colindex] = NULL;
-                                                            }
-                                                        }
-                                                    } else {
-                                                        // failed on duplicated rowkey
-                                                        RDBRowFree(row);
-                                                    }
-                                                }
-                                            } else {
-                                                if (resultmap->filter->sqlstmt->sqlfunc == RDBSQL_FUNC_COUNT) {
-                                                    addcount = 1;
-                                                }
-                                            }
-                                        }
+    RDBEnv env = ctx->env;
 
-                                        RedisFreeReplyObject(&replyCols);
-                                    }
-                                } else {
-                                    if (resultmap->filter->sqlstmt->sqlfunc == RDBSQL_FUNC_COUNT) {
-                                        addcount = 1;
-                                    }
-                                }
-                            }
+    RDBTableDes_t tabledes;
+    RDBTableDropJob job, *link;
 
-                            if (addcount) {
-                                RDBRowIter rowiter = RDBResultMapFirstRow(resultmap);
-                                RDBRow row = RDBRowIterGetRow(rowiter);
-                                RDBCell cell = RDBRowCell(row, 0);
+    int threaded;
 
-                                RDBCellSetInteger(cell, RDBCellGetInteger(cell) + 1);
-                            }
-                        }
-                    }
+    res = RDBTableDescribe(ctx, tablespace, tablename, &tabledes);
 
-                    RedisFreeReplyObject(&replyRows);
-                }
-            } else {
-                nodeindex++;
-            }
+    if (res == RDBAPI_SUCCESS) {
+        int i;
+
+        char keybuf[RDB_KEY_NAME_MAXLEN * 4];
+        char stamp[22];
+
+        const char *argv[8];
+        size_t argvlen[8];
+
+        redisReply *reply;
+
+        // unlink indexes of table
+        argv[0] = "UNLINK";
+        argvlen[0] = 6;
+
+        argv[1] = keybuf;
+
+        for (i = 1; i <= tabledes.indexids[0]; i++) {
+            int shard = 0;
+
+            do {
+                argvlen[1] = RDBTableIndexKey(&tabledes, tabledes.indexids[i], shard, keybuf, sizeof(keybuf));
+
+                reply = RedisExecCommandArgv(ctx, 2, argv, argvlen);
+                RedisFreeReplyObject(&reply);
+            } while (tabledes.fielddes[tabledes.indexids[i] - 1].rowkey && ++shard < tabledes.rowkeyshards);
+        }
+
+        // HMSET {redisdb::$tablespace:$tablename} dropping $stamp reclaimed 0 timestamp $stamp
+        argv[0] = "HMSET";
+        argvlen[0] = 5;
+
+        argv[1] = tabledes.table_rowkey;
+        argvlen[1] = strlen(tabledes.table_rowkey);
+
+        argv[2] = "dropping";
+        argvlen[2] = 8;
+
+        argv[3] = stamp;
+        argvlen[3] = snprintf_chkd_V1(stamp, sizeof(stamp), "%"PRIu64, RDBGetLocalTime(NULL));
+
+        argv[4] = "reclaimed";
+        argvlen[4] = 9;
+
+        argv[5] = "0";
+        argvlen[5] = 1;
+
+        // changed timestamp lets cached descriptors be revalidated
+        argv[6] = "timestamp";
+        argvlen[6] = 9;
+
+        argv[7] = stamp;
+        argvlen[7] = argvlen[3];
+
+        reply = RedisExecCommandArgv(ctx, 8, argv, argvlen);
+
+        if (! RedisCheckReplyStatus(reply, "OK", 2)) {
+            snprintf_chkd_V1(ctx->errmsg, sizeof(ctx->errmsg), "RDBAPI_ERROR: failed to tombstone table: %s", tabledes.table_rowkey);
+            RedisFreeReplyObject(&reply);
+            return RDBAPI_ERROR;
         }
+
+        RedisFreeReplyObject(&reply);
+    } else if (res != RDBAPI_ERR_REJECTED) {
+        // table not found
+        return RDBAPI_ERROR;
     }
 
-return_offset:
-    return LastOffs;
-}
+    RDBEnvInvalidTableDes(env, tablespace, tablename);
 
+    threadlock_lock(&env->thrlock);
 
-RDBAPI_RESULT RDBTableCreate (RDBCtx ctx, const char *tablespace, const char *tablename, const char *tablecomment, int nfields, RDBFieldDes_t *fieldes)
-{
-    RDBAPI_RESULT  result;
+    link = &env->dropjobs;
 
-    int rowkeyid[RDBAPI_SQL_KEYS_MAX + 1] = {0};
+    while ((job = *link) != NULL) {
+        if (job->finished) {
+            // reap finished job
+            *link = job->next;
 
-    int tablespacelen = cstr_length(tablespace, RDB_KEY_NAME_MAXLEN + 1);
-    int tablenamelen = cstr_length(tablename, RDB_KEY_NAME_MAXLEN + 1);
-    int commentlen = cstr_length(tablecomment, RDB_KEY_VALUE_SIZE - 1);
+            if (job->threaded) {
+                rdbthread_join(job->thread);
+            }
+            RDBMemFree(job);
+            continue;
+        }
 
-    char table_rowkey[RDB_KEY_NAME_MAXLEN * 3];
+        if (! strcmp(job->tablespace, tablespace) && ! strcmp(job->tablename, tablename)) {
+            // reclaiming in progress
+            threadlock_unlock(&env->thrlock);
+            return RDBAPI_SUCCESS;
+        }
 
-    char timestamp[22] = {0};
-    char numfields[10] = {0};
+        link = &job->next;
+    }
 
-    tpl_bin outbin = {0};
+    job = (RDBTableDropJob) RDBMemAlloc(sizeof(RDBTableDropJob_t));
 
-    const char * fields[] = {"numfields", "fieldes", "timestamp", "comment", 0};
-    const char * values[5];
+    job->env = env;
 
-    size_t valueslen[5];
+    snprintf_chkd_V1(job->tablespace, sizeof(job->tablespace), "%s", tablespace);
+    snprintf_chkd_V1(job->tablename, sizeof(job->tablename), "%s", tablename);
+    snprintf_chkd_V1(job->table_rowkey, sizeof(job->table_rowkey), "{%s::%s:%s}", RDB_SYSTEM_TABLE_PREFIX, tablespace, tablename);
 
-    if (tablespacelen < 2 || tablespacelen > RDB_KEY_NAME_MAXLEN) {
-        snprintf_chkd_V1(ctx->errmsg, sizeof(ctx->errmsg), "RDBAPI_ERR_BADARG: invalid tablespace: %s", tablespace);
-        return RDBAPI_ERR_BADARG;
+    job->patternlen = snprintf_chkd_V1(job->pattern, sizeof(job->pattern), "{%s::%s:*", tablespace, tablename);
+
+    // thread created and threaded set before job is published, so a reaper
+    //   always sees how to join it. job proc waits for thrlock if it needs
+    threaded = (rdbthread_create(&job->thread, RDBTableDropJobProc, job) == 0? 1 : 0);
+    job->threaded = threaded;
+
+    if (threaded) {
+        job->next = env->dropjobs;
+        env->dropjobs = job;
     }
-    if (tablenamelen < 4 || tablenamelen > RDB_KEY_NAME_MAXLEN) {
-        snprintf_chkd_V1(ctx->errmsg, sizeof(ctx->errmsg), "RDBAPI_ERR_BADARG: invalid tablename: %s", tablename);
-        return RDBAPI_ERR_BADARG;
+
+    threadlock_unlock(&env->thrlock);
+
+    if (! threaded) {
+        // reclaim in current thread if failed to create thread. job is not
+        //   published, so neither reaper nor RDBTableDropJobsStop frees it
+        RDBTableDropJobProc(job);
+        RDBMemFree(job);
     }
 
-    if (! RDBFieldDesCheckSet(ctx->env->valtypetable, fieldes, nfields, rowkeyid, ctx->errmsg, sizeof(ctx->errmsg))) {
-        return RDBAPI_ERROR;
+    return RDBAPI_SUCCESS;
+}
+
+
+RDBAPI_BOOL RDBTableDropProgress (RDBCtx ctx, const char *tablespace, const char *tablename, ub8 *reclaimed)
+{
+    RDBAPI_BOOL dropping = RDBAPI_FALSE;
+
+    redisReply *reply = NULL;
+
+    char table_rowkey[256];
+
+    const char *fldnames[] = {"dropping", "reclaimed", 0};
+
+    snprintf_chkd_V1(table_rowkey, sizeof(table_rowkey), "{%s::%s:%s}", RDB_SYSTEM_TABLE_PREFIX, tablespace, tablename);
+
+    *reclaimed = 0;
+
+    // HMGET {redisdb::$tablespace:$tablename} dropping reclaimed
+    if (RedisHMGet(ctx, table_rowkey, fldnames, &reply) == RDBAPI_SUCCESS) {
+        if (reply->element[0]->type == REDIS_REPLY_STRING) {
+            dropping = RDBAPI_TRUE;
+
+            if (reply->element[1]->type == REDIS_REPLY_STRING) {
+                cstr_to_ub8(10, reply->element[1]->str, (int) reply->element[1]->len, reclaimed);
+            }
+        }
     }
 
-    // {redisdb::$tablespace:$tablename}
-    snprintf_chkd_V1(table_rowkey, sizeof(table_rowkey), "{%s::%.*s:%.*s}", RDB_SYSTEM_TABLE_PREFIX, tablespacelen, tablespace, tablenamelen, tablename);
+    RedisFreeReplyObject(&reply);
 
-    if (RDBFieldDesPack(fieldes, nfields, &outbin) != 0) {
-        snprintf_chkd_V1(ctx->errmsg, sizeof(ctx->errmsg), "(%s:%d) RDBAPI_ERROR: RDBFieldDesPack failed.", __FILE__, __LINE__);
-        return RDBAPI_ERROR;
+    return dropping;
+}
+
+
+void RDBTableDropJobsStop (RDBEnv env)
+{
+    RDBTableDropJob job, next;
+
+    threadlock_lock(&env->thrlock);
+
+    job = env->dropjobs;
+    env->dropjobs = NULL;
+
+    threadlock_unlock(&env->thrlock);
+
+    for (next = job; next; next = next->next) {
+        next->stopped = 1;
     }
 
-    values[0] = numfields;
-    values[1] = (char *) outbin.addr;
-    values[2] = timestamp;
-    values[3] = tablecomment;
-    values[4] = 0;
+    while (job) {
+        next = job->next;
 
-    valueslen[0] = snprintf_chkd_V1(numfields, sizeof(numfields), "%d", nfields);
-    valueslen[1] = outbin.sz;
-    valueslen[2] = snprintf_chkd_V1(timestamp, sizeof(timestamp), "%"PRIu64, RDBGetLocalTime(NULL));
-    valueslen[3] = commentlen;
-    valueslen[4] = 0;
+        if (job->threaded) {
+            rdbthread_join(job->thread);
+        }
+        RDBMemFree(job);
 
-    result = RedisHMSet(ctx, table_rowkey, fields, values, valueslen, RDBAPI_KEY_PERSIST);
-    free(outbin.addr);
-    return result;
+        job = next;
+    }
 }
 
 
-RDBAPI_RESULT RDBTableDescribe (RDBCtx ctx, const char *tablespace, const char *tablename, RDBTableDes_t *tabledes)
+static ub8 RDBTableGetTimestamp (RDBCtx ctx, const char *tablespace, const char *tablename)
 {
-    ub8 u8val;
-    redisReply *tableReply = NULL;
+    ub8 u8val = (ub8)(-1);
 
-    const char *fldnames[] = {"numfields", "fieldes", "timestamp", "comment", 0};
+    redisReply *reply = NULL;
 
-    bzero(tabledes, sizeof(*tabledes));
+    char table_rowkey[256] = {0};
 
-    if (! strcmp(tablespace, RDB_SYSTEM_TABLE_PREFIX)) {
-        snprintf_chkd_V1(ctx->errmsg, sizeof(ctx->errmsg), "(%s:%d) RDBAPI_ERROR: system tablespace: %s", __FILE__, __LINE__, tablespace);
-        return RDBAPI_ERROR;
+    const char *fldnames[] = {"timestamp", 0};
+
+    snprintf_chkd_V1(table_rowkey, sizeof(table_rowkey), "{%s::%s:%s}", RDB_SYSTEM_TABLE_PREFIX, tablespace, tablename);
+
+    // HMGET {redisdb::$tablespace:$tablename} timestamp
+    if (RedisHMGet(ctx, table_rowkey, fldnames, &reply) == RDBAPI_SUCCESS) {
+        cstr_to_ub8(10, reply->element[0]->str, reply->element[0]->len, &u8val);
     }
 
-    // hmget {redisdb::$tablespace:$tablename} numfields fieldes timestamp comment
-    snprintf_chkd_V1(tabledes->table_rowkey, sizeof(tabledes->table_rowkey) - 1, "{%s::%s:%s}", RDB_SYSTEM_TABLE_PREFIX, tablespace, tablename);
+    if (reply) {
+        freeReplyObject(reply);
+    }
 
-    if (RedisHMGet(ctx, tabledes->table_rowkey, fldnames, &tableReply) != RDBAPI_SUCCESS) {
-        snprintf_chkd_V1(ctx->errmsg, sizeof(ctx->errmsg), "RDBAPI_ERROR: key not found: %s", tabledes->table_rowkey);
-        return RDBAPI_ERROR;
+    return u8val;
+}
+
+
+/**
+ * RDBTableDesCacheLoad
+ *   load table descriptor from env cache. an entry older than ttl is
+ *   revalidated by HMGET timestamp only; full describe happens only if
+ *   table changed or not in cache.
+ *
+ * tabledes:
+ *   copy of descriptor, could be NULL if only timestamp wanted
+ */
+static RDBAPI_RESULT RDBTableDesCacheLoad (RDBCtx ctx, const char *tablespace, const char *tablename, RDBTableDes_t *tabledes, ub8 *timestamp)
+{
+    RDBEnv env = ctx->env;
+    RDBTableDesEntry_t *entry, *old;
+
+    char key[RDB_KEY_NAME_MAXLEN * 2 + 2];
+    int keylen;
+
+    int cached = 0;
+    ub8 cachedstamp = 0;
+    ub8 now = RDBGetLocalTime(NULL);
+
+    keylen = snprintf_chkd_V1(key, sizeof(key), "%s.%s", tablespace, tablename);
+
+    threadlock_lock(&env->thrlock);
+
+    HASH_FIND(hh, env->tabledesmap, key, keylen, entry);
+    if (entry) {
+        if (now - entry->checkstamp < env->tabledesttl) {
+            if (tabledes) {
+                memcpy(tabledes, &entry->tabledes, sizeof(*tabledes));
+            }
+            *timestamp = entry->tabledes.table_timestamp;
+
+            threadlock_unlock(&env->thrlock);
+            return RDBAPI_SUCCESS;
+        }
+
+        cached = 1;
+        cachedstamp = entry->tabledes.table_timestamp;
     }
 
-    u8val = 0;
-    cstr_to_ub8(10, tableReply->element[0]->str, tableReply->element[0]->len, &u8val);
-    tabledes->nfields = (int) u8val;
+    threadlock_unlock(&env->thrlock);
 
-    if (!tableReply->element[1]->str || ! tableReply->element[1]->len || ! tabledes->nfields) {
-        snprintf_chkd_V1(ctx->errmsg, sizeof(ctx->errmsg), "RDBAPI_ERROR: invalid fieldes: %s", tabledes->table_rowkey);
-        RedisFreeReplyObject(&tableReply);
-        return RDBAPI_ERROR;
+    if (cached && cachedstamp == RDBTableGetTimestamp(ctx, tablespace, tablename)) {
+        // table not changed: renew check time only
+        threadlock_lock(&env->thrlock);
+
+        HASH_FIND(hh, env->tabledesmap, key, keylen, entry);
+        if (entry && entry->tabledes.table_timestamp == cachedstamp) {
+            entry->checkstamp = now;
+
+            if (tabledes) {
+                memcpy(tabledes, &entry->tabledes, sizeof(*tabledes));
+            }
+            *timestamp = cachedstamp;
+
+            threadlock_unlock(&env->thrlock);
+            return RDBAPI_SUCCESS;
+        }
+
+        threadlock_unlock(&env->thrlock);
     }
 
-    if (! RDBFieldDesUnpack(tableReply->element[1]->str, tableReply->element[1]->len, tabledes->fielddes, tabledes->nfields)) {
-        snprintf_chkd_V1(ctx->errmsg, sizeof(ctx->errmsg), "RDBAPI_ERROR: RDBFieldDesUnpack: %s", tabledes->table_rowkey);
-        RedisFreeReplyObject(&tableReply);
+    entry = (RDBTableDesEntry_t *) RDBMemAlloc(sizeof(RDBTableDesEntry_t));
+    if (! entry) {
+        snprintf_chkd_V1(ctx->errmsg, sizeof(ctx->errmsg), "RDBAPI_ERR_NOMEM: out of memory");
+        return RDBAPI_ERR_NOMEM;
+    }
+
+    if (RDBTableDescribe(ctx, tablespace, tablename, &entry->tabledes) != RDBAPI_SUCCESS) {
+        RDBMemFree(entry);
+        RDBEnvInvalidTableDes(env, tablespace, tablename);
         return RDBAPI_ERROR;
     }
 
-    cstr_to_ub8(10, tableReply->element[2]->str, (int) tableReply->element[2]->len, &tabledes->table_timestamp);
+    memcpy(entry->key, key, keylen + 1);
+    entry->checkstamp = now;
 
-    snprintf_chkd_V1(tabledes->table_comment, sizeof(tabledes->table_comment), "%.*s", (int)tableReply->element[3]->len, tableReply->element[3]->str);
+    if (tabledes) {
+        memcpy(tabledes, &entry->tabledes, sizeof(*tabledes));
+    }
+    *timestamp = entry->tabledes.table_timestamp;
 
-    RedisFreeReplyObject(&tableReply);
+    threadlock_lock(&env->thrlock);
 
-    if (! RDBFieldDesCheckSet(ctx->env->valtypetable, tabledes->fielddes, tabledes->nfields, tabledes->rowkeyid, ctx->errmsg, sizeof(ctx->errmsg))) {
-        return RDBAPI_ERROR;
+    HASH_FIND(hh, env->tabledesmap, key, keylen, old);
+    if (old) {
+        HASH_DEL(env->tabledesmap, old);
+        RDBMemFree(old);
     }
 
+    HASH_ADD(hh, env->tabledesmap, key, keylen, entry);
+
+    threadlock_unlock(&env->thrlock);
+
     return RDBAPI_SUCCESS;
 }
+
+
+RDBAPI_RESULT RDBTableDescribeCached (RDBCtx ctx, const char *tablespace, const char *tablename, RDBTableDes_t *tabledes)
+{
+    ub8 timestamp;
+
+    if (! ctx->env->tabledesttl) {
+        return RDBTableDescribe(ctx, tablespace, tablename, tabledes);
+    }
+
+    return RDBTableDesCacheLoad(ctx, tablespace, tablename, tabledes, &timestamp);
+}
+
+
+ub8 RDBTableGetTimestampCached (RDBCtx ctx, const char *tablespace, const char *tablename)
+{
+    ub8 timestamp = (ub8)(-1);
+
+    if (! ctx->env->tabledesttl) {
+        return RDBTableGetTimestamp(ctx, tablespace, tablename);
+    }
+
+    if (RDBTableDesCacheLoad(ctx, tablespace, tablename, NULL, &timestamp) != RDBAPI_SUCCESS) {
+        return (ub8)(-1);
+    }
+
+    return timestamp;
+}
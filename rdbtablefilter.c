@@ -33,6 +33,8 @@
  */
 #include "rdbtablefilter.h"
 
+#include "common/cstrsimd.h"
+
 
 /**
  * https://github.com/kokke/tiny-regex-c
@@ -43,6 +45,22 @@
 #define RDBEXPR_SGN(a, b)  ((a)>(b)? 1:((a)<(b)? (-1):0))
 
 
+// 1 if src[0..slen) matches compiled pattern. src is a slice of rowkey or
+//   reply not terminated by '\0'
+static int RDBFilterNodeMatch (re_t regex, int automaton, const char *src, int slen)
+{
+    if (! src || ! regex) {
+        return 0;
+    }
+
+    if (automaton) {
+        return re_matchp_nfa_n(regex, src, slen);
+    }
+
+    return (re_matchp_n(regex, src, slen) == -1? 0 : 1);
+}
+
+
 // src $expr dst ? true(1) : false(0)
 
 //  1: accept
@@ -121,15 +139,11 @@ int doNodeExprValue (RDBFilterNode node, const char *src, int slen)
 
         case RDBFIL_LIKE:
             // a like 'left%' or '%mid%' or '%right'
-            result = cstr_containwith(src, slen, node->dest, node->destlen);
+            result = cstr_containwith_simd(src, slen, node->dest, node->destlen);
             break;
 
         case RDBFIL_MATCH:
-            if (re_match(src, node->dest) == -1) {
-                result = 0;
-            } else {
-                result = 1;
-            }
+            result = RDBFilterNodeMatch(node->regex, node->automaton, src, slen);
             break;
         }
 
@@ -195,12 +209,15 @@ int doNodeExprValue (RDBFilterNode node, const char *src, int slen)
 }
 
 
-RDBFilterNode RDBFilterNodeAdd (RDBFilterNode existed, RDBFilterExpr expr, RDBValueType valtype, const char *dest, int destlen)
+RDBFilterNode RDBFilterNodeAdd (mem_arena_t *arena, RDBFilterNode existed, RDBFilterExpr expr, RDBValueType valtype, const char *dest, int destlen)
 {
     RDBFilterNode newnode;
 
     int null_dest = 0;
 
+    // compiled pattern of MATCH is kept after dest in node
+    size_t nodesize, regexoff = 0;
+
     if (destlen == -1) {
         destlen = cstr_length(dest, RDB_KEY_VALUE_SIZE - 1);
     }
@@ -209,7 +226,18 @@ RDBFilterNode RDBFilterNodeAdd (RDBFilterNode existed, RDBFilterExpr expr, RDBVa
         null_dest = 1;
     }
 
-    newnode = (RDBFilterNode) RDBMemAlloc(sizeof(RDBFilterNode_t) + destlen + 1);
+    nodesize = sizeof(RDBFilterNode_t) + destlen + 1;
+
+    if (expr == RDBFIL_MATCH) {
+        regexoff = (nodesize + 15) & ~((size_t) 15);
+        nodesize = regexoff + re_compiled_size();
+    }
+
+    if (arena) {
+        newnode = (RDBFilterNode) mem_arena_alloc(arena, nodesize);
+    } else {
+        newnode = (RDBFilterNode) RDBMemAlloc(nodesize);
+    }
 
     newnode->next = existed;
 
@@ -220,6 +248,12 @@ RDBFilterNode RDBFilterNodeAdd (RDBFilterNode existed, RDBFilterExpr expr, RDBVa
     newnode->destlen = destlen;
     memcpy(newnode->dest, dest, destlen);
 
+    if (regexoff) {
+        // compile once rather than per row (re_match)
+        newnode->regex = re_compile_r(newnode->dest, (char *) newnode + regexoff);
+        newnode->automaton = (RDB_REGEX_AUTOMATON_MINLEN && destlen >= RDB_REGEX_AUTOMATON_MINLEN);
+    }
+
     // validate dest value
     if (! newnode->null_dest) {
         switch (valtype) {
@@ -236,6 +270,7 @@ RDBFilterNode RDBFilterNodeAdd (RDBFilterNode existed, RDBFilterExpr expr, RDBVa
         case RDBVT_UB4:
         case RDBVT_UB2:
         case RDBVT_BYTE:
+        case RDBVT_STAMP:
             if (cstr_to_ub8(10, newnode->dest, newnode->destlen, &newnode->ub8_dest) > 0) {
                 newnode->val_dest = 1;
             }
@@ -290,13 +325,317 @@ int RDBFilterNodeExpr (RDBFilterNode node, const char *sour, int sourlen)
 }
 
 
-RDBTableFilter RDBTableFilterNew (RDBSQLStmt sqlstmt, const char *tablespace, const char *tablename)
+// signs of compare accepted by expr: bit0 (<), bit1 (=), bit2 (>)
+static ub1 FilterExprSignMask (RDBFilterExpr expr)
 {
-    RDBTableFilter filter = (RDBTableFilter) RDBMemAlloc(sizeof(RDBTableFilter_t));
-    if (! filter) {
-        fprintf(stderr, "(%s:%d): RDBTableFilterNew failed: no memory.\n", __FILE__, __LINE__);
-        exit(EXIT_FAILURE);
+    switch (expr) {
+    case RDBFIL_EQUAL:
+        return 2;
+    case RDBFIL_NOT_EQUAL:
+        return 5;
+    case RDBFIL_GREAT_THAN:
+        return 4;
+    case RDBFIL_LESS_THAN:
+        return 1;
+    case RDBFIL_GREAT_EQUAL:
+        return 6;
+    case RDBFIL_LESS_EQUAL:
+        return 3;
+    default:
+        return 0;
+    }
+}
+
+
+/**
+ * FilterNodeCompileOp
+ *   resolve opcode of node as doNodeExprValue does. returns 0 if node
+ *   accepts all (RDBFIL_IGNORE)
+ */
+static int FilterNodeCompileOp (RDBFilterNode node, int col, RDBFilterOp_t *op)
+{
+    if (node->expr == RDBFIL_IGNORE) {
+        return 0;
+    }
+
+    op->col = (sb2) col;
+    op->slot = -1;
+    op->dest = node->dest;
+    op->destlen = node->destlen;
+    op->signmask = FilterExprSignMask(node->expr);
+    op->regex = node->regex;
+    op->automaton = node->automaton;
+
+    if (node->null_dest && (node->expr == RDBFIL_EQUAL || node->expr == RDBFIL_NOT_EQUAL)) {
+        op->opcode = (node->expr == RDBFIL_EQUAL? RDBFILOP_ISNULL : RDBFILOP_NOTNULL);
+        op->rank = 0;
+        return 1;
+    }
+
+    if (node->valtype == RDBVT_STR) {
+        switch (node->expr) {
+        case RDBFIL_LEFT_LIKE:
+            op->opcode = RDBFILOP_LEFTLIKE;
+            op->rank = 3;
+            break;
+
+        case RDBFIL_RIGHT_LIKE:
+            op->opcode = RDBFILOP_RIGHTLIKE;
+            op->rank = 3;
+            break;
+
+        case RDBFIL_LIKE:
+            op->opcode = RDBFILOP_LIKE;
+            op->rank = 5;
+            break;
+
+        case RDBFIL_MATCH:
+            op->opcode = RDBFILOP_MATCH;
+            op->rank = 6;
+            break;
+
+        default:
+            op->opcode = (op->signmask? RDBFILOP_STRCMP : RDBFILOP_REJECT);
+            op->rank = (op->signmask == 2? 1 : (op->signmask == 5? 4 : 2));
+            break;
+        }
+
+        return 1;
+    }
+
+    if (! op->signmask) {
+        // like on number always rejects
+        op->opcode = RDBFILOP_REJECT;
+        op->rank = 0;
+        return 1;
+    }
+
+    switch (node->val_dest) {
+    case 1:
+        op->opcode = RDBFILOP_UB8;
+        op->num.u8 = node->ub8_dest;
+        break;
+
+    case 2:
+        op->opcode = RDBFILOP_UB8X;
+        op->num.u8 = node->ub8_dest;
+        break;
+
+    case 3:
+        op->opcode = RDBFILOP_SB8;
+        op->num.s8 = node->sb8_dest;
+        break;
+
+    case 4:
+        op->opcode = RDBFILOP_DBL;
+        op->num.dbl = node->dbl_dest;
+        break;
+
+    default:
+        // invalid dest
+        op->opcode = RDBFILOP_REJECT;
+        op->rank = 0;
+        return 1;
+    }
+
+    op->rank = (op->signmask == 2? 1 : (op->signmask == 5? 4 : 2));
+    return 1;
+}
+
+
+static int FilterOpRankCmp (const void *a, const void *b)
+{
+    const RDBFilterOp_t *opa = (const RDBFilterOp_t *) a;
+    const RDBFilterOp_t *opb = (const RDBFilterOp_t *) b;
+
+    if (opa->rank != opb->rank) {
+        return (opa->rank < opb->rank? -1 : 1);
+    }
+
+    // keep ops on the same column together
+    return (opa->col < opb->col? -1 : (opa->col > opb->col? 1 : 0));
+}
+
+
+/**
+ * RDBFilterProgCompile
+ *   compile filternodes[1..numcols] into a program carved from arena.
+ *   returns NULL if no filter on columns.
+ */
+RDBFilterProg RDBFilterProgCompile (mem_arena_t *arena, RDBFilterNode filternodes[], int numcols)
+{
+    int col, numops = 0;
+
+    RDBFilterNode node;
+    RDBFilterProg prog;
+
+    sb2 colslots[RDBAPI_ARGV_MAXNUM + 1];
+
+    for (col = 1; col <= numcols; col++) {
+        for (node = filternodes[col]; node; node = node->next) {
+            if (node->expr != RDBFIL_IGNORE) {
+                numops++;
+            }
+        }
+    }
+
+    if (! numops) {
+        return NULL;
+    }
+
+    prog = (RDBFilterProg) mem_arena_alloc(arena, sizeof(RDBFilterProg_t) + sizeof(RDBFilterOp_t) * numops);
+
+    for (col = 1; col <= numcols; col++) {
+        for (node = filternodes[col]; node; node = node->next) {
+            prog->numops += FilterNodeCompileOp(node, col - 1, &prog->ops[prog->numops]);
+        }
+    }
+
+    qsort(prog->ops, prog->numops, sizeof(RDBFilterOp_t), FilterOpRankCmp);
+
+    // one slot for each column compared as number
+    memset(colslots, 0xff, sizeof(colslots));
+
+    for (numops = 0; numops < prog->numops; numops++) {
+        RDBFilterOp_t *op = &prog->ops[numops];
+
+        if (op->opcode >= RDBFILOP_UB8) {
+            if (colslots[op->col] == -1) {
+                colslots[op->col] = (sb2) prog->numslots++;
+            }
+            op->slot = colslots[op->col];
+        }
+    }
+
+    return prog;
+}
+
+
+/**
+ * RDBFilterProgExec
+ *   run program on values of columns (vals[i] is NULL if null)
+ *
+ * returns:
+ *   RDBTABLE_FILTER_ACCEPT
+ *   RDBTABLE_FILTER_REJECT
+ */
+int RDBFilterProgExec (const RDBFilterProg_t *prog, const char *vals[], const int valslen[])
+{
+    int i, cmp;
+
+    // 0: not parsed; 1: parsed; 2: not a number
+    ub1 parsed[RDBAPI_ARGV_MAXNUM + 1];
+    RDBFilterNum_t nums[RDBAPI_ARGV_MAXNUM + 1];
+
+    if (! prog) {
+        return RDBTABLE_FILTER_ACCEPT;
+    }
+
+    memset(parsed, 0, prog->numslots);
+
+    for (i = 0; i < prog->numops; i++) {
+        const RDBFilterOp_t *op = &prog->ops[i];
+
+        const char *src = vals[op->col];
+        int slen = valslen[op->col];
+
+        switch (op->opcode) {
+        case RDBFILOP_ISNULL:
+            if (src) {
+                return RDBTABLE_FILTER_REJECT;
+            }
+            continue;
+
+        case RDBFILOP_NOTNULL:
+            if (! src) {
+                return RDBTABLE_FILTER_REJECT;
+            }
+            continue;
+
+        case RDBFILOP_STRCMP:
+            cmp = cstr_compare_len(src, slen, op->dest, op->destlen);
+            cmp = RDBEXPR_SGN(cmp, 0);
+            break;
+
+        case RDBFILOP_LEFTLIKE:
+            if (! cstr_startwith(src, slen, op->dest, op->destlen)) {
+                return RDBTABLE_FILTER_REJECT;
+            }
+            continue;
+
+        case RDBFILOP_RIGHTLIKE:
+            if (! cstr_endwith(src, slen, op->dest, op->destlen)) {
+                return RDBTABLE_FILTER_REJECT;
+            }
+            continue;
+
+        case RDBFILOP_LIKE:
+            if (! cstr_containwith_simd(src, slen, op->dest, op->destlen)) {
+                return RDBTABLE_FILTER_REJECT;
+            }
+            continue;
+
+        case RDBFILOP_MATCH:
+            if (! RDBFilterNodeMatch(op->regex, op->automaton, src, slen)) {
+                return RDBTABLE_FILTER_REJECT;
+            }
+            continue;
+
+        case RDBFILOP_UB8:
+        case RDBFILOP_UB8X:
+        case RDBFILOP_SB8:
+        case RDBFILOP_DBL:
+            if (! parsed[op->slot]) {
+                int ok;
+
+                if (op->opcode == RDBFILOP_SB8) {
+                    ok = cstr_to_sb8(10, src, slen, &nums[op->slot].s8);
+                } else if (op->opcode == RDBFILOP_DBL) {
+                    ok = cstr_to_dbl(src, slen, &nums[op->slot].dbl);
+                } else {
+                    ok = cstr_to_ub8((op->opcode == RDBFILOP_UB8X? 16 : 10), src, slen, &nums[op->slot].u8);
+                }
+
+                parsed[op->slot] = (ok > 0? 1 : 2);
+            }
+
+            if (parsed[op->slot] != 1) {
+                return RDBTABLE_FILTER_REJECT;
+            }
+
+            if (op->opcode == RDBFILOP_SB8) {
+                cmp = RDBEXPR_SGN(nums[op->slot].s8, op->num.s8);
+            } else if (op->opcode == RDBFILOP_DBL) {
+                cmp = RDBEXPR_SGN(nums[op->slot].dbl, op->num.dbl);
+            } else {
+                cmp = RDBEXPR_SGN(nums[op->slot].u8, op->num.u8);
+            }
+            break;
+
+        default:
+            return RDBTABLE_FILTER_REJECT;
+        }
+
+        if (! ((op->signmask >> (cmp + 1)) & 1)) {
+            return RDBTABLE_FILTER_REJECT;
+        }
     }
+
+    return RDBTABLE_FILTER_ACCEPT;
+}
+
+
+RDBTableFilter RDBTableFilterNew (RDBSQLStmt sqlstmt, const char *tablespace, const char *tablename)
+{
+    RDBTableFilter filter;
+
+    mem_arena_t arena;
+    mem_arena_init(&arena, RDB_QUERY_ARENA_CHUNK);
+
+    // filter lives in its own arena
+    filter = (RDBTableFilter) mem_arena_alloc(&arena, sizeof(RDBTableFilter_t));
+    filter->arena = arena;
+
     filter->sqlstmt = sqlstmt;
     snprintf_chkd_V1(filter->table, sizeof(filter->table), "%s.%s", tablespace, tablename);
     return filter;
@@ -306,23 +645,39 @@ RDBTableFilter RDBTableFilterNew (RDBSQLStmt sqlstmt, const char *tablespace, co
 void RDBTableFilterFree (RDBTableFilter filter)
 {
     int i;
-    RDBFilterNode node;
 
-    for (i = 0; i < sizeof(filter->rowkeyfilters)/sizeof(filter->rowkeyfilters[0]); i++) {
-        node = filter->rowkeyfilters[i];
-        if (node) {
-            RDBFilterNodeFree(node);
-        }
+    // filter nodes are freed with arena
+    mem_arena_t arena = filter->arena;
+
+    if (filter->pushargv) {
+        RDBMemFree(filter->pushargv);
     }
 
-    for (i = 0; i < sizeof(filter->fieldfilters)/sizeof(filter->fieldfilters[0]); i++) {
-        node = filter->fieldfilters[i];
-        if (node) {
-            RDBFilterNodeFree(node);
+    if (filter->indexcursors) {
+        for (i = 0; i < filter->indexshards; i++) {
+            RedisFreeReplyObject(&filter->indexcursors[i].page);
         }
+
+        RDBMemFree(filter->indexcursors);
+    }
+
+    if (filter->tabledes) {
+        RDBMemFree(filter->tabledes);
     }
 
-    RDBMemFree(filter);
+    // filter itself is in arena
+    mem_arena_free(&arena);
+}
+
+
+/**
+ * RDBTableFilterCompile
+ *   compile rowkeyfilters and fieldfilters once filter nodes are final
+ */
+void RDBTableFilterCompile (RDBTableFilter filter)
+{
+    filter->rowkeyprog = RDBFilterProgCompile(&filter->arena, filter->rowkeyfilters, filter->rowkeyids[0]);
+    filter->fieldprog = RDBFilterProgCompile(&filter->arena, filter->fieldfilters, filter->getfieldids[0]);
 }
 
 
@@ -355,13 +710,6 @@ int RDBTableFilterRowkeyVals(RDBTableFilter filter, int prefixlen, char *rowkeys
         rkvals[i] = str;
         rkvalslen[i] = (int)(end - str);
 
-        if (filter) {
-            // scan match key needs filter
-            if (RDBFilterNodeExpr(filter->rowkeyfilters[i + 1], rkvals[i], rkvalslen[i]) != RDBTABLE_FILTER_ACCEPT) {
-                return (-1);
-            }
-        }
-
         i++;
         str = ++end;
     }
@@ -373,13 +721,15 @@ int RDBTableFilterRowkeyVals(RDBTableFilter filter, int prefixlen, char *rowkeys
     rkvals[i] = str;
     rkvalslen[i] = (int) (&rowkeystr[rowkeylen - 1] - str);
 
-    if (filter) {
-        if (RDBFilterNodeExpr(filter->rowkeyfilters[i+1], rkvals[i], rkvalslen[i]) != RDBTABLE_FILTER_ACCEPT) {
+    i++;
+
+    if (filter && filter->rowkeyprog) {
+        // scan match key needs filter
+        if (i != filter->rowkeyids[0] || RDBFilterProgExec(filter->rowkeyprog, rkvals, rkvalslen) != RDBTABLE_FILTER_ACCEPT) {
             return (-1);
         }
     }
 
-    i++;
     return i;
 }
 
@@ -390,6 +740,17 @@ int RDBTableFilterReplyCols (RDBTableFilter filter, redisReply *replyCols)
 
     int col = 0;
 
+    const char *colvals[RDBAPI_ARGV_MAXNUM + 1];
+    int colvalslen[RDBAPI_ARGV_MAXNUM + 1];
+
+    if (filter->pushdown) {
+        // rows accepted by scan script come with only selected fields
+        if (! replyCols || replyCols->type != REDIS_REPLY_ARRAY || replyCols->elements != (size_t) filter->selfieldnum) {
+            return (-1);
+        }
+        return filter->getfieldids[0];
+    }
+
     if (filter->getfieldids[0]) {
         if (! replyCols || replyCols->elements != filter->getfieldids[0]) {
             fprintf(stderr, "(%s:%d) SHOULD NEVER RUN TO THIS!\n", __FILE__, __LINE__);
@@ -404,11 +765,153 @@ int RDBTableFilterReplyCols (RDBTableFilter filter, redisReply *replyCols)
                 return (-1);
             }
 
-            if (RDBFilterNodeExpr(filter->fieldfilters[col+1], replyCol->str, (int)replyCol->len) != RDBTABLE_FILTER_ACCEPT) {
-                return (-1);
-            }
+            colvals[col] = replyCol->str;
+            colvalslen[col] = (int) replyCol->len;
+        }
+
+        if (RDBFilterProgExec(filter->fieldprog, colvals, colvalslen) != RDBTABLE_FILTER_ACCEPT) {
+            return (-1);
         }
     }
 
     return col;
 }
+
+
+// max integer of lua number (double) without precision loss
+#define RDBFILTER_LUA_INTMAX   ((ub8) 9007199254740992ULL)
+
+/**
+ * FilterNodePushExpr
+ *   get expr and kind of node for scan script:
+ *     kind: 's' - string; 'n' - number; 'z' - null
+ *
+ *   returns 0 if node cannot run in lua the same as doNodeExprValue
+ */
+static int FilterNodePushExpr (RDBFilterNode node, const char **expr, const char **kind)
+{
+    const char *exprs[] = {0, "eq", "ll", "rl", "lk", 0, "ne", "gt", "lt", "ge", "le"};
+
+    if (node->expr <= RDBFIL_IGNORE || node->expr >= filterexprs_count_max || ! exprs[node->expr]) {
+        // MATCH is tiny-regex-c pattern rather than lua one
+        return 0;
+    }
+
+    *expr = exprs[node->expr];
+
+    if (node->null_dest) {
+        *kind = "z";
+        return (node->expr == RDBFIL_EQUAL || node->expr == RDBFIL_NOT_EQUAL);
+    }
+
+    if (node->valtype == RDBVT_STR) {
+        *kind = "s";
+        return 1;
+    }
+
+    *kind = "n";
+
+    if (node->expr >= RDBFIL_LEFT_LIKE && node->expr <= RDBFIL_MATCH) {
+        // like on number always rejects
+        return 0;
+    }
+
+    switch (node->val_dest) {
+    case 1:
+        return (node->ub8_dest <= RDBFILTER_LUA_INTMAX);
+
+    case 3:
+        return (node->sb8_dest <= (sb8) RDBFILTER_LUA_INTMAX && node->sb8_dest >= - (sb8) RDBFILTER_LUA_INTMAX);
+
+    case 4:
+        return 1;
+    }
+
+    // hex or invalid dest
+    return 0;
+}
+
+
+/**
+ * RDBTableFilterPushdown
+ *   compile HMGET fields and fieldfilters into args of scan script.
+ *
+ * returns:
+ *   1: filter->pushdown set
+ *   0: no fieldfilters or some cannot be pushed down
+ */
+int RDBTableFilterPushdown (RDBTableFilter filter)
+{
+    int j, argc, numfilters = 0;
+
+    const char *expr, *kind;
+    RDBFilterNode node;
+
+    char *numbuf;
+
+    int fieldsnum = filter->getfieldids[0];
+
+    for (j = 1; j <= fieldsnum; j++) {
+        for (node = filter->fieldfilters[j]; node; node = node->next) {
+            if (node->expr != RDBFIL_IGNORE) {
+                if (! FilterNodePushExpr(node, &expr, &kind)) {
+                    return 0;
+                }
+                numfilters++;
+            }
+        }
+    }
+
+    if (! numfilters) {
+        return 0;
+    }
+
+    argc = 2 + fieldsnum + numfilters * 4;
+
+    // argv, argvlen and text of numbers in one block
+    filter->pushargv = (const char **) RDBMemAlloc((sizeof(char *) + sizeof(size_t)) * argc + 12 * (2 + numfilters));
+    filter->pushargvlen = (size_t *) &filter->pushargv[argc];
+
+    numbuf = (char *) &filter->pushargvlen[argc];
+
+    argc = 0;
+
+    filter->pushargv[argc] = numbuf;
+    filter->pushargvlen[argc++] = snprintf_chkd_V1(numbuf, 12, "%d", fieldsnum);
+    numbuf += 12;
+
+    filter->pushargv[argc] = numbuf;
+    filter->pushargvlen[argc++] = snprintf_chkd_V1(numbuf, 12, "%d", filter->selfieldnum);
+    numbuf += 12;
+
+    for (j = 0; j < fieldsnum; j++) {
+        filter->pushargv[argc] = filter->getfieldnames[j];
+        filter->pushargvlen[argc++] = filter->getfieldnameslen[j];
+    }
+
+    for (j = 1; j <= fieldsnum; j++) {
+        for (node = filter->fieldfilters[j]; node; node = node->next) {
+            if (node->expr != RDBFIL_IGNORE) {
+                FilterNodePushExpr(node, &expr, &kind);
+
+                filter->pushargv[argc] = numbuf;
+                filter->pushargvlen[argc++] = snprintf_chkd_V1(numbuf, 12, "%d", j);
+                numbuf += 12;
+
+                filter->pushargv[argc] = expr;
+                filter->pushargvlen[argc++] = 2;
+
+                filter->pushargv[argc] = kind;
+                filter->pushargvlen[argc++] = 1;
+
+                filter->pushargv[argc] = node->dest;
+                filter->pushargvlen[argc++] = node->destlen;
+            }
+        }
+    }
+
+    filter->pushargc = argc;
+    filter->pushdown = 1;
+
+    return 1;
+}
@@ -74,16 +74,106 @@ typedef struct _RDBFilterNode_t
         double dbl_dest;    // val_dest=4
     };
 
+    // pattern of RDBFIL_MATCH compiled once into node
+    re_t regex;
+
+    // 1: regex run by automaton (re_matchp_nfa)
+    int automaton;
+
     int destlen;
     char dest[0];
 } RDBFilterNode_t, *RDBFilterNode;
 
 
+// opcodes of compiled filter program
+#define RDBFILOP_REJECT       0   // always reject (dest not valid for type)
+#define RDBFILOP_ISNULL       1
+#define RDBFILOP_NOTNULL      2
+#define RDBFILOP_STRCMP       3
+#define RDBFILOP_LEFTLIKE     4
+#define RDBFILOP_RIGHTLIKE    5
+#define RDBFILOP_LIKE         6
+#define RDBFILOP_MATCH        7
+#define RDBFILOP_UB8          8
+#define RDBFILOP_UB8X         9
+#define RDBFILOP_SB8          10
+#define RDBFILOP_DBL          11
+
+
+typedef union
+{
+    ub8 u8;
+    sb8 s8;
+    double dbl;
+} RDBFilterNum_t;
+
+
+// one comparison of compiled filter program
+typedef struct _RDBFilterOp_t
+{
+    ub1 opcode;
+
+    // signs of compare accepted: bit0 (<), bit1 (=), bit2 (>)
+    ub1 signmask;
+
+    // 0-based column of values
+    sb2 col;
+
+    // 0-based slot caching number parsed from column per row
+    sb2 slot;
+
+    // order in program: more selective and cheaper first
+    sb2 rank;
+
+    // dest refers to filter node
+    int destlen;
+    const char *dest;
+
+    // dest parsed once for numeric opcodes
+    RDBFilterNum_t num;
+
+    // compiled pattern of node for RDBFILOP_MATCH
+    re_t regex;
+    int automaton;
+} RDBFilterOp_t;
+
+
+/**
+ * filter nodes of columns compiled into a flat program: comparators are
+ * resolved from value type and expr once, ops are ordered by selectivity
+ * and number of a cell is parsed once for all ops on its column.
+ */
+typedef struct _RDBFilterProg_t
+{
+    int numops;
+    int numslots;
+    RDBFilterOp_t ops[0];
+} RDBFilterProg_t, *RDBFilterProg;
+
+
+// cursor and page of one ZSET of index
+typedef struct _RDBIndexShard_t
+{
+    ub8 cursor;
+    int finished;
+
+    // members (with scores if merged by score) of page
+    redisReply *page;
+    size_t next;
+} RDBIndexShard_t;
+
+
 typedef struct _RDBTableFilter_t
 {
+    // filter itself, filter nodes and rows of result are carved from arena
+    mem_arena_t arena;
+
     // reference
     RDBSQLStmt sqlstmt;
 
+    // sqlfunc of sqlstmt copied at scan: result may outlive sqlstmt
+    int sqlfunc;
+
     // "tablespace.tablename"
     char table[RDB_KEY_NAME_MAXLEN *2 + 1];
 
@@ -105,12 +195,63 @@ typedef struct _RDBTableFilter_t
     // 1-based field value filters
     RDBFilterNode fieldfilters[RDBAPI_ARGV_MAXNUM + 1];
 
+    // rowkeyfilters and fieldfilters compiled by RDBTableFilterCompile.
+    //   NULL if no filter on columns
+    RDBFilterProg rowkeyprog;
+    RDBFilterProg fieldprog;
+
     // max field id (1-based) for select getfieldids
     int selfieldnum;
 
+    // value types of result columns: rowkey fields and then select fields
+    RDBValueType colvaltypes[RDBAPI_ARGV_MAXNUM + RDBAPI_KEYS_MAXNUM + 1];
+
     // use $HMGET than SCAN
     int use_hmget;
 
+    // 1: rows of DELETE have been deleted by parallel scan workers
+    int scandeleted;
+
+    // 1: fieldfilters are run by scan script on server
+    int pushdown;
+
+    // args of scan script compiled from HMGET fields and fieldfilters:
+    //   numget numsel field1 ... fieldN [col expr kind value] ...
+    int pushargc;
+    const char **pushargv;
+    size_t *pushargvlen;
+
+    // copy of table descriptor only if table has indexes to maintain
+    RDBTableDes_t *tabledes;
+
+    // 1: rows found by ZRANGEBYSCORE on index
+    // 2: rows found by ZRANGEBYLEX on index
+    int useindex;
+
+    // 1-based field index of index used. rowkey index if it is a rowkey
+    int indexfieldid;
+
+    // number of ZSET shards of index: 1 for field index
+    int indexshards;
+
+    // index range: [indexmin, indexmax]
+    int indexminlen;
+    char indexmin[RDB_ROWKEY_MAX_SIZE];
+
+    int indexmaxlen;
+    char indexmax[RDB_ROWKEY_MAX_SIZE];
+
+    RDBTableCursor_t indexstate;
+
+    // shards of index being merged, kept between calls if streaming
+    RDBIndexShard_t *indexcursors;
+
+    // rows passed filters on index
+    ub8 indexmatched;
+
+    // 1: rows are fetched batch by batch by RDBCursorFetch
+    int streaming;
+
     // rowkey pattern used in SCAN cursor MATCH $keypattern
     int patternprefixlen;
     int patternlen;
@@ -121,12 +262,18 @@ typedef struct _RDBTableFilter_t
 } RDBTableFilter_t;
 
 
-RDBFilterNode RDBFilterNodeAdd (RDBFilterNode existed, RDBFilterExpr expr, RDBValueType valtype, const char *dest, int destlen);
+RDBFilterNode RDBFilterNodeAdd (mem_arena_t *arena, RDBFilterNode existed, RDBFilterExpr expr, RDBValueType valtype, const char *dest, int destlen);
 
 void RDBFilterNodeFree (RDBFilterNode node);
 
 int RDBFilterNodeExpr (RDBFilterNode node, const char *sour, int sourlen);
 
+RDBFilterProg RDBFilterProgCompile (mem_arena_t *arena, RDBFilterNode filternodes[], int numcols);
+
+int RDBFilterProgExec (const RDBFilterProg_t *prog, const char *vals[], const int valslen[]);
+
+void RDBTableFilterCompile (RDBTableFilter filter);
+
 RDBTableFilter RDBTableFilterNew (RDBSQLStmt sqlstmt, const char *tablespace, const char *tablename);
 
 void RDBTableFilterFree (RDBTableFilter filter);
@@ -137,6 +284,8 @@ int RDBTableFilterRowkeyVals(RDBTableFilter filter, int prefixlen, char *rowkeys
 
 int RDBTableFilterReplyCols (RDBTableFilter filter, redisReply *replyCols);
 
+int RDBTableFilterPushdown (RDBTableFilter filter);
+
 
 #if defined(__cplusplus)
 }
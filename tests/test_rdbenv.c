@@ -0,0 +1,98 @@
+﻿/***********************************************************************
+* Copyright (c) 2008-2080 pepstack.com, 350137278@qq.com
+*
+* ALL RIGHTS RESERVED.
+* 
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+* 
+*   Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+* 
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+* A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+* OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+* SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+* LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+* THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+***********************************************************************/
+/**
+ * test_rdbenv.c
+ *   create and destroy env on nodes never reachable: seeds are on
+ *   TEST-NET-1 (192.0.2.0/24, RFC 5737) which is not routed, so no seed
+ *   answers 'cluster nodes' and nodes are used as given.
+ *
+ * @author: master@pepstack.com
+ *
+ * @create: 2019-10-18
+ * @update:
+ */
+#include "rdbcommon.h"
+
+
+// unroutable: no redis node could be there
+#define TEST_SEED_HOST  "192.0.2.1"
+
+
+static int test_env_create_free (void)
+{
+    int i;
+    RDBEnv env = NULL;
+
+    if (RDBEnvCreate("test@"TEST_SEED_HOST":7001,test@"TEST_SEED_HOST":7002,test@"TEST_SEED_HOST":7003", 1, 100, &env) != RDBAPI_SUCCESS) {
+        printf("FAILED: RDBEnvCreate\n");
+        return 1;
+    }
+
+    if (RDBEnvNumNodes(env) != 3 || env->topology->numnodes != 3 || RDBEnvTopologyEpoch(env) != 1) {
+        printf("FAILED: nodes=%d topology nodes=%d\n", RDBEnvNumNodes(env), env->topology->numnodes);
+        RDBEnvDestroy(env);
+        return 1;
+    }
+
+    for (i = 0; i < 3; i++) {
+        RDBEnvNode envnode = RDBEnvGetNode(env, i);
+
+        if (RDBEnvNodePort(envnode) != (ub4) (7001 + i) || strcmp(RDBEnvNodeHost(envnode), TEST_SEED_HOST)) {
+            printf("FAILED: node(%d) = %s\n", i, RDBEnvNodeHostPort(envnode));
+            RDBEnvDestroy(env);
+            return 1;
+        }
+
+        if (RDBEnvNodeGetMaster(envnode, NULL) == RDBAPI_TRUE) {
+            printf("FAILED: node(%d) has role before cluster checked\n", i);
+            RDBEnvDestroy(env);
+            return 1;
+        }
+    }
+
+    if (RDBEnvFindNode(env, TEST_SEED_HOST, 7002) != RDBEnvGetNode(env, 1) || RDBEnvFindNode(env, TEST_SEED_HOST, 7009)) {
+        printf("FAILED: RDBEnvFindNode\n");
+        RDBEnvDestroy(env);
+        return 1;
+    }
+
+    RDBEnvDestroy(env);
+    return 0;
+}
+
+
+int main (int argc, char *argv[])
+{
+    int i, nfailed = 0;
+
+    // repeated to catch leaks by valgrind
+    for (i = 0; i < 3; i++) {
+        nfailed += test_env_create_free();
+    }
+
+    printf("test_rdbenv: %s\n", nfailed? "FAILED" : "OK");
+
+    return nfailed? 1 : 0;
+}
@@ -0,0 +1,247 @@
+﻿/***********************************************************************
+* Copyright (c) 2008-2080 pepstack.com, 350137278@qq.com
+*
+* ALL RIGHTS RESERVED.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+*
+*   Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+* A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+* OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+* SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+* LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+* THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+***********************************************************************/
+/**
+ * test_rdbfilter.c
+ *   compiled filter program (RDBFilterProgExec) must accept the same rows
+ *   as filter nodes evaluated one by one (doNodeExprValue). values are
+ *   slices followed by digits, so reading past slice changes the result.
+ *
+ * @author: master@pepstack.com
+ *
+ * @create: 2019-10-18
+ * @update:
+ */
+#include "rdbtablefilter.h"
+
+
+#define TEST_NUMCOLS   5
+
+
+// value types of columns 1..TEST_NUMCOLS (0 not used)
+static const RDBValueType colvaltypes[TEST_NUMCOLS + 1] = {
+    RDBVT_STR, RDBVT_STR, RDBVT_STR, RDBVT_SB8, RDBVT_UB8X, RDBVT_FLT64
+};
+
+
+typedef struct
+{
+    int col;
+    RDBFilterExpr expr;
+    const char *dest;
+} TestFilter_t;
+
+
+typedef struct
+{
+    // expected: RDBTABLE_FILTER_ACCEPT or RDBTABLE_FILTER_REJECT
+    int accept;
+
+    // conjunction of filters (col 0: end)
+    TestFilter_t filters[4];
+
+    // values of columns 1..TEST_NUMCOLS as slices: vals[i][0..lens[i]).
+    //   NULL for null
+    const char *vals[TEST_NUMCOLS];
+    int lens[TEST_NUMCOLS];
+} TestCase_t;
+
+
+static const TestCase_t testcases[] = {
+    // AND of filters on one column and on columns
+    {1, {{1, RDBFIL_LEFT_LIKE, "ab"}, {1, RDBFIL_NOT_EQUAL, "abd"}, {2, RDBFIL_EQUAL, "x"}}, {"abc9", "x9", "1", "1", "1"}, {3, 1, 1, 1, 1}},
+    {0, {{1, RDBFIL_LEFT_LIKE, "ab"}, {2, RDBFIL_EQUAL, "x"}}, {"abc9", "x9", "1", "1", "1"}, {3, 2, 1, 1, 1}},
+
+    // NOT: != and not null
+    {0, {{1, RDBFIL_NOT_EQUAL, "abc"}}, {"abcd", "", "1", "1", "1"}, {3, 0, 1, 1, 1}},
+    {1, {{1, RDBFIL_NOT_EQUAL, "abc"}}, {"abcd", "", "1", "1", "1"}, {4, 0, 1, 1, 1}},
+    {0, {{2, RDBFIL_NOT_EQUAL, "(null)"}}, {"a", NULL, "1", "1", "1"}, {1, 0, 1, 1, 1}},
+    {1, {{2, RDBFIL_EQUAL, "(null)"}}, {"a", NULL, "1", "1", "1"}, {1, 0, 1, 1, 1}},
+
+    // MATCH stops at end of slice
+    {1, {{1, RDBFIL_MATCH, "^ab$"}}, {"abc", "", "1", "1", "1"}, {2, 0, 1, 1, 1}},
+    {0, {{1, RDBFIL_MATCH, "c"}}, {"abc", "", "1", "1", "1"}, {2, 0, 1, 1, 1}},
+    {1, {{1, RDBFIL_MATCH, "^\\d+$"}, {2, RDBFIL_MATCH, "^[a-z]*$"}}, {"1234x", "abc1", "1", "1", "1"}, {4, 3, 1, 1, 1}},
+
+    // LIKE inside slice
+    {0, {{1, RDBFIL_RIGHT_LIKE, "bc"}}, {"abcd", "", "1", "1", "1"}, {2, 0, 1, 1, 1}},
+    {0, {{1, RDBFIL_LIKE, "cd"}}, {"abcd", "", "1", "1", "1"}, {3, 0, 1, 1, 1}},
+
+    // numbers parsed from slice only
+    {0, {{3, RDBFIL_GREAT_THAN, "100"}}, {"a", "", "123", "1", "1"}, {1, 0, 2, 1, 1}},
+    {1, {{3, RDBFIL_EQUAL, "-12"}, {3, RDBFIL_LESS_EQUAL, "0"}}, {"a", "", "-123", "1", "1"}, {1, 0, 3, 1, 1}},
+    {1, {{4, RDBFIL_EQUAL, "ff"}}, {"a", "", "1", "fff", "1"}, {1, 0, 1, 2, 1}},
+    {1, {{4, RDBFIL_GREAT_EQUAL, "a0"}, {4, RDBFIL_LESS_THAN, "b0"}}, {"a", "", "1", "ab9", "1"}, {1, 0, 1, 2, 1}},
+    {0, {{3, RDBFIL_EQUAL, "1"}}, {"a", "", "x1", "1", "1"}, {1, 0, 2, 1, 1}},
+    {1, {{5, RDBFIL_LESS_EQUAL, "1.5"}}, {"a", "", "1", "1", "1.59"}, {1, 0, 1, 1, 3}},
+    {0, {{5, RDBFIL_GREAT_THAN, "1.5"}, {3, RDBFIL_EQUAL, "1"}}, {"a", "", "1", "1", "1.59"}, {1, 0, 1, 1, 3}}
+};
+
+
+// values of random rows: slices of them are taken
+static const char *randvals[] = {
+    "", "a", "ab", "abc", "abd", "b1", "0", "1", "12", "123", "-12", "ff", "1.5", "1.59", "2e3", "x"
+};
+
+static const char *randdests[] = {
+    "a", "ab", "abc", "b", "1", "12", "-12", "100", "ff", "1.5", "^a", "b$", "\\d+", "(null)"
+};
+
+static const RDBFilterExpr randexprs[] = {
+    RDBFIL_EQUAL, RDBFIL_NOT_EQUAL, RDBFIL_GREAT_THAN, RDBFIL_LESS_THAN, RDBFIL_GREAT_EQUAL,
+    RDBFIL_LESS_EQUAL, RDBFIL_LEFT_LIKE, RDBFIL_RIGHT_LIKE, RDBFIL_LIKE, RDBFIL_MATCH
+};
+
+
+// tree: filter nodes of columns evaluated one by one
+static int test_tree_exec (RDBFilterNode filternodes[], const char *vals[], int lens[])
+{
+    return RDBTableFilterNode(&filternodes[1], RDBVT_STR, vals, lens, TEST_NUMCOLS);
+}
+
+
+static int test_prog_exec (RDBFilterNode filternodes[], const char *vals[], int lens[])
+{
+    int accept;
+    mem_arena_t arena;
+
+    RDBFilterProg prog;
+
+    mem_arena_init(&arena, RDB_QUERY_ARENA_CHUNK);
+
+    prog = RDBFilterProgCompile(&arena, filternodes, TEST_NUMCOLS);
+    accept = RDBFilterProgExec(prog, vals, lens);
+
+    mem_arena_free(&arena);
+    return accept;
+}
+
+
+static int test_filter_cases (void)
+{
+    int i, k, nfailed = 0;
+
+    for (i = 0; i < (int) (sizeof(testcases) / sizeof(testcases[0])); i++) {
+        const TestCase_t *tc = &testcases[i];
+
+        RDBFilterNode filternodes[TEST_NUMCOLS + 1] = {0};
+
+        const char *vals[TEST_NUMCOLS];
+        int lens[TEST_NUMCOLS];
+
+        int tree, prog;
+
+        for (k = 0; k < 4 && tc->filters[k].col; k++) {
+            int col = tc->filters[k].col;
+
+            filternodes[col] = RDBFilterNodeAdd(NULL, filternodes[col], tc->filters[k].expr, colvaltypes[col], tc->filters[k].dest, -1);
+        }
+
+        memcpy(vals, tc->vals, sizeof(vals));
+        memcpy(lens, tc->lens, sizeof(lens));
+
+        tree = test_tree_exec(filternodes, vals, lens);
+        prog = test_prog_exec(filternodes, vals, lens);
+
+        if (tree != tc->accept || prog != tc->accept) {
+            printf("FAILED: case(%d) expected %d: tree=%d prog=%d\n", i, tc->accept, tree, prog);
+            nfailed++;
+        }
+
+        for (k = 1; k <= TEST_NUMCOLS; k++) {
+            RDBFilterNodeFree(filternodes[k]);
+        }
+    }
+
+    return nfailed;
+}
+
+
+static int test_filter_random (int numrows)
+{
+    int i, k, col, nfailed = 0;
+
+    srand(1);
+
+    for (i = 0; i < numrows; i++) {
+        RDBFilterNode filternodes[TEST_NUMCOLS + 1] = {0};
+
+        const char *vals[TEST_NUMCOLS];
+        int lens[TEST_NUMCOLS];
+
+        int tree, prog;
+
+        // 1..4 filters on random columns
+        for (k = rand() % 4; k >= 0; k--) {
+            col = 1 + rand() % TEST_NUMCOLS;
+
+            filternodes[col] = RDBFilterNodeAdd(NULL, filternodes[col],
+                randexprs[rand() % (sizeof(randexprs) / sizeof(randexprs[0]))],
+                colvaltypes[col],
+                randdests[rand() % (sizeof(randdests) / sizeof(randdests[0]))], -1);
+        }
+
+        for (col = 0; col < TEST_NUMCOLS; col++) {
+            if (rand() % 8 == 0) {
+                vals[col] = NULL;
+                lens[col] = 0;
+            } else {
+                vals[col] = randvals[rand() % (sizeof(randvals) / sizeof(randvals[0]))];
+                lens[col] = (int) strlen(vals[col]);
+
+                if (lens[col] && rand() % 2) {
+                    // slice without its last char
+                    lens[col]--;
+                }
+            }
+        }
+
+        tree = test_tree_exec(filternodes, vals, lens);
+        prog = test_prog_exec(filternodes, vals, lens);
+
+        if (tree != prog) {
+            printf("FAILED: row(%d) tree=%d prog=%d\n", i, tree, prog);
+            nfailed++;
+        }
+
+        for (col = 1; col <= TEST_NUMCOLS; col++) {
+            RDBFilterNodeFree(filternodes[col]);
+        }
+    }
+
+    return nfailed;
+}
+
+
+int main (int argc, char *argv[])
+{
+    int nfailed = 0;
+
+    nfailed += test_filter_cases();
+    nfailed += test_filter_random(20000);
+
+    printf("test_rdbfilter: %s\n", nfailed? "FAILED" : "OK");
+
+    return nfailed? 1 : 0;
+}